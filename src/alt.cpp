@@ -25,10 +25,20 @@
 */
 
 #include <vector>
+#include <algorithm>
 #include "cppcsp.h"
 
 using namespace csp;
 
+namespace
+{
+	///Finds the index of a guard that the alting process has been committed to (see Primitive::altCommit)
+	inline unsigned int CommittedIndex(const std::vector<Guard*>& guards,const Guard* committed)
+	{
+		return static_cast<unsigned int>(std::find(guards.begin(),guards.end(),committed) - guards.begin());
+	}
+}
+
 bool csp::SkipGuard::enable(internal::AltingProcessPtr)
 {
 	//Skip guards are always ready
@@ -111,10 +121,16 @@ csp::Alternative::Alternative(Guard** const guardArray,const unsigned int amount
 
 csp::Alternative::~Alternative()
 {
-	//Delete all the guards:
+	deleteOwnedGuards();
+}
+
+void csp::Alternative::deleteOwnedGuards()
+{
+	//Delete all the guards, apart from those owned by the user:
 
 	for (unsigned i = 0;i < guards.size();i++)
-		delete guards[i];
+		if (guards[i]->ownedByAlternative)
+			delete guards[i];
 }
 
 unsigned int csp::Alternative::priSelect()
@@ -157,6 +173,12 @@ GOTO_FoundAnOption:
 		}
 	}
 	
+	//A multiway synchronisation (such as an AltBarrier) that completed must be selected, whatever its priority:
+	if (altCommitted(thisProcess) != NULL)
+	{
+		selected = static_cast<signed int>(CommittedIndex(guards,altCommitted(thisProcess)));
+	}
+	
 	altFinish(thisProcess);
 
 	//Now activate the selected guard:
@@ -229,6 +251,12 @@ GOTO_FoundAnOption:
 		}
 	}
 	
+	//A multiway synchronisation (such as an AltBarrier) that completed must be selected, whatever its priority:
+	if (altCommitted(thisProcess) != NULL)
+	{
+		selected = static_cast<signed int>(CommittedIndex(guards,altCommitted(thisProcess)));
+	}
+	
 	altFinish(thisProcess);
 
 	//Now activate the selected guard:
@@ -264,3 +292,231 @@ Guard* csp::Alternative::replaceGuard(unsigned int index,Guard* guard)
 	guards[index] = guard;
 	return old;
 }
+
+void csp::internal::AltReadySet::remove(unsigned int index)
+{
+	mutex.claim();
+		if (isPending[index])
+		{
+			isPending[index] = false;
+			pending.erase(std::find(pending.begin(),pending.end(),index));
+		}
+	mutex.release();
+}
+
+namespace
+{
+	/**
+	*	Orders guard indexes by their priority in a select, where first has the highest priority
+	*	and the indexes wrap around after the last guard
+	*/
+	class SelectOrder
+	{
+	private:
+		const unsigned int first;
+		const unsigned int size;
+	public:
+		inline SelectOrder(unsigned int _first,unsigned int _size)
+			:	first(_first),size(_size)
+		{
+		}
+		
+		inline unsigned int key(unsigned int index) const
+		{
+			return (index >= first) ? (index - first) : (index + size - first);
+		}
+		
+		inline bool operator()(unsigned int a,unsigned int b) const
+		{
+			return key(a) < key(b);
+		}
+	};
+}
+
+void csp::ReadinessAlternative::attachAll()
+{
+	attached.resize(guards.size(),false);
+	//So that select never needs to allocate:
+	candidates.reserve(guards.size());
+	
+	for (unsigned int i = 0;i < guards.size();i++)
+	{
+		attached[i] = guards[i]->attach(&readySet,i);
+		if (false == attached[i])
+		{
+			unattached.push_back(i);
+		}
+	}
+}
+
+csp::ReadinessAlternative::~ReadinessAlternative()
+{
+	for (unsigned int i = 0;i < guards.size();i++)
+	{
+		if (attached[i])
+		{
+			guards[i]->detach();
+		}
+		if (guards[i]->ownedByAlternative)
+		{
+			delete guards[i];
+		}
+	}
+}
+
+unsigned int csp::ReadinessAlternative::select(const unsigned int first)
+{
+	const SelectOrder order(first,static_cast<unsigned int>(guards.size()));
+	
+	internal::AltingProcessPtr thisProcess( currentProcess() );
+	
+	//The unattached guards are enabled in priority order, so we start from the first one at or after first:
+	const unsigned int unattachedCount = static_cast<unsigned int>(unattached.size());
+	const unsigned int unattachedStart = static_cast<unsigned int>(std::lower_bound(unattached.begin(),unattached.end(),first) - unattached.begin());
+	
+	while (true)
+	{
+		altEnabling(thisProcess);
+		
+		//If any attached guards have signalled, we won't wait; otherwise the ready set will wake us:
+		bool ready = readySet.beginWait(thisProcess);
+		
+		unsigned int enabled = 0;
+		while (enabled < unattachedCount)
+		{
+			const unsigned int i = unattached[(unattachedStart + enabled) % unattachedCount];
+			enabled++;
+			if (guards[i]->enable(thisProcess))
+			{
+				ready = true;
+				break;
+			}
+		}
+		
+		if (false == ready && altShouldWait(thisProcess))
+		{
+			reschedule();
+		}
+		
+		readySet.endWait();
+		
+		//Disable in reverse order, so that the highest priority ready guard is the last one found:
+		bool found = false;
+		unsigned int selected = 0;
+		while (enabled > 0)
+		{
+			enabled--;
+			const unsigned int i = unattached[(unattachedStart + enabled) % unattachedCount];
+			if (guards[i]->disable(thisProcess))
+			{
+				selected = i;
+				found = true;
+			}
+		}
+		
+		//A multiway synchronisation (such as an AltBarrier) that completed must be selected, whatever its priority:
+		if (altCommitted(thisProcess) != NULL)
+		{
+			selected = CommittedIndex(guards,altCommitted(thisProcess));
+			altFinish(thisProcess);
+			guards[selected]->activate();
+			return selected;
+		}
+		
+		altFinish(thisProcess);
+		
+		//Check the signalled guards in priority order, up to the first one that is really ready.
+		//Those that are no longer ready are dropped; they will signal again when they next become ready:
+		readySet.takeAll(&candidates);
+		std::sort(candidates.begin(),candidates.end(),order);
+		
+		std::vector<unsigned int>::const_iterator it = candidates.begin();
+		for (;it != candidates.end();it++)
+		{
+			if (found && order.key(*it) > order.key(selected))
+			{
+				//An unattached guard has priority over the rest
+				break;
+			}
+			
+			if (guards[*it]->ready())
+			{
+				selected = *it;
+				found = true;
+				break;
+			}
+		}
+		
+		//The selected guard and the ones we did not check may still be ready, so they go back in the set:
+		readySet.putBack(it,candidates.end());
+		
+		if (found)
+		{
+			guards[selected]->activate();
+			return selected;
+		}
+		
+		//All the signalled guards had stopped being ready, so go round again
+	}
+}
+
+unsigned int csp::ReadinessAlternative::priSelect()
+{
+	const unsigned int selected = select(0);
+	
+	favourite = selected + 1;
+	if (favourite >= guards.size())
+		favourite -= static_cast<unsigned int>(guards.size());
+	
+	return selected;
+}
+
+unsigned int csp::ReadinessAlternative::fairSelect()
+{
+	const unsigned int selected = select(favourite);
+	
+	favourite = selected + 1;
+	if (favourite >= guards.size())
+		favourite -= static_cast<unsigned int>(guards.size());
+	
+	return selected;
+}
+
+unsigned int csp::ReadinessAlternative::sameSelect()
+{
+	const unsigned int selected = select(favourite);
+	
+	favourite = selected;
+	
+	return selected;
+}
+
+Guard* csp::ReadinessAlternative::replaceGuard(unsigned int index,Guard* guard)
+{
+	if (index >= guards.size())
+	{
+		return NULL;
+	}
+	
+	Guard* old = guards[index];
+	if (attached[index])
+	{
+		old->detach();
+		//Remove any signal it left behind, before the new guard can signal:
+		readySet.remove(index);
+	}
+	
+	guards[index] = guard;
+	attached[index] = guard->attach(&readySet,index);
+	
+	unattached.clear();
+	for (unsigned int i = 0;i < guards.size();i++)
+	{
+		if (false == attached[i])
+		{
+			unattached.push_back(i);
+		}
+	}
+	
+	return old;
+}
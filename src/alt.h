@@ -20,16 +20,146 @@
 #include <vector>
 #include <list>
 
+class AltChannelTest;
+
 namespace csp
 {
 	class Alternative;
+	class ReadinessAlternative;
+	
+	namespace internal
+	{
+		/**@internal
+		*	The set of guards that have signalled (to a ReadinessAlternative) that they may have become ready.
+		*
+		*	Guards attached to the set call signal() with their index, holding their channel's mutex, whenever their
+		*	channel becomes ready.  Each index is only held in the set once.  If the alternative has registered
+		*	itself as waiting, signal() frees it, using the usual alting state-machine, so the alternative may
+		*	wait on a mixture of attached guards and normally-enabled guards.
+		*
+		*	The set never allocates memory after it is constructed, because it holds at most one entry per guard.
+		*/
+		class AltReadySet : private Primitive, public boost::noncopyable
+		{
+		private:
+			PureSpinMutex mutex;
+			std::vector<unsigned int> pending;
+			std::vector<bool> isPending;
+			///The alting process, if it is waiting for a signal
+			AltingProcessPtr alter;
+		public:
+			inline explicit AltReadySet(unsigned int size)
+				:	isPending(size,false),alter(NullProcessPtr)
+			{
+				pending.reserve(size);
+			}
+			
+			///Adds the index to the set (if it is not already there) and frees the alter if it is waiting
+			inline void signal(unsigned int index)
+			{
+				mutex.claim();
+					if (false == isPending[index])
+					{
+						isPending[index] = true;
+						pending.push_back(index);
+					}
+					
+					if (alter != NullProcessPtr)
+					{
+						freeProcessMaybe(alter);
+						alter = NullProcessPtr;
+					}
+				mutex.release();
+			}
+			
+			/**@internal
+			*	Registers the alter as waiting for a signal, unless the set is already non-empty.
+			*
+			*	@return True if the set is non-empty
+			*/
+			inline bool beginWait(AltingProcessPtr proc)
+			{
+				bool any;
+				mutex.claim();
+					any = (false == pending.empty());
+					if (false == any)
+					{
+						alter = proc;
+					}
+				mutex.release();
+				return any;
+			}
+			
+			///Unregisters the alter; after this, signals only add to the set
+			inline void endWait()
+			{
+				mutex.claim();
+					alter = NullProcessPtr;
+				mutex.release();
+			}
+			
+			///Moves the whole set into taken (which must have enough capacity to hold every index)
+			inline void takeAll(std::vector<unsigned int>* taken)
+			{
+				mutex.claim();
+					taken->assign(pending.begin(),pending.end());
+					for (unsigned int i = 0;i < pending.size();i++)
+					{
+						isPending[pending[i]] = false;
+					}
+					pending.clear();
+				mutex.release();
+			}
+			
+			///Puts indexes that were taken back into the set, without freeing the alter
+			inline void putBack(std::vector<unsigned int>::const_iterator begin,std::vector<unsigned int>::const_iterator end)
+			{
+				mutex.claim();
+					for (;begin != end;begin++)
+					{
+						if (false == isPending[*begin])
+						{
+							isPending[*begin] = true;
+							pending.push_back(*begin);
+						}
+					}
+				mutex.release();
+			}
+			
+			///Removes an index from the set, if it is there
+			void remove(unsigned int index);
+			
+			//For testing:
+			friend class ::AltChannelTest;
+		};
+		
+		/**@internal
+		*	Storage for a channel's guard, so that the guard can be constructed (with placement new) inside
+		*	another object rather than on the heap.  All the channel guards are only a few pointers in size;
+		*	place() checks at compile-time that the guard fits.
+		*/
+		class GuardStorage : public boost::noncopyable
+		{
+		private:
+			boost::aligned_storage<6 * sizeof(void*)>::type storage;
+		public:
+			template <typename GUARD>
+			inline void* place()
+			{
+				BOOST_STATIC_ASSERT(sizeof(GUARD) <= sizeof(storage));
+				return &storage;
+			}
+		};
+		
+		class EmbeddedGuard;
+	} //namespace internal
 	
 	/**
 	*	An <tt>ALT</tt> guard.
 	*
 	*	A guard in an Alternative represents one possible choice for the Alternative to select.
 	*	There are three different types of guards supplied with C++CSP2:
-	*	- Channel guards; use methods such as AltChanin::inputGuard()
+	*	- Channel guards; use methods such as AltChanin::inputGuard() and AltChanout::outputGuard()
 	*	- Timeout guards; RelTimeoutGuard and TimeoutGuard
 	*	- The skip guard, SkipGuard
 	*
@@ -61,18 +191,133 @@ namespace csp
 		*	but for channel guards it performs the communication
 		*/
 		virtual void activate() {}
+		
+		/**@internal
+		*	Attaches the guard to a ReadinessAlternative's ready set.
+		*
+		*	Until detach() is called, the guard must call set->signal(index) whenever it becomes ready
+		*	(including straight away, if it is ready now).  Spurious signals are allowed; the alternative checks
+		*	each signalled guard with ready() before selecting it.
+		*
+		*	Guards that cannot do this return false (the default), and are then enabled and disabled as normal in each select.
+		*
+		*	@return Whether the guard was attached
+		*/
+		virtual bool attach(internal::AltReadySet*,unsigned int) {return false;}
+		
+		/**@internal
+		*	Detaches a guard that was successfully attached
+		*/
+		virtual void detach() {}
+		
+		/**@internal
+		*	Checks whether an attached guard is ready now.  This is only called on attached guards.
+		*/
+		virtual bool ready() {return false;}
+		
+		inline Guard()
+			:	ownedByAlternative(true)
+		{
+		}
+		
+		/**@internal
+		*	Constructs a guard that is owned by whoever constructed it (such as an InputGuard), rather than
+		*	by the Alternative it is put into.  The Alternative will not delete it.
+		*/
+		inline explicit Guard(bool _ownedByAlternative)
+			:	ownedByAlternative(_ownedByAlternative)
+		{
+		}
+
+	private:
+		///Whether the Alternative (or ReadinessAlternative) holding the guard should delete it
+		bool ownedByAlternative;
 
 	public:
 		///@internal Empty virtual destructor
 		virtual ~Guard() {};
 
 		/**@internal
-		*	Alternative is a friend because:
+		*	Alternative and ReadinessAlternative are friends because:
 		*
-		*	It needs to call our functions
+		*	They need to call our functions
 		*/
 		friend class Alternative;
+		friend class ReadinessAlternative;
+		
+		/**@internal
+		*	EmbeddedGuard is a friend because it passes each call on to the channel's guard that it holds
+		*/
+		friend class internal::EmbeddedGuard;
 	};
+	
+	namespace internal
+	{
+		/**@internal
+		*	The base of InputGuard and OutputGuard.  It holds a channel's guard, constructed in its own storage
+		*	rather than on the heap, and passes each call on to that guard.
+		*/
+		class EmbeddedGuard : public Guard, public boost::noncopyable
+		{
+		private:
+			///The channel's guard, constructed in storage
+			Guard* guard;
+		protected:
+			GuardStorage storage;
+			
+			virtual bool enable(AltingProcessPtr proc)
+			{
+				return guard->enable(proc);
+			}
+			
+			virtual bool disable(AltingProcessPtr proc)
+			{
+				return guard->disable(proc);
+			}
+			
+			virtual void activate()
+			{
+				guard->activate();
+			}
+			
+			virtual bool attach(AltReadySet* set,unsigned int index)
+			{
+				return guard->attach(set,index);
+			}
+			
+			virtual void detach()
+			{
+				guard->detach();
+			}
+			
+			virtual bool ready()
+			{
+				return guard->ready();
+			}
+			
+			inline EmbeddedGuard()
+				:	Guard(false),guard(NULL)
+			{
+			}
+			
+			///Must be called once by the sub-class's constructor, with the guard that it has constructed in storage
+			inline void hold(Guard* _guard)
+			{
+				guard = _guard;
+			}
+		public:
+			virtual ~EmbeddedGuard()
+			{
+				if (guard != NULL)
+				{
+					guard->~Guard();
+				}
+			}
+			
+			//For testing:
+			friend class ::AltChannelTest;
+		};
+	} //namespace internal
 
 	/**
 	*	An <tt>ALT</tt> relative timeout guard, for use in an Alternative.
@@ -236,6 +481,12 @@ namespace csp
 	*	perform a fair <tt>ALT</tt> or <tt>PRI ALT</tt> on these guards
 	*	any number of times (even switching between fairSelect and priSelect as you wish).
 	*
+	*	The guards returned by AltChanin::inputGuard() are allocated on the heap, and are deleted by the Alternative.
+	*	Where that matters (for example, in a process that builds a new Alternative for each select), use InputGuard
+	*	instead.  An InputGuard holds the channel's guard inside itself, so it can be a local variable or a member
+	*	alongside the channel end, and the Alternative does not delete it.  Together with rearm(), this allows the guards
+	*	of an Alternative to be changed between selects without allocating any memory.
+	*
 	*	@section compat C++CSP v1.x Compatibility
 	*
 	*	In C++CSP v1.x, inputGuard() (and extInputGuard) took a parameter specifying where to store the data, and then the
@@ -263,6 +514,9 @@ namespace csp
 		*	Favourite index for fair <tt>ALT</tt>s
 		*/
 		signed int favourite;
+		
+		///Deletes the guards in the array that the Alternative owns
+		void deleteOwnedGuards();
 
 	public:
 		/** 
@@ -315,9 +569,54 @@ namespace csp
 		/**
 		*	Destructor.
 		*
-		*	It destroys all the guards in its guard array
+		*	It destroys all the guards in its guard array (except for guards such as InputGuard that are
+		*	owned by the user)
 		*/
 		~Alternative();
+		
+		/**
+		*	Re-arms the Alternative with a new array of guards, in place of the current ones.
+		*
+		*	This is useful for processes whose set of guards changes from one select to the next (for example,
+		*	a buffer process that only wants input while it has space, and only wants to offer output while it has data).
+		*	Used with InputGuard, which is constructed without allocating memory, this allows such a process to choose a new
+		*	subset of its guards before each select without allocating any memory:
+		*	@code
+				InputGuard<int> dataGuard(dataIn);
+				InputGuard<bool> controlGuard(controlIn);
+				Guard* guards[2];
+				Alternative alt(guards,0);
+				
+				while (true)
+				{
+					guards[0] = &controlGuard;
+					unsigned int n = 1;
+					if (wantData)
+						guards[n++] = &dataGuard;
+					alt.rearm(guards,guards + n);
+					
+					switch (alt.priSelect())
+					...
+				}
+			@endcode
+		*
+		*	The guards that the Alternative owns are deleted, as they would be by the destructor, so the
+		*	guards in the new array should be either new guards or guards that the Alternative does not own.
+		*	Memory is only allocated if the new array is larger than any the Alternative has held before.
+		*	The fairness of fairSelect() is kept across re-arms that do not change the number of guards.
+		*
+		*	ITERATOR is the same as for the iterator constructor.
+		*/
+		template <typename ITERATOR>
+		inline void rearm(ITERATOR begin,ITERATOR end)
+		{
+			deleteOwnedGuards();
+			guards.assign(begin,end);
+			if (favourite >= static_cast<signed int>(guards.size()))
+			{
+				favourite = 0;
+			}
+		}
 
 		/**
 		*	Performs a <tt>PRI ALT</tt> on the guard array
@@ -370,7 +669,118 @@ namespace csp
 		*	@return The old guard, must be deleted or otherwise dealt with
 		*/
 		Guard* replaceGuard(unsigned int index,Guard* guard);
-
+		
+		//For testing:
+		friend class ::AltChannelTest;
 	}; //class Alternative
+	
+	/**
+	*	An Alternative for selecting between very large numbers of channels, where each select only costs
+	*	time in proportion to the number of guards that are ready (rather than the total number of guards).
+	*
+	*	A normal Alternative enables every guard (claiming each channel's mutex) at the start of every select,
+	*	and disables them all again at the end, so a process alting over thousands of channels does thousands of
+	*	mutex claims per select even if only one channel is ready.  A ReadinessAlternative instead attaches its
+	*	channel guards to the channels once, when it is constructed.  From then on, each channel signals the
+	*	ReadinessAlternative whenever it becomes ready, and a select only looks at the channels that have signalled.
+	*
+	*	ReadinessAlternative is used exactly like Alternative, and priSelect(), fairSelect() and sameSelect()
+	*	select the same guards that they would on an Alternative with the same guards:
+	*	@code
+			vector<Guard*> guards;
+			for (unsigned i = 0;i < clients.size();i++)
+				guards.push_back(clients[i].inputGuard());
+			ReadinessAlternative alt(guards);
+			
+			while (true)
+			{
+				unsigned i = alt.fairSelect();
+				clients[i] >> request;
+				... Process the request ...
+			}
+		@endcode
+	*
+	*	The guards for One2OneChannel, BufferedOne2OneChannel and BufferedAny2OneChannel (and their instrumented versions) support
+	*	being attached.  Other guards (such as timeout guards, skip guards and the guards for the other channel types) are
+	*	enabled and disabled in each select, as they would be in an Alternative, so they still work but still cost time
+	*	in every select.  A channel can only be attached to one ReadinessAlternative at a time; if the same channel appears
+	*	in more than one ReadinessAlternative (or more than once in the same one), its later guards are treated the same way.
+	*
+	*	Because the guards are attached for the whole life of the ReadinessAlternative, the ReadinessAlternative must be
+	*	destroyed before any of its channels are.  As with Alternative, it deletes all its guards (other than InputGuard and
+	*	other guards owned by the user) when it is destroyed.
+	*
+	*	@see Alternative
+	*/
+	class ReadinessAlternative : private internal::Primitive, public boost::noncopyable
+	{
+	private:
+		std::vector<Guard*> guards;
+		///Whether each guard is attached to readySet
+		std::vector<bool> attached;
+		///The indexes of the guards that are not attached, in order
+		std::vector<unsigned int> unattached;
+		///Working space for select, held here to avoid allocating memory in each select
+		std::vector<unsigned int> candidates;
+		internal::AltReadySet readySet;
+		
+		///Favourite index for fair <tt>ALT</tt>s
+		unsigned int favourite;
+		
+		void attachAll();
+		
+		/**
+		*	Selects a ready guard, giving priority to first, then first + 1, and so on (wrapping around).
+		*/
+		unsigned int select(unsigned int first);
+	public:
+		/**
+		*	Constructs the ReadinessAlternative, attaching all the guards that support it to their channels
+		*/
+		inline explicit ReadinessAlternative(const std::list<Guard*>& _guards)
+			:	guards(_guards.begin(),_guards.end()),readySet(static_cast<unsigned int>(_guards.size())),favourite(0)
+		{
+			attachAll();
+		}
+		
+		/**
+		*	@overload
+		*/
+		inline explicit ReadinessAlternative(const std::vector<Guard*>& _guards)
+			:	guards(_guards),readySet(static_cast<unsigned int>(_guards.size())),favourite(0)
+		{
+			attachAll();
+		}
+		
+		/**
+		*	Destructor.  Detaches all the guards, and then destroys them.
+		*/
+		~ReadinessAlternative();
+		
+		/**
+		*	Performs a <tt>PRI ALT</tt> on the guards.  @see Alternative::priSelect()
+		*/
+		unsigned int priSelect();
+		
+		/**
+		*	Performs a fair <tt>ALT</tt> on the guards.  @see Alternative::fairSelect()
+		*/
+		unsigned int fairSelect();
+		
+		/**
+		*	Performs a "same" <tt>ALT</tt> on the guards.  @see Alternative::sameSelect()
+		*/
+		unsigned int sameSelect();
+		
+		/**
+		*	Replaces a guard.  @see Alternative::replaceGuard()
+		*
+		*	The old guard is detached from its channel before it is returned.
+		*/
+		Guard* replaceGuard(unsigned int index,Guard* guard);
+		
+		//For testing:
+		friend class ::AltChannelTest;
+	}; //class ReadinessAlternative
 
 } //namespace csp
@@ -0,0 +1,296 @@
+/*
+*	The Kent C++CSP Library
+*	Copyright (C) 2002-2007 Neil Brown
+*
+*	This library is free software; you can redistribute it and/or
+*	modify it under the terms of the GNU Lesser General Public
+*	License as published by the Free Software Foundation; either
+*	version 2.1 of the License, or (at your option) any later version.
+*
+*	This library is distributed in the hope that it will be useful,
+*	but WITHOUT ANY WARRANTY; without even the implied warranty of
+*	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+*	Lesser General Public License for more details.
+*
+*	You should have received a copy of the GNU Lesser General Public
+*	License along with this library; if not, write to the Free Software
+*	Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+/** @internal@file alt_barrier.cpp
+*	@brief Implements AltBarrier, and its guard
+*/
+
+#include "cppcsp.h"
+
+using namespace csp;
+using namespace csp::internal;
+
+namespace
+{
+	/**
+	*	The lock shared by all the AltBarriers.  A process may offer to sync on several barriers
+	*	in one alt, so completing a sync must be atomic with respect to every other barrier, not just its own.
+	*/
+	PureSpinMutex AltBarrierOracle;
+}
+
+namespace csp
+{
+	namespace internal
+	{
+		/**@internal
+		*	One member of an AltBarrier.  Its address is the key of the enrollment.
+		*
+		*	While the member is offering to sync, it is in its barrier's list of offerers.  guard is the
+		*	guard that the process has enabled, or NULL if the process is waiting in sync().
+		*/
+		class AltBarrierMember
+		{
+		public:
+			Process* process;
+			Guard* guard;
+			AltBarrierMember* prev;
+			AltBarrierMember* next;
+			bool offering;
+
+			inline AltBarrierMember()
+				:	process(NULL),guard(NULL),prev(NULL),next(NULL),offering(false)
+			{
+			}
+		};
+
+		/**@internal
+		*	The guard returned by AltBarrierEnd::guard()
+		*/
+		class AltBarrierGuard : public Guard
+		{
+		private:
+			AltBarrier* barrier;
+			AltBarrierMember* member;
+		protected:
+			virtual bool enable(AltingProcessPtr proc)
+			{
+				return barrier->enable(member,this,proc);
+			}
+
+			virtual bool disable(AltingProcessPtr proc)
+			{
+				return barrier->disable(member,this,proc);
+			}
+		public:
+			inline AltBarrierGuard(AltBarrier* _barrier,AltBarrierMember* _member)
+				:	barrier(_barrier),member(_member)
+			{
+			}
+		};
+	}
+}
+
+csp::AltBarrier::AltBarrier()
+	:	enrolled(0),offering(0),offerers(NULL)
+{
+}
+
+csp::AltBarrier::~AltBarrier() __CPPCSP_THROWING_DESTRUCTOR
+{
+	if (false == std::uncaught_exception())
+	{
+		//Claim the lock to make sure no-one is currently finishing a sync:
+		AltBarrierOracle.claim();
+			const unsigned int stillEnrolled = enrolled;
+		AltBarrierOracle.release();
+
+		if (stillEnrolled != 0)
+		{
+			throw BarrierError("AltBarrier was destroyed while some processes were still enrolled on it");
+		}
+	}
+}
+
+void csp::AltBarrier::addOfferer(AltBarrierMember* member)
+{
+	member->offering = true;
+	member->prev = NULL;
+	member->next = offerers;
+	if (offerers != NULL)
+	{
+		offerers->prev = member;
+	}
+	offerers = member;
+	offering++;
+}
+
+void csp::AltBarrier::removeOfferer(AltBarrierMember* member)
+{
+	member->offering = false;
+	if (member->prev != NULL)
+	{
+		member->prev->next = member->next;
+	}
+	else
+	{
+		offerers = member->next;
+	}
+	if (member->next != NULL)
+	{
+		member->next->prev = member->prev;
+	}
+	offering--;
+}
+
+bool csp::AltBarrier::tryComplete(Process* self)
+{
+	AltBarrierMember* member;
+	AltBarrierMember* next;
+
+	//Alting members that another barrier has already committed will not sync on this one.
+	//Their disable would withdraw them anyway; we do it now, and the sync cannot complete yet:
+	bool committedElsewhere = false;
+	for (member = offerers;member != NULL;member = next)
+	{
+		next = member->next;
+		if (member->guard != NULL && altCommitted(member->process) != NULL)
+		{
+			removeOfferer(member);
+			committedElsewhere = true;
+		}
+	}
+
+	if (committedElsewhere)
+	{
+		return false;
+	}
+
+	//Everyone is offering, so commit the alters to our guard and free the syncers.
+	//The member must not be touched once its process is freed, as it may then resign:
+	for (member = offerers;member != NULL;member = next)
+	{
+		next = member->next;
+		member->offering = false;
+		if (member->guard != NULL)
+		{
+			altCommit(member->process,member->guard);
+		}
+		else if (member->process != self)
+		{
+			freeProcessNoAlt(member->process);
+		}
+	}
+
+	offerers = NULL;
+	offering = 0;
+	return true;
+}
+
+bool csp::AltBarrier::enable(AltBarrierMember* member,Guard* guard,AltingProcessPtr proc)
+{
+	bool ready;
+
+	AltBarrierOracle.claim();
+		if (altCommitted(proc) != NULL)
+		{
+			//Another barrier earlier in this alt has committed us, so we must not offer on this one.
+			//Stop enabling; the alt will select the committed guard:
+			ready = true;
+		}
+		else
+		{
+			if (false == member->offering)
+			{
+				member->process = proc;
+				member->guard = guard;
+				addOfferer(member);
+
+				if (offering == enrolled)
+				{
+					tryComplete(proc);
+				}
+			}
+
+			ready = (altCommitted(proc) == guard);
+		}
+	AltBarrierOracle.release();
+
+	return ready;
+}
+
+bool csp::AltBarrier::disable(AltBarrierMember* member,Guard* guard,AltingProcessPtr proc)
+{
+	bool ready;
+
+	AltBarrierOracle.claim();
+		if (member->offering && member->guard == guard)
+		{
+			//Withdraw the offer:
+			removeOfferer(member);
+		}
+
+		ready = (altCommitted(proc) == guard);
+	AltBarrierOracle.release();
+
+	return ready;
+}
+
+void* csp::AltBarrier::enroll()
+{
+	AltBarrierOracle.claim();
+		enrolled++;
+	AltBarrierOracle.release();
+
+	return new AltBarrierMember;
+}
+
+void csp::AltBarrier::halfEnroll()
+{
+	AltBarrierOracle.claim();
+		enrolled++;
+	AltBarrierOracle.release();
+}
+
+void* csp::AltBarrier::completeEnroll()
+{
+	//We were already counted by halfEnroll():
+	return new AltBarrierMember;
+}
+
+void csp::AltBarrier::resign(void* key)
+{
+	AltBarrierOracle.claim();
+		enrolled--;
+
+		//Everyone left may now be offering:
+		if (enrolled > 0 && offering == enrolled)
+		{
+			tryComplete(NULL);
+		}
+	AltBarrierOracle.release();
+
+	delete static_cast<AltBarrierMember*>(key);
+}
+
+void csp::AltBarrier::sync(void* key)
+{
+	AltBarrierMember* member = static_cast<AltBarrierMember*>(key);
+	Process* self = currentProcess();
+	bool completed;
+
+	AltBarrierOracle.claim();
+		member->process = self;
+		member->guard = NULL;
+		addOfferer(member);
+
+		completed = (offering == enrolled) && tryComplete(self);
+	AltBarrierOracle.release();
+
+	if (false == completed)
+	{
+		//The process that completes the sync will free us:
+		reschedule();
+	}
+}
+
+Guard* csp::AltBarrier::guard(void* key)
+{
+	return new AltBarrierGuard(this,static_cast<AltBarrierMember*>(key));
+}
@@ -21,3 +21,108 @@
 
 //This code has been moved to atomic_impl.h
 
+
+#ifdef CPPCSP_POSIX
+	#include <sys/mman.h>
+	#include <unistd.h>
+	#ifdef CPPCSP_LINUX
+		#include <sys/syscall.h>
+	#endif
+#endif
+
+namespace
+{
+	csp::internal::PureSpinMutex AsymmetricBarrierMutex;
+	
+	/*
+	*	Changing the protection of a page that the program has touched makes the operating system interrupt
+	*	every processor that is running one of our threads (to flush its TLB), which is a full memory barrier on each of them.
+	*	This is the fall-back when the operating system has no more direct way of doing it.
+	*/
+	void* DummyPage = NULL;
+	
+	void ProtectionBarrier()
+	{
+	#ifdef CPPCSP_WINDOWS
+		DWORD old;
+		if (DummyPage == NULL)
+		{
+			DummyPage = ::VirtualAlloc(NULL,1,MEM_RESERVE | MEM_COMMIT,PAGE_READWRITE);
+		}
+		::VirtualProtect(DummyPage,1,PAGE_READWRITE,&old);
+		*static_cast<volatile char*>(DummyPage) = 0;
+		::VirtualProtect(DummyPage,1,PAGE_NOACCESS,&old);
+	#else
+		if (DummyPage == NULL)
+		{
+			DummyPage = ::mmap(NULL,::getpagesize(),PROT_READ | PROT_WRITE,MAP_PRIVATE | MAP_ANON,-1,0);
+		}
+		::mprotect(DummyPage,::getpagesize(),PROT_READ | PROT_WRITE);
+		*static_cast<volatile char*>(DummyPage) = 0;
+		::mprotect(DummyPage,::getpagesize(),PROT_NONE);
+	#endif
+	}
+	
+	enum BarrierMethod
+	{
+		BarrierMethodUnknown,
+		BarrierMethodSystem,
+		BarrierMethodProtection
+	} Method = BarrierMethodUnknown;
+	
+#ifdef CPPCSP_WINDOWS
+	typedef VOID (WINAPI *FlushProcessWriteBuffersFunction)();
+	FlushProcessWriteBuffersFunction FlushProcessWriteBuffersPointer = NULL;
+#endif
+
+#ifdef CPPCSP_LINUX
+	//From linux/membarrier.h, which older systems do not have:
+	enum
+	{
+		MembarrierPrivateExpedited = (1 << 3),
+		MembarrierRegisterPrivateExpedited = (1 << 4)
+	};
+#endif
+	
+	///Finds out whether the operating system can do the barrier for us (Windows Vista onwards, Linux 4.14 onwards)
+	BarrierMethod ChooseMethod()
+	{
+	#ifdef CPPCSP_WINDOWS
+		HMODULE kernel32 = ::GetModuleHandleA("kernel32.dll");
+		if (kernel32 != NULL)
+		{
+			FlushProcessWriteBuffersPointer = reinterpret_cast<FlushProcessWriteBuffersFunction>(::GetProcAddress(kernel32,"FlushProcessWriteBuffers"));
+		}
+		return (FlushProcessWriteBuffersPointer != NULL) ? BarrierMethodSystem : BarrierMethodProtection;
+	#elif defined(CPPCSP_LINUX) && defined(SYS_membarrier)
+		return (::syscall(SYS_membarrier,MembarrierRegisterPrivateExpedited,0) == 0) ? BarrierMethodSystem : BarrierMethodProtection;
+	#else
+		return BarrierMethodProtection;
+	#endif
+	}
+}
+
+void csp::internal::AsymmetricBarrier()
+{
+	AsymmetricBarrierMutex.claim();
+	
+		if (Method == BarrierMethodUnknown)
+		{
+			Method = ChooseMethod();
+		}
+		
+		if (Method == BarrierMethodSystem)
+		{
+		#ifdef CPPCSP_WINDOWS
+			FlushProcessWriteBuffersPointer();
+		#elif defined(CPPCSP_LINUX) && defined(SYS_membarrier)
+			::syscall(SYS_membarrier,MembarrierPrivateExpedited,0);
+		#endif
+		}
+		else
+		{
+			ProtectionBarrier();
+		}
+		
+	AsymmetricBarrierMutex.release();
+}
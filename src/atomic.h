@@ -232,7 +232,26 @@ namespace csp
 	{
 		return static_cast<DATA_TYPE*>(_AtomicSwap(reinterpret_cast<__CPPCSP_ALIGNED_VOID_PTR *>(address),value));
 	}
-				
+
+	/**@internal
+	*	Stops the compiler moving reads and writes of memory across this point.  It does not stop the processor
+	*	reordering them, but on x86 and x86-64 a write is never reordered with an earlier write, so this is enough
+	*	to make sure that a set of writes is visible to other threads before a flag that is written after them.
+	*/
+	inline void CompilerBarrier();
+
+	/**@internal
+	*	Makes every other thread of the program that is currently running on a processor execute a full memory barrier,
+	*	before this function returns.  Threads that are not currently running have already had one, by being switched out.
+	*
+	*	This is very slow (it involves the operating system interrupting the other processors), but it allows a thread
+	*	that performs an operation very often to do without any memory barriers of its own, provided that the thread
+	*	that needs the barrier performs its operation only rarely.  The frequent thread writes a flag and then reads
+	*	a shared value with plain reads and writes (and a CompilerBarrier between them); the rare thread writes the
+	*	shared value, calls AsymmetricBarrier, and then reads the flag.  Either the rare thread sees the flag, or the
+	*	frequent thread sees the new value (or both) -- exactly as if both had used a full barrier.
+	*/
+	void AsymmetricBarrier();
 				
 	//End of group:
 	/** @} */
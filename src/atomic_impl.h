@@ -495,6 +495,15 @@ usign32 AtomicDecrement(__CPPCSP_ALIGNED_USIGN32_PTR address)
 	return InterlockedDecrement(__CPPCSP_INTERLOCKED_CAST (address));
 }
 
+void CompilerBarrier()
+{
+#ifdef CPPCSP_MSVC
+	_ReadWriteBarrier();
+#else
+	__asm__ __volatile__ ("" : : : "memory");
+#endif
+}
+
 
 } //namespace internal
 } //namespace csp
@@ -27,159 +27,403 @@
 
 #include <set>
 #include <map>
+#include <functional>
+
+class BarrierTest;
 
 namespace csp
 {	
 	namespace internal
 	{
+		/**@internal
+		*	A set of per-kernel slots, indexed by Primitive::currentKernelIndex().
+		*
+		*	Each slot is allocated separately and padded on both sides to a cache line, so that slots used
+		*	by different threads never share a cache line, and pointers to a slot stay valid as more slots are added.
+		*	The slots are default-constructed the first time that they are needed, and only destroyed with the set.
+		*
+		*	KernelSlots is not thread-safe; its users protect it with their own mutex.
+		*/
+		template <typename SLOT>
+		class KernelSlots : public boost::noncopyable
+		{
+		private:
+			class Padded
+			{
+			public:
+				char _pad0[64];
+				SLOT slot;
+				char _pad1[64];
+			};
+			std::vector<Padded*> slots;
+		public:
+			inline ~KernelSlots()
+			{
+				for (unsigned int i = 0;i < slots.size();i++)
+				{
+					delete slots[i];
+				}
+			}
+			
+			///Gets the slot for the given kernel index, constructing it if necessary
+			inline SLOT* get(unsigned int index)
+			{
+				if (index >= slots.size())
+				{
+					slots.resize(index + 1,NULL);
+				}
+				if (slots[index] == NULL)
+				{
+					slots[index] = new Padded;
+				}
+				return &(slots[index]->slot);
+			}
+			
+			///Gets the slot for the given kernel index, or NULL if it has not been constructed
+			inline SLOT* find(unsigned int index) const
+			{
+				return (index < slots.size() && slots[index] != NULL) ? &(slots[index]->slot) : NULL;
+			}
+		};
+	
+		/**@internal
+		*	The REDUCTION for a barrier that only synchronises.  Everything is empty, so the compiler can remove it entirely.
+		*/
+		class NoReduction
+		{
+		public:
+			class Slot
+			{
+			};
+			
+			///Called by whoever completes a sync, before it passes each slot to add()
+			inline void start()
+			{
+			}
+			
+			///Called by whoever completes a sync, for each slot, before anyone is freed
+			inline void add(Slot*)
+			{
+			}
+		};
+		
 		/**@internal
 		*
 		*	Used for implementation of cross-thread barriers.
 		*
+		*	Each kernel (i.e. thread) with processes enrolled on the barrier has a slot, in which its processes
+		*	sync without any atomic operations.  The last process in a thread to sync reports to a two-level combining tree:
+		*	it atomically decrements the counter of its slot's group (GroupSize kernels, by kernel index), and the last
+		*	slot in a group decrements the root counter.  So no counter is shared by more than GroupSize or so threads,
+		*	and the thread that brings the root counter to zero completes the sync.
+		*
 		*	The mutex only needs to be claimed for two operations - the final sync operation (which may be caused by a resign), and the enroll operations.
+		*	The final sync walks the slots that have processes enrolled once, to reset their counts and free their processes.
 		*
-		*	Each sync operation can be done non-atomically, unless it is the last in its thread - in which case it performs an atomic subtraction.
-		*	The final sync of all the threads claims the mutex.
+		*	When every enrolled process is in the same thread, and nobody is half-enrolled, that thread's slot is the
+		*	local slot.  The last process in the local slot to sync completes the sync itself, with no atomic operations
+		*	and without the mutex.  The combining tree is left counting the local slot as unfinished throughout, so
+		*	that when an enroll (under the mutex) ends the local mode, the counts are already correct for the tree.
+		*	Enrolling in another thread does not touch the local slot, so a sync completed locally by a thread that has
+		*	not yet seen the end of the local mode simply happened before that enroll.
+		*
+		*	A process can also arrive() without blocking, and later wait() for the phase to complete.  Each slot counts the
+		*	phases it has completed; the count is only changed by whoever completes the sync, after the slot's counts have
+		*	been put back, so a process that sees the count change may arrive again straight away.  A process arriving
+		*	counts towards the current phase, and that phase cannot complete again until it arrives again, so the phase
+		*	it arrived in is complete as soon as the count differs from it.
+		*
+		*	REDUCTION lets a barrier combine values from its processes (see ReducingBarrier).  Each slot is also a REDUCTION::Slot,
+		*	that its own processes may change while the slot is unfinished.  Whoever completes a sync passes every slot to the
+		*	reduction, before anyone is freed.
 		*/
-		template <typename MUTEX>
+		template <typename MUTEX,typename REDUCTION = NoReduction>
 		class _InterThreadBarrier : private internal::Primitive, public boost::noncopyable
 		{
-			class Data
+			enum { GroupSize = 8 };
+			
+			class Group
+			{
+			public:
+				///The number of active slots in the group that have not finished syncing
+				__CPPCSP_ALIGNED_USIGN32 leftToSync;
+				
+				inline Group()
+					:	leftToSync(0)
+				{
+				}
+			};
+			
+			class Data : public REDUCTION::Slot
 			{
 			public:
 				volatile usign32 leftToSync;
 				volatile usign32 enrolled;
 				volatile ProcessPtr queueHead;
 				volatile ProcessPtr queueTail;
+				///The processes that have arrived and are now waiting for the phase to complete.  Only used with the mutex held (or in the local mode)
+				ProcessPtr waitHead;
+				ProcessPtr waitTail;
+				///The number of phases that the slot has completed
+				volatile usign32 phase;
+				Group* group;
+				///Whether the slot is in the active list
+				bool active;
+				
+				inline Data()
+					:	leftToSync(0),enrolled(0),queueHead(NullProcessPtr),queueTail(NullProcessPtr),
+						waitHead(NullProcessPtr),waitTail(NullProcessPtr),phase(0),group(NULL),active(false)
+				{
+				}
 			};
-			std::map<ThreadId,Data> processes;
-			__CPPCSP_ALIGNED_USIGN32 threadsLeftToSync;
-			MUTEX mutex;			
+			KernelSlots<Data> processes;
+			KernelSlots<Group> groups;
+			///The slots that have (or recently had) processes enrolled
+			std::vector<Data*> active;
+			///The number of groups that have not finished syncing, plus any half-enrollments
+			__CPPCSP_ALIGNED_USIGN32 groupsLeftToSync;
+			///The number of half-enrollments that have not yet been completed.  Only used with the mutex held
+			usign32 halfEnrolled;
+			///The slot that all the enrolled processes are in, or NULL if they are not all in one slot
+			Data* volatile localSlot;
+			REDUCTION _reduction;
+			MUTEX mutex;
+			
+			///Gets the current kernel's slot, and makes sure it is active.  The mutex must be held
+			inline Data* currentSlot()
+			{
+				const unsigned int index = currentKernelIndex();
+				Data* slot = processes.get(index);
+				if (slot->group == NULL)
+				{
+					slot->group = groups.get(index / GroupSize);
+				}
+				if (false == slot->active)
+				{
+					slot->active = true;
+					active.push_back(slot);
+				}
+				return slot;
+			}
 			
 			/**
-			*	@return true if the sync completed, false if it didn't (i.e. false means we are blocked)
-			*
-			*	May block temporarily to grab the mutex
-			*/			
-			inline bool syncWholeThread(const ProcessPtr& process,usign32* numWhoSynced)
+			*	Decides whether the barrier can use the local mode.  The mutex must be held, and the combining tree must
+			*	count any unfinished slots (i.e. this must not be called part-way through completeSync)
+			*/
+			inline void updateLocalSlot()
+			{
+				if (active.size() == 1 && active[0]->enrolled > 0 && halfEnrolled == 0)
+				{
+					localSlot = active[0];
+				}
+				else
+				{
+					localSlot = NULL;
+				}
+			}
+			
+			/**
+			*	Completes a sync in the local mode: frees everyone else in the slot and resets its count.  There must be
+			*	at least one process still enrolled, so that the combining tree's count of the slot stays correct.
+			*/
+			inline usign32 completeLocalSync(Data* slot,const ProcessPtr& process)
 			{
-				//std::cerr << "syncWholeThread " << this << std::endl;
+				_reduction.start();
+				_reduction.add(slot);
+				
+				ProcessPtr queueHead = slot->queueHead;
+				ProcessPtr queueTail = slot->queueTail;
+				slot->queueHead = NullProcessPtr;
+				slot->queueTail = NullProcessPtr;
+				slot->leftToSync = slot->enrolled;
+				slot->phase += 1;
+				
+				if (queueHead != NullProcessPtr && queueHead == process)
+				{
+					//Miss out ourselves:
+					queueHead = getNextProcess(process);
+				}
+				if (queueHead != NullProcessPtr)
+				{
+					freeProcessChain(queueHead,queueTail);
+				}
+				
+				freeWaiters(slot);
+				
+				return slot->enrolled;
+			}
 			
-					typename MUTEX::End mutexEnd(mutex.end());
-
-					usign32 val = AtomicDecrement(&threadsLeftToSync);
+			///Frees the processes waiting for the slot's phase to complete
+			inline void freeWaiters(Data* slot)
+			{
+				if (slot->waitHead != NullProcessPtr)
+				{
+					freeProcessChain(slot->waitHead,slot->waitTail);
+					slot->waitHead = NullProcessPtr;
+					slot->waitTail = NullProcessPtr;
+				}
+			}
+			
+			/**
+			*	Frees everyone, and resets the counts ready for the next sync.  The mutex must be held, and
+			*	groupsLeftToSync must be zero.  process (who must not be freed) may be NULL.
+			*/
+			inline void completeSync(const ProcessPtr& process,usign32* numWhoSynced)
+			{
+				if (numWhoSynced != NULL)
+					*numWhoSynced = 0;
 					
-					if (val == 0)
-					{
-						//We can complete the sync, as long as nobody enrolls in the mean-time.  Must grab the mutex:
-						mutexEnd.claim();
+				do
+				{
+					//We hold the root count above zero while we reset the groups, because the processes that we free
+					//may sync again (in other threads) before we have finished:
+					AtomicPut(&groupsLeftToSync,1);
 					
-						//All the other processes were blocked, so the only person that could have come along since
-						//our atomic decrement was an enrolling process.  If they've enrolled (but not synced)
-						//we must also wait - they will complete the sync
+					//Everyone has synced, and nobody has been freed yet:
+					_reduction.start();
+					for (unsigned int i = 0;i < active.size();i++)
+					{
+						_reduction.add(active[i]);
+					}
+				
+					for (unsigned int i = 0;i < active.size();)
+					{
+						Data* slot = active[i];
+						ProcessPtr queueHead = slot->queueHead;
+						ProcessPtr queueTail = slot->queueTail;
+						
+						if (numWhoSynced != NULL)
+							*numWhoSynced += slot->enrolled;
 					
-						if (AtomicGet(&threadsLeftToSync) == 0)
+						slot->queueHead = NullProcessPtr;
+						slot->queueTail = NullProcessPtr;
+						
+						if (slot->enrolled > 0)
 						{
-							//We need to put the count back, ready for any processes that we free who sync quickly.
-							//First we must make a pass to count the number that will be left:
-							
-							usign32 threadsLeft = 0;
-							for (typename std::map<ThreadId,Data>::iterator it = processes.begin();it != processes.end();it++)
+							//The counts must be put back before we free anyone (or complete the phase for those who arrived):
+							slot->leftToSync = slot->enrolled;
+							if (AtomicIncrement(&(slot->group->leftToSync)) == 1)
 							{
-								if (it->second.enrolled > 0)
-								{
-									threadsLeft += 1;
-								}
+								AtomicIncrement(&groupsLeftToSync);
 							}
-							
-							AtomicPut(&threadsLeftToSync,threadsLeft);
-							
-							if (numWhoSynced != NULL)
-								*numWhoSynced = 0;
+							i++;
+						}
+						else
+						{
+							slot->active = false;
+							active[i] = active.back();
+							active.pop_back();
+						}
+						
+						slot->phase += 1;
+						freeWaiters(slot);
 						
-							//No-one enrolled before we claimed the mutex - sync by freeing everyone in the map (except us!)
-							for (typename std::map<ThreadId,Data>::iterator it = processes.begin();it != processes.end();)
+						if (queueHead != NullProcessPtr)
+						{
+							if (queueHead == process)
 							{
-								ProcessPtr queueHead = it->second.queueHead;
-								ProcessPtr queueTail = it->second.queueTail;
-								
-								if (numWhoSynced != NULL)
-									*numWhoSynced += it->second.enrolled;
-							
-								if (it->second.enrolled > 0)
-								{
-									it->second.queueHead = NullProcessPtr;
-									it->second.queueTail = NullProcessPtr;
-									it->second.leftToSync = it->second.enrolled;
-									
-									it++;
-								}
-								else
-								{									
-								#ifdef CPPCSP_MSVC
-									it = processes.erase(it);
-								#else
-									processes.erase(it++);
-								#endif
-								}							
-							
-								if (queueHead != NullProcessPtr)
+								//Miss out ourselves:
+								ProcessPtr next = getNextProcess(process);
+								if (next != NULL)
 								{
-									if (queueHead == process)
-									{
-										//Miss out ourselves:
-										ProcessPtr next = getNextProcess(process);
-										if (next != NULL)
-										{
-											freeProcessChain(next,queueTail);
-										}										
-									}
-									else
-									{
-										//We weren't in there - free them all:
-										freeProcessChain(queueHead,queueTail);
-									}
-								}								
+									freeProcessChain(next,queueTail);
+								}										
+							}
+							else
+							{
+								//We weren't in there - free them all:
+								freeProcessChain(queueHead,queueTail);
 							}
-												
-							mutexEnd.release();
-							return true;
-						}
-						else
-						{
-							//Someone has enrolled.  We must sleep ourselves!
-							mutexEnd.release();
-							return false;
 						}
 					}
-					else
-					{
-						//Not all threads are ready
-						return false;
-					}
-			}						
+				
+				//If everyone we freed has already synced again, that sync is ours to complete too:
+				} while (AtomicDecrement(&groupsLeftToSync) == 0 && false == active.empty());
+				
+				updateLocalSlot();
+			}
+			
+			/**
+			*	@return true if the sync completed, false if it didn't (i.e. false means we are blocked)
+			*
+			*	May block temporarily to grab the mutex
+			*/			
+			inline bool syncWholeThread(Data* slot,const ProcessPtr& process,usign32* numWhoSynced)
+			{
+				if (AtomicDecrement(&(slot->group->leftToSync)) != 0 || AtomicDecrement(&groupsLeftToSync) != 0)
+				{
+					//Not all threads are ready
+					return false;
+				}
+				
+				//We can complete the sync, as long as nobody enrolls in the mean-time.  Must grab the mutex:
+				typename MUTEX::End mutexEnd(mutex.end());
+				mutexEnd.claim();
+			
+				//All the other processes were blocked, so the only person that could have come along since
+				//our atomic decrement was an enrolling process.  If they've enrolled (but not synced)
+				//we must also wait - they will complete the sync
+			
+				if (AtomicGet(&groupsLeftToSync) == 0)
+				{
+					completeSync(process,numWhoSynced);
+					mutexEnd.release();
+					return true;
+				}
+				else
+				{
+					//Someone has enrolled.  We must sleep ourselves!
+					mutexEnd.release();
+					return false;
+				}
+			}
+			
+			///Counts a slot that has just become unfinished in its group (and the group in the root, unless told not to)
+			inline void slotUnfinished(Data* slot,bool countGroup = true)
+			{
+				if (AtomicIncrement(&(slot->group->leftToSync)) == 1 && countGroup)
+				{
+					AtomicIncrement(&groupsLeftToSync);
+				}
+			}
 			
 		public:
 			typedef Data* Key;
 
 			inline _InterThreadBarrier()
-				:	threadsLeftToSync(0)
+				:	groupsLeftToSync(0),halfEnrolled(0),localSlot(NULL)
+			{
+			}
+			
+			/**
+			*	The reduction.  Once a process has been freed from a sync, it may read the result of that sync from here
+			*	until it next syncs, because the next sync cannot complete without it.
+			*/
+			inline REDUCTION& reduction()
 			{
+				return _reduction;
 			}			
 
 			//If it performs the sync, returns the number of processes who synced 
 			//If it did not perform the sync itself, returns 0;
 			inline usign32 sync(const Key key)
 			{
-				//temp__issueDebugReport("pre-sync ");
-			
 				const ProcessPtr process ( currentProcess() );
 				addProcessToQueueAtHead(&(key->queueHead),&(key->queueTail),process);
 				usign32 num = 0;
 				bool synced;
 				if (--(key->leftToSync) == 0)
 				{
-					synced = syncWholeThread(process,&num);
+					if (localSlot == key)
+					{
+						//Everyone enrolled is in this thread, and they have all synced:
+						num = completeLocalSync(key,process);
+						synced = true;
+					}
+					else
+					{
+						synced = syncWholeThread(key,process,&num);
+					}
 				}
 				else
 				{
@@ -187,8 +431,6 @@ namespace csp
 					synced = false;
 				}
 
-				//temp__issueDebugReport("post-sync");
-				
 				if (false == synced)
 				{
 					//We may already be back on the run queue by now, but that doesn't matter
@@ -198,40 +440,80 @@ namespace csp
 				return num;
 			}
 		
-			inline Key enroll()
+			/**
+			*	Counts the current process as having synced, without waiting for the others.
+			*
+			*	@return The phase to pass to wait() or tryWait()
+			*/
+			inline usign32 arrive(const Key key)
+			{
+				const usign32 phase = key->phase;
+				if (--(key->leftToSync) == 0)
+				{
+					if (localSlot == key)
+					{
+						completeLocalSync(key,NullProcessPtr);
+					}
+					else
+					{
+						//If this does not complete the sync, the last to arrive will:
+						syncWholeThread(key,NullProcessPtr,NULL);
+					}
+				}
+				return phase;
+			}
+			
+			///Returns true if the given phase (from arrive()) has completed
+			inline bool tryWait(const Key key,const usign32 phase)
 			{
-				const ThreadId& threadId = currentThread();
+				return key->phase != phase;
+			}
+			
+			///Waits for the given phase (from arrive()) to complete
+			inline void wait(const Key key,const usign32 phase)
+			{
+				if (key->phase != phase)
+				{
+					return;
+				}
+				
 				typename MUTEX::End mutexEnd = mutex.end();
 				mutexEnd.claim();
 				
-				//It's ok if we add ourselves to the map, as no-one else will be altering the map while we hold the mutex
+				//Whoever completes the sync will hold the mutex (or be in our thread), so this check is reliable:
+				if (key->phase != phase)
+				{
+					mutexEnd.release();
+					return;
+				}
 				
-				typename std::map<ThreadId,Data>::iterator it = processes.find(threadId);
+				addProcessToQueue(&(key->waitHead),&(key->waitTail),currentProcess());
 				
-				if (it == processes.end())
-				{
-					Data data;
-					data.leftToSync = 1;
-					data.enrolled = 1;
-					data.queueHead = NullProcessPtr;
-					data.queueTail = NullProcessPtr;
-					it = processes.insert(std::make_pair(threadId,data)).first;
-					AtomicIncrement(&threadsLeftToSync);
-				}
-				else
+				mutexEnd.release();
+				
+				reschedule();
+			}
+		
+			inline Key enroll()
+			{
+				typename MUTEX::End mutexEnd = mutex.end();
+				mutexEnd.claim();
+				
+				//It's ok if we add a slot, as no-one else will be altering the slots while we hold the mutex
+				Data* slot = currentSlot();
+				slot->leftToSync += 1;
+				slot->enrolled += 1;
+				if (slot->leftToSync == 1)
 				{
-					it->second.leftToSync += 1;
-					it->second.enrolled += 1;
-					if (it->second.leftToSync == 1)
-					{
-						//Everyone else was done already - but not any more!
-						AtomicIncrement(&threadsLeftToSync);
-					}
+					//Everyone else in this thread was done already (or there was no-one) - but not any more!
+					slotUnfinished(slot);
 				}
 				
+				updateLocalSlot();
+				
 				mutexEnd.release();
 				
-				return &(it->second);
+				return slot;
 			}
 			
 			inline void halfEnroll()
@@ -239,72 +521,59 @@ namespace csp
 				typename MUTEX::End mutexEnd = mutex.end();
 				mutexEnd.claim();
 				
-				AtomicIncrement(&threadsLeftToSync);
+				AtomicIncrement(&groupsLeftToSync);
+				
+				//We don't know which thread the enrollment will be completed in:
+				halfEnrolled += 1;
+				localSlot = NULL;
 				
 				mutexEnd.release();
 			}
 			
 			inline Key completeEnroll()
 			{
-				//temp__issueDebugReport("pre-completeEnroll");
-
-				const ThreadId& threadId = currentThread();
 				typename MUTEX::End mutexEnd = mutex.end();
 				mutexEnd.claim();
 				
-				//It's ok if we add ourselves to the map, as no-one else will be altering the map while we hold the mutex
-				
-				typename std::map<ThreadId,Data>::iterator it = processes.find(threadId);
+				Data* slot = currentSlot();
+				slot->leftToSync += 1;
+				slot->enrolled += 1;
 				
-				if (it == processes.end())
-				{
-					Data data;
-					data.leftToSync = 1;
-					data.enrolled = 1;
-					data.queueHead = NullProcessPtr;
-					data.queueTail = NullProcessPtr;
-					it = processes.insert(std::make_pair(threadId,data)).first;
-					
-					//threadsLeftToSync is already one greater than it should be because of our half-enrollment
-					//so don't touch it
+				//groupsLeftToSync is already one greater than it should be because of our half-enrollment.
+				//If our group has just become unfinished, that takes its place; otherwise we reverse it:
+				if (slot->leftToSync == 1 && AtomicIncrement(&(slot->group->leftToSync)) == 1)
+				{
+					//no need to reverse
 				}
 				else
 				{
-					it->second.leftToSync += 1;
-					it->second.enrolled += 1;
-					//threadsLeftToSync is already one greater than it should be because of our half-enrollment
-					//so we should reverse that, if appropriate:
-					if (it->second.leftToSync == 1)
-					{
-						//Everyone else was done already - but not any more!
-						//no need to reverse
-					}
-					else
-					{
-						//reverse it:
-						AtomicDecrement(&threadsLeftToSync);
-					}					
+					AtomicDecrement(&groupsLeftToSync);
 				}
 				
-				mutexEnd.release();
-				
-				//temp__issueDebugReport("post-completeEnroll");
+				halfEnrolled -= 1;
+				updateLocalSlot();
 				
+				mutexEnd.release();
 				
-				return &(it->second);				
+				return slot;
 			}
 			
 			//Returns true if the barrier is now empty
 			inline bool resign(const Key key)
 			{
-				//std::cerr << "resign " << this << std::endl;
-				//temp__issueDebugReport("pre-resign");				
-
 				key->enrolled -= 1;
 				if (--(key->leftToSync) == 0)
 				{
+					if (localSlot == key && key->enrolled > 0)
+					{
+						//Everyone left is in this thread, and they have all synced:
+						completeLocalSync(key,NullProcessPtr);
+						return false;
+					}
+					
+					//If we were the last in the local slot, this goes through the tree, which ends the local mode:
 					usign32 num = 1; //Just so long as it's not zero!
-					syncWholeThread(NullProcessPtr,&num);
+					syncWholeThread(key,NullProcessPtr,&num);
 					
 					return (num == 0);
 				}
@@ -312,7 +581,7 @@ namespace csp
 				return false;
 			}			
 			
-			inline ~_InterThreadBarrier()
+			inline ~_InterThreadBarrier() __CPPCSP_THROWING_DESTRUCTOR
 			{
 				if (false == std::uncaught_exception())
 				{
@@ -321,7 +590,7 @@ namespace csp
 					mutexEnd.claim();
 					
 					//if there are classes synced on the barrier when it is destroyed, we should do something about it
-					if (processes.size() != 0 || AtomicGet(&threadsLeftToSync) > 0)
+					if (false == active.empty() || AtomicGet(&groupsLeftToSync) > 0)
 					{
 						throw BarrierError("InterThreadBarrier was destroyed while some processes were still enrolled on it");
 					}
@@ -331,6 +600,9 @@ namespace csp
 					mutexEnd.release();
 				}
 			}
+			
+			//For testing:
+			friend class ::BarrierTest;
 		};
 		
 		typedef _InterThreadBarrier<PureSpinMutex> InterThreadBarrier;
@@ -343,6 +615,22 @@ namespace csp
 	class AltBarrierEnd;
 	class ScopedBarrierEnd;
 	class ScopedAltBarrierEnd;
+	class ScopedAltBarrierMember;
+	class AltBarrier;
+	
+	namespace internal
+	{
+		class AltBarrierMember;
+		class AltBarrierGuard;
+	}
+	
+	Mobile<BarrierEnd> NoAlt(const Mobile<AltBarrierEnd>&);
+	
+	/**
+	*	The token returned by BarrierEnd::arrive(), to be passed to BarrierEnd::wait() or BarrierEnd::tryWait().
+	*	It identifies the phase of the barrier that the process arrived in; its value has no other meaning.
+	*/
+	typedef usign32 BarrierPhase;
 
 
 	namespace internal
@@ -358,7 +646,8 @@ namespace csp
 			}
 			*/
 			
-			inline virtual ~BarrierBase()
+			//Some barriers throw from their destructors on misuse, which the derived destructors must be allowed to do:
+			inline virtual ~BarrierBase() __CPPCSP_THROWING_DESTRUCTOR
 			{
 			}
 			
@@ -375,6 +664,25 @@ namespace csp
 			virtual void resign(void* key) = 0;
 			
 			virtual void sync(void* key) = 0;
+			
+			/**
+			*	Barriers that cannot do split-phase synchronisation complete the whole sync in arrive(),
+			*	so that wait() and tryWait() never have to wait
+			*/
+			virtual BarrierPhase arrive(void* key)
+			{
+				sync(key);
+				return 0;
+			}
+			
+			virtual bool tryWait(void*,BarrierPhase)
+			{
+				return true;
+			}
+			
+			virtual void wait(void*,BarrierPhase)
+			{
+			}
 		
 			typedef BarrierBase* Pointer;
 			
@@ -397,6 +705,7 @@ namespace csp
 			typedef AltBarrierBase* Pointer;
 			
 			friend class csp::AltBarrierEnd;			
+			friend class csp::ScopedAltBarrierMember;
 		};
 		
 		
@@ -426,6 +735,23 @@ namespace csp
 	*	the better method is probably to create a new end for the new process (either from the original
 	*	Barrier or using makeEnrolledCopy() ) and resign from the original end.
 	*
+	*	Instead of sync(), a process can split the synchronisation in two: arrive() counts it as having synced
+	*	without blocking, and wait() blocks until everyone else has arrived (or synced) too.  The process can do
+	*	other work in between, that does not depend on the other processes, and will only block if the barrier
+	*	has not completed by the time that it needs it to have done so:
+	*	@code
+		for (;;)
+		{
+			computeBoundary();
+			BarrierPhase phase = end->arrive();
+			computeInterior(); //Does not need the neighbours' boundaries
+			end->wait(phase);
+			exchangeBoundaries();
+		}
+		@endcode
+	*	On a Barrier, arrive() does not block.  On barriers that cannot split the synchronisation (AltBarrier)
+	*	arrive() behaves like sync(), and wait() returns straight away.
+	*
 	*	@see Barrier
 	*	@see ScopedBarrierEnd
 	*/
@@ -434,20 +760,33 @@ namespace csp
 	private:
 		internal::BarrierBase::Pointer barrier;
 		void* key;
+		///Whether we have arrived, and not yet seen the phase complete
+		bool arrived;
+		BarrierPhase arrivedPhase;
 		
 		/**
 		*	The default constructor
 		*/
 		inline BarrierEnd()
-			:	barrier(NULL),key(NULL)
+			:	barrier(NULL),key(NULL),arrived(false),arrivedPhase(0)
+		{
+		}
+		
+		///Waits for our last arrival to complete, if we have not seen it complete yet
+		inline void finishArrival()
 		{
+			if (arrived)
+			{
+				barrier->wait(key,arrivedPhase);
+				arrived = false;
+			}
 		}
 	public:
 		/**@internal
 		*	Constructor for internal use only
 		*/	
 		inline explicit BarrierEnd(internal::BarrierBase* _barrier,void* _key = NULL)
-			:	barrier(_barrier),key(_key)
+			:	barrier(_barrier),key(_key),arrived(false),arrivedPhase(0)
 		{
 		}		
 		
@@ -466,7 +805,7 @@ namespace csp
 		*
 		*	@see ScopedBarrierEnd
 		*/
-		inline ~BarrierEnd()
+		inline ~BarrierEnd() __CPPCSP_THROWING_DESTRUCTOR
 		{
 			if (key != NULL)
 			{
@@ -520,6 +859,8 @@ namespace csp
 			
 			if (key != NULL)
 			{
+				//We cannot leave until the phase we arrived in has completed:
+				finishArrival();
 				barrier->resign(key);
 				key = NULL;
 			}
@@ -530,25 +871,90 @@ namespace csp
 		*
 		*	Sync will block until all the other processes on the barrier have also called sync().
 		*
-		*	It is an error to call sync() on a currently non-enrolled barrier end.  This will result
-		*	in a BarrierError being thrown.
+		*	It is an error to call sync() on a currently non-enrolled barrier end.  This will result
+		*	in a BarrierError being thrown.
+		*/
+		inline void sync()
+		{
+			if (key == barrier)
+			{
+				//We're only half-enrolled.  Complete enrollment before syncing:
+				key = barrier->completeEnroll();
+			}
+		
+			if (key != NULL)
+			{
+				finishArrival();
+				barrier->sync(key);
+			}
+			else
+			{
+				throw BarrierError("Attempt made to sync() on a barrier while not enrolled - did you not call enroll() first?");
+			}
+		}
+		
+		/**
+		*	Counts this process as having synchronised on the barrier, but does not wait for the others.  This must be done by the same
+		*	process that has previously called enroll() on the barrier (and has not yet called resign() since).
+		*
+		*	Pass the returned phase to wait() or tryWait() to find out when everyone else has arrived too.  If the process calls arrive(), sync()
+		*	or resign() before it has seen the phase complete, they first wait for it to do so.
+		*
+		*	It is an error to call arrive() on a currently non-enrolled barrier end.  This will result
+		*	in a BarrierError being thrown.
+		*
+		*	@return The phase to pass to wait() or tryWait()
+		*/
+		inline BarrierPhase arrive()
+		{
+			if (key == barrier)
+			{
+				//We're only half-enrolled.  Complete enrollment before arriving:
+				key = barrier->completeEnroll();
+			}
+			
+			if (key == NULL)
+			{
+				throw BarrierError("Attempt made to arrive() on a barrier while not enrolled - did you not call enroll() first?");
+			}
+			
+			finishArrival();
+			arrivedPhase = barrier->arrive(key);
+			arrived = true;
+			return arrivedPhase;
+		}
+		
+		/**
+		*	Blocks until the given phase of the barrier has completed, i.e. until all the processes enrolled on the barrier
+		*	have arrived (or synced) in it.  Returns straight away if it already has.
+		*
+		*	@param phase The phase returned by the last call to arrive()
 		*/
-		inline void sync()
+		inline void wait(BarrierPhase phase)
 		{
-			if (key == barrier)
+			if (arrived && phase == arrivedPhase)
 			{
-				//We're only half-enrolled.  Complete enrollment before syncing:
-				key = barrier->completeEnroll();
+				finishArrival();
 			}
+		}
 		
-			if (key != NULL)
-			{
-				barrier->sync(key);
-			}
-			else
+		/**
+		*	Finds out whether the given phase of the barrier has completed, without blocking.
+		*
+		*	@param phase The phase returned by the last call to arrive()
+		*	@return True if the phase has completed (and so wait() would not block), false otherwise
+		*/
+		inline bool tryWait(BarrierPhase phase)
+		{
+			if (arrived && phase == arrivedPhase)
 			{
-				throw BarrierError("Attempt made to sync() on a barrier while not enrolled - did you not call enroll() first?");
+				if (false == barrier->tryWait(key,arrivedPhase))
+				{
+					return false;
+				}
+				arrived = false;
 			}
+			return true;
 		}
 
 		/**
@@ -590,6 +996,7 @@ namespace csp
 		}
 
 		friend class AltBarrierEnd;		
+		friend Mobile<BarrierEnd> NoAlt(const Mobile<AltBarrierEnd>&);
 		
 	};
 
@@ -624,7 +1031,7 @@ namespace csp
 		}
 		*/
 		
-		inline ~AltBarrierEnd()
+		inline ~AltBarrierEnd() __CPPCSP_THROWING_DESTRUCTOR
 		{
 			if (key != NULL)
 			{
@@ -664,7 +1071,7 @@ namespace csp
 		*
 		*	The Alternative will delete this guard so you don't have to.
 		*
-		*	Using a guard in a process not currently enrolled on the barrier has undefined behaviour.
+		*	Getting a guard from a non-enrolled barrier end will cause a BarrierError to be thrown.
 		*
 		*	@see Alternative
 		*	@see Guard
@@ -672,15 +1079,38 @@ namespace csp
 		*/		
 		inline Guard* guard()
 		{
-			//TODO later make it throw a BarrierError in the guard if we are not enrolled
+			if (key == barrier)
+			{
+				//We're only half-enrolled.  Complete enrollment before offering to sync:
+				key = altBarrier->completeEnroll();
+			}
+			
+			if (key == NULL)
+			{
+				throw BarrierError("Attempt made to get a guard from a barrier end that is not enrolled - did you not call enroll() first?");
+			}
+			
 			return altBarrier->guard(key);
 		}
 		
 		friend class AltBarrier;
+		friend class ScopedAltBarrierMember;
 	};
 	
-	//TODO later document
-	Mobile<BarrierEnd> NoAlt(const Mobile<AltBarrierEnd>&);
+	/**
+	*	Converts an AltBarrierEnd into a BarrierEnd of the same barrier, for processes that will only ever sync() on it.
+	*	If the AltBarrierEnd was enrolled, the returned end is enrolled in its place.
+	*
+	*	Due to Mobile semantics, the passed Mobile will be blanked.
+	*/
+	inline Mobile<BarrierEnd> NoAlt(const Mobile<AltBarrierEnd>& _end)
+	{
+		Mobile<AltBarrierEnd> end(_end);
+		Mobile<BarrierEnd> ret(new BarrierEnd(end->barrier,end->key));
+		//The enrollment now belongs to the new end:
+		end->key = NULL;
+		return ret;
+	}
 	
 	
 	/**
@@ -765,39 +1195,87 @@ namespace csp
 		{
 			end->sync();
 		}
+		
+		/**
+		*	Arrives at the barrier without waiting.  @see BarrierEnd::arrive()
+		*/
+		BarrierPhase arrive()
+		{
+			return end->arrive();
+		}
+		
+		/**
+		*	Waits for the phase to complete.  @see BarrierEnd::wait()
+		*/
+		void wait(BarrierPhase phase)
+		{
+			end->wait(phase);
+		}
+		
+		/**
+		*	Finds out whether the phase has completed.  @see BarrierEnd::tryWait()
+		*/
+		bool tryWait(BarrierPhase phase)
+		{
+			return end->tryWait(phase);
+		}
 			
 	};
 
-	//TODO later document this class.  And uncomment it!
-	/*
+	/**
+	*	A scoped member of an AltBarrier.
+	*
+	*	This is the AltBarrier equivalent of ScopedBarrierEnd.  It enrolls on the barrier of the given end when it is constructed
+	*	(separately from the end itself, which is left as it was) and resigns when it is destroyed:
+	*	@code
+		{
+			ScopedAltBarrierMember member(*end);
+			Alternative alt( boost::assign::list_of<Guard*>(member.guard())(in.inputGuard()) );
+			...
+		} //Here, the member resigns from the barrier automatically
+		@endcode
+	*
+	*	@ingroup scoped
+	*/
 	class ScopedAltBarrierMember : public boost::noncopyable
 	{
 		internal::AltBarrierBase::Pointer barrier;
 		void* key;
 	public:
+		/**
+		*	Enrolls on the barrier that the given end belongs to
+		*/
 		inline explicit ScopedAltBarrierMember(const AltBarrierEnd& end)
 			:	barrier(end.altBarrier)
 		{
 			key = barrier->enroll();
 		}
 		
+		/**
+		*	Resigns from the barrier
+		*/
 		inline ~ScopedAltBarrierMember()
 		{
 			barrier->resign(key);
 		}
 	
+		/**
+		*	Syncs on the barrier.  @see BarrierEnd::sync()
+		*/
 		void sync()
 		{
 			barrier->sync(key);
 		}
 		
+		/**
+		*	Gets a guard for the barrier.  @see AltBarrierEnd::guard()
+		*/
 		Guard* guard()
 		{
 			return barrier->guard(key);
 		}
 			
 	};
-	*/	
 
 
 	/**
@@ -875,6 +1353,21 @@ namespace csp
 			barrier.sync(static_cast<internal::InterThreadBarrier::Key>(key));
 		}
 		
+		virtual BarrierPhase arrive(void* key)
+		{
+			return barrier.arrive(static_cast<internal::InterThreadBarrier::Key>(key));
+		}
+		
+		virtual bool tryWait(void* key,BarrierPhase phase)
+		{
+			return barrier.tryWait(static_cast<internal::InterThreadBarrier::Key>(key),phase);
+		}
+		
+		virtual void wait(void* key,BarrierPhase phase)
+		{
+			barrier.wait(static_cast<internal::InterThreadBarrier::Key>(key),phase);
+		}
+		
 		//TODO later document _deleteSelfWhenBecomeEmpty well
 		inline Barrier(bool _deleteSelfWhenBecomeEmpty)
 			:	deleteSelfWhenBecomeEmpty(_deleteSelfWhenBecomeEmpty)
@@ -927,8 +1420,347 @@ namespace csp
 		}	
 		
 		friend class ScopedForking;
+		
+		//For testing:
+		friend class ::BarrierTest;
+	};
+	
+	/**
+	*	A barrier that can be used as a guard in an Alternative.
+	*
+	*	An AltBarrier behaves like a Barrier, except that its members can offer to synchronise on it as part of an
+	*	Alternative, using the guard from AltBarrierEnd::guard(), as well as by calling sync().  The synchronisation
+	*	completes when every enrolled member is offering to synchronise.  When it does, all of the alting members
+	*	select the barrier's guard - even if another of their guards (of higher priority) is also ready.
+	*	Until then, a member's offer is withdrawn whenever its Alternative selects another guard.
+	*
+	*	A member may offer to synchronise on several AltBarriers in the same Alternative.  The synchronisations
+	*	are resolved by a single lock shared by all the AltBarriers (as in JCSP), which makes sure that each
+	*	member is committed to at most one of them.  Offering and withdrawing take constant time, and completing
+	*	a synchronisation takes time proportional to the number of members.  The cost does not depend on how many
+	*	of the members are not offering at the time, so a barrier with hundreds of members that are mostly
+	*	busy elsewhere is no more expensive to offer on than a barrier with a handful.  Syncing without an
+	*	Alternative takes the same lock, so a plain Barrier is faster if you never need to alt over the barrier.
+	*
+	*	For example, a process that either reads from a channel or synchronises with its peers:
+	*	@code
+		void run()
+		{
+			AltBarrierEnd* end = ...; //An enrolled end, from AltBarrier::enrolledEnd()
+			std::list<Guard*> guards = boost::assign::list_of<Guard*>(end->guard())(in.inputGuard());
+			Alternative alt(guards);
+			while (true)
+			{
+				switch (alt.priSelect())
+				{
+					case 0:
+						//Synchronised with all the other members
+						break;
+					case 1:
+						in >> n;
+						break;
+				}
+			}
+		}
+		@endcode
+	*
+	*	Ends are obtained using end() and enrolledEnd(), and are used in the same way as BarrierEnd
+	*	(with the addition of AltBarrierEnd::guard()).
+	*
+	*	@see Barrier
+	*	@see AltBarrierEnd
+	*	@see ScopedAltBarrierMember
+	*/
+	class AltBarrier : private internal::AltBarrierBase, private internal::Primitive, public boost::noncopyable
+	{
+	private:
+		///The number of enrolled members, including half-enrolled members.  Protected by the global lock, as are the rest
+		unsigned int enrolled;
+		///The number of members offering to sync (by calling sync() or enabling a guard)
+		unsigned int offering;
+		///The head of the (doubly-linked) list of offering members
+		internal::AltBarrierMember* offerers;
+		
+		void addOfferer(internal::AltBarrierMember* member);
+		void removeOfferer(internal::AltBarrierMember* member);
+		bool tryComplete(internal::Process* self);
+		
+		bool enable(internal::AltBarrierMember* member,Guard* guard,internal::AltingProcessPtr proc);
+		bool disable(internal::AltBarrierMember* member,Guard* guard,internal::AltingProcessPtr proc);
+		
+		virtual void* enroll();
+		virtual void halfEnroll();
+		virtual void* completeEnroll();
+		virtual void resign(void* key);
+		virtual void sync(void* key);
+		virtual Guard* guard(void* key);
+	public:
+		/**
+		*	Default constructor.  Constructs an empty barrier.
+		*/
+		AltBarrier();
+		
+		/**
+		*	Destroys the barrier.  If any processes are still enrolled on the barrier, a BarrierError
+		*	will be thrown because your application is in error.
+		*/
+		~AltBarrier() __CPPCSP_THROWING_DESTRUCTOR;
+		
+		/**
+		*	Gets a non-enrolled end of this barrier.
+		*/
+		Mobile<AltBarrierEnd> end()
+		{
+			return Mobile<AltBarrierEnd>(new AltBarrierEnd(this));
+		}
+		
+		/**
+		*	Gets an already enrolled end of this barrier.
+		*/
+		Mobile<AltBarrierEnd> enrolledEnd()
+		{
+			halfEnroll();
+			//Make sure an identical pointer is given for both arguments:
+			internal::AltBarrierBase* base = this;
+			return Mobile<AltBarrierEnd>(new AltBarrierEnd(base,base));
+		}
+		
+		friend class internal::AltBarrierGuard;
+	};
+	
+	template <typename DATA_TYPE,typename OPERATION>
+	class ReducingBarrier;
+	
+	namespace internal
+	{
+		/**@internal
+		*	The REDUCTION of a ReducingBarrier: each slot combines the values from its own processes,
+		*	and whoever completes the sync combines the slots.
+		*/
+		template <typename DATA_TYPE,typename OPERATION>
+		class ValueReduction
+		{
+		public:
+			class Slot
+			{
+			public:
+				///The values given by the slot's processes in this sync, combined
+				DATA_TYPE partial;
+				///The number of values in partial
+				usign32 count;
+				
+				inline Slot()
+					:	partial(),count(0)
+				{
+				}
+			};
+			
+			///The combined values of the last sync
+			DATA_TYPE result;
+			///The number of values in result
+			usign32 count;
+			OPERATION operation;
+			
+			inline ValueReduction()
+				:	result(),count(0),operation()
+			{
+			}
+			
+			///Adds a value to a slot.  Must be called by a process of the slot, before it syncs
+			inline void give(Slot* slot,const DATA_TYPE& value)
+			{
+				slot->partial = (slot->count == 0) ? value : operation(slot->partial,value);
+				slot->count += 1;
+			}
+			
+			inline void start()
+			{
+				count = 0;
+			}
+			
+			inline void add(Slot* slot)
+			{
+				if (slot->count > 0)
+				{
+					result = (count == 0) ? slot->partial : operation(result,slot->partial);
+					count += slot->count;
+					slot->count = 0;
+				}
+			}
+		};
+	}
+	
+	/**
+	*	An end of a ReducingBarrier.
+	*
+	*	It is used in the same way as BarrierEnd, except that sync() takes a value, and returns the result
+	*	of combining the values from every process that synced.  Like BarrierEnd, it is given out as a Mobile,
+	*	and it must be resigned before it is destroyed.
+	*
+	*	@see ReducingBarrier
+	*/
+	template <typename DATA_TYPE,typename OPERATION = std::plus<DATA_TYPE> >
+	class ReducingBarrierEnd : public boost::noncopyable
+	{
+	private:
+		ReducingBarrier<DATA_TYPE,OPERATION>* barrier;
+		typename internal::_InterThreadBarrier<internal::PureSpinMutex,internal::ValueReduction<DATA_TYPE,OPERATION> >::Key key;
+		///Whether the end was enrolled by ReducingBarrier::enrolledEnd(), and has not yet completed the enrollment
+		bool halfEnrolled;
+		
+		inline ReducingBarrierEnd(ReducingBarrier<DATA_TYPE,OPERATION>* _barrier,bool _halfEnrolled)
+			:	barrier(_barrier),key(NULL),halfEnrolled(_halfEnrolled)
+		{
+		}
+		
+		inline void completeEnroll()
+		{
+			if (halfEnrolled)
+			{
+				key = barrier->barrier.completeEnroll();
+				halfEnrolled = false;
+			}
+		}
+	public:
+		/**
+		*	The destructor.  Throws a BarrierError if the end is still enrolled (as BarrierEnd does).
+		*/
+		inline ~ReducingBarrierEnd() __CPPCSP_THROWING_DESTRUCTOR
+		{
+			if (key != NULL || halfEnrolled)
+			{
+				resign();
+				
+				if (false == std::uncaught_exception())
+					throw BarrierError("A ReducingBarrierEnd was destroyed while still enrolled on a barrier - did you omit a resign() call?");
+			}
+		}
+		
+		/**
+		*	Enrolls on the barrier.  This must be done by the process that will then make the sync() and resign() calls.
+		*	Calling it when already enrolled has no effect.  @see BarrierEnd::enroll()
+		*/
+		inline void enroll()
+		{
+			if (halfEnrolled)
+			{
+				completeEnroll();
+			}
+			else if (key == NULL)
+			{
+				key = barrier->barrier.enroll();
+			}
+		}
+		
+		/**
+		*	Resigns from the barrier.  Calling it when not enrolled has no effect.  @see BarrierEnd::resign()
+		*/
+		inline void resign()
+		{
+			completeEnroll();
+			
+			if (key != NULL)
+			{
+				barrier->barrier.resign(key);
+				key = NULL;
+			}
+		}
+		
+		/**
+		*	Synchronises with the barrier, giving it a value.
+		*
+		*	Blocks until all the other processes enrolled on the barrier have also called sync().  It is an error to call
+		*	sync() on a non-enrolled end, which will result in a BarrierError being thrown.
+		*
+		*	@param value The value that this process contributes
+		*	@return The values from every process that synced, combined using the barrier's operation
+		*/
+		inline DATA_TYPE sync(const DATA_TYPE& value)
+		{
+			completeEnroll();
+			
+			if (key == NULL)
+			{
+				throw BarrierError("Attempt made to sync() on a barrier while not enrolled - did you not call enroll() first?");
+			}
+			
+			//Our slot is ours until it has finished syncing, so no atomics are needed to combine with the rest of our thread:
+			barrier->barrier.reduction().give(key,value);
+			barrier->barrier.sync(key);
+			return barrier->barrier.reduction().result;
+		}
+		
+		friend class ReducingBarrier<DATA_TYPE,OPERATION>;
+	};
+	
+	/**
+	*	A barrier that combines a value from each of its processes, and gives the result to all of them.
+	*
+	*	Each process calls ReducingBarrierEnd::sync() with its own value.  When every enrolled process has done so,
+	*	the values are combined using OPERATION, and every sync() call returns the result.  So, for example,
+	*	a set of workers can sum their partial results in a single synchronisation:
+	*	@code
+		ReducingBarrier<double> total;
+		//Give each worker total.enrolledEnd()
+		...
+		//In each worker:
+		double overall = end->sync(myPartialSum);
+		@endcode
+	*	This replaces syncing on a Barrier, sending each result to an aggregating process, and having it send out the total.
+	*
+	*	The values of processes in the same thread are combined as they sync, with no atomic operations, and the
+	*	combined values of each thread are combined by whichever process completes the synchronisation.  The order in
+	*	which the values are combined is not defined, so OPERATION must be associative and commutative.  It must be
+	*	default-constructible, and take two DATA_TYPE values, returning a DATA_TYPE; std::plus (the default) and std::multiplies
+	*	are examples.  DATA_TYPE must be default-constructible and assignable.
+	*
+	*	Enrollment and resignation work as they do on Barrier.  Processes that resign do not contribute a value.
+	*	If every process resigns instead of syncing, the result is left unchanged from the previous sync.
+	*
+	*	@see ReducingBarrierEnd
+	*/
+	template <typename DATA_TYPE,typename OPERATION = std::plus<DATA_TYPE> >
+	class ReducingBarrier : public boost::noncopyable
+	{
+	private:
+		typedef internal::_InterThreadBarrier<internal::PureSpinMutex,internal::ValueReduction<DATA_TYPE,OPERATION> > Implementation;
+		typedef typename Implementation::Key Key;
+		
+		Implementation barrier;
+	public:
+		/**
+		*	Default constructor.  Constructs an empty barrier.
+		*/
+		inline ReducingBarrier()
+		{
+		}
+		
+		#ifdef CPPCSP_DOXYGEN
+		/**
+		*	Destroys the barrier.  If any processes are still enrolled on the barrier, a BarrierError
+		*	will be thrown because your application is in error.
+		*/
+		inline ~ReducingBarrier() {}
+		#endif
+		
+		/**
+		*	Gets a non-enrolled end of this barrier.
+		*/
+		Mobile< ReducingBarrierEnd<DATA_TYPE,OPERATION> > end()
+		{
+			return Mobile< ReducingBarrierEnd<DATA_TYPE,OPERATION> >(new ReducingBarrierEnd<DATA_TYPE,OPERATION>(this,false));
+		}
+		
+		/**
+		*	Gets an already enrolled end of this barrier.
+		*/
+		Mobile< ReducingBarrierEnd<DATA_TYPE,OPERATION> > enrolledEnd()
+		{
+			barrier.halfEnroll();
+			return Mobile< ReducingBarrierEnd<DATA_TYPE,OPERATION> >(new ReducingBarrierEnd<DATA_TYPE,OPERATION>(this,true));
+		}
+		
+		friend class ReducingBarrierEnd<DATA_TYPE,OPERATION>;
 	};
-
-
 
 } //namespace csp
@@ -0,0 +1,593 @@
+/*
+*	The Kent C++CSP Library
+*	Copyright (C) 2002-2007 Neil Brown
+*
+*	This library is free software; you can redistribute it and/or
+*	modify it under the terms of the GNU Lesser General Public
+*	License as published by the Free Software Foundation; either
+*	version 2.1 of the License, or (at your option) any later version.
+*
+*	This library is distributed in the hope that it will be useful,
+*	but WITHOUT ANY WARRANTY; without even the implied warranty of
+*	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+*	Lesser General Public License for more details.
+*
+*	You should have received a copy of the GNU Lesser General Public
+*	License along with this library; if not, write to the Free Software
+*	Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+/** @file broadcast_channel.h
+*	@brief Contains the header for BroadcastChannel and BroadcastSubscription
+*
+*	This file is \#included from cppcsp.h
+*/
+
+#ifndef INCLUDED_FROM_CPPCSP_H
+#error This file should only be included by csp.h, not individually
+#endif
+
+class BroadcastChannelTest;
+
+namespace csp
+{
+	template <typename DATA_TYPE>
+	class BroadcastChannel;
+
+	template <typename DATA_TYPE>
+	class BroadcastSubscription;
+
+	namespace internal
+	{
+		/**@internal
+		*	A single item written to a broadcast channel.
+		*
+		*	There is only ever one copy of each item, shared by all the subscribers.  The data is never
+		*	changed after it is written, so subscribers copy it out without holding the channel's mutex.
+		*	remaining is the number of subscribers (counted when the item was written) that have yet to take it.
+		*/
+		template <typename DATA_TYPE>
+		class BroadcastItem
+		{
+		public:
+			const DATA_TYPE data;
+			usign32 remaining;
+			BroadcastItem<DATA_TYPE>* next;
+
+			inline BroadcastItem(const DATA_TYPE& _data)
+				:	data(_data),remaining(0),next(NULL)
+			{
+			}
+		};
+	} //namespace internal
+
+	template <typename DATA_TYPE>
+	class BroadcastSubscription : protected internal::BaseAltChan<DATA_TYPE>, private internal::Primitive
+	{
+	private:
+		typedef internal::BroadcastItem<DATA_TYPE> Item;
+
+		BroadcastChannel<DATA_TYPE>* channel;
+
+		//The rest of these are only accessed with the channel's mutex claimed:
+
+		///The next item for this subscriber to take, or NULL if it has taken everything written so far
+		Item* nextItem;
+		///The reader (possibly alting), if they are waiting for an item
+		internal::AltingProcessPtr waitingProcess;
+
+		//Links in the channel's list of subscribers:
+		BroadcastSubscription<DATA_TYPE>* prevSubscriber;
+		BroadcastSubscription<DATA_TYPE>* nextSubscriber;
+
+		inline explicit BroadcastSubscription(BroadcastChannel<DATA_TYPE>* _channel)
+			:	channel(_channel),nextItem(NULL),waitingProcess(NullProcessPtr),prevSubscriber(NULL),nextSubscriber(NULL)
+		{
+		}
+
+		/**@internal
+		*	Waits until this subscriber has an item to take.  Must be called with the channel's mutex claimed,
+		*	and returns with it claimed.  If the channel has been poisoned and there is nothing left to take, the
+		*	mutex is released and a PoisonException is thrown.
+		*/
+		Item* waitForItem()
+		{
+			//We don't check poison if there is data ready, just like the buffered channels:
+			if (nextItem == NULL)
+			{
+				if (channel->isPoisoned)
+				{
+					channel->mutex.release();
+					throw PoisonException();
+				}
+
+				waitingProcess = currentProcess();
+				channel->mutex.release();
+				reschedule();
+				//A writer has given us an item, or we've been poisoned:
+				channel->mutex.claim();
+
+				if (nextItem == NULL)
+				{
+					channel->mutex.release();
+					throw PoisonException();
+				}
+			}
+			return nextItem;
+		}
+
+		void input(DATA_TYPE* const dest)
+		{
+			channel->mutex.claim();
+				Item* item = waitForItem();
+			channel->mutex.release();
+
+			//The item cannot be deleted until we have taken it, so we copy without the mutex:
+			*dest = item->data;
+
+			channel->mutex.claim();
+				channel->take(this);
+			channel->mutex.release();
+		}
+
+		void beginExtInput(DATA_TYPE* const dest)
+		{
+			channel->mutex.claim();
+				Item* item = waitForItem();
+			channel->mutex.release();
+
+			*dest = item->data;
+		}
+
+		//This method will never throw a poison exception
+		void endExtInput()
+		{
+			//Only now is the item taken, so that an unbuffered writer stays blocked throughout the extended input
+			channel->mutex.claim();
+				if (nextItem != NULL)
+					channel->take(this);
+			channel->mutex.release();
+		}
+
+		void output(const DATA_TYPE* const)
+		{
+			//Never called; subscriptions only have reading ends
+		}
+
+		void poisonIn()
+		{
+			channel->poison();
+		}
+
+		void poisonOut()
+		{
+			channel->poison();
+		}
+
+		class __SubscriptionGuard : public Guard
+		{
+		private:
+			BroadcastSubscription<DATA_TYPE>* subscription;
+		protected:
+			bool enable(internal::AltingProcessPtr proc)
+			{
+				bool ready;
+				subscription->channel->mutex.claim();
+
+					if (subscription->nextItem != NULL || subscription->channel->isPoisoned)
+					{
+						ready = true;
+					}
+					else
+					{
+						subscription->waitingProcess = proc;
+						ready = false;
+					}
+
+				subscription->channel->mutex.release();
+				return ready;
+			}
+
+			bool disable(internal::AltingProcessPtr)
+			{
+				bool ready;
+				subscription->channel->mutex.claim();
+
+					subscription->waitingProcess = NullProcessPtr;
+					ready = (subscription->nextItem != NULL || subscription->channel->isPoisoned);
+
+				subscription->channel->mutex.release();
+				return ready;
+			}
+		public:
+			inline explicit __SubscriptionGuard(BroadcastSubscription<DATA_TYPE>* _subscription)
+				:	subscription(_subscription)
+			{
+			}
+		};
+
+		Guard* inputGuard()
+		{
+			return new __SubscriptionGuard(this);
+		}
+		
+		Guard* inputGuard(internal::GuardStorage* storage)
+		{
+			return new (storage->place<__SubscriptionGuard>()) __SubscriptionGuard(this);
+		}
+
+		bool pending()
+		{
+			bool ret;
+			channel->mutex.claim();
+				ret = (nextItem != NULL || channel->isPoisoned);
+			channel->mutex.release();
+			return ret;
+		}
+	public:
+		/**
+		*	Gets the reading end for this subscription.
+		*
+		*	The reading end remains valid until the subscription is destroyed or unsubscribe() is called.
+		*/
+		AltChanin<DATA_TYPE> reader()
+		{
+			return AltChanin<DATA_TYPE>(this,true);
+		}
+
+		/**
+		*	Stops this subscription from receiving any more items from the channel.
+		*
+		*	Any items that had been written but not yet read by this subscriber are discarded (as far as this
+		*	subscriber is concerned), which may allow a blocked writer to continue.  Calling this more than once
+		*	has no further effect.  The reading end must not be used after this call.
+		*/
+		void unsubscribe()
+		{
+			if (channel != NULL)
+			{
+				channel->removeSubscriber(this);
+				channel = NULL;
+			}
+		}
+
+		/**
+		*	Destroys the subscription, unsubscribing from the channel if this has not already been done.
+		*/
+		~BroadcastSubscription()
+		{
+			unsubscribe();
+		}
+
+		friend class BroadcastChannel<DATA_TYPE>;
+
+		//For testing:
+		friend class ::BroadcastChannelTest;
+	};
+
+	template <typename DATA_TYPE>
+	class BroadcastChannel : protected internal::BaseChan<DATA_TYPE>, private internal::Primitive
+	{
+	private:
+		typedef internal::BroadcastItem<DATA_TYPE> Item;
+		typedef BroadcastSubscription<DATA_TYPE> Subscription;
+
+		internal::PureSpinMutex mutex;
+		using internal::BaseChan<DATA_TYPE>::isPoisoned;
+
+		///The number of items that may be outstanding before the writer must wait
+		const usign32 bufferSize;
+
+		//The rest of these are only accessed with the mutex claimed:
+
+		///Items that are still to be taken by at least one subscriber, oldest first
+		Item* itemsHead;
+		Item* itemsTail;
+		usign32 outstanding;
+
+		Subscription* subscribers;
+		usign32 subscriberCount;
+
+		internal::ProcessPtr waitingWriter;
+		bool volatile * writerFinished;
+
+		/**@internal
+		*	Frees any items that every subscriber has taken, and frees the writer if it was waiting and
+		*	there is now room.  Must be called with the mutex claimed.
+		*/
+		void itemsTaken()
+		{
+			while (itemsHead != NULL && itemsHead->remaining == 0)
+			{
+				Item* item = itemsHead;
+				itemsHead = item->next;
+				delete item;
+			}
+			if (itemsHead == NULL)
+				itemsTail = NULL;
+
+			if (waitingWriter != NullProcessPtr && outstanding <= bufferSize)
+			{
+				*writerFinished = true;
+				internal::ProcessPtr writer = waitingWriter;
+				waitingWriter = NullProcessPtr;
+				freeProcessNoAlt(writer);
+			}
+		}
+
+		/**@internal
+		*	Records that the subscriber has taken its next item.  Must be called with the mutex claimed.
+		*/
+		void take(Subscription* sub)
+		{
+			Item* item = sub->nextItem;
+			sub->nextItem = item->next;
+
+			if (0 == --(item->remaining))
+			{
+				outstanding--;
+				itemsTaken();
+			}
+		}
+
+		void removeSubscriber(Subscription* sub)
+		{
+			mutex.claim();
+
+				//Any items they have not taken no longer need to wait for them:
+				bool anyFinished = false;
+				for (Item* item = sub->nextItem;item != NULL;item = item->next)
+				{
+					if (0 == --(item->remaining))
+					{
+						outstanding--;
+						anyFinished = true;
+					}
+				}
+				sub->nextItem = NULL;
+				if (anyFinished)
+					itemsTaken();
+
+				if (sub->prevSubscriber != NULL)
+					sub->prevSubscriber->nextSubscriber = sub->nextSubscriber;
+				else
+					subscribers = sub->nextSubscriber;
+				if (sub->nextSubscriber != NULL)
+					sub->nextSubscriber->prevSubscriber = sub->prevSubscriber;
+				subscriberCount--;
+
+			mutex.release();
+		}
+
+		void output(const DATA_TYPE* const src)
+		{
+			//Copy the data before we claim the mutex; this is the only copy made by the channel:
+			Item* item = new Item(*src);
+
+			mutex.claim();
+
+			if (isPoisoned)
+			{
+				mutex.release();
+				delete item;
+				throw PoisonException();
+			}
+
+			if (subscriberCount == 0)
+			{
+				//No-one to receive it:
+				mutex.release();
+				delete item;
+				return;
+			}
+
+			item->remaining = subscriberCount;
+			if (itemsTail == NULL)
+				itemsHead = item;
+			else
+				itemsTail->next = item;
+			itemsTail = item;
+			outstanding++;
+
+			for (Subscription* sub = subscribers;sub != NULL;sub = sub->nextSubscriber)
+			{
+				if (sub->nextItem == NULL)
+				{
+					//They had taken everything, so this is now their next item:
+					sub->nextItem = item;
+
+					if (sub->waitingProcess != NullProcessPtr)
+					{
+						//Might be alting, might not:
+						freeProcessMaybe(sub->waitingProcess);
+						sub->waitingProcess = NullProcessPtr;
+					}
+				}
+			}
+
+			if (outstanding > bufferSize)
+			{
+				bool volatile finished = false;
+				writerFinished = &finished;
+				waitingWriter = currentProcess();
+				mutex.release();
+				reschedule();
+				//Enough items have been taken, or we've been poisoned:
+				if (false == finished)
+					throw PoisonException();
+			}
+			else
+			{
+				mutex.release();
+			}
+		}
+
+		void poison()
+		{
+			mutex.claim();
+				isPoisoned = true;
+
+				for (Subscription* sub = subscribers;sub != NULL;sub = sub->nextSubscriber)
+				{
+					if (sub->waitingProcess != NullProcessPtr)
+					{
+						freeProcessMaybe(sub->waitingProcess);
+						sub->waitingProcess = NullProcessPtr;
+					}
+				}
+
+				if (waitingWriter != NullProcessPtr)
+				{
+					internal::ProcessPtr writer = waitingWriter;
+					waitingWriter = NullProcessPtr;
+					freeProcessNoAlt(writer);
+				}
+			mutex.release();
+		}
+
+		void poisonOut()
+		{
+			poison();
+		}
+
+		//The channel itself only has a writing end, so these are never called:
+
+		void input(DATA_TYPE* const)
+		{
+		}
+
+		void beginExtInput(DATA_TYPE* const)
+		{
+		}
+
+		void endExtInput()
+		{
+		}
+
+		void poisonIn()
+		{
+			poison();
+		}
+	public:
+		/**
+		*	Constructs a broadcast channel.
+		*
+		*	@param _bufferSize The number of items that the writer may write ahead of the slowest subscriber.
+		*	The default, zero, gives an unbuffered channel: each write completes only once every subscriber
+		*	has taken the item.
+		*/
+		inline explicit BroadcastChannel(const usign32 _bufferSize = 0)
+			:	bufferSize(_bufferSize),itemsHead(NULL),itemsTail(NULL),outstanding(0),
+				subscribers(NULL),subscriberCount(0),waitingWriter(NullProcessPtr),writerFinished(NULL)
+		{
+		}
+
+		/**
+		*	Destroys the channel.  All subscriptions should be destroyed (or unsubscribed) first.
+		*/
+		~BroadcastChannel()
+		{
+			for (Subscription* sub = subscribers;sub != NULL;sub = sub->nextSubscriber)
+			{
+				sub->channel = NULL;
+				sub->nextItem = NULL;
+			}
+
+			while (itemsHead != NULL)
+			{
+				Item* item = itemsHead;
+				itemsHead = item->next;
+				delete item;
+			}
+		}
+
+		/**
+		*	Gets the writing end of the channel.
+		*/
+		Chanout<DATA_TYPE> writer()
+		{
+			return Chanout<DATA_TYPE>(this,true);
+		}
+
+		/**
+		*	Subscribes a new reader to the channel.
+		*
+		*	The new subscriber will receive every item written after this call returns (but none that were
+		*	written before it).  It is safe to subscribe while the writer is writing; the subscriber may or
+		*	may not receive the item currently being written.
+		*
+		*	@return The subscription.  Use its reader() method to get the reading end.  Destroying the
+		*	subscription unsubscribes it.
+		*/
+		Mobile< BroadcastSubscription<DATA_TYPE> > subscribe()
+		{
+			Subscription* sub = new Subscription(this);
+
+			mutex.claim();
+				sub->nextSubscriber = subscribers;
+				if (subscribers != NULL)
+					subscribers->prevSubscriber = sub;
+				subscribers = sub;
+				subscriberCount++;
+			mutex.release();
+
+			return Mobile<Subscription>(sub);
+		}
+
+		friend class BroadcastSubscription<DATA_TYPE>;
+
+		//For testing:
+		friend class ::BroadcastChannelTest;
+	};
+
+	/** @class BroadcastChannel
+	*	A one-to-many channel that delivers every item to every subscribed reader.
+	*
+	*	Unlike a One2AnyChannel (where each item goes to just one of the readers), every item written to a
+	*	BroadcastChannel is received by each reader that was subscribed when the item was written.  Readers
+	*	subscribe with subscribe(), and can join and leave at any time while the channel is in use:
+	*	@code
+		BroadcastChannel<int> c;
+
+		Mobile< BroadcastSubscription<int> > subA = c.subscribe();
+		Mobile< BroadcastSubscription<int> > subB = c.subscribe();
+
+		Run(InParallel
+			(new WriterProcess<int>(c.writer(),42))
+			(new ReaderProcess<int>(subA->reader()))
+			(new ReaderProcess<int>(subB->reader()))
+		);
+		@endcode
+	*
+	*	Each item is copied once, when it is written, and that single copy is shared by all the subscribers
+	*	(each of which copies it out when it reads).  A write costs one wake-up per waiting reader, plus one for
+	*	the writer if it had to wait, compared to the several processes and internal channels per reader needed
+	*	when fanning out with csp::common::Delta processes.
+	*
+	*	The constructor takes a buffer size.  With the default of zero, a write does not complete until every
+	*	subscriber has taken the item (and if there are no subscribers, the item is discarded straight away).
+	*	With a buffer size of N, the writer may be up to N items ahead of the slowest subscriber before it must wait.
+	*	Unsubscribing discards that subscriber's unread items, so a slow subscriber leaving may free the writer.
+	*
+	*	The reading ends are AltChanin, so they may be used in alternatives and for extended input.  During an
+	*	extended input, the item is not counted as taken until the extended input finishes.
+	*
+	*	Poisoning the writing end, or any of the reading ends, poisons the whole channel.  As with the buffered
+	*	channels, readers will continue to receive items that were written before the poison until they have
+	*	taken them all, and only then will they see the poison.
+	*
+	*	@section tempreq DATA_TYPE Requirements
+	*
+	*	DATA_TYPE must have a copy constructor and support assignment.
+	*/
+
+	/** @class BroadcastSubscription
+	*	A subscription to a BroadcastChannel.
+	*
+	*	Subscriptions are created by BroadcastChannel::subscribe(), and are held in a Mobile so that they
+	*	can be passed to the process that will use them.  A subscription receives every item written to the
+	*	channel after it was created, until it is unsubscribed (either explicitly, or by being destroyed).
+	*	Subscriptions must not outlive their channel.
+	*/
+
+} //namespace csp
@@ -43,12 +43,145 @@ namespace csp
 	{
 	private:
 		typedef std::pair<internal::ProcessPtr,internal::ProcessPtr> ProcessQueue;
-		std::map<ThreadId,ProcessQueue> processes;
-		volatile usign32 processCount;
-		internal::PureSpinMutex mutex;			
+		
+		///The processes in the bucket from one thread
+		class Slot
+		{
+		public:
+			ProcessQueue queue;
+			volatile usign32 count;
+			ThreadId thread;
+			unsigned int index;
+			///Set by the owning thread while it uses the slot without the mutex
+			volatile bool busy;
+			
+			inline Slot()
+				:	queue(NullProcessPtr,NullProcessPtr),count(0),thread(NULL),index(0),busy(false)
+			{
+			}
+		};
+		
+		internal::KernelSlots<Slot> slots;
+		///The slots that have processes in them (not including the local slot)
+		std::vector<Slot*> waiting;
+		/**
+		*	The slot of the only thread that has used the bucket, or NULL.  While it is set, that thread uses its slot
+		*	without the mutex.  Once a second thread uses the bucket it is set to NULL, and stays that way
+		*/
+		Slot* volatile localSlot;
+		///Whether more than one thread has used the bucket
+		bool shared;
+		internal::PureSpinMutex mutex;
+		
+		/**
+		*	Called by the local thread before using its slot without the mutex.  Returns false if the bucket is
+		*	(now) shared, in which case the mutex must be used instead.
+		*
+		*	There is no memory barrier between setting busy and reading localSlot; stopLocal() makes up for that,
+		*	with an AsymmetricBarrier between clearing localSlot and reading busy.  So either it sees us as busy
+		*	(and waits for us), or we see that we can no longer use the slot without the mutex.
+		*/
+		inline bool startLocal(Slot* slot)
+		{
+			slot->busy = true;
+			internal::CompilerBarrier();
+			if (localSlot == slot)
+			{
+				return true;
+			}
+			slot->busy = false;
+			return false;
+		}
+		
+		///Called by the local thread after using its slot without the mutex
+		inline void finishLocal(Slot* slot)
+		{
+			//Our changes to the slot must be visible before anyone can see that we have finished:
+			internal::CompilerBarrier();
+			slot->busy = false;
+		}
+		
+		/**
+		*	Gets the slot for the given kernel, deciding whether the bucket is shared.  The mutex must be held.
+		*	If the returned slot is the local slot, it is not in the waiting list.
+		*/
+		Slot* lockedSlot(unsigned int index)
+		{
+			Slot* slot = slots.get(index);
+			if (slot->thread == NULL)
+			{
+				slot->thread = currentThread();
+				slot->index = index;
+				if (false == shared && localSlot == NULL)
+				{
+					//We are the first to use the bucket:
+					localSlot = slot;
+					return slot;
+				}
+			}
+			
+			if (localSlot != NULL && localSlot != slot)
+			{
+				stopLocal();
+			}
+			
+			return slot;
+		}
+		
+		///Ends the local mode, because another thread is using the bucket.  The mutex must be held
+		void stopLocal()
+		{
+			Slot* local = localSlot;
+			localSlot = NULL;
+			shared = true;
+			
+			internal::AsymmetricBarrier();
+			
+			//The local thread may be part-way through using its slot, but it will be quick:
+			for (int spinCount = 0;local->busy;spinCount++)
+			{
+				spin(spinCount);
+			}
+			
+			if (local->queue.first != NullProcessPtr)
+			{
+				waiting.push_back(local);
+			}
+		}
+		
+		///Frees the processes in a slot, and returns how many there were
+		inline usign32 freeSlot(Slot* slot)
+		{
+			const usign32 ret = slot->count;
+			const ProcessQueue queue = slot->queue;
+			slot->queue = ProcessQueue(NullProcessPtr,NullProcessPtr);
+			slot->count = 0;
+			if (queue.first != NullProcessPtr)
+			{
+				freeProcessChain(queue.first,queue.second);
+			}
+			return ret;
+		}
+		
+		///For testing: the queue of processes from each thread that has processes in the bucket
+		std::map<ThreadId,ProcessQueue> queues()
+		{
+			std::map<ThreadId,ProcessQueue> ret;
+			mutex.claim();
+				if (localSlot != NULL && localSlot->queue.first != NullProcessPtr)
+				{
+					ret[localSlot->thread] = localSlot->queue;
+				}
+				for (unsigned int i = 0;i < waiting.size();i++)
+				{
+					ret[waiting[i]->thread] = waiting[i]->queue;
+				}
+			mutex.release();
+			return ret;
+		}
 	public:
 		inline Bucket()
-			:	processCount(0)
+			:	localSlot(NULL),shared(false)
 		{
 		}
 		
@@ -57,26 +190,37 @@ namespace csp
 		*
 		*	Any process may fall into a bucket (i.e. no enrollment is needed).  It will then wait until another
 		*	process calls the flush() function.
+		*
+		*	While all the processes that use the bucket are in the same thread, falling into it and flushing it
+		*	need no mutex or atomic operations.
 		*/
 		void fallInto()
 		{
-			ThreadId id = currentThread();
-			mutex.claim();
+			const unsigned int index = currentKernelIndex();
+			Slot* slot = localSlot;
 			
-				std::map<ThreadId,ProcessQueue>::iterator it = processes.find(id);
+			if (slot != NULL && slot->index == index && startLocal(slot))
+			{
+				addProcessToQueue(&(slot->queue.first),&(slot->queue.second),currentProcess());
+				slot->count++;
+				finishLocal(slot);
+			}
+			else
+			{
+				mutex.claim();
 				
-				if (it == processes.end())
-				{
-					it = processes.insert(std::make_pair(id,std::make_pair(NullProcessPtr,NullProcessPtr))).first;
-				}
-							
-				ProcessQueue& queue = it->second;
-			
-				addProcessToQueue(&(queue.first),&(queue.second),currentProcess());
+					slot = lockedSlot(index);
+					
+					if (slot->queue.first == NullProcessPtr && slot != localSlot)
+					{
+						waiting.push_back(slot);
+					}
 				
-				processCount++;
-			
-			mutex.release();
+					addProcessToQueue(&(slot->queue.first),&(slot->queue.second),currentProcess());
+					slot->count++;
+				
+				mutex.release();
+			}
 			
 			reschedule();
 		}
@@ -95,20 +239,35 @@ namespace csp
 		*/
 		usign32 flush()
 		{
-			usign32 ret;
-			mutex.claim();
+			usign32 ret = 0;
+			const unsigned int index = currentKernelIndex();
+			Slot* slot = localSlot;
 			
-				ret = processCount;
-				processCount = 0;
+			if (slot != NULL && slot->index == index && startLocal(slot))
+			{
+				ret = freeSlot(slot);
+				finishLocal(slot);
+			}
+			else
+			{
+				mutex.claim();
 				
-				for (std::map<ThreadId,ProcessQueue>::const_iterator it = processes.begin();it != processes.end();it++)
-				{
-					freeProcessChain(it->second.first,it->second.second);
-				}
-		
-				processes.clear();
-				
-			mutex.release();
+					slot = lockedSlot(index);
+					
+					if (slot == localSlot)
+					{
+						ret = freeSlot(slot);
+					}
+					
+					for (unsigned int i = 0;i < waiting.size();i++)
+					{
+						ret += freeSlot(waiting[i]);
+					}
+			
+					waiting.clear();
+					
+				mutex.release();
+			}
 		
 			return ret;
 		}
@@ -125,9 +284,18 @@ namespace csp
 		*/
 		usign32 holding()
 		{
-			usign32 ret;
+			usign32 ret = 0;
 			mutex.claim();
-				ret = processCount;
+				//The local thread may be changing its count as we read it, but the count only ever
+				//changes by one at a time, so we will get either the old value or the new one:
+				if (localSlot != NULL)
+				{
+					ret = localSlot->count;
+				}
+				for (unsigned int i = 0;i < waiting.size();i++)
+				{
+					ret += waiting[i]->count;
+				}
 			mutex.release();
 			return ret;
 		}
@@ -41,9 +41,10 @@ namespace csp
 	namespace internal
 	{
 		
-	template <typename DATA_TYPE,typename MUTEX = internal::PureSpinMutex>
+	template <typename DATA_TYPE,typename MUTEX = internal::PureSpinMutex,typename STATS = internal::NullChannelStats>
 	class _BufferedOne2OneChannel
-		:	protected internal::BaseAltChan<DATA_TYPE>, private internal::Primitive
+		:	protected internal::BaseAltChan<DATA_TYPE>, protected internal::BaseAltOutChan<DATA_TYPE>,
+			private internal::Primitive, protected STATS
 	{
 	private:
 		MUTEX mutex;
@@ -56,6 +57,32 @@ namespace csp
 		using internal::BaseAltChan<DATA_TYPE>::isPoisoned;
 		bool volatile * volatile commFinished;
 		
+		///The ReadinessAlternative that the reader's guard is attached to, if any
+		internal::AltReadySet* readySet;
+		unsigned int readyIndex;
+		
+		///Must be called with the mutex claimed, whenever data is put in the buffer (or the channel is poisoned)
+		inline void signalReady()
+		{
+			if (readySet != NULL)
+			{
+				readySet->signal(readyIndex);
+			}
+		}
+		
+		///The writer, if it is alting with an output guard that was not ready
+		volatile internal::AltingProcessPtr outputAlter;
+		
+		///Must be called with the mutex claimed, whenever data is taken out of the buffer (or the channel is poisoned)
+		inline void freeOutputAlter()
+		{
+			if (outputAlter != NULL)
+			{
+				freeProcessMaybe(outputAlter);
+				outputAlter = NULL;
+			}
+		}
+		
 		virtual void input(DATA_TYPE* const _dest)
 		{
 			typename MUTEX::End end(mutex.end());
@@ -78,7 +105,10 @@ namespace csp
 				commFinished = &finished;
 				
 				end.release();
-				reschedule();
+				{
+					typename STATS::Wait wait(*this,true);
+					reschedule();
+				}
 				//Communication done, or we were poisoned:				
 				if (false == finished)
 				{					
@@ -91,12 +121,16 @@ namespace csp
 			
 				//get data from the buffer:
 				buffer->get(_dest);
+				STATS::bufferGot();
 
 				//now see if there is an outputter waiting on the buffer:
 				if (waitingProcess != NULL && buffer->outputWouldSucceed(src))
 				{
 					//there is, so do their transfer and wake them up
 					buffer->put(src);
+					STATS::bufferPut();
+					STATS::messageSent();
+					signalReady();
 					
 					*commFinished = true;
 
@@ -107,6 +141,7 @@ namespace csp
 					freeProcessNoAlt(wasWaiting);
 				}
 				
+				freeOutputAlter();
 				end.release();
 			}		
 		}		
@@ -133,7 +168,10 @@ namespace csp
 				commFinished = &finished;
 				
 				end.release();
-				reschedule();
+				{
+					typename STATS::Wait wait(*this,true);
+					reschedule();
+				}
 				//Communication done, or we were poisoned:
 								
 				if (false == finished)
@@ -166,12 +204,16 @@ namespace csp
 			end.claim();
 			
 			buffer->endExtGet();
+			STATS::bufferGot();
 			
 				//now see if there is an outputter waiting on the buffer:
 				if (waitingProcess != NULL && buffer->outputWouldSucceed(src))
 				{
 					//there is, so do their transfer and wake them up
 					buffer->put(src);
+					STATS::bufferPut();
+					STATS::messageSent();
+					signalReady();
 					
 					*commFinished = true;
 
@@ -181,6 +223,8 @@ namespace csp
 					
 					freeProcessNoAlt(wasWaiting);
 				}
+				
+				freeOutputAlter();
 			
 			end.release();
 		}
@@ -205,7 +249,10 @@ namespace csp
 				commFinished = &finished;
 				
 				end.release();
-				reschedule();
+				{
+					typename STATS::Wait wait(*this,false);
+					reschedule();
+				}
 				//Either communication has finished, or we were poisoned:				
 				if (false == finished)
 				{					
@@ -215,6 +262,9 @@ namespace csp
 			else
 			{
 				buffer->put(_src);
+				STATS::bufferPut();
+				STATS::messageSent();
+				signalReady();
 				//now see if there is a reader waiting on the buffer:
 				if (waitingProcess != NULL)
 				{
@@ -225,6 +275,7 @@ namespace csp
 						if (dest != NULL)
 						{
 							buffer->get(dest);
+							STATS::bufferGot();
 						}
 						
 						*commFinished = true;
@@ -255,6 +306,7 @@ namespace csp
 			if (clearBuffer)
 			{
 				buffer->clear();
+				STATS::bufferCleared();
 			}
 			
 			if (waitingProcess != NullProcessPtr)
@@ -263,7 +315,10 @@ namespace csp
 				waitingProcess = NULL;
 					
 				freeProcessMaybe(wasWaiting);
-			}						
+			}
+			
+			freeOutputAlter();
+			signalReady();
 			end.release();
 		}
 		
@@ -280,9 +335,9 @@ namespace csp
 		class __ChannelGuard : public csp::Guard
 		{
 			volatile bool finished;
-			_BufferedOne2OneChannel<DATA_TYPE>* channel;
+			_BufferedOne2OneChannel<DATA_TYPE,MUTEX,STATS>* channel;
 		public:
-			inline __ChannelGuard(_BufferedOne2OneChannel<DATA_TYPE>* _channel)
+			inline __ChannelGuard(_BufferedOne2OneChannel<DATA_TYPE,MUTEX,STATS>* _channel)
 				:	channel(_channel)
 			{
 			}
@@ -332,12 +387,103 @@ namespace csp
 				
 				return ret;
 			}
+			
+			inline bool attach(internal::AltReadySet* set,unsigned int index)
+			{
+				typename MUTEX::End end(channel->mutex.end());
+				end.claim();
+				bool ret = false;
+				
+					if (channel->readySet == NULL)
+					{
+						channel->readySet = set;
+						channel->readyIndex = index;
+						if (channel->buffer->inputWouldSucceed() || channel->isPoisoned)
+						{
+							set->signal(index);
+						}
+						ret = true;
+					}
+				
+				end.release();
+				return ret;
+			}
+			
+			inline void detach()
+			{
+				typename MUTEX::End end(channel->mutex.end());
+				end.claim();
+					channel->readySet = NULL;
+				end.release();
+			}
+			
+			inline bool ready()
+			{
+				return channel->pending();
+			}
 		};
 		
 		virtual Guard* inputGuard()
 		{
 			return new __ChannelGuard(this);
 		}		
+		
+		virtual Guard* inputGuard(internal::GuardStorage* storage)
+		{
+			return new (storage->place<__ChannelGuard>()) __ChannelGuard(this);
+		}
+		
+		/**@internal
+		*	The writer's guard.  It is ready when the buffer has room for the data, or the channel is poisoned.
+		*	If it is not ready, the writer is recorded as outputAlter, and the next input from the buffer frees it.
+		*/
+		class __OutputGuard : public csp::Guard
+		{
+			_BufferedOne2OneChannel<DATA_TYPE,MUTEX,STATS>* channel;
+			const DATA_TYPE* source;
+		public:
+			inline __OutputGuard(_BufferedOne2OneChannel<DATA_TYPE,MUTEX,STATS>* _channel,const DATA_TYPE* _source)
+				:	channel(_channel),source(_source)
+			{
+			}
+		
+			inline bool enable(ProcessPtr proc)
+			{
+				typename MUTEX::End end(channel->mutex.end());
+				end.claim();
+				
+					const bool ret = channel->isPoisoned || channel->buffer->outputWouldSucceed(source);
+					if (false == ret)
+					{
+						channel->outputAlter = proc;
+					}
+				
+				end.release();
+				return ret;
+			}
+			
+			inline bool disable(ProcessPtr)
+			{
+				typename MUTEX::End end(channel->mutex.end());
+				end.claim();
+				
+					channel->outputAlter = NullProcessPtr;
+					const bool ret = channel->isPoisoned || channel->buffer->outputWouldSucceed(source);
+					
+				end.release();
+				return ret;
+			}
+		};
+		
+		virtual Guard* outputGuard(const DATA_TYPE* source)
+		{
+			return new __OutputGuard(this,source);
+		}
+		
+		virtual Guard* outputGuard(const DATA_TYPE* source,internal::GuardStorage* storage)
+		{
+			return new (storage->place<__OutputGuard>()) __OutputGuard(this,source);
+		}
 
 		/**@internal
 		*	Checks whether an input would succeed immediately on the channel
@@ -365,20 +511,26 @@ namespace csp
 		//For the child Buffered.. channels
 		_BufferedOne2OneChannel()
 			:	waitingProcess(NULL),
+				readySet(NULL),readyIndex(0),outputAlter(NULL),
 				buffer(NULL)
 		{
 			dest = NULL;
 			src = NULL; //both, just in case
+			
+			STATS::attachMutex(&mutex);
 		}
 
 	
 	public:
 		_BufferedOne2OneChannel(const ChannelBufferFactory<DATA_TYPE>& bufferFactory)
 			:	waitingProcess(NULL),
+				readySet(NULL),readyIndex(0),outputAlter(NULL),
 				buffer(bufferFactory.createBuffer())
 		{
 			dest = NULL;
 			src = NULL; //both, just in case
+			
+			STATS::attachMutex(&mutex);
 		}		
 		
 		/**
@@ -402,11 +554,11 @@ namespace csp
 		/**
 		*	Gets a writing end for the channel
 		*
-		*	@see Chanout
+		*	@see AltChanout
 		*/
-		inline Chanout<DATA_TYPE> writer()
+		inline AltChanout<DATA_TYPE> writer()
 		{
-			return Chanout<DATA_TYPE>(this,true);
+			return AltChanout<DATA_TYPE>(this,this,true);
 		}		
 		
 		
@@ -416,7 +568,7 @@ namespace csp
 		template <typename CHANNEL,typename _DATA_TYPE,typename _MUTEX>
 		friend class internal::One2AnyAdapter;
 		
-		template <typename CHANNEL,typename _DATA_TYPE>
+		template <typename CHANNEL,typename _DATA_TYPE,typename _MUTEX>
 		friend class internal::Any2AnyAdapter;		
 		
 		
@@ -461,7 +613,7 @@ namespace csp
 		AltChanin<DATA_TYPE> reader();		
 		
 		///Gets the writing end of the channel
-		Chanout<DATA_TYPE> writer();
+		AltChanout<DATA_TYPE> writer();
 		#endif	
 		
 		friend class csp::BufferedOne2AnyChannel<DATA_TYPE>;
@@ -524,7 +676,7 @@ namespace csp
 		Chanin<DATA_TYPE> reader();		
 		
 		///Gets the writing end of the channel
-		Chanout<DATA_TYPE> writer();
+		AltChanout<DATA_TYPE> writer();
 		#endif	
 		
 		//For testing:
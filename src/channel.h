@@ -33,8 +33,9 @@ namespace csp
 		template <typename CHANNEL,typename DATA_TYPE,typename MUTEX>
 		class One2AnyAdapter;
 	
-	template <typename DATA_TYPE, typename MUTEX = internal::PureSpinMutex>	
-	class _One2OneChannel : protected internal::BaseAltChan<DATA_TYPE>, private internal::Primitive
+	template <typename DATA_TYPE, typename MUTEX = internal::PureSpinMutex, typename STATS = internal::NullChannelStats>
+	class _One2OneChannel : protected internal::BaseAltChan<DATA_TYPE>, protected internal::BaseAltOutChan<DATA_TYPE>,
+		private internal::Primitive, protected STATS
 	{
 	private:
 		//typedef internal::QueuedMutex Mutex;
@@ -49,6 +50,29 @@ namespace csp
     using internal::BaseChan<DATA_TYPE>::isPoisoned;
     bool volatile * volatile commFinished;
     Mutex mutex;
+    
+    //The ReadinessAlternative that the reader's guard is attached to, if any:
+    internal::AltReadySet* readySet;
+    unsigned int readyIndex;
+    
+    //Must be called with the mutex claimed:
+    inline void signalReady() {
+        if (readySet != NULL)
+            readySet->signal(readyIndex);
+    }
+    
+    //The writer, if it is alting with an output guard:
+    Process* volatile outputAlter;
+    //Whether the reader in waiting (if any) is alting, rather than committed to an input:
+    bool volatile readerAlting;
+    
+    //Must be called with the mutex claimed, when a (committed) reader starts waiting:
+    inline void freeOutputAlter() {
+        if (outputAlter != NULL) {
+            freeProcessMaybe(outputAlter);
+            outputAlter = NULL;
+        }
+    }
 
     void checkPoison() {
         if (isPoisoned) {
@@ -69,14 +93,19 @@ namespace csp
             *commFinished = true;
             freeProcessNoAlt(wasWaiting);
             mutex.release();
+            STATS::messageSent();
         } else {
             //No-one waiting:
             dest = paramDest;
             waiting = currentProcess();
             volatile bool finished = false;
             commFinished = &finished;
+            freeOutputAlter();
             mutex.release();
-            reschedule();
+            {
+                typename STATS::Wait wait(*this,true);
+                reschedule();
+            }
             //Now communication has finished (or we've been poisoned)
             if (false == finished)
                 throw PoisonException();
@@ -97,8 +126,12 @@ namespace csp
             waiting = currentProcess();
             volatile bool finished = false;
             commFinished = &finished;
+            freeOutputAlter();
             mutex.release();
-            reschedule();
+            {
+                typename STATS::Wait wait(*this,true);
+                reschedule();
+            }
             //Now we are in the extended action (or we've been poisoned)
             if (false == finished)
                 throw PoisonException();
@@ -120,6 +153,7 @@ namespace csp
             waiting = NULL; src = NULL;
             *commFinished = true;
             freeProcessNoAlt(wasWaiting);
+            STATS::messageSent();
         }
     }
 
@@ -137,17 +171,22 @@ namespace csp
                 *commFinished = true;
                 freeProcessNoAlt(wasWaiting);
                 mutex.release();
+                STATS::messageSent();
             } else {
                 //Alting/extended reader:
                 Process* wasWaiting = waiting;
                 waiting = currentProcess();
+                readerAlting = false;
                 src = paramSrc;
                 *commFinished = true;
                 volatile bool finished = false;
                 commFinished = &finished;
                 freeProcessMaybe(wasWaiting);
                 mutex.release();
-                reschedule();
+                {
+                    typename STATS::Wait wait(*this,false);
+                    reschedule();
+                }
                 //Now communication has finished (or we've been poisoned)
                 if (false == finished)
                     throw PoisonException();
@@ -158,8 +197,12 @@ namespace csp
             waiting = currentProcess();
             bool finished = false;
             commFinished = &finished;
+            signalReady();
             mutex.release();
-            reschedule();
+            {
+                typename STATS::Wait wait(*this,false);
+                reschedule();
+            }
             //Now communication has finished (or we've been poisoned)
             if (false == finished)
                 throw PoisonException();
@@ -173,11 +216,15 @@ namespace csp
         
         Process* wasWaiting = waiting;
         waiting = NULL;
+        readerAlting = false;
 
         if (wasWaiting != NULL) {
             //Might be alting, might not:
             freeProcessMaybe(wasWaiting);
         }
+        
+        freeOutputAlter();
+        signalReady();
 
         mutex.release();
 
@@ -195,7 +242,7 @@ namespace csp
     {
     private:
 		volatile bool finished;
-		_One2OneChannel<DATA_TYPE,MUTEX>* channel;
+		_One2OneChannel<DATA_TYPE,MUTEX,STATS>* channel;
 	protected:
     
     
@@ -222,6 +269,7 @@ namespace csp
         } else {
             //Put ourselves in the channel:
             channel->waiting = proc;
+            channel->readerAlting = true;
             channel->dest = NULL;
             //Mainly to stop the pointer being invalid:
             channel->commFinished = &finished;
@@ -243,13 +291,42 @@ namespace csp
         } else {
             //Only us in the channel, remove ourselves:
             channel->waiting = NullProcessPtr;
+            channel->readerAlting = false;
             channel->mutex.release();
             return false;
         }
     }
     
+    bool attach(internal::AltReadySet* set,unsigned int index) {
+        channel->mutex.claim();
+        
+        if (channel->readySet != NULL) {
+            //Already attached to another alternative:
+            channel->mutex.release();
+            return false;
+        }
+        
+        channel->readySet = set;
+        channel->readyIndex = index;
+        if (channel->isPoisoned || (channel->waiting != NULL && channel->src != NULL)) {
+            set->signal(index);
+        }
+        channel->mutex.release();
+        return true;
+    }
+    
+    void detach() {
+        channel->mutex.claim();
+        channel->readySet = NULL;
+        channel->mutex.release();
+    }
+    
+    bool ready() {
+        return channel->pending();
+    }
+    
     public:
-			inline __ChannelGuard(_One2OneChannel<DATA_TYPE,MUTEX>* _channel)
+			inline __ChannelGuard(_One2OneChannel<DATA_TYPE,MUTEX,STATS>* _channel)
 				:	channel(_channel)
 			{
 			}
@@ -281,17 +358,76 @@ namespace csp
 		{			
 			return new __ChannelGuard(this);
 		}
-
-
-
+		
+		Guard* inputGuard(internal::GuardStorage* storage)
+		{
+			return new (storage->place<__ChannelGuard>()) __ChannelGuard(this);
+		}
+		
+		/**@internal
+		*	The writer's guard.  It is ready when a reader is committed to an input (not alting), or the channel is poisoned.
+		*	If it is not ready, the writer is recorded as outputAlter, and the next reader to commit to an input frees it.
+		*/
+		class __OutputGuard : public Guard
+		{
+		private:
+			_One2OneChannel<DATA_TYPE,MUTEX,STATS>* channel;
+			
+			//Must be called with the mutex claimed:
+			inline bool readerWaiting()
+			{
+				return channel->isPoisoned || (channel->waiting != NULL && false == channel->readerAlting);
+			}
+		protected:
+			bool enable(Process* proc)
+			{
+				bool ready;
+				channel->mutex.claim();
+					ready = readerWaiting();
+					if (false == ready)
+					{
+						channel->outputAlter = proc;
+					}
+				channel->mutex.release();
+				return ready;
+			}
+			
+			bool disable(Process*)
+			{
+				bool ready;
+				channel->mutex.claim();
+					channel->outputAlter = NULL;
+					ready = readerWaiting();
+				channel->mutex.release();
+				return ready;
+			}
+		public:
+			inline explicit __OutputGuard(_One2OneChannel<DATA_TYPE,MUTEX,STATS>* _channel)
+				:	channel(_channel)
+			{
+			}
+		};
+		
+		//The data to be output is not needed to tell whether the reader is waiting:
+		Guard* outputGuard(const DATA_TYPE*)
+		{
+			return new __OutputGuard(this);
+		}
+		
+		Guard* outputGuard(const DATA_TYPE*,internal::GuardStorage* storage)
+		{
+			return new (storage->place<__OutputGuard>()) __OutputGuard(this);
+		}
 	
 	public:
 		inline _One2OneChannel()
-			:	waiting(NULL)
+			:	waiting(NULL),readySet(NULL),readyIndex(0),outputAlter(NULL),readerAlting(false)
 		{
 			//Do both, just to be sure:
 			src = NULL;
 			dest = NULL;
+			
+			STATS::attachMutex(&mutex);
 		}
 	
 		AltChanin<DATA_TYPE> reader()
@@ -299,9 +435,9 @@ namespace csp
 			return AltChanin<DATA_TYPE>(this,true);
 		}
 		
-		Chanout<DATA_TYPE> writer()
+		AltChanout<DATA_TYPE> writer()
 		{
-			return Chanout<DATA_TYPE>(this,true);
+			return AltChanout<DATA_TYPE>(this,this,true);
 		}
 					
 		template <typename CHANNEL,typename _DATA_TYPE,typename _MUTEX>
@@ -331,7 +467,7 @@ namespace csp
 		AltChanin<DATA_TYPE> reader();		
 		
 		///Gets the writing end of the channel
-		Chanout<DATA_TYPE> writer()
+		AltChanout<DATA_TYPE> writer()
 		#endif
 	};	
 		
@@ -450,12 +586,410 @@ namespace csp
 	
 	namespace internal
 	{	
+		/**@internal
+		*	The implementation of Any2OneChannel.
+		*
+		*	Rather than serialising the writers on a mutex and passing them through a _One2OneChannel one at a
+		*	time (as Any2OneAdapter does), writers queue directly on the channel.  Each writer pushes a WriterRecord
+		*	(held on its own stack, since it will be blocked until the record is finished with) onto writerStack
+		*	with a single compare-and-swap, and then blocks.  The reader takes the whole stack in one go, reverses
+		*	it onto readerQueue and then serves the writers in the order that they arrived.  Writers therefore
+		*	never wait for each other, only for the reader.
+		*
+		*	writerStack also acts as the reader's waiting flag.  When the reader finds no writers it swaps
+		*	in &readerWaitingMarker and sleeps.  A writer that finds the marker claims the mutex and either copies
+		*	its data straight to the reader (normal input) or replaces the marker with its own record and wakes
+		*	the reader (alting or extended input).  Claiming the mutex here stops the reader's guard being disabled
+		*	between the writer taking the marker and waking the reader, which keeps the alting state-machine
+		*	correct.  This only happens when the reader was idle, so the mutex is rarely contended.
+		*
+		*	Apart from that, the mutex is only used by the reader (to protect readerQueue and extWriter, which
+		*	the reader's alting guard also needs) and by poisoners, which must free every queued writer.
+		*	Poisoning swaps in &poisonedMarker, so that a writer cannot push itself onto the stack after the
+		*	poisoner has emptied it.
+		*/
+		template <typename DATA_TYPE, typename MUTEX = internal::PureSpinMutex>
+		class _Any2OneChannel : protected internal::BaseAltChan<DATA_TYPE>, private internal::Primitive
+		{
+		private:
+			typedef MUTEX Mutex;
+		
+			class WriterRecord
+			{
+			public:
+				ProcessPtr process;
+				const DATA_TYPE* src;
+				volatile bool finished;
+				WriterRecord* next;
+			};
+			
+			///Waiting writers, most recent first, or one of the markers:
+			__CPPCSP_ALIGNED_PTR(WriterRecord) writerStack;
+			WriterRecord readerWaitingMarker;
+			WriterRecord poisonedMarker;
+			
+			//These are only accessed with the mutex claimed:
+			
+			///Writers already taken from writerStack by the reader, oldest first:
+			WriterRecord* readerQueueHead;
+			///The writer whose data is being used in the current extended input:
+			WriterRecord* extWriter;
+			ProcessPtr readerProcess;
+			///NULL when the reader is alting or performing an extended input:
+			DATA_TYPE* readerDest;
+			bool volatile * readerFinished;
+			
+			Mutex mutex;
+			
+			using internal::BaseChan<DATA_TYPE>::isPoisoned;
+			
+			void checkPoison()
+			{
+				if (isPoisoned)
+				{
+					mutex.release();
+					throw PoisonException();
+				}
+			}
+			
+			/**@internal
+			*	Takes the next writer off readerQueue, first moving any newly-arrived writers onto it if it is empty.
+			*	Must be called with the mutex claimed, by the reader.
+			*
+			*	@return The writer, or NULL if none are waiting
+			*/
+			WriterRecord* nextWriter()
+			{
+				if (readerQueueHead == NULL)
+				{
+					WriterRecord* arrived = AtomicSwap(&writerStack,static_cast<WriterRecord*>(NULL));
+					
+					//The most recent writer is on top of the stack; reverse it so that the oldest is served first:
+					while (arrived != NULL)
+					{
+						WriterRecord* next = arrived->next;
+						arrived->next = readerQueueHead;
+						readerQueueHead = arrived;
+						arrived = next;
+					}
+				}
+				
+				WriterRecord* writer = readerQueueHead;
+				if (writer != NULL)
+					readerQueueHead = writer->next;
+				return writer;
+			}
+			
+			/**@internal
+			*	Records the reader as waiting.  Must be called with the mutex claimed, by the reader.
+			*
+			*	@return True if the reader is now waiting, false if a writer arrived in the meantime
+			*/
+			bool markReaderWaiting(ProcessPtr proc,DATA_TYPE* dest,bool volatile * finished)
+			{
+				readerProcess = proc;
+				readerDest = dest;
+				readerFinished = finished;
+				return (NULL == AtomicCompareAndSwap(&writerStack,static_cast<WriterRecord*>(NULL),&readerWaitingMarker));
+			}
+			
+			///Completes a communication with a writer that has been taken off the queue
+			static void releaseWriter(WriterRecord* writer)
+			{
+				ProcessPtr proc = writer->process;
+				writer->finished = true;
+				freeProcessNoAlt(proc);
+			}
+			
+			///Frees a chain of writers without completing their communications, so that they notice the poison
+			static void releaseWritersPoisoned(WriterRecord* writer)
+			{
+				while (writer != NULL)
+				{
+					WriterRecord* next = writer->next;
+					freeProcessNoAlt(writer->process);
+					writer = next;
+				}
+			}
+			
+			void input(DATA_TYPE* const paramDest)
+			{
+				mutex.claim();
+				checkPoison();
+				
+				WriterRecord* writer = nextWriter();
+				if (writer == NULL)
+				{
+					volatile bool finished = false;
+					if (markReaderWaiting(currentProcess(),paramDest,&finished))
+					{
+						mutex.release();
+						reschedule();
+						//A writer has copied its data to us (or we've been poisoned)
+						if (false == finished)
+							throw PoisonException();
+						return;
+					}
+					
+					//A writer turned up while we were checking:
+					writer = nextWriter();
+				}
+				mutex.release();
+				
+				*paramDest = *(writer->src);
+				releaseWriter(writer);
+			}
+			
+			void beginExtInput(DATA_TYPE* const paramDest)
+			{
+				mutex.claim();
+				checkPoison();
+				
+				WriterRecord* writer = nextWriter();
+				if (writer == NULL)
+				{
+					if (markReaderWaiting(currentProcess(),NULL,NULL))
+					{
+						mutex.release();
+						reschedule();
+						//A writer has queued and woken us (or we've been poisoned)
+						mutex.claim();
+						checkPoison();
+					}
+					writer = nextWriter();
+				}
+				extWriter = writer;
+				mutex.release();
+				
+				*paramDest = *(writer->src);
+			}
+			
+			//This method will never throw a poison exception
+			void endExtInput()
+			{
+				//If the reader poisoned the channel during the extended input, the writer will already have
+				//been freed (and extWriter cleared) by the poisoning, so there will be nothing to do
+				mutex.claim();
+					WriterRecord* writer = extWriter;
+					extWriter = NULL;
+				mutex.release();
+				
+				if (writer != NULL)
+					releaseWriter(writer);
+			}
+			
+			void output(const DATA_TYPE* const paramSrc)
+			{
+				WriterRecord record;
+				record.process = currentProcess();
+				record.src = paramSrc;
+				record.finished = false;
+				
+				while (true)
+				{
+					WriterRecord* top = AtomicGet(&writerStack);
+					
+					if (top == &poisonedMarker)
+					{
+						throw PoisonException();
+					}
+					else if (top == &readerWaitingMarker)
+					{
+						//The reader is waiting.  See the class comment for why we claim the mutex:
+						mutex.claim();
+						checkPoison();
+						
+						if (readerDest != NULL)
+						{
+							//Normal reader; complete the communication and carry on:
+							if (&readerWaitingMarker == AtomicCompareAndSwap(&writerStack,&readerWaitingMarker,static_cast<WriterRecord*>(NULL)))
+							{
+								*readerDest = *paramSrc;
+								ProcessPtr reader = readerProcess;
+								*readerFinished = true;
+								mutex.release();
+								freeProcessNoAlt(reader);
+								return;
+							}
+						}
+						else
+						{
+							//Alting or extended reader; queue up and wake them:
+							record.next = NULL;
+							if (&readerWaitingMarker == AtomicCompareAndSwap(&writerStack,&readerWaitingMarker,&record))
+							{
+								freeProcessMaybe(readerProcess);
+								mutex.release();
+								break;
+							}
+						}
+						
+						//The reader stopped waiting before we got the mutex; try again:
+						mutex.release();
+					}
+					else
+					{
+						record.next = top;
+						if (top == AtomicCompareAndSwap(&writerStack,top,&record))
+							break;
+					}
+				}
+				
+				reschedule();
+				//Now communication has finished (or we've been poisoned)
+				if (false == record.finished)
+					throw PoisonException();
+			}
+			
+			void _poison()
+			{
+				mutex.claim();
+				isPoisoned = true;
+				
+				WriterRecord* top = AtomicSwap(&writerStack,&poisonedMarker);
+				
+				if (top == &readerWaitingMarker)
+				{
+					//Might be alting, might not:
+					freeProcessMaybe(readerProcess);
+				}
+				else if (top != &poisonedMarker)
+				{
+					releaseWritersPoisoned(top);
+				}
+				
+				releaseWritersPoisoned(readerQueueHead);
+				readerQueueHead = NULL;
+				
+				if (extWriter != NULL)
+				{
+					//Don't complete their communication; they will see the poison:
+					extWriter->next = NULL;
+					releaseWritersPoisoned(extWriter);
+					extWriter = NULL;
+				}
+				
+				mutex.release();
+			}
+			
+			void poisonOut()
+			{
+				_poison();
+			}
+			
+			void poisonIn()
+			{
+				_poison();
+			}
+			
+			class __ChannelGuard : public Guard
+			{
+			private:
+				_Any2OneChannel<DATA_TYPE,MUTEX>* channel;
+			protected:
+				bool enable(ProcessPtr proc)
+				{
+					bool ready;
+					channel->mutex.claim();
+					
+					if (channel->isPoisoned || channel->readerQueueHead != NULL)
+					{
+						ready = true;
+					}
+					else
+					{
+						WriterRecord* top = AtomicGet(&(channel->writerStack));
+						
+						if (top == &(channel->readerWaitingMarker))
+						{
+							//This channel is being used multiple times in the alt, and we are already waiting on it:
+							ready = false;
+						}
+						else if (top != NULL)
+						{
+							//Writers are waiting:
+							ready = true;
+						}
+						else
+						{
+							ready = (false == channel->markReaderWaiting(proc,NULL,NULL));
+						}
+					}
+					
+					channel->mutex.release();
+					return ready;
+				}
+				
+				bool disable(ProcessPtr)
+				{
+					bool ready;
+					channel->mutex.claim();
+					
+						//Take our marker out if it is still there:
+						AtomicCompareAndSwap(&(channel->writerStack),&(channel->readerWaitingMarker),static_cast<WriterRecord*>(NULL));
+						
+						ready = channel->isPoisoned || channel->readerQueueHead != NULL || AtomicGet(&(channel->writerStack)) != NULL;
+						
+					channel->mutex.release();
+					return ready;
+				}
+			public:
+				inline __ChannelGuard(_Any2OneChannel<DATA_TYPE,MUTEX>* _channel)
+					:	channel(_channel)
+				{
+				}
+				
+				virtual ~__ChannelGuard()
+				{
+				}
+			};
+			
+			bool pending()
+			{
+				bool ret;
+				mutex.claim();
+					ret = isPoisoned || readerQueueHead != NULL || AtomicGet(&writerStack) != NULL;
+				mutex.release();
+				return ret;
+			}
+			
+			Guard* inputGuard()
+			{
+				return new __ChannelGuard(this);
+			}
+			
+			Guard* inputGuard(GuardStorage* storage)
+			{
+				return new (storage->place<__ChannelGuard>()) __ChannelGuard(this);
+			}
+		public:
+			inline _Any2OneChannel()
+				:	writerStack(NULL),readerQueueHead(NULL),extWriter(NULL),readerProcess(NullProcessPtr),
+					readerDest(NULL),readerFinished(NULL)
+			{
+			}
+		
+			AltChanin<DATA_TYPE> reader()
+			{
+				return AltChanin<DATA_TYPE>(this,true);
+			}
+			
+			Chanout<DATA_TYPE> writer()
+			{
+				return Chanout<DATA_TYPE>(this,true);
+			}
+			
+			//For testing:
+			friend class ::ChannelTest;
+			friend class ::AltChannelTest;
+		};
 		
 		template <typename CHANNEL,typename DATA_TYPE,typename MUTEX = internal::QueuedMutex>
 		class Any2OneAdapter : protected virtual CHANNEL
 		{
-		private:
+		protected:
 			MUTEX writerMutex;
+		private:
 				
 			virtual void output(const DATA_TYPE* const _src)
 			{
@@ -504,8 +1038,9 @@ namespace csp
 		template <typename CHANNEL,typename DATA_TYPE,typename MUTEX = internal::QueuedMutex>
 		class One2AnyAdapter : protected virtual CHANNEL
 		{
-		private:
+		protected:
 			MUTEX readerMutex;
+		private:
 			typename MUTEX::End extEnd;
 			bool inExtInput;
 				
@@ -589,7 +1124,7 @@ namespace csp
 				return CHANNEL::reader();
 			}
 		
-			Chanout<DATA_TYPE> writer()
+			AltChanout<DATA_TYPE> writer()
 			{
 				return CHANNEL::writer();
 			}
@@ -599,8 +1134,8 @@ namespace csp
 			friend class ::BufferedChannelTest;
 		};
 		
-		template <typename CHANNEL,typename DATA_TYPE>
-		class Any2AnyAdapter : protected Any2OneAdapter<CHANNEL,DATA_TYPE>, protected One2AnyAdapter<CHANNEL,DATA_TYPE>
+		template <typename CHANNEL,typename DATA_TYPE,typename MUTEX = internal::QueuedMutex>
+		class Any2AnyAdapter : protected Any2OneAdapter<CHANNEL,DATA_TYPE,MUTEX>, protected One2AnyAdapter<CHANNEL,DATA_TYPE,MUTEX>
 		{
 		public:
 			Chanin<DATA_TYPE> reader()
@@ -620,7 +1155,7 @@ namespace csp
 	}
 	
 	template <typename DATA_TYPE>
-	class Any2OneChannel : public internal::Any2OneAdapter<One2OneChannel<DATA_TYPE>,DATA_TYPE>
+	class Any2OneChannel : public internal::_Any2OneChannel<DATA_TYPE>
 	#ifdef CPPCSP_DOXYGEN
 		//For the public docs, so the users know it can't be copied
 		, public boost::noncopyable
@@ -656,7 +1191,7 @@ namespace csp
 		AltChanin<DATA_TYPE> reader();		
 		
 		///Gets the writing end of the channel
-		Chanout<DATA_TYPE> writer();
+		AltChanout<DATA_TYPE> writer();
 		#endif	
 	};
 	
@@ -38,6 +38,8 @@ namespace csp
 	class AltChanin;
 	template <typename T>
 	class Chanout;		
+	template <typename T>
+	class AltChanout;
 	
 	template <typename DATA_TYPE>
 	class ScopedExtInput;
@@ -197,6 +199,14 @@ namespace internal
 		*	@see Alternative
 		*/
 		virtual Guard* inputGuard() = 0;
+		
+		/**@internal
+		*	Constructs a normal input guard for this class in the given storage, rather than on the heap.
+		*	The guard must be destroyed (but not deleted) by the caller.
+		*
+		*	@see InputGuard
+		*/
+		virtual Guard* inputGuard(GuardStorage* storage) = 0;
 
 		/**@internal
 		*	Checks whether an input would succeed immediately on the channel
@@ -219,6 +229,45 @@ namespace internal
 		typedef BaseAltChan<DATA_TYPE>* Pointer;
 
 	};
+	
+	/**@internal
+	*	The interface for channels whose writing end supports ALTing (with AltChanout::outputGuard()).
+	*
+	*	This is separate from BaseChan, so that channels that implement it still only have one BaseChan
+	*	(and therefore one poison flag).  Note that a pointer to this class should never be deleted and hence it
+	*	contains no virtual destructor.
+	*/
+	template <typename DATA_TYPE>
+	class BaseAltOutChan
+	{
+	protected:
+		/**@internal
+		*	Gets an output guard for this class
+		*
+		*	@param source The data that will be output if the guard is selected
+		*	@return A pointer to the guard
+		*/
+		virtual Guard* outputGuard(const DATA_TYPE* source) = 0;
+		
+		/**@internal
+		*	Constructs an output guard for this class in the given storage, rather than on the heap.
+		*	The guard must be destroyed (but not deleted) by the caller.
+		*
+		*	@see OutputGuard
+		*/
+		virtual Guard* outputGuard(const DATA_TYPE* source,GuardStorage* storage) = 0;
+		
+		inline ~BaseAltOutChan()
+		{
+		}
+	public:
+		/**@internal
+		*	AltChanout is a friend because:
+		*
+		*	It needs to access these functions for the channels
+		*/
+		friend class AltChanout<DATA_TYPE>;
+	};
 
 
 } //namespace internal
@@ -18,11 +18,7 @@
 */
 
 #include <list>
-#include <boost/mpl/sizeof.hpp>
-#include <boost/mpl/if.hpp>
-#include <boost/mpl/less_equal.hpp>
-#include <boost/mpl/times.hpp>
-#include <boost/pool/pool_alloc.hpp>
+#include <new>
 
 class AltChannelTest;
 
@@ -215,11 +211,259 @@ namespace csp
 		}
 	};
 	
+namespace internal
+{
+	/**@internal
+	*	A fixed-capacity FIFO queue held in a single contiguous block of storage.
+	*
+	*	All the storage is allocated once, in the constructor, and the items then chase each other round
+	*	the block (head is the index of the oldest item, and the newest item is count - 1 places after it,
+	*	wrapping at capacity).  Items are copy-constructed into the slots by put and destroyed when they are
+	*	removed, so DATA_TYPE does not need a default constructor.
+	*
+	*	The method names mirror those of std::list so that the buffers (and their tests) can treat it as they
+	*	used to treat the list.
+	*/
+	template <typename DATA_TYPE>
+	class RingStorage : public boost::noncopyable
+	{
+	private:
+		DATA_TYPE* const slots;
+		const unsigned capacity;
+		unsigned head;
+		unsigned count;
+	public:
+		inline explicit RingStorage(const unsigned _capacity)
+			:	slots(static_cast<DATA_TYPE*>(::operator new(sizeof(DATA_TYPE) * _capacity))),
+				capacity(_capacity),head(0),count(0)
+		{
+		}
+
+		inline ~RingStorage()
+		{
+			clear();
+			::operator delete(slots);
+		}
+
+		inline bool empty() const
+		{
+			return (0 == count);
+		}
+
+		inline unsigned size() const
+		{
+			return count;
+		}
+
+		inline bool full() const
+		{
+			return (count == capacity);
+		}
+
+		/**@internal
+		*	Adds an item to the back of the queue.
+		*
+		*	@pre full() is false
+		*/
+		inline void push_back(const DATA_TYPE& data)
+		{
+			unsigned tail = head + count;
+			if (tail >= capacity)
+				tail -= capacity;
+
+			new (slots + tail) DATA_TYPE(data);
+			count++;
+		}
+
+		/**@internal
+		*	@pre empty() is false
+		*/
+		inline DATA_TYPE& front()
+		{
+			return slots[head];
+		}
+
+		/**@internal
+		*	Removes the oldest item from the queue.
+		*
+		*	@pre empty() is false
+		*/
+		inline void pop_front()
+		{
+			slots[head].~DATA_TYPE();
+			if (++head == capacity)
+				head = 0;
+			count--;
+		}
+
+		inline void clear()
+		{
+			while (count > 0)
+			{
+				pop_front();
+			}
+			head = 0;
+		}
+	};
+
+	/**@internal
+	*	An unbounded FIFO queue built from a chain of fixed-size segments.
+	*
+	*	Each segment holds SegmentSlots items in one contiguous block.  Items are added at the tail segment
+	*	and removed from the head segment; when the head segment has been drained it is moved onto a free list
+	*	belonging to this queue rather than being deleted, so that a queue that is continually filled and emptied
+	*	stops allocating once it has reached its working size.  At most MaxFreeSegments are kept on the free list
+	*	so that a one-off burst of data does not pin its memory for the lifetime of the queue.
+	*/
+	template <typename DATA_TYPE>
+	class SegmentedStorage : public boost::noncopyable
+	{
+	private:
+		/**@internal
+		*	Aims for segments of around a kilobyte, but always at least four items
+		*/
+		static const unsigned SegmentSlots = (sizeof(DATA_TYPE) >= 256) ? 4 : (1024 / sizeof(DATA_TYPE));
+		static const unsigned MaxFreeSegments = 4;
+
+		struct Segment
+		{
+			Segment* next;
+			DATA_TYPE* slots;
+		};
+
+		Segment* headSegment;
+		Segment* tailSegment;
+		//Index of the oldest item in headSegment:
+		unsigned headIndex;
+		//Index of the next free slot in tailSegment:
+		unsigned tailIndex;
+
+		Segment* freeSegments;
+		unsigned freeCount;
+
+		inline Segment* allocateSegment()
+		{
+			Segment* seg;
+			if (freeSegments != NULL)
+			{
+				seg = freeSegments;
+				freeSegments = seg->next;
+				freeCount--;
+			}
+			else
+			{
+				seg = new Segment;
+				seg->slots = static_cast<DATA_TYPE*>(::operator new(sizeof(DATA_TYPE) * SegmentSlots));
+			}
+			seg->next = NULL;
+			return seg;
+		}
+
+		inline void releaseSegment(Segment* seg)
+		{
+			if (freeCount < MaxFreeSegments)
+			{
+				seg->next = freeSegments;
+				freeSegments = seg;
+				freeCount++;
+			}
+			else
+			{
+				::operator delete(seg->slots);
+				delete seg;
+			}
+		}
+	public:
+		inline SegmentedStorage()
+			:	headSegment(NULL),tailSegment(NULL),headIndex(0),tailIndex(0),freeSegments(NULL),freeCount(0)
+		{
+		}
+
+		inline ~SegmentedStorage()
+		{
+			clear();
+			while (freeSegments != NULL)
+			{
+				Segment* seg = freeSegments;
+				freeSegments = seg->next;
+				::operator delete(seg->slots);
+				delete seg;
+			}
+		}
+
+		inline bool empty() const
+		{
+			return (headSegment == NULL);
+		}
+
+		inline void push_back(const DATA_TYPE& data)
+		{
+			if (tailSegment == NULL)
+			{
+				headSegment = tailSegment = allocateSegment();
+				headIndex = tailIndex = 0;
+			}
+			else if (tailIndex == SegmentSlots)
+			{
+				tailSegment->next = allocateSegment();
+				tailSegment = tailSegment->next;
+				tailIndex = 0;
+			}
+
+			new (tailSegment->slots + tailIndex) DATA_TYPE(data);
+			tailIndex++;
+		}
+
+		/**@internal
+		*	@pre empty() is false
+		*/
+		inline DATA_TYPE& front()
+		{
+			return headSegment->slots[headIndex];
+		}
+
+		/**@internal
+		*	@pre empty() is false
+		*/
+		inline void pop_front()
+		{
+			headSegment->slots[headIndex].~DATA_TYPE();
+			headIndex++;
+
+			if (headSegment == tailSegment)
+			{
+				if (headIndex == tailIndex)
+				{
+					//Now empty; keep the segment at hand for the next push:
+					releaseSegment(headSegment);
+					headSegment = tailSegment = NULL;
+					headIndex = tailIndex = 0;
+				}
+			}
+			else if (headIndex == SegmentSlots)
+			{
+				Segment* drained = headSegment;
+				headSegment = headSegment->next;
+				headIndex = 0;
+				releaseSegment(drained);
+			}
+		}
+
+		inline void clear()
+		{
+			while (false == empty())
+			{
+				pop_front();
+			}
+		}
+	};
+} //namespace internal
+
 	template <typename DATA_TYPE>
 	class InfiniteFIFOBuffer : public ChannelBuffer<DATA_TYPE>, public boost::noncopyable
 	{
 	private:
-		std::list<DATA_TYPE> buffer;	
+		internal::SegmentedStorage<DATA_TYPE> buffer;
 	public:
 		virtual bool inputWouldSucceed()
 		{
@@ -265,25 +509,11 @@ namespace csp
 		typedef ChannelBufferFactoryImpl<DATA_TYPE,InfiniteFIFOBuffer<DATA_TYPE> > Factory;		
 	};
 		
-	template <typename DATA_TYPE, typename _LIST_DATA_TYPE = 
-		typename boost::mpl::if_< 
-			//If sizeof(DATA_TYPE) <= 4 * sizeof(void*)
-			boost::mpl::less_equal<  
-				boost::mpl::sizeof_<DATA_TYPE>,
-				boost::mpl::times< boost::mpl::int_<4>, boost::mpl::sizeof_<void*> >
-			>,
-			//Then use a pool allocator:
-			std::list< DATA_TYPE,boost::fast_pool_allocator<DATA_TYPE> >,
-			//Else use a normal list:
-			std::list< DATA_TYPE >
-		>::type
-	>
+	template <typename DATA_TYPE>
 	class FIFOBuffer : public ChannelBuffer<DATA_TYPE>, public boost::noncopyable
 	{
 	private:
-		typedef _LIST_DATA_TYPE LIST_DATA_TYPE;
-		LIST_DATA_TYPE buffer;
-		const unsigned maxSize;
+		internal::RingStorage<DATA_TYPE> buffer;
 	public:		
 		virtual bool inputWouldSucceed()
 		{
@@ -291,7 +521,7 @@ namespace csp
 		}
 		virtual bool outputWouldSucceed(const DATA_TYPE*)
 		{
-			return ((buffer.size() + 1) <= maxSize);
+			return (false == buffer.full());
 		}		
 	
 		virtual void put(const DATA_TYPE* source)
@@ -325,7 +555,7 @@ namespace csp
 		/**
 		*	A channel buffer factory that can be used with this buffer.
 		*/
-		typedef SizedChannelBufferFactoryImpl<DATA_TYPE,FIFOBuffer<DATA_TYPE,LIST_DATA_TYPE> > Factory;
+		typedef SizedChannelBufferFactoryImpl<DATA_TYPE,FIFOBuffer<DATA_TYPE> > Factory;
 	
 		/**
 		*	Constructor
@@ -333,7 +563,7 @@ namespace csp
 		*	@param n The size of the FIFO buffer to create
 		*/
 		inline explicit FIFOBuffer(unsigned int n)
-			:	maxSize(n)
+			:	buffer(n)
 		{
 		}
 		
@@ -341,25 +571,11 @@ namespace csp
 		friend class ::AltChannelTest;
 	};
 	
-	template <typename DATA_TYPE, typename _LIST_DATA_TYPE = 
-		typename boost::mpl::if_< 
-			//If sizeof(DATA_TYPE) <= 4 * sizeof(void*)
-			boost::mpl::less_equal<  
-				boost::mpl::sizeof_<DATA_TYPE>,
-				boost::mpl::times< boost::mpl::int_<4>, boost::mpl::sizeof_<void*> >
-			>,
-			//Then use a pool allocator:
-			std::list< DATA_TYPE,boost::fast_pool_allocator<DATA_TYPE> >,
-			//Else use a normal list:
-			std::list< DATA_TYPE >
-		>::type
-	>
+	template <typename DATA_TYPE>
 	class OverwritingBuffer : public ChannelBuffer<DATA_TYPE>, public boost::noncopyable
 	{
 	private:
-		typedef _LIST_DATA_TYPE LIST_DATA_TYPE;
-		LIST_DATA_TYPE buffer;
-		const unsigned maxSize;
+		internal::RingStorage<DATA_TYPE> buffer;
 		bool shouldRemove;
 	public:		
 		virtual bool inputWouldSucceed()
@@ -373,7 +589,7 @@ namespace csp
 	
 		virtual void put(const DATA_TYPE* source)
 		{
-			if (buffer.size() == maxSize)
+			if (buffer.full())
 			{
 				shouldRemove = false;
 				buffer.pop_front();
@@ -411,7 +627,7 @@ namespace csp
 		/**
 		*	A channel buffer factory that can be used with this buffer.
 		*/
-		typedef SizedChannelBufferFactoryImpl<DATA_TYPE,OverwritingBuffer<DATA_TYPE,LIST_DATA_TYPE> > Factory;
+		typedef SizedChannelBufferFactoryImpl<DATA_TYPE,OverwritingBuffer<DATA_TYPE> > Factory;
 	
 		/**
 		*	Constructor
@@ -419,7 +635,7 @@ namespace csp
 		*	@param n The size of the overwriting buffer to create
 		*/
 		inline explicit OverwritingBuffer(unsigned int n)
-			:	maxSize(n)
+			:	buffer(n)
 		{
 		}
 		
@@ -517,12 +733,13 @@ namespace csp
 	*	Unlike InfiniteFIFOBuffer, FIFOBuffer has a fixed maximum size.  Data items come out of the buffer
 	*	in the same order that they went in.
 	*
-	*	The complicated-looking second template parameter
-	*	is a bit of C++ trickery (with the help of boost) that you are unlikely to need to ever alter.  It implements
-	*	a heuristic that uses std::list with a standard allocator (using new and delete) if sizeof(DATA_TYPE) is strictly greater
-	*	than four times the sizeof(void*).  Otherwise, boost's pool allocator is used to speed up the continual re-allocation
-	*	of the linked list nodes.  If you are <i>incredibly</i> concerned with memory or speed usage you may want to play with
-	*	this parameter, but otherwise leave it as the default.
+	*	The storage for all the items is allocated once, when the buffer is constructed, as a contiguous ring
+	*	of the given size.  Putting data into and getting data out of the buffer therefore never allocates memory,
+	*	and consecutive items sit next to each other in memory.  Bear this in mind if you create very large buffers
+	*	of large items; the memory is claimed up-front rather than as the buffer fills.
+	*
+	*	In earlier versions of C++CSP2, FIFOBuffer had a second template parameter that chose the list type used
+	*	for storage.  This parameter has been removed, as there is no longer a list.
 	*
 	*	@section tempreq DATA_TYPE Requirements
 	*
@@ -537,6 +754,10 @@ namespace csp
 	*	or otherwise unexpectedly terminates.  It is advised that you use a FIFOBuffer with a high capacity instead, but 
 	*	sometimes an infinite buffer can be useful.  
 	*
+	*	The data is stored in a chain of fixed-size segments (each holding around a kilobyte of data).  Segments
+	*	that have been emptied are kept by the buffer and re-used as it grows again, so a buffer whose size
+	*	stays roughly steady does not repeatedly allocate and free memory.
+	*
 	*	@section tempreq DATA_TYPE Requirements
 	*
 	*	DATA_TYPE must have a copy constructor and support assignment.
@@ -551,7 +772,7 @@ namespace csp
 	*	from the buffer, they will always read the oldest item of data (i.e. the oldest item that has not yet
 	*	been overwritten).
 	*
-	*	For an explanation of the second template parameter, see the documentation for csp::FIFOBuffer.
+	*	Like csp::FIFOBuffer, the storage is allocated once, up-front, as a contiguous ring of the given size.
 	*
 	*	@section tempreq DATA_TYPE Requirements
 	*
@@ -579,7 +800,7 @@ namespace csp
 	//NOTE: sending empty collections into an aggregating buffer has no effect!
 	//Aggregating buffers are undocumented for now, and should not be used
 	
-	//TODO later this buffer will forever block if you try to put into it more than it can hold at one time
+	//A put of more than the limit is accepted once the buffer is empty, rather than blocking forever
 	template <typename DATA_TYPE>
 	class PrimitiveAggregatingFIFOBuffer : public ChannelBuffer< std::vector<DATA_TYPE> >
 	{
@@ -599,14 +820,17 @@ namespace csp
 		}
 		virtual bool outputWouldSucceed(const std::vector<DATA_TYPE>* source)
 		{
-			return (buffer.size() + source->size()) <= limit;
+			return buffer.empty() || (buffer.size() + source->size()) <= limit;
 		}
 	
 		virtual void put(const std::vector<DATA_TYPE>* source)
 		{
-			const size_t prevSize = buffer.size();
-			buffer.resize(prevSize + source->size());
-			memcpy(&(buffer[prevSize]),&(source[0]),sizeof(DATA_TYPE) * source->size());
+			if (false == source->empty())
+			{
+				const size_t prevSize = buffer.size();
+				buffer.resize(prevSize + source->size());
+				memcpy(&(buffer[prevSize]),&((*source)[0]),sizeof(DATA_TYPE) * source->size());
+			}
 		}		
 		
 		virtual void get(std::vector<DATA_TYPE>* dest)
@@ -633,6 +857,70 @@ namespace csp
 		typedef SizedChannelBufferFactoryImpl< std::vector<unsigned char> , PrimitiveAggregatingFIFOBuffer<unsigned char> > Factory;
 	};
 	
+	//Queues mobile collections by ownership (rather than copying their contents), holding up to a limit of elements in total.
+	//Like PrimitiveAggregatingFIFOBuffer, a collection larger than the limit is accepted once the buffer is empty
+	template <typename COLLECTION>
+	class MobileCollectionFIFOBuffer : public ChannelBuffer< Mobile<COLLECTION> >
+	{
+	private:
+		std::list< Mobile<COLLECTION> > buffer;
+		//list::size() can be O(N) on some implementations, so we'll keep track of the elements:
+		size_t curSize;
+		const size_t limit;
+	public:
+		inline explicit MobileCollectionFIFOBuffer(const size_t _limit)
+			:	curSize(0),limit(_limit)
+		{
+		}
+		
+		virtual bool inputWouldSucceed()
+		{
+			return (false == buffer.empty());
+		}
+		virtual bool outputWouldSucceed(const Mobile<COLLECTION>* source)
+		{
+			return buffer.empty() || (false == *source) || (curSize + (*source)->size()) <= limit;
+		}
+	
+		virtual void put(const Mobile<COLLECTION>* source)
+		{
+			if (*source && false == (*source)->empty())
+			{
+				curSize += (*source)->size();
+				buffer.push_back(*source);
+			}
+			else
+			{
+				//Nothing to queue, but it has still been sent:
+				Mobile<COLLECTION> discarded(*source);
+			}
+		}		
+		
+		virtual void get(Mobile<COLLECTION>* dest)
+		{
+			*dest = buffer.front();
+			curSize -= (*dest)->size();
+			buffer.pop_front();
+		}
+				
+		virtual void beginExtGet(Mobile<COLLECTION>* dest)
+		{
+			get(dest);
+		}
+				
+		virtual void endExtGet()
+		{
+		}
+		
+		virtual void clear()
+		{
+			buffer.clear();
+			curSize = 0;
+		}
+		
+		typedef SizedChannelBufferFactoryImpl< Mobile<COLLECTION> , MobileCollectionFIFOBuffer<COLLECTION> > Factory;
+	};
+	
 	template <typename DATA_TYPE>
 	class AggregatingFIFOBuffer : public ChannelBuffer< Mobile< std::list<DATA_TYPE> > >
 	{
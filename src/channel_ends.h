@@ -358,6 +358,14 @@ namespace csp
 			return channel->inputGuard();
 		};
 		
+		/**@internal
+		*	Constructs an input guard in the given storage, rather than on the heap.  Use InputGuard rather than calling this directly.
+		*/
+		inline Guard* inputGuard(internal::GuardStorage* storage) const
+		{
+			return channel->inputGuard(storage);
+		}
+		
 		/**
 		*	Performs a normal input
 		*	
@@ -575,6 +583,39 @@ namespace csp
 		}
 	};
 	
+	/**
+	*	An input guard that is held inside the InputGuard object itself, rather than being allocated on the heap.
+	*
+	*	AltChanin::inputGuard() allocates a new guard each time it is called, which the Alternative then deletes.
+	*	An InputGuard can instead be a local variable, or a member of a process alongside the channel end, and lives
+	*	as long as it does.  Pass its address to an Alternative (or ReadinessAlternative) in place of the result of
+	*	inputGuard(); the Alternative will not delete it, so the InputGuard must outlive the Alternative (or
+	*	be taken out of it with Alternative::rearm()).
+	*
+	*	@code
+			InputGuard<int> guard0(in0),guard1(in1);
+			Guard* guards[] = {&guard0,&guard1};
+			Alternative alt(guards,2);
+		@endcode
+	*
+	*	The InputGuard behaves exactly the same as the guard returned by inputGuard(), and can be used in
+	*	any number of Alternatives, one after the other.  It cannot be copied.
+	*
+	*	@see Alternative::rearm()
+	*/
+	template <typename DATA_TYPE>
+	class InputGuard : public internal::EmbeddedGuard
+	{
+	public:
+		/**
+		*	Constructs an input guard for the given channel end
+		*/
+		inline explicit InputGuard(const AltChanin<DATA_TYPE>& in)
+		{
+			hold(in.inputGuard(&storage));
+		}
+	};
+	
 	template<typename DATA_TYPE>
 	class Chanout
 	{
@@ -737,6 +778,104 @@ namespace csp
 		friend Chanout<DATA_TYPE> NoPoison<>(const Chanout<DATA_TYPE>& in);
 
 	}; //class Chanout<DATA_TYPE>			
+	
+	template<typename DATA_TYPE>
+	class AltChanout : public Chanout<DATA_TYPE>
+	{
+	private:
+		/**@internal
+		*	The channel, for getting output guards
+		*/
+		internal::BaseAltOutChan<DATA_TYPE>* altChannel;
+	public:
+		/**@internal
+		*	A constructor for internal use only.  See the constructor of Chanout.
+		*/
+		inline AltChanout(internal::BaseChan<DATA_TYPE>* const ch,internal::BaseAltOutChan<DATA_TYPE>* const altCh,bool _canPoison)
+			:	Chanout<DATA_TYPE>(ch,_canPoison),altChannel(altCh)
+		{
+		}
+		
+		/**
+		*	A constructor for instances that are class members.  See the equivalent constructor of Chanout.
+		*/
+		inline AltChanout()
+			:	altChannel(NULL)
+		{
+		}
+		
+		/**
+		*	Gets an output guard to use in an <tt>ALT</tt>.
+		*
+		*	The guard will be ready when an output of *source would complete straight away (for one-to-one channels, when
+		*	the reader is waiting to read; for buffered channels, when the buffer has space for *source), or when the
+		*	channel is poisoned.  When the guard is selected, you should then output *source on this channel end,
+		*	which will either complete straight away, or throw a PoisonException.  For example, to send each item to
+		*	whichever of two workers is ready first:
+		*	@code
+				AltChanout<Job> out0 = worker0.writer(), out1 = worker1.writer();
+				Job job;
+				Alternative alt( list_of<Guard*>(out0.outputGuard(&job))(out1.outputGuard(&job)) );
+				
+				while (true)
+				{
+					in >> job;
+					switch (alt.fairSelect())
+					{
+						case 0: out0 << job; break;
+						case 1: out1 << job; break;
+					}
+				}
+			@endcode
+		*
+		*	For unbuffered channels, the reader should not also alt on its input of the same channel: an output guard
+		*	is only ready for a reader that has committed to an input, so if both ends were alting on the channel
+		*	at once, neither guard would become ready.  Buffered channels do not have this restriction.
+		*
+		*	As with AltChanin::inputGuard(), the Alternative will delete this Guard, so you don't have to.
+		*
+		*	@param source The data that will be output if the guard is selected.  Buffered channels use it to check
+		*	whether their buffer has room for it, so it must remain valid for as long as the guard is in use.  It
+		*	is not copied, so changing the data that it points to between selects is fine.
+		*	@return The output guard
+		*
+		*	@see OutputGuard
+		*/
+		inline Guard* outputGuard(const DATA_TYPE* source) const
+		{
+			return altChannel->outputGuard(source);
+		}
+		
+		/**@internal
+		*	Constructs an output guard in the given storage, rather than on the heap.  Use OutputGuard rather than calling this directly.
+		*/
+		inline Guard* outputGuard(const DATA_TYPE* source,internal::GuardStorage* storage) const
+		{
+			return altChannel->outputGuard(source,storage);
+		}
+	}; //class AltChanout<DATA_TYPE>
+	
+	/**
+	*	An output guard that is held inside the OutputGuard object itself, rather than being allocated on the heap.
+	*	It is to AltChanout::outputGuard() what InputGuard is to AltChanin::inputGuard(); see InputGuard for details.
+	*
+	*	@see AltChanout::outputGuard()
+	*/
+	template <typename DATA_TYPE>
+	class OutputGuard : public internal::EmbeddedGuard
+	{
+	public:
+		/**
+		*	Constructs an output guard for the given channel end
+		*
+		*	@param out The channel end
+		*	@param source The data that will be output if the guard is selected (see AltChanout::outputGuard())
+		*/
+		inline OutputGuard(const AltChanout<DATA_TYPE>& out,const DATA_TYPE* source)
+		{
+			hold(out.outputGuard(source,&storage));
+		}
+	};
 
 	/**
 	*	@defgroup channelends Channel Ends
@@ -744,8 +883,9 @@ namespace csp
 	*	More information on using channels is available in the @ref channels "Channels" module, and
 	*	in the @ref tut-channels "Channels" section of the guide.
 	*
-	*	Channels in C++CSP2 are accessed through their ends.  There are three channel-end types:
+	*	Channels in C++CSP2 are accessed through their ends.  There are four channel-end types:
 	*	- Chanout - a writing-end of a channel that allows normal writing of data
+	*	- AltChanout - a writing-end of a channel that allows normal writing of data, and ALTing on the output
 	*	- Chanin - a reading-end of a channel that allows normal reading of data, and extended inputs
 	*	- AltChanin - a reading-end of a channel that allows normal reading of data, extended inputs, and ALTing (as well as extended ALTing)
 	*
@@ -775,6 +915,10 @@ namespace csp
 	*	AltChanin to a process that requires a Chanin.  However, the reverse transformation is not possible,
 	*	so a process that needs an AltChanin cannot be given a Chanin.	
 	*
+	*	The writing ends are divided in the same way.  The channels with an unshared writing-end (One2OneChannel,
+	*	One2AnyChannel, BufferedOne2OneChannel and BufferedOne2AnyChannel) return an AltChanout from their writer()
+	*	method, which can be used wherever a Chanout is needed, and also provides AltChanout::outputGuard().
+	*
 	*	@section compat C++CSP v1.x Compatibility
 	*
 	*	C++CSP v1.x had only two channel-ends: Chanout and Chanin.  Chanin contained methods for ALTing
@@ -854,6 +998,19 @@ namespace csp
 	*	@see Chanin
 	*	@see PoisonException
 	*/
+	
+	/** @class AltChanout
+	*
+	*	This class is identical to Chanout except that it also supports ALTing on the output, with outputGuard().
+	*	It derives from Chanout, so it can be used anywhere that a Chanout can.  See the page on @ref channelends "Channel Ends".
+	*
+	*	@see One2OneChannel::writer()
+	*	@see One2AnyChannel::writer()
+	*	@see BufferedOne2OneChannel::writer()
+	*	@see BufferedOne2AnyChannel::writer()
+	*	@see Chanout
+	*	@see OutputGuard
+	*/
 
 	
 	/** @class Chanin
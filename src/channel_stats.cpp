@@ -0,0 +1,95 @@
+/*
+*	The Kent C++CSP Library
+*	Copyright (C) 2002-2007 Neil Brown
+*
+*	This library is free software; you can redistribute it and/or
+*	modify it under the terms of the GNU Lesser General Public
+*	License as published by the Free Software Foundation; either
+*	version 2.1 of the License, or (at your option) any later version.
+*
+*	This library is distributed in the hope that it will be useful,
+*	but WITHOUT ANY WARRANTY; without even the implied warranty of
+*	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+*	Lesser General Public License for more details.
+*
+*	You should have received a copy of the GNU Lesser General Public
+*	License along with this library; if not, write to the Free Software
+*	Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+/** @internal@file channel_stats.cpp
+*	@brief Implements the statistics of the instrumented channels, and the registry of them
+*/
+
+#include "cppcsp.h"
+
+using namespace csp;
+using namespace csp::internal;
+using namespace std;
+
+namespace
+{
+	PureSpinMutex RegistryMutex;
+
+	//Constructed on first use, so that instrumented channels may be constructed during static initialisation:
+	list<ChannelStats*>& Registry()
+	{
+		static list<ChannelStats*> registry;
+		return registry;
+	}
+}
+
+csp::ChannelStatistics::ChannelStatistics()
+	:	messages(0),readerWaits(0),writerWaits(0),mutexClaims(0),mutexSpins(0),bufferHighWater(0)
+{
+	MicroSeconds(0,&blockedTime);
+}
+
+csp::internal::ChannelStats::ChannelStats()
+	:	bufferOccupancy(0)
+{
+	RegistryMutex.claim();
+		registration = Registry().insert(Registry().end(),this);
+	RegistryMutex.release();
+}
+
+csp::internal::ChannelStats::~ChannelStats()
+{
+	RegistryMutex.claim();
+		Registry().erase(registration);
+	RegistryMutex.release();
+}
+
+ChannelStatistics csp::internal::ChannelStats::statistics()
+{
+	statsMutex.claim();
+		ChannelStatistics ret(counts);
+	statsMutex.release();
+	return ret;
+}
+
+void csp::internal::ChannelStats::resetStatistics()
+{
+	statsMutex.claim();
+		const string name(counts.name);
+		counts = ChannelStatistics();
+		counts.name = name;
+		//The buffer occupancy is the current state, not a count, so it is kept:
+		counts.bufferHighWater = bufferOccupancy;
+	statsMutex.release();
+}
+
+list<ChannelStatistics> csp::GetAllChannelStatistics()
+{
+	list<ChannelStatistics> ret;
+
+	//A channel cannot be destroyed while we hold the registry mutex, so it is safe to read its statistics:
+	RegistryMutex.claim();
+		for (list<ChannelStats*>::iterator it = Registry().begin();it != Registry().end();it++)
+		{
+			ret.push_back((*it)->statistics());
+		}
+	RegistryMutex.release();
+
+	return ret;
+}
@@ -0,0 +1,362 @@
+/*
+*	The Kent C++CSP Library
+*	Copyright (C) 2002-2007 Neil Brown
+*
+*	This library is free software; you can redistribute it and/or
+*	modify it under the terms of the GNU Lesser General Public
+*	License as published by the Free Software Foundation; either
+*	version 2.1 of the License, or (at your option) any later version.
+*
+*	This library is distributed in the hope that it will be useful,
+*	but WITHOUT ANY WARRANTY; without even the implied warranty of
+*	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+*	Lesser General Public License for more details.
+*
+*	You should have received a copy of the GNU Lesser General Public
+*	License along with this library; if not, write to the Free Software
+*	Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+/** @file channel_stats.h
+*	@brief Contains the statistics recorded by instrumented channels
+*
+*	This file is \#included from cppcsp.h
+*/
+
+#ifndef INCLUDED_FROM_CPPCSP_H
+#error This file should only be included by csp.h, not individually
+#endif
+
+class InstrumentedChannelTest;
+
+namespace csp
+{
+	/**
+	*	A snapshot of the statistics recorded by an instrumented channel.
+	*
+	*	All the counts start at zero when the channel is constructed (or when its statistics are reset),
+	*	and wrap around if they overflow.
+	*
+	*	@see InstrumentedOne2OneChannel
+	*/
+	class ChannelStatistics
+	{
+	public:
+		///The name that the channel was given when it was constructed
+		std::string name;
+		///The number of communications that have completed on the channel
+		usign32 messages;
+		///The number of times that a reader blocked in the channel, waiting for a writer
+		usign32 readerWaits;
+		///The number of times that a writer blocked in the channel, waiting for a reader (or for buffer space)
+		usign32 writerWaits;
+		///The number of times that the channel's mutexes were claimed
+		usign32 mutexClaims;
+		/**
+		*	The amount of spinning done while claiming the channel's mutexes.  For spinning mutexes,
+		*	this is the number of failed claim attempts; for the queued mutexes used by shared channel-ends,
+		*	it is the number of claims that had to queue behind another process.
+		*/
+		usign32 mutexSpins;
+		/**
+		*	The most items that have been held in the channel's buffer at once (always zero for unbuffered channels).
+		*	This is worked out by counting the items put into and taken out of the buffer, so for buffers that
+		*	discard data (such as OverwritingBuffer) it includes the discarded items.
+		*/
+		usign32 bufferHighWater;
+		///The total time that readers and writers have spent blocked in the channel
+		Time blockedTime;
+
+		ChannelStatistics();
+	};
+
+	/**
+	*	Gets the statistics of every instrumented channel that currently exists.
+	*
+	*	This is intended for periodic export (e.g. to a log or a monitoring system).  The statistics for each
+	*	channel are taken one channel at a time, so they are not a consistent snapshot across all the channels.
+	*	The order of the list is the order that the channels were constructed in.
+	*/
+	std::list<ChannelStatistics> GetAllChannelStatistics();
+
+	namespace internal
+	{
+		class ChannelStats;
+
+		/**@internal
+		*	The base of CountingMutex, so that ChannelStats can attach itself to any counting mutex
+		*/
+		class CountingMutexBase
+		{
+		protected:
+			ChannelStats* stats;
+
+			inline CountingMutexBase()
+				:	stats(NULL)
+			{
+			}
+
+			inline void claimed(usign32 spins);
+		public:
+			inline void attach(ChannelStats* _stats)
+			{
+				stats = _stats;
+			}
+		};
+
+		/**@internal
+		*	The statistics policy for the instrumented channels.
+		*
+		*	The channels take a STATS policy template argument, in the same way that they take a MUTEX.
+		*	The channel inherits from its STATS, and calls the hooks below at the appropriate points.
+		*	The uninstrumented channels use NullChannelStats, whose hooks do nothing and compile away.
+		*
+		*	The counts are protected by their own mutex, because they are updated by both ends of the channel,
+		*	and sometimes by the shared-end mutexes in the adapters too.
+		*
+		*	Every ChannelStats adds itself to a global registry when it is constructed, and removes itself
+		*	when it is destroyed, so that GetAllChannelStatistics() can find it.
+		*/
+		class ChannelStats : public boost::noncopyable
+		{
+		private:
+			PureSpinMutex statsMutex;
+			ChannelStatistics counts;
+			usign32 bufferOccupancy;
+			std::list<ChannelStats*>::iterator registration;
+		protected:
+			ChannelStats();
+			~ChannelStats();
+
+			inline void setName(const std::string& name)
+			{
+				statsMutex.claim();
+					counts.name = name;
+				statsMutex.release();
+			}
+
+			///Attaches the statistics to one of the channel's mutexes, so that its claims are counted
+			inline void attachMutex(CountingMutexBase* mutex)
+			{
+				mutex->attach(this);
+			}
+
+			///Mutexes that do not count their claims are ignored
+			inline void attachMutex(void*)
+			{
+			}
+
+			inline void messageSent()
+			{
+				statsMutex.claim();
+					counts.messages++;
+				statsMutex.release();
+			}
+
+			inline void bufferPut()
+			{
+				statsMutex.claim();
+					if (++bufferOccupancy > counts.bufferHighWater)
+					{
+						counts.bufferHighWater = bufferOccupancy;
+					}
+				statsMutex.release();
+			}
+
+			inline void bufferGot()
+			{
+				statsMutex.claim();
+					if (bufferOccupancy > 0)
+					{
+						bufferOccupancy--;
+					}
+				statsMutex.release();
+			}
+
+			inline void bufferCleared()
+			{
+				statsMutex.claim();
+					bufferOccupancy = 0;
+				statsMutex.release();
+			}
+
+			inline void mutexClaimed(usign32 spins)
+			{
+				statsMutex.claim();
+					counts.mutexClaims++;
+					counts.mutexSpins += spins;
+				statsMutex.release();
+			}
+
+			/**@internal
+			*	Records a process blocking in the channel.  Construct one of these immediately before
+			*	the process reschedules, and let it go out of scope immediately afterwards.
+			*/
+			class Wait
+			{
+			private:
+				ChannelStats& stats;
+				const bool reader;
+				Time start;
+			public:
+				inline Wait(ChannelStats& _stats,bool _reader)
+					:	stats(_stats),reader(_reader)
+				{
+					CurrentTime(&start);
+				}
+
+				inline ~Wait()
+				{
+					Time blocked;
+					CurrentTime(&blocked);
+					blocked -= start;
+
+					stats.statsMutex.claim();
+						if (reader)
+						{
+							stats.counts.readerWaits++;
+						}
+						else
+						{
+							stats.counts.writerWaits++;
+						}
+						stats.counts.blockedTime += blocked;
+					stats.statsMutex.release();
+				}
+			};
+
+			friend class CountingMutexBase;
+		public:
+			/**
+			*	Gets a snapshot of the channel's statistics
+			*/
+			ChannelStatistics statistics();
+
+			/**
+			*	Resets all the channel's counts to zero
+			*/
+			void resetStatistics();
+
+			friend std::list<ChannelStatistics> csp::GetAllChannelStatistics();
+		};
+
+		inline void CountingMutexBase::claimed(usign32 spins)
+		{
+			if (stats != NULL)
+			{
+				stats->mutexClaimed(spins);
+			}
+		}
+
+		/**@internal
+		*	The statistics policy for channels that are not instrumented.  None of the hooks do anything.
+		*/
+		class NullChannelStats
+		{
+		protected:
+			template <typename MUTEX>
+			inline void attachMutex(MUTEX*) {}
+
+			inline void messageSent() {}
+			inline void bufferPut() {}
+			inline void bufferGot() {}
+			inline void bufferCleared() {}
+
+			class Wait
+			{
+			public:
+				inline Wait(NullChannelStats&,bool) {}
+			};
+		};
+
+		/**@ingroup mutex
+		*	@internal
+		*	A spinning mutex that counts its claims (and the spinning needed to get them) in a ChannelStats.
+		*
+		*	MUTEX must be a spinning mutex with a tryClaim() function, such as PureSpinMutex.
+		*	The counting is done once the mutex is held, so the extra cost is only borne by the claimer.
+		*/
+		template <typename MUTEX>
+		class CountingMutex : public CountingMutexBase, private Primitive, public boost::noncopyable
+		{
+		private:
+			MUTEX mutex;
+		public:
+			inline void claim()
+			{
+				int spinCount = 0;
+				while (false == mutex.tryClaim())
+				{
+					spin(++spinCount);
+				}
+				claimed(spinCount);
+			}
+
+			inline bool isClaimed()
+			{
+				return mutex.isClaimed();
+			}
+
+			inline void release()
+			{
+				mutex.release();
+			}
+
+			typedef CountingMutex<MUTEX>& End;
+
+			End end()
+			{
+				return *this;
+			}
+		};
+
+		/**@ingroup mutex
+		*	@internal
+		*	A QueuedMutex that counts its claims, and the claims that had to queue, in a ChannelStats.
+		*/
+		template <>
+		class CountingMutex<QueuedMutex> : public CountingMutexBase, public boost::noncopyable
+		{
+		private:
+			QueuedMutex mutex;
+		public:
+			/**@internal
+			*	The end of a counting queued mutex
+			*/
+			class End
+			{
+			private:
+				CountingMutex<QueuedMutex>* mutex;
+				QueuedMutex::Key key;
+				inline explicit End(CountingMutex<QueuedMutex>* _mutex)
+					:	mutex(_mutex)
+				{
+				}
+			public:
+				inline void claim()
+				{
+					const bool queued = mutex->mutex.claim(&key);
+					mutex->claimed(queued ? 1 : 0);
+				}
+
+				inline void release()
+				{
+					mutex->mutex.release(&key);
+				}
+
+				friend class CountingMutex<QueuedMutex>;
+			};
+
+			inline bool isClaimed()
+			{
+				return mutex.isClaimed();
+			}
+
+			End end()
+			{
+				return End(this);
+			}
+		};
+
+	} //namespace internal
+} //namespace csp
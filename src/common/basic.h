@@ -22,6 +22,7 @@
 class AltChannelTest;
 class ChannelTest;
 class BufferedChannelTest;
+class BroadcastChannelTest;
 
 namespace csp
 {
@@ -345,6 +346,7 @@ namespace common
 		//For testing:
 		friend class ::ChannelTest;
 		friend class ::BufferedChannelTest;
+		friend class ::BroadcastChannelTest;
 	};
 	
 	
@@ -766,7 +768,19 @@ namespace common
 		}
 	};	
 	
-	//TODO later document this process once I'm sure I'm happy with the design
+	/**
+	*	Sends each item it receives out on both of its output channels, in parallel.
+	*
+	*	For each item, the Delta process outputs to both channels at once, and only reads the next
+	*	item once both outputs have completed.  It uses two internal processes and four internal channels
+	*	to do so.  If you want to send every item to several readers, csp::BroadcastChannel is usually a
+	*	better choice: it does the same job without any extra processes, copies each item only once, and
+	*	allows readers to subscribe and unsubscribe while it is in use.
+	*
+	*	@section tempreq DATA_TYPE Requirements
+	*
+	*	DATA_TYPE must have a default constructor and support assignment.
+	*/
 	template <typename DATA_TYPE>
 	class Delta : public CSProcess
 	{
@@ -818,6 +832,11 @@ namespace common
 				in.poison();
 				out0.poison();
 				out1.poison();
+				//Shut down the senders too, otherwise they would wait forever for more data:
+				intermedOut0.poison();
+				intermedOut1.poison();
+				ack0.poison();
+				ack1.poison();
 			}
 		}
 	public:
@@ -1317,12 +1336,50 @@ namespace common
 	
 	//TODO later move this to a new header file:
 	
+	/**
+	*	Serves each connection read from its input channel with a new process, running alongside the others.
+	*
+	*	For each connection (typically read from the reader of a TCPSocketAccepterChannel), a PROCESS is constructed
+	*	with the reader and writer of the connection and a copy of the data, and is forked, either in a new thread
+	*	or in the handler's thread.  The connection is closed as soon as its PROCESS has finished.
+	*
+	*	There is no limit on how many connections are served at once: a burst of connections forks a burst of
+	*	processes (and threads, if forkAsThread is true).  Where that matters, use PooledConnectionHandler.
+	*
+	*	When the input channel is poisoned, the handler poisons it in turn, and finishes once the connections
+	*	being served have all finished.
+	*
+	*	To use this process, you will need to #include <cppcsp/common/basic.h>
+	*
+	*	@section tempreq CHANNEL_TYPE, PROCESS and PROCESS_DATA Requirements
+	*
+	*	CHANNEL_TYPE must have reader() and writer() methods.  PROCESS must derive from CSProcess and have a constructor
+	*	that takes the results of those methods and a PROCESS_DATA.  PROCESS_DATA must have a copy constructor.
+	*/
 	template <typename CHANNEL_TYPE, typename PROCESS, typename PROCESS_DATA>
 	class ConnectionHandler : public CSProcess
 	{
 	private:
+		///Runs a PROCESS for one connection, then closes it
+		class Connection : public CSProcess
+		{
+		private:
+			Mobile< CHANNEL_TYPE > chan;
+			PROCESS_DATA data;
+		protected:
+			void run()
+			{
+				RunInThisThread(new PROCESS(chan->reader(),chan->writer(),data));
+				chan.blank();
+			}
+		public:
+			inline Connection(Mobile< CHANNEL_TYPE >& _chan, const PROCESS_DATA& _data)
+				:	chan(_chan),data(_data)
+			{
+			}
+		};
+		
 		Chanin< Mobile< CHANNEL_TYPE > > in;
-		std::list< Mobile< CHANNEL_TYPE > > channels;
 		PROCESS_DATA data;
 		bool forkAsThread;
 	protected:
@@ -1336,8 +1393,7 @@ namespace common
 				{
 					Mobile< CHANNEL_TYPE > mob;
 					in >> mob;
-					CSProcessPtr proc = new PROCESS(mob->reader(),mob->writer(),data);
-					channels.push_back(mob);
+					CSProcessPtr proc = new Connection(mob,data);
 					if (forkAsThread)
 					{
 						forking.fork(proc);
@@ -1360,6 +1416,123 @@ namespace common
 		}
 	};
 	
+	/**
+	*	Serves the connections read from its input channel with a fixed pool of worker processes.
+	*
+	*	This is a bounded form of ConnectionHandler.  The handler starts the given number of workers, spread as
+	*	evenly as it can over the given number of new threads (or run in the handler's own thread, if that is zero).
+	*	Each worker takes a connection from a channel shared by them all, runs a PROCESS for it (constructed as for
+	*	ConnectionHandler), closes the connection once that PROCESS has finished, and then takes the next.
+	*
+	*	So no more than workers connections are served at once, however many arrive, and no threads are started after
+	*	the pool.  While all the workers are busy, the handler waits to hand over the connection it holds, and stops
+	*	reading its input channel; for an accepter, further connections then wait in the operating system's queue
+	*	of pending connections until a worker is free.
+	*
+	*	When the input channel is poisoned, the handler poisons it in turn and tells the workers to stop; each
+	*	finishes once its current connection has finished, and the handler finishes once they all have.
+	*
+	*	To use this process, you will need to #include <cppcsp/common/basic.h>
+	*
+	*	@section tempreq CHANNEL_TYPE, PROCESS and PROCESS_DATA Requirements
+	*
+	*	As for ConnectionHandler.
+	*/
+	template <typename CHANNEL_TYPE, typename PROCESS, typename PROCESS_DATA>
+	class PooledConnectionHandler : public CSProcess
+	{
+	private:
+		///Serves the connections it takes from the shared channel, one at a time
+		class Worker : public CSProcess
+		{
+		private:
+			Chanin< Mobile< CHANNEL_TYPE > > in;
+			PROCESS_DATA data;
+		protected:
+			void run()
+			{
+				try
+				{
+					while (true)
+					{
+						Mobile< CHANNEL_TYPE > chan;
+						in >> chan;
+						RunInThisThread(new PROCESS(chan->reader(),chan->writer(),data));
+					}
+				}
+				catch (PoisonException&)
+				{
+				}
+			}
+		public:
+			inline Worker(const Chanin< Mobile< CHANNEL_TYPE > >& _in, const PROCESS_DATA& _data)
+				:	in(_in),data(_data)
+			{
+			}
+		};
+		
+		Chanin< Mobile< CHANNEL_TYPE > > in;
+		PROCESS_DATA data;
+		const usign32 workers;
+		const usign32 threads;
+	protected:
+		void run()
+		{
+			One2AnyChannel< Mobile< CHANNEL_TYPE > > work;
+			ScopedForking forking;
+			
+			if (threads == 0)
+			{
+				for (usign32 i = 0;i < workers;i++)
+				{
+					forking.forkInThisThread(new Worker(work.reader(),data));
+				}
+			}
+			else
+			{
+				for (usign32 t = 0;t < threads;t++)
+				{
+					std::list<CSProcessPtr> procs;
+					for (usign32 i = t;i < workers;i += threads)
+					{
+						procs.push_back(new Worker(work.reader(),data));
+					}
+					forking.fork(InParallelOneThread(procs.begin(),procs.end()));
+				}
+			}
+			
+			try
+			{
+				while (true)
+				{
+					Mobile< CHANNEL_TYPE > mob;
+					in >> mob;
+					//Blocks until a worker is free:
+					work.writer() << mob;
+				}
+			}
+			catch (PoisonException&)
+			{
+				in.poison();
+				work.writer().poison();
+			}
+		}
+	public:
+		/**
+		*	Constructs the handler.
+		*
+		*	@param _in The channel to read the connections from
+		*	@param _data The data to construct each PROCESS with
+		*	@param _workers The number of workers, and so the most connections served at once (at least one)
+		*	@param _threads The number of new threads to spread the workers over (no more than the workers), or zero
+		*	to run them all in the handler's thread
+		*/
+		inline PooledConnectionHandler(const Chanin< Mobile< CHANNEL_TYPE > >& _in, const PROCESS_DATA& _data, usign32 _workers, usign32 _threads = 1)
+			:	in(_in),data(_data),workers((std::max)(_workers,static_cast<usign32>(1))),threads((std::min)(_threads,workers))
+		{
+		}
+	};
+	
 } //namespace common
 
 } //namespace csp
@@ -0,0 +1,384 @@
+/*
+*	The Kent C++CSP Library
+*	Copyright (C) 2002-2007 Neil Brown
+*
+*	This library is free software; you can redistribute it and/or
+*	modify it under the terms of the GNU Lesser General Public
+*	License as published by the Free Software Foundation; either
+*	version 2.1 of the License, or (at your option) any later version.
+*
+*	This library is distributed in the hope that it will be useful,
+*	but WITHOUT ANY WARRANTY; without even the implied warranty of
+*	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+*	Lesser General Public License for more details.
+*
+*	You should have received a copy of the GNU Lesser General Public
+*	License along with this library; if not, write to the Free Software
+*	Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#include <string>
+#include <vector>
+#include <boost/scoped_array.hpp>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+namespace csp
+{
+namespace common
+{
+
+	/**
+	*	A process that reads a file from start to end, sending it in chunks on its output channel.
+	*
+	*	The reads are made through the kernel's io_uring (see csp::Buffer), keeping several in flight at once, so
+	*	that the file is read ahead while the chunks are sent.  Waiting for a read does not block the thread: other
+	*	processes in the same thread keep running, so the reader does not need a thread of its own (unlike a
+	*	ThreadCSProcess making blocking read calls).  The chunks come from a pool of buffers registered with the ring,
+	*	and their memory returns to the pool when they are destroyed.
+	*
+	*	Each chunk holds up to chunkSize bytes; all but the last are full, unless the file is changing as it is read.
+	*	Once the whole file has been sent, the output channel is poisoned.  It is also poisoned if the file cannot
+	*	be opened or read.  If the output channel is poisoned, the process finishes.
+	*
+	*	This process is only available on Linux.  To use it, you will need to #include <cppcsp/common/file_io.h>
+	*/
+	class FileReader : public CSProcess
+	{
+	private:
+		Chanout< Mobile<Buffer> > out;
+		const std::string path;
+		const usign32 chunkSize;
+		const usign32 queueDepth;
+
+		int fd;
+		internal::IoRing* ring;
+		internal::BufferPool* pool;
+		boost::scoped_array<internal::IoOperation> ops;
+		std::vector<Buffer*> buffers;
+		std::vector<off_t> offsets;
+		off_t offset;
+
+		void queueRead(usign32 i)
+		{
+			buffers[i] = pool->take();
+			offsets[i] = offset;
+			ring->read(&ops[i],fd,buffers[i],chunkSize,offset);
+			offset += chunkSize;
+		}
+
+		///Waits for all the reads in flight, and frees their buffers
+		void finishReads()
+		{
+			for (usign32 i = 0;i < queueDepth;i++)
+			{
+				ring->wait(&ops[i]);
+				delete buffers[i];
+				buffers[i] = NULL;
+			}
+		}
+	protected:
+		void run()
+		{
+			fd = open(path.c_str(),O_RDONLY | O_CLOEXEC);
+			if (fd < 0)
+			{
+				out.poison();
+				return;
+			}
+
+			ring = internal::IoRing::Current();
+			//Enough buffers to have a full queue of reads while as many chunks again are being used:
+			pool = new internal::BufferPool(ring,chunkSize,queueDepth * 2);
+			ops.reset(new internal::IoOperation[queueDepth]);
+			buffers.assign(queueDepth,NULL);
+			offsets.assign(queueDepth,0);
+			offset = 0;
+
+			try
+			{
+				for (usign32 i = 0;i < queueDepth;i++)
+				{
+					queueRead(i);
+				}
+
+				//The reads complete in any order, but are sent in order:
+				for (usign32 i = 0;;i = (i + 1) % queueDepth)
+				{
+					ring->wait(&ops[i]);
+					const sign32 n = ops[i].result();
+					if (n <= 0)
+					{
+						//The end of the file, or an error:
+						break;
+					}
+
+					Mobile<Buffer> chunk(buffers[i]);
+					buffers[i] = NULL;
+					chunk->resize(static_cast<usign32>(n));
+
+					if (static_cast<usign32>(n) < chunkSize)
+					{
+						//A short read (normally at the end of the file).  The reads after it would leave a gap, so
+						//they are thrown away and read again from the end of this one:
+						finishReads();
+						offset = offsets[i] + static_cast<usign32>(n);
+						for (usign32 j = 1;j <= queueDepth;j++)
+						{
+							queueRead((i + j) % queueDepth);
+						}
+					}
+					else
+					{
+						queueRead(i);
+					}
+
+					out << chunk;
+				}
+				finishReads();
+				out.poison();
+			}
+			catch (PoisonException&)
+			{
+				finishReads();
+			}
+
+			pool->close();
+			pool = NULL;
+			close(fd);
+		}
+	public:
+		/**
+		*	Constructs the process.
+		*
+		*	@param _out The channel to send the chunks of the file on
+		*	@param _path The path of the file to read
+		*	@param _chunkSize The most bytes in each chunk
+		*	@param _queueDepth The number of reads to keep in flight
+		*/
+		inline FileReader(const Chanout< Mobile<Buffer> >& _out,const std::string& _path,usign32 _chunkSize = 65536,usign32 _queueDepth = 4)
+			:	CSProcess(65536),out(_out),path(_path),chunkSize((std::max)(_chunkSize,static_cast<usign32>(1))),
+				queueDepth((std::min)((std::max)(_queueDepth,static_cast<usign32>(1)),internal::IoRing::Entries)),
+				fd(-1),ring(NULL),pool(NULL),offset(0)
+		{
+		}
+	};
+
+	/**
+	*	A process that writes the buffers it reads from its input channel to a file, one after another.
+	*
+	*	The file is created if it does not exist, and truncated if it does.  The writes are made through the kernel's
+	*	io_uring (see csp::Buffer), with several in flight at once, so the writer does not block its thread, nor need
+	*	a thread of its own.  Buffers from a FileReader in the same thread are written without copying or registering
+	*	their memory again.
+	*
+	*	When the input channel is poisoned, the writes in flight are finished, the file is closed, and the process
+	*	finishes, so everything that was read has been written once the process has finished.  If the file
+	*	cannot be opened or written, the input channel is poisoned.
+	*
+	*	This process is only available on Linux.  To use it, you will need to #include <cppcsp/common/file_io.h>
+	*/
+	class FileWriter : public CSProcess
+	{
+	private:
+		Chanin< Mobile<Buffer> > in;
+		const std::string path;
+		const usign32 queueDepth;
+
+		int fd;
+		internal::IoRing* ring;
+		boost::scoped_array<internal::IoOperation> ops;
+		boost::scoped_array< Mobile<Buffer> > held;
+		std::vector<off_t> offsets;
+		std::vector<usign32> written;
+
+		///Waits for the write in the given slot to finish (writing the rest, if it was short), returning false if it failed
+		bool finishWrite(usign32 i)
+		{
+			ring->wait(&ops[i]);
+			while (held[i])
+			{
+				const sign32 n = ops[i].result();
+				if (n <= 0)
+				{
+					return false;
+				}
+
+				written[i] += static_cast<usign32>(n);
+				if (written[i] >= held[i]->size())
+				{
+					held[i].blank();
+				}
+				else
+				{
+					ring->write(&ops[i],fd,held[i].get(),written[i],offsets[i] + written[i]);
+					ring->wait(&ops[i]);
+				}
+			}
+			return true;
+		}
+	protected:
+		void run()
+		{
+			fd = open(path.c_str(),O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC,0666);
+			if (fd < 0)
+			{
+				in.poison();
+				return;
+			}
+
+			ring = internal::IoRing::Current();
+			ops.reset(new internal::IoOperation[queueDepth]);
+			held.reset(new Mobile<Buffer>[queueDepth]);
+			offsets.assign(queueDepth,0);
+			written.assign(queueDepth,0);
+
+			off_t offset = 0;
+			bool failed = false;
+			try
+			{
+				for (usign32 i = 0;;i = (i + 1) % queueDepth)
+				{
+					//The slot's previous write must finish before its buffer is replaced:
+					if (false == finishWrite(i))
+					{
+						failed = true;
+						break;
+					}
+
+					in >> held[i];
+					if (!held[i] || held[i]->size() == 0)
+					{
+						held[i].blank();
+						continue;
+					}
+
+					offsets[i] = offset;
+					written[i] = 0;
+					offset += held[i]->size();
+					ring->write(&ops[i],fd,held[i].get(),0,offsets[i]);
+				}
+			}
+			catch (PoisonException&)
+			{
+			}
+
+			for (usign32 i = 0;i < queueDepth;i++)
+			{
+				failed = (false == finishWrite(i)) || failed;
+			}
+			held.reset();
+
+			if (close(fd) != 0 || failed)
+			{
+				in.poison();
+			}
+		}
+	public:
+		/**
+		*	Constructs the process.
+		*
+		*	@param _in The channel to read the buffers to write from
+		*	@param _path The path of the file to write
+		*	@param _queueDepth The number of writes to keep in flight
+		*/
+		inline FileWriter(const Chanin< Mobile<Buffer> >& _in,const std::string& _path,usign32 _queueDepth = 4)
+			:	CSProcess(65536),in(_in),path(_path),
+				queueDepth((std::min)((std::max)(_queueDepth,static_cast<usign32>(1)),internal::IoRing::Entries)),
+				fd(-1),ring(NULL)
+		{
+		}
+	};
+
+	/**
+	*	A process that maps a file into memory and sends views of it, chunk by chunk, on its output channel.
+	*
+	*	Nothing is copied: each MappedView refers to the shared mapping, which is unmapped once the last view has
+	*	been destroyed, so the processes downstream read the page cache directly, however many channels the views
+	*	pass along.  The mapping is advised to be read sequentially, and the kernel is asked to read readAhead bytes
+	*	ahead of the views that have been sent, so that the consumers seldom wait for the disk.
+	*
+	*	Once views of the whole file have been sent, the output channel is poisoned.  It is also poisoned if the file
+	*	cannot be opened or mapped, or is empty.  If the output channel is poisoned, the process finishes.
+	*
+	*	Since the data is read when it is first touched, the consumers (not this process) may wait for the disk, and
+	*	a file that is truncated while it is mapped will raise SIGBUS in them.  Where that matters, use FileReader.
+	*
+	*	This process is only available on Linux.  To use it, you will need to #include <cppcsp/common/file_io.h>
+	*/
+	class MappedFileSource : public CSProcess
+	{
+	private:
+		Chanout<MappedView> out;
+		const std::string path;
+		const size_t chunkSize;
+		size_t readAhead;
+	protected:
+		void run()
+		{
+			const int fd = open(path.c_str(),O_RDONLY | O_CLOEXEC);
+			struct stat info;
+			if (fd < 0 || fstat(fd,&info) != 0 || info.st_size <= 0)
+			{
+				if (fd >= 0)
+				{
+					close(fd);
+				}
+				out.poison();
+				return;
+			}
+
+			//The mapping does not need the descriptor once it is made:
+			const size_t size = static_cast<size_t>(info.st_size);
+			void* const data = mmap(NULL,size,PROT_READ,MAP_SHARED,fd,0);
+			close(fd);
+			if (data == MAP_FAILED)
+			{
+				out.poison();
+				return;
+			}
+			madvise(data,size,MADV_SEQUENTIAL);
+
+			internal::MappedFile* const file = new internal::MappedFile(data,size);
+			try
+			{
+				//The advice is given in windows of readAhead bytes, with the next given once half the last has been sent:
+				size_t advised = 0;
+				for (size_t offset = 0;offset < size;offset += chunkSize)
+				{
+					while (advised < size && advised < offset + readAhead / 2 + chunkSize)
+					{
+						madvise(static_cast<unsigned char*>(data) + advised,(std::min)(readAhead,size - advised),MADV_WILLNEED);
+						advised += readAhead;
+					}
+					out << MappedView(file,offset,(std::min)(chunkSize,size - offset));
+				}
+				out.poison();
+			}
+			catch (PoisonException&)
+			{
+			}
+			file->release();
+		}
+	public:
+		/**
+		*	Constructs the process.
+		*
+		*	@param _out The channel to send the views on
+		*	@param _path The path of the file to map
+		*	@param _chunkSize The most bytes in each view
+		*	@param _readAhead How far ahead of the views sent the kernel is asked to read (rounded up to whole pages)
+		*/
+		inline MappedFileSource(const Chanout<MappedView>& _out,const std::string& _path,size_t _chunkSize = 1048576,size_t _readAhead = 8388608)
+			:	CSProcess(65536),out(_out),path(_path),chunkSize((std::max)(_chunkSize,static_cast<size_t>(1))),readAhead(_readAhead)
+		{
+			//madvise needs page-aligned windows:
+			const size_t page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+			readAhead = (std::max)(((readAhead + page - 1) / page) * page,page);
+		}
+	};
+
+} //namespace common
+} //namespace csp
@@ -0,0 +1,162 @@
+/*
+*	The Kent C++CSP Library
+*	Copyright (C) 2002-2007 Neil Brown
+*
+*	This library is free software; you can redistribute it and/or
+*	modify it under the terms of the GNU Lesser General Public
+*	License as published by the Free Software Foundation; either
+*	version 2.1 of the License, or (at your option) any later version.
+*
+*	This library is distributed in the hope that it will be useful,
+*	but WITHOUT ANY WARRANTY; without even the implied warranty of
+*	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+*	Lesser General Public License for more details.
+*
+*	You should have received a copy of the GNU Lesser General Public
+*	License along with this library; if not, write to the Free Software
+*	Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+/** @file counting_semaphore.h
+*	@brief Contains the Semaphore class
+*
+*	This file is \#included from cppcsp.h
+*/
+
+#ifndef INCLUDED_FROM_CPPCSP_H
+#error This file should only be included by csp.h, not individually
+#endif
+
+namespace csp
+{
+	/**
+	*	A counting semaphore for processes.  The semaphore holds a number of permits; acquire() takes one, and release()
+	*	gives one back.  A process that acquires when there are no permits left blocks (like it would on a channel) until
+	*	another process releases one, leaving the other processes in its thread to run.  The operating system's semaphores
+	*	would block the whole thread instead.
+	*
+	*	For example, to stop more than four processes using a connection pool at once:
+	*	@code
+		Semaphore connections(4);
+
+		//In each process:
+		connections.acquire();
+		//... use a connection ...
+		connections.release();
+		@endcode
+	*
+	*	acquire() and release() each take one atomic operation when no process has to block.  Blocked processes are
+	*	freed in the order that they blocked.  Any process may release a permit; it does not have to be one that acquired.
+	*
+	*	@see ReadWriteLock
+	*/
+	class Semaphore : private internal::Primitive, public boost::noncopyable
+	{
+	private:
+		/**
+		*	The number of permits available, minus the number of processes that have found none.  It is
+		*	really signed; it is negative while processes are (or are about to be) waiting
+		*/
+		__CPPCSP_ALIGNED_USIGN32 count;
+		///The queue of blocked processes
+		internal::ProcessPtr head,tail;
+		/**
+		*	Permits handed over by release() to a process that had found none, but had not yet
+		*	joined the queue by the time the permit was released
+		*/
+		usign32 handedOver;
+		internal::PureSpinMutex mutex;
+	public:
+		/**
+		*	Constructs the semaphore.
+		*
+		*	@param permits The number of permits that the semaphore starts with
+		*/
+		inline explicit Semaphore(usign32 permits)
+			:	count(permits),head(NullProcessPtr),tail(NullProcessPtr),handedOver(0)
+		{
+		}
+
+		/**
+		*	Takes a permit, blocking until one is available if necessary
+		*/
+		void acquire()
+		{
+			if (static_cast<sign32>(internal::AtomicDecrement(&count)) >= 0)
+			{
+				return;
+			}
+
+			mutex.claim();
+				if (handedOver != 0)
+				{
+					//A permit was released for us before we got here:
+					handedOver--;
+					mutex.release();
+					return;
+				}
+
+				addProcessToQueue(&head,&tail,currentProcess());
+			mutex.release();
+
+			//Whoever frees us has given us their permit:
+			reschedule();
+		}
+
+		/**
+		*	Takes a permit if one is available, without blocking.
+		*
+		*	@return True if a permit was taken, false if none were available
+		*/
+		bool tryAcquire()
+		{
+			usign32 current = internal::AtomicGet(&count);
+			while (static_cast<sign32>(current) > 0)
+			{
+				const usign32 previous = internal::AtomicCompareAndSwap(&count,current,current - 1);
+				if (previous == current)
+				{
+					return true;
+				}
+				current = previous;
+			}
+			return false;
+		}
+
+		/**
+		*	Gives back a permit.  If any processes are waiting for one, the first of them takes it.
+		*/
+		void release()
+		{
+			if (static_cast<sign32>(internal::AtomicIncrement(&count)) > 0)
+			{
+				return;
+			}
+
+			//Someone has found no permits, so it is theirs:
+			mutex.claim();
+				if (head != NullProcessPtr)
+				{
+					internal::ProcessPtr process = head;
+					head = getNextProcess(process);
+					freeProcessNoAlt(process);
+				}
+				else
+				{
+					//They have not queued up yet:
+					handedOver++;
+				}
+			mutex.release();
+		}
+
+		/**
+		*	Gets the number of permits currently available.  This is zero while processes are waiting.  As with all such
+		*	functions, the answer may be out of date by the time you use it.
+		*/
+		inline usign32 available()
+		{
+			const sign32 current = static_cast<sign32>(internal::AtomicGet(&count));
+			return current > 0 ? static_cast<usign32>(current) : 0;
+		}
+	};
+}
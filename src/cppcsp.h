@@ -204,10 +204,21 @@
 #include <boost/integer.hpp>
 #include <boost/variant.hpp>
 #include <boost/array.hpp>
+#include <boost/aligned_storage.hpp>
+#include <boost/static_assert.hpp>
 #include <string>
 #include <vector>
 #include <list>
 #include <map>
+#include <new>
+
+//Destructors that throw on misuse (such as those of the barriers) must be marked as able to throw under C++11 and later,
+//where destructors are noexcept by default:
+#if __cplusplus >= 201103L
+	#define __CPPCSP_THROWING_DESTRUCTOR noexcept(false)
+#else
+	#define __CPPCSP_THROWING_DESTRUCTOR
+#endif
 
 /** @class boost::noncopyable
 *
@@ -290,7 +301,8 @@ namespace csp
     typedef boost::variant<IPv4Address,IPv6Address> IPAddress;
     
     const IPAddress IPAddress_Any;
-	const IPAddress IPAddress_Localhost;
+	const IPv4Address IPv4Address_Localhost = {{127,0,0,1}};
+	const IPAddress IPAddress_Localhost(IPv4Address_Localhost);
     
     typedef IPAddress NetworkInterface;
     
@@ -506,18 +518,33 @@ namespace csp
 #include "run.h"
 
 #include "bucket.h"
+#include "rw_lock.h"
+#include "counting_semaphore.h"
+#include "shared_value.h"
 
 #include "alt.h"
 
 #include "channel_base.h"
 #include "channel_ends.h"
+#include "channel_stats.h"
 #include "channel.h"
 
 #include "channel_buffers.h"
 #include "buffered_channel.h"
+#include "instrumented_channel.h"
+#include "broadcast_channel.h"
+
+#ifdef CPPCSP_LINUX
+	#include "shm_channel.h"
+#endif
+
 #include "channel_factory.h"
 
-#include "net_channels.h"
+#ifdef CPPCSP_LINUX
+	#include "net_channels.h"
+	#include "named_channels.h"
+	#include "file_io.h"
+#endif
 
 namespace csp
 {
@@ -0,0 +1,592 @@
+/*
+*	The Kent C++CSP Library
+*	Copyright (C) 2002-2007 Neil Brown
+*
+*	This library is free software; you can redistribute it and/or
+*	modify it under the terms of the GNU Lesser General Public
+*	License as published by the Free Software Foundation; either
+*	version 2.1 of the License, or (at your option) any later version.
+*
+*	This library is distributed in the hope that it will be useful,
+*	but WITHOUT ANY WARRANTY; without even the implied warranty of
+*	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+*	Lesser General Public License for more details.
+*
+*	You should have received a copy of the GNU Lesser General Public
+*	License along with this library; if not, write to the Free Software
+*	Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+/** @internal@file file_io.cpp
+*	@brief Implements Buffer, its pools, mapped files, and the io_uring ring that each kernel uses for file I/O
+*/
+
+#include "cppcsp.h"
+
+#ifdef CPPCSP_LINUX
+
+#include <sys/mman.h>
+#include <sys/eventfd.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <new>
+
+//io_uring is driven with raw system calls, so all that is needed is the kernel's header:
+#if defined(__has_include) && defined(__NR_io_uring_setup)
+	#if __has_include(<linux/io_uring.h>)
+		#include <linux/io_uring.h>
+		#define CPPCSP_IO_URING
+	#endif
+#endif
+
+using namespace csp;
+using namespace csp::internal;
+using namespace std;
+
+namespace
+{
+	//Buffers are page-aligned, which direct I/O needs:
+	const size_t BufferAlignment = 4096;
+
+	inline sign32 ErrorResult()
+	{
+		return -static_cast<sign32>(errno);
+	}
+}
+
+Buffer::Buffer(usign32 capacity)
+	:	memory(new unsigned char[capacity]),bufferCapacity(capacity),bufferSize(0),pool(NULL)
+{
+}
+
+Buffer::~Buffer()
+{
+	if (pool != NULL)
+	{
+		pool->give(memory);
+	}
+	else
+	{
+		delete []memory;
+	}
+}
+
+BufferPool::BufferPool(IoRing* _ring,usign32 _bufferSize,usign32 _count)
+	:	block(NULL),bufferSize(_bufferSize),count(_count),references(1),ring(NULL),firstSlot(-1)
+{
+	void* memory;
+	if (posix_memalign(&memory,BufferAlignment,static_cast<size_t>(bufferSize) * count) != 0)
+	{
+		throw std::bad_alloc();
+	}
+	block = static_cast<unsigned char*>(memory);
+
+	//Taken from the back, so that the first buffers are used first:
+	unused.reserve(count);
+	for (usign32 i = count;i > 0;i--)
+	{
+		unused.push_back(block + static_cast<size_t>(i - 1) * bufferSize);
+	}
+
+	if (_ring != NULL)
+	{
+		firstSlot = _ring->registerBuffers(block,bufferSize,count);
+		if (firstSlot >= 0)
+		{
+			ring = _ring;
+		}
+	}
+}
+
+BufferPool::~BufferPool()
+{
+	free(block);
+}
+
+Buffer* BufferPool::take()
+{
+	mutex.claim();
+		if (unused.empty())
+		{
+			mutex.release();
+			return new Buffer(bufferSize);
+		}
+		unsigned char* const memory = unused.back();
+		unused.pop_back();
+	mutex.release();
+
+	AtomicIncrement(&references);
+	return new Buffer(memory,bufferSize,this);
+}
+
+void BufferPool::give(unsigned char* memory)
+{
+	mutex.claim();
+		unused.push_back(memory);
+	mutex.release();
+	release();
+}
+
+void BufferPool::release()
+{
+	if (AtomicDecrement(&references) == 0)
+	{
+		delete this;
+	}
+}
+
+void BufferPool::close()
+{
+	if (ring != NULL)
+	{
+		ring->unregisterBuffers(firstSlot,count);
+		ring = NULL;
+		firstSlot = -1;
+	}
+	release();
+}
+
+MappedFile::~MappedFile()
+{
+	munmap(const_cast<unsigned char*>(data),size);
+}
+
+#ifdef CPPCSP_IO_URING
+
+IoRing::IoRing(const AtomicProcessQueue& _runQueue)
+	:	fd(-1),rings(MAP_FAILED),ringsSize(0),sqes(MAP_FAILED),sqesSize(0),tail(0),unsubmitted(0),pending(0),
+		runQueue(_runQueue),wakeFd(-1),wakeArmed(false),wakeCount(0),waiting(0)
+{
+	//Other threads wake us from waiting on the ring by writing to this:
+	wakeFd = eventfd(0,EFD_CLOEXEC);
+	if (wakeFd < 0)
+	{
+		return;
+	}
+
+	//Completions from the kernel's workers do not interrupt us; we run their work when we next reap (Linux 5.19):
+	io_uring_params params;
+	memset(&params,0,sizeof(params));
+	params.flags = IORING_SETUP_COOP_TASKRUN | IORING_SETUP_TASKRUN_FLAG;
+	fd = static_cast<int>(syscall(__NR_io_uring_setup,Entries,&params));
+	if (fd < 0 && errno == EINVAL)
+	{
+		memset(&params,0,sizeof(params));
+		fd = static_cast<int>(syscall(__NR_io_uring_setup,Entries,&params));
+	}
+	if (fd < 0)
+	{
+		return;
+	}
+
+	//The rings are mapped together, and waiting has a timeout; without these (before Linux 5.11), we do without:
+	if ((params.features & IORING_FEAT_SINGLE_MMAP) == 0 || (params.features & IORING_FEAT_EXT_ARG) == 0)
+	{
+		close(fd);
+		fd = -1;
+		return;
+	}
+
+	ringsSize = (std::max)(params.sq_off.array + params.sq_entries * sizeof(usign32),params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe));
+	rings = mmap(NULL,ringsSize,PROT_READ | PROT_WRITE,MAP_SHARED | MAP_POPULATE,fd,IORING_OFF_SQ_RING);
+	sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+	sqes = mmap(NULL,sqesSize,PROT_READ | PROT_WRITE,MAP_SHARED | MAP_POPULATE,fd,IORING_OFF_SQES);
+	if (rings == MAP_FAILED || sqes == MAP_FAILED)
+	{
+		if (rings != MAP_FAILED)
+		{
+			munmap(rings,ringsSize);
+			rings = MAP_FAILED;
+		}
+		if (sqes != MAP_FAILED)
+		{
+			munmap(sqes,sqesSize);
+			sqes = MAP_FAILED;
+		}
+		close(fd);
+		fd = -1;
+		return;
+	}
+
+	unsigned char* const base = static_cast<unsigned char*>(rings);
+	sqEntries = params.sq_entries;
+	sqMask = *reinterpret_cast<usign32*>(base + params.sq_off.ring_mask);
+	sqTail = reinterpret_cast<usign32 volatile *>(base + params.sq_off.tail);
+	sqArray = reinterpret_cast<usign32*>(base + params.sq_off.array);
+	sqFlags = reinterpret_cast<usign32 volatile *>(base + params.sq_off.flags);
+	cqMask = *reinterpret_cast<usign32*>(base + params.cq_off.ring_mask);
+	cqHead = reinterpret_cast<usign32 volatile *>(base + params.cq_off.head);
+	cqTail = reinterpret_cast<usign32 volatile *>(base + params.cq_off.tail);
+	cqes = base + params.cq_off.cqes;
+	tail = *sqTail;
+
+	//An empty table of buffers, filled in as buffer pools are made.  Registering pins memory, which may not be
+	//allowed; then operations simply use unregistered buffers:
+	io_uring_rsrc_register table;
+	memset(&table,0,sizeof(table));
+	table.nr = RegisteredBuffers;
+	table.flags = IORING_RSRC_REGISTER_SPARSE;
+	if (syscall(__NR_io_uring_register,fd,IORING_REGISTER_BUFFERS2,&table,sizeof(table)) == 0)
+	{
+		slots.resize(RegisteredBuffers,false);
+	}
+}
+
+IoRing::~IoRing()
+{
+	if (sqes != MAP_FAILED)
+	{
+		munmap(sqes,sqesSize);
+	}
+	if (rings != MAP_FAILED)
+	{
+		munmap(rings,ringsSize);
+	}
+	if (fd >= 0)
+	{
+		close(fd);
+	}
+	if (wakeFd >= 0)
+	{
+		close(wakeFd);
+	}
+}
+
+void* IoRing::nextEntry()
+{
+	//Without a polling thread in the kernel, the submission queue is emptied by each submission:
+	while (unsubmitted == sqEntries)
+	{
+		if (false == submit(0,NULL))
+		{
+			//The completion queue has overflowed; make room:
+			reap();
+		}
+	}
+
+	const usign32 index = tail & sqMask;
+	sqArray[index] = index;
+	tail++;
+	unsubmitted++;
+	return static_cast<io_uring_sqe*>(sqes) + index;
+}
+
+void IoRing::queue(IoOperation* op,int opcode,int file,void* data,usign32 length,off_t offset,int slot)
+{
+	io_uring_sqe* const sqe = static_cast<io_uring_sqe*>(nextEntry());
+	memset(sqe,0,sizeof(io_uring_sqe));
+	sqe->opcode = static_cast<__u8>(opcode);
+	sqe->fd = file;
+	sqe->addr = reinterpret_cast<__u64>(data);
+	sqe->len = length;
+	sqe->off = offset;
+	if (slot >= 0)
+	{
+		sqe->buf_index = static_cast<__u16>(slot);
+	}
+	sqe->user_data = reinterpret_cast<__u64>(op);
+
+	op->done = false;
+	op->res = 0;
+	pending++;
+}
+
+bool IoRing::submit(usign32 waitFor,const Time* timeout)
+{
+	__atomic_store_n(sqTail,tail,__ATOMIC_RELEASE);
+
+	unsigned flags = 0;
+	io_uring_getevents_arg arg;
+	__kernel_timespec ts;
+	if (waitFor > 0)
+	{
+		memset(&arg,0,sizeof(arg));
+		arg.sigmask_sz = _NSIG / 8;
+		if (timeout != NULL)
+		{
+			ts.tv_sec = timeout->tv_sec;
+			ts.tv_nsec = static_cast<long long>(timeout->tv_usec) * 1000;
+			arg.ts = reinterpret_cast<__u64>(&ts);
+		}
+		flags = IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG;
+	}
+
+	const long ret = syscall(__NR_io_uring_enter,fd,unsubmitted,waitFor,flags,waitFor > 0 ? &arg : NULL,waitFor > 0 ? sizeof(arg) : 0);
+	if (ret < 0)
+	{
+		//A timeout or signal while waiting is not a failure; being busy (with the completion queue full) is:
+		return errno == ETIME || errno == EINTR;
+	}
+	unsubmitted -= static_cast<usign32>(ret);
+	return true;
+}
+
+usign32 IoRing::reap()
+{
+	if ((__atomic_load_n(sqFlags,__ATOMIC_RELAXED) & IORING_SQ_TASKRUN) != 0)
+	{
+		//Some operations have finished, but their completions must be posted from our thread:
+		syscall(__NR_io_uring_enter,fd,0,0,IORING_ENTER_GETEVENTS,NULL,0);
+	}
+
+	usign32 head = *cqHead;
+	const usign32 end = __atomic_load_n(cqTail,__ATOMIC_ACQUIRE);
+	const usign32 ret = end - head;
+
+	for (;head != end;head++)
+	{
+		const io_uring_cqe* const cqe = static_cast<const io_uring_cqe*>(cqes) + (head & cqMask);
+		if (cqe->user_data == 0)
+		{
+			//The read of the eventfd; someone woke us:
+			wakeArmed = false;
+			continue;
+		}
+		IoOperation* const op = reinterpret_cast<IoOperation*>(cqe->user_data);
+		op->res = cqe->res;
+		op->done = true;
+		pending--;
+		if (op->waiting != NullProcessPtr)
+		{
+			ProcessPtr process = op->waiting;
+			op->waiting = NullProcessPtr;
+			freeProcessNoAlt(process);
+		}
+	}
+
+	__atomic_store_n(cqHead,end,__ATOMIC_RELEASE);
+	return ret;
+}
+
+void IoRing::complete(bool idle,const Time* timeout)
+{
+	if (unsubmitted > 0)
+	{
+		submit(0,NULL);
+	}
+
+	if (reap() == 0 && idle && pending > unsubmitted)
+	{
+		Time wait;
+		if (timeout != NULL)
+		{
+			Time now;
+			CurrentTime(&now);
+			if (*timeout <= now)
+			{
+				return;
+			}
+			wait = *timeout - now;
+		}
+
+		//Ask to be woken, then check that no-one has added to our run queue before we asked:
+		AtomicSwap(&waiting,1);
+		if (runQueue.empty())
+		{
+			if (false == wakeArmed)
+			{
+				//Not counted as pending; it is marked by having no operation:
+				io_uring_sqe* const sqe = static_cast<io_uring_sqe*>(nextEntry());
+				memset(sqe,0,sizeof(io_uring_sqe));
+				sqe->opcode = IORING_OP_READ;
+				sqe->fd = wakeFd;
+				sqe->addr = reinterpret_cast<__u64>(&wakeCount);
+				sqe->len = sizeof(wakeCount);
+				sqe->off = static_cast<__u64>(-1);
+				wakeArmed = true;
+			}
+			submit(1,timeout == NULL ? NULL : &wait);
+		}
+		//Freeing our own processes as we reap must not wake us next time:
+		AtomicPut(&waiting,0);
+		reap();
+	}
+}
+
+int IoRing::registerBuffers(unsigned char* memory,usign32 bufferSize,usign32 count)
+{
+	//Find the first run of enough empty slots:
+	usign32 first = 0,run = 0;
+	for (usign32 i = 0;i < slots.size() && run < count;i++)
+	{
+		if (slots[i])
+		{
+			first = i + 1;
+			run = 0;
+		}
+		else
+		{
+			run++;
+		}
+	}
+	if (count == 0 || run < count)
+	{
+		return -1;
+	}
+
+	std::vector<iovec> iovs(count);
+	for (usign32 i = 0;i < count;i++)
+	{
+		iovs[i].iov_base = memory + static_cast<size_t>(i) * bufferSize;
+		iovs[i].iov_len = bufferSize;
+	}
+
+	io_uring_rsrc_update2 update;
+	memset(&update,0,sizeof(update));
+	update.offset = first;
+	update.data = reinterpret_cast<__u64>(&iovs[0]);
+	update.nr = count;
+	const long ret = syscall(__NR_io_uring_register,fd,IORING_REGISTER_BUFFERS_UPDATE,&update,sizeof(update));
+	if (ret != static_cast<long>(count))
+	{
+		//Most likely the memory could not be pinned:
+		if (ret > 0)
+		{
+			unregisterBuffers(static_cast<int>(first),static_cast<usign32>(ret));
+		}
+		return -1;
+	}
+
+	std::fill(slots.begin() + first,slots.begin() + first + count,true);
+	return static_cast<int>(first);
+}
+
+void IoRing::unregisterBuffers(int first,usign32 count)
+{
+	//Operations in flight keep their buffers registered until they complete:
+	std::vector<iovec> iovs(count);
+	memset(&iovs[0],0,sizeof(iovec) * count);
+
+	io_uring_rsrc_update2 update;
+	memset(&update,0,sizeof(update));
+	update.offset = static_cast<__u32>(first);
+	update.data = reinterpret_cast<__u64>(&iovs[0]);
+	update.nr = count;
+	syscall(__NR_io_uring_register,fd,IORING_REGISTER_BUFFERS_UPDATE,&update,sizeof(update));
+
+	std::fill(slots.begin() + first,slots.begin() + first + count,false);
+}
+
+void IoRing::read(IoOperation* op,int file,Buffer* buffer,usign32 length,off_t offset)
+{
+	length = (std::min)(length,buffer->capacity());
+	if (fd < 0)
+	{
+		const ssize_t n = pread(file,buffer->data(),length,offset);
+		op->res = n < 0 ? ErrorResult() : static_cast<sign32>(n);
+		op->done = true;
+		return;
+	}
+
+	if (buffer->pool != NULL && buffer->pool->ring == this)
+	{
+		const int slot = buffer->pool->firstSlot + static_cast<int>((buffer->data() - buffer->pool->block) / buffer->pool->bufferSize);
+		queue(op,IORING_OP_READ_FIXED,file,buffer->data(),length,offset,slot);
+	}
+	else
+	{
+		queue(op,IORING_OP_READ,file,buffer->data(),length,offset,-1);
+	}
+}
+
+void IoRing::write(IoOperation* op,int file,const Buffer* buffer,usign32 from,off_t offset)
+{
+	const usign32 length = buffer->size() - (std::min)(from,buffer->size());
+	unsigned char* const data = const_cast<unsigned char*>(buffer->data()) + from;
+	if (fd < 0)
+	{
+		const ssize_t n = pwrite(file,data,length,offset);
+		op->res = n < 0 ? ErrorResult() : static_cast<sign32>(n);
+		op->done = true;
+		return;
+	}
+
+	if (buffer->pool != NULL && buffer->pool->ring == this)
+	{
+		const int slot = buffer->pool->firstSlot + static_cast<int>((buffer->data() - buffer->pool->block) / buffer->pool->bufferSize);
+		queue(op,IORING_OP_WRITE_FIXED,file,data,length,offset,slot);
+	}
+	else
+	{
+		queue(op,IORING_OP_WRITE,file,data,length,offset,-1);
+	}
+}
+
+#else //CPPCSP_IO_URING
+
+//Without io_uring, every operation blocks the thread while it is queued:
+
+IoRing::IoRing(const AtomicProcessQueue& _runQueue)
+	:	fd(-1),rings(NULL),ringsSize(0),sqes(NULL),sqesSize(0),tail(0),unsubmitted(0),pending(0),
+		runQueue(_runQueue),wakeFd(-1),wakeArmed(false),wakeCount(0),waiting(0)
+{
+}
+
+IoRing::~IoRing()
+{
+}
+
+void IoRing::complete(bool,const Time*)
+{
+}
+
+int IoRing::registerBuffers(unsigned char*,usign32,usign32)
+{
+	return -1;
+}
+
+void IoRing::unregisterBuffers(int,usign32)
+{
+}
+
+void IoRing::read(IoOperation* op,int file,Buffer* buffer,usign32 length,off_t offset)
+{
+	const ssize_t n = pread(file,buffer->data(),(std::min)(length,buffer->capacity()),offset);
+	op->res = n < 0 ? ErrorResult() : static_cast<sign32>(n);
+	op->done = true;
+}
+
+void IoRing::write(IoOperation* op,int file,const Buffer* buffer,usign32 from,off_t offset)
+{
+	from = (std::min)(from,buffer->size());
+	const ssize_t n = pwrite(file,buffer->data() + from,buffer->size() - from,offset);
+	op->res = n < 0 ? ErrorResult() : static_cast<sign32>(n);
+	op->done = true;
+}
+
+#endif //CPPCSP_IO_URING
+
+IoRing* IoRing::Current()
+{
+	return currentIoRing();
+}
+
+void IoRing::wake()
+{
+	//A full barrier between adding to the run queue and reading the flag, so that either we see that the kernel
+	//is waiting, or it sees what we added:
+	if (AtomicCompareAndSwap(&waiting,1,0) == 1)
+	{
+		//This only fails if the count would overflow, and then the kernel is woken anyway:
+		const unsigned long long one = 1;
+		const ssize_t written = ::write(wakeFd,&one,sizeof(one));
+		(void)written;
+	}
+}
+
+void IoRing::wait(IoOperation* op)
+{
+	if (false == op->done)
+	{
+		//Our kernel frees us when it reaps the completion:
+		op->waiting = currentProcess();
+		reschedule();
+	}
+}
+
+#endif //CPPCSP_LINUX
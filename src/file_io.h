@@ -0,0 +1,400 @@
+/*
+*	The Kent C++CSP Library
+*	Copyright (C) 2002-2007 Neil Brown
+*
+*	This library is free software; you can redistribute it and/or
+*	modify it under the terms of the GNU Lesser General Public
+*	License as published by the Free Software Foundation; either
+*	version 2.1 of the License, or (at your option) any later version.
+*
+*	This library is distributed in the hope that it will be useful,
+*	but WITHOUT ANY WARRANTY; without even the implied warranty of
+*	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+*	Lesser General Public License for more details.
+*
+*	You should have received a copy of the GNU Lesser General Public
+*	License along with this library; if not, write to the Free Software
+*	Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+/** @file file_io.h
+*	@brief Contains Buffer and MappedView, and the io_uring ring through which a kernel's processes do asynchronous file I/O
+*
+*	This file is \#included from cppcsp.h on Linux only
+*/
+
+#ifndef INCLUDED_FROM_CPPCSP_H
+#error This file should only be included by csp.h, not individually
+#endif
+
+#include <vector>
+#include <sys/types.h>
+
+namespace csp
+{
+	namespace internal
+	{
+		class BufferPool;
+		class IoRing;
+
+		/**@internal
+		*	A read-only memory mapping of a whole file, shared by the MappedViews of it, and unmapped once
+		*	the last of them has been destroyed.
+		*/
+		class MappedFile : public boost::noncopyable
+		{
+		private:
+			__CPPCSP_ALIGNED_USIGN32 references;
+		protected:
+			///Only release() destroys the mapping
+			~MappedFile();
+		public:
+			const unsigned char* const data;
+			const size_t size;
+
+			///Takes ownership of the mapping, with one reference
+			inline MappedFile(const void* _data,size_t _size)
+				:	references(1),data(static_cast<const unsigned char*>(_data)),size(_size)
+			{
+			}
+
+			inline void addReference()
+			{
+				AtomicIncrement(&references);
+			}
+
+			inline void release()
+			{
+				if (0 == AtomicDecrement(&references))
+				{
+					delete this;
+				}
+			}
+		};
+	}
+
+	/**
+	*	A read-only view of part of a memory-mapped file, as sent by csp::common::MappedFileSource.
+	*
+	*	A view is just an offset, a length and a reference to the mapping, so views can be sent down a pipeline
+	*	of channels, and copied at each hop, without the data ever being copied: the readers read the page cache
+	*	directly.  The mapping stays alive until the last view of it has been destroyed, wherever that is.
+	*/
+	class MappedView
+	{
+	private:
+		internal::MappedFile* file;
+		size_t start;
+		size_t length;
+	public:
+		///An empty view
+		inline MappedView()
+			:	file(NULL),start(0),length(0)
+		{
+		}
+
+		///A view of part of the mapping, which must lie within it
+		inline MappedView(internal::MappedFile* _file,size_t _start,size_t _length)
+			:	file(_file),start(_start),length(_length)
+		{
+			file->addReference();
+		}
+
+		inline MappedView(const MappedView& view)
+			:	file(view.file),start(view.start),length(view.length)
+		{
+			if (file != NULL)
+			{
+				file->addReference();
+			}
+		}
+
+		inline MappedView& operator=(const MappedView& view)
+		{
+			if (view.file != NULL)
+			{
+				view.file->addReference();
+			}
+			if (file != NULL)
+			{
+				file->release();
+			}
+			file = view.file;
+			start = view.start;
+			length = view.length;
+			return *this;
+		}
+
+		inline ~MappedView()
+		{
+			if (file != NULL)
+			{
+				file->release();
+			}
+		}
+
+		inline const unsigned char* data() const
+		{
+			return file == NULL ? NULL : file->data + start;
+		}
+
+		inline size_t size() const
+		{
+			return length;
+		}
+
+		///The position in the file of the view's first byte
+		inline size_t offset() const
+		{
+			return start;
+		}
+
+		///A view of part of this view (clipped to it), sharing the same mapping
+		inline MappedView sub(size_t from,size_t n) const
+		{
+			from = (std::min)(from,length);
+			return file == NULL ? MappedView() : MappedView(file,start + from,(std::min)(n,length - from));
+		}
+	};
+
+	/**
+	*	A block of memory for file I/O, such as the chunks of a file sent by csp::common::FileReader, or the data
+	*	given to csp::common::FileWriter.
+	*
+	*	A Buffer has a fixed capacity, of which the first size() bytes are in use.  Buffers are meant to be passed
+	*	between processes in a Mobile (as Mobile<Buffer>), so that the data is never copied.
+	*
+	*	The buffers sent by a FileReader come from a pool that is registered with its kernel's I/O ring.  Destroying
+	*	one (in any thread) returns its memory to the pool, where it can be read into again without being registered
+	*	afresh; if such a buffer is given to a FileWriter in the same thread, it is written without being registered either.
+	*/
+	class Buffer : public boost::noncopyable
+	{
+	private:
+		unsigned char* memory;
+		usign32 bufferCapacity;
+		usign32 bufferSize;
+		internal::BufferPool* pool;
+
+		inline Buffer(unsigned char* _memory,usign32 _capacity,internal::BufferPool* _pool)
+			:	memory(_memory),bufferCapacity(_capacity),bufferSize(0),pool(_pool)
+		{
+		}
+
+		friend class internal::BufferPool;
+		friend class internal::IoRing;
+	public:
+		///Allocates a buffer with the given capacity, none of which is in use
+		explicit Buffer(usign32 capacity);
+
+		///Frees the memory, or returns it to its pool
+		~Buffer();
+
+		inline unsigned char* data()
+		{
+			return memory;
+		}
+
+		inline const unsigned char* data() const
+		{
+			return memory;
+		}
+
+		///The number of bytes in use
+		inline usign32 size() const
+		{
+			return bufferSize;
+		}
+
+		inline usign32 capacity() const
+		{
+			return bufferCapacity;
+		}
+
+		///Sets the number of bytes in use, which must not be more than the capacity
+		inline void resize(usign32 n)
+		{
+			bufferSize = (std::min)(n,bufferCapacity);
+		}
+	};
+
+	namespace internal
+	{
+		/**@internal
+		*	A set of equally-sized buffers, registered (where possible) with a kernel's I/O ring as one block.
+		*
+		*	The pool is reference-counted: its owner holds one reference, and each Buffer taken from it holds another,
+		*	so that buffers still held by other processes outlive the owner.  When the owner closes the pool, its memory
+		*	is unregistered from the ring; the outstanding buffers remain valid, as plain memory.
+		*/
+		class BufferPool : public boost::noncopyable
+		{
+		private:
+			PureSpinMutex mutex;
+			std::vector<unsigned char*> unused;
+			unsigned char* block;
+			const usign32 bufferSize;
+			const usign32 count;
+			__CPPCSP_ALIGNED_USIGN32 references;
+
+			//The ring the block is registered with, and the ring's index of its first buffer (NULL and -1 if it is not):
+			IoRing* ring;
+			int firstSlot;
+
+			~BufferPool();
+
+			void give(unsigned char* memory);
+			void release();
+
+			friend class csp::Buffer;
+			friend class IoRing;
+		public:
+			///Makes a pool of count buffers of the given size, registered with the ring if it can be
+			BufferPool(IoRing* ring,usign32 bufferSize,usign32 count);
+
+			/**
+			*	Takes an unused buffer from the pool (with a size of zero).  If they are all in use, a buffer is allocated
+			*	that is not registered with the ring, and is freed rather than returned.
+			*/
+			Buffer* take();
+
+			///Unregisters the pool from the ring, and gives up the owner's reference.  Must be called in the ring's thread
+			void close();
+		};
+
+		/**@internal
+		*	A read or write submitted to an IoRing.  It must not be destroyed (or resubmitted) until it has completed.
+		*/
+		class IoOperation : public boost::noncopyable
+		{
+		private:
+			sign32 res;
+			bool done;
+			ProcessPtr waiting;
+
+			friend class IoRing;
+		public:
+			inline IoOperation()
+				:	res(0),done(true),waiting(NullProcessPtr)
+			{
+			}
+
+			inline bool complete() const
+			{
+				return done;
+			}
+
+			///The number of bytes transferred, or a negated errno value
+			inline sign32 result() const
+			{
+				return res;
+			}
+		};
+
+		/**@internal
+		*	A kernel's io_uring, through which its processes read and write files without blocking the thread.
+		*
+		*	Each kernel creates its ring the first time one of its processes asks for it (see Current()), and only that
+		*	kernel's processes use it.  A process queues operations, then blocks in wait() until the one it needs has
+		*	completed.  The ring is driven from Kernel::ReSchedule: each time the kernel reschedules, the queued
+		*	operations are submitted in one system call, and the completions are reaped (which is only a read of
+		*	shared memory), putting their waiting processes back on the run queue.  When the kernel has nothing to run
+		*	but operations are in flight, it waits on the ring instead of its run queue, so no extra thread is needed.
+		*
+		*	So that another thread freeing one of its processes can wake it from that wait, the ring always has a read of
+		*	an eventfd in flight while the kernel waits, and Kernel::AddProcess calls wake(), which writes to the eventfd
+		*	if the kernel is waiting.  The wait is otherwise only limited by the kernel's soonest timeout.
+		*
+		*	If io_uring is not available (it needs Linux 5.11, and may be disabled), each operation is instead carried
+		*	out with a blocking system call when it is queued.
+		*/
+		class IoRing : public boost::noncopyable, private Primitive
+		{
+		private:
+			int fd;
+			void* rings;
+			size_t ringsSize;
+			void* sqes;
+			size_t sqesSize;
+
+			usign32 sqMask, sqEntries, cqMask;
+			usign32 volatile * sqTail;
+			usign32 volatile * sqFlags;
+			usign32 volatile * cqHead;
+			usign32 volatile * cqTail;
+			usign32* sqArray;
+			void* cqes;
+
+			//Our copy of the submission tail, and the number of operations queued since the last submission:
+			usign32 tail;
+			usign32 unsubmitted;
+			//The operations queued or submitted that have not completed:
+			usign32 pending;
+
+			//Which of the ring's registered buffer slots are in use, if registering buffers works:
+			std::vector<bool> slots;
+
+			//The run queue of our kernel, which other threads may add to while we wait on the ring:
+			const AtomicProcessQueue& runQueue;
+			//The eventfd that wakes us, whether its read is on the ring, and what that reads into:
+			int wakeFd;
+			bool wakeArmed;
+			unsigned long long wakeCount;
+			//Non-zero while we wait on the ring and want another thread to wake us:
+			__CPPCSP_ALIGNED_USIGN32 waiting;
+
+			void* nextEntry();
+			void queue(IoOperation* op,int opcode,int fd,void* data,usign32 length,off_t offset,int slot);
+			bool submit(usign32 waitFor,const Time* timeout);
+			usign32 reap();
+
+			explicit IoRing(const AtomicProcessQueue& _runQueue);
+			~IoRing();
+
+			friend class Kernel;
+		public:
+			///The most operations queued on the ring at once
+			static const usign32 Entries = 256;
+			///The most buffers registered with the ring at once
+			static const usign32 RegisteredBuffers = 1024;
+
+			///The ring of the current kernel, created on first use
+			static IoRing* Current();
+
+			///True if the ring is backed by io_uring (false if each operation blocks instead)
+			inline bool asynchronous() const
+			{
+				return fd >= 0;
+			}
+
+			///The number of operations that have not completed
+			inline usign32 inFlight() const
+			{
+				return pending;
+			}
+
+			///Queues a read of up to length bytes into the buffer's memory (its size is left for the caller to set)
+			void read(IoOperation* op,int fd,Buffer* buffer,usign32 length,off_t offset);
+
+			///Queues a write of the buffer's bytes from the given index onwards
+			void write(IoOperation* op,int fd,const Buffer* buffer,usign32 from,off_t offset);
+
+			///Blocks the calling process until the operation has completed
+			void wait(IoOperation* op);
+
+			///Registers memory with the ring as consecutive buffers, returning the first buffer's index, or -1 if it cannot
+			int registerBuffers(unsigned char* memory,usign32 bufferSize,usign32 count);
+
+			void unregisterBuffers(int first,usign32 count);
+
+			/**
+			*	Submits the queued operations and reaps the completed ones.  If idle is true and none had completed,
+			*	waits until one does, or until wake() is called, or until the timeout (if any).  Called from Kernel::ReSchedule.
+			*/
+			void complete(bool idle,const Time* timeout);
+
+			///Wakes the kernel if it is waiting in complete().  Called (from any thread) after adding to its run queue
+			void wake();
+		};
+	}
+} //namespace csp
@@ -0,0 +1,298 @@
+/*
+*	The Kent C++CSP Library
+*	Copyright (C) 2002-2007 Neil Brown
+*
+*	This library is free software; you can redistribute it and/or
+*	modify it under the terms of the GNU Lesser General Public
+*	License as published by the Free Software Foundation; either
+*	version 2.1 of the License, or (at your option) any later version.
+*
+*	This library is distributed in the hope that it will be useful,
+*	but WITHOUT ANY WARRANTY; without even the implied warranty of
+*	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+*	Lesser General Public License for more details.
+*
+*	You should have received a copy of the GNU Lesser General Public
+*	License along with this library; if not, write to the Free Software
+*	Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+/** @file instrumented_channel.h
+*	@brief Contains the instrumented versions of the channels
+*
+*	This file is \#included from cppcsp.h
+*/
+
+#ifndef INCLUDED_FROM_CPPCSP_H
+#error This file should only be included by csp.h, not individually
+#endif
+
+class InstrumentedChannelTest;
+
+namespace csp
+{
+	template <typename DATA_TYPE>
+	class InstrumentedOne2AnyChannel;
+
+	template <typename DATA_TYPE>
+	class InstrumentedAny2OneChannel;
+
+	template <typename DATA_TYPE>
+	class InstrumentedAny2AnyChannel;
+
+	template <typename DATA_TYPE>
+	class InstrumentedBufferedOne2AnyChannel;
+
+	template <typename DATA_TYPE>
+	class InstrumentedBufferedAny2OneChannel;
+
+	template <typename DATA_TYPE>
+	class InstrumentedBufferedAny2AnyChannel;
+
+	/**
+	*	A One2OneChannel that records statistics about its use.
+	*
+	*	Each instrumented channel is given a name when it is constructed, and records:
+	*	- the number of messages sent down the channel
+	*	- how many times the reader and the writer each had to block, waiting for the other
+	*	- how many times the channel's mutexes were claimed, and how much spinning that needed
+	*	- the most items that were held in the channel's buffer at once (for the buffered channels)
+	*	- the total time that processes spent blocked in the channel
+	*
+	*	Use statistics() to get a snapshot of one channel's statistics, or GetAllChannelStatistics()
+	*	to get them for every instrumented channel in the program, for example in a process that
+	*	periodically writes them to a log:
+	*	@code
+		InstrumentedOne2OneChannel<int> c("requests");
+		//...
+		std::list<ChannelStatistics> stats = GetAllChannelStatistics();
+		for (std::list<ChannelStatistics>::iterator it = stats.begin();it != stats.end();it++)
+		{
+			std::cout << it->name << ": " << it->messages << " messages, "
+				<< GetSeconds(it->blockedTime) << " seconds blocked" << std::endl;
+		}
+		@endcode
+	*
+	*	Apart from the statistics, the instrumented channels behave exactly the same as the normal channels.
+	*	They are slower though, because recording the statistics involves claiming another mutex (and reading
+	*	the clock whenever a process blocks), so they are intended for diagnosing performance problems rather than
+	*	for general use.  The normal channels are unaffected; none of the recording code is compiled into them.
+	*
+	*	There are instrumented versions of all the normal channel types: InstrumentedOne2OneChannel, InstrumentedOne2AnyChannel,
+	*	InstrumentedAny2OneChannel, InstrumentedAny2AnyChannel, InstrumentedBufferedOne2OneChannel, InstrumentedBufferedOne2AnyChannel,
+	*	InstrumentedBufferedAny2OneChannel and InstrumentedBufferedAny2AnyChannel.  The shared ends of these channels use a mutex
+	*	to share the end, and its claims are included in the statistics.  This includes InstrumentedAny2OneChannel, so it
+	*	is implemented slightly differently to Any2OneChannel.
+	*
+	*	@see ChannelStatistics
+	*/
+	template <typename DATA_TYPE>
+	class InstrumentedOne2OneChannel
+		:	public internal::_One2OneChannel<DATA_TYPE,internal::CountingMutex<internal::PureSpinMutex>,internal::ChannelStats>
+	{
+	protected:
+		//For the any2 and 2any channels:
+		InstrumentedOne2OneChannel()
+		{
+		}
+	public:
+		/**
+		*	Constructs the channel.
+		*
+		*	@param name The name that will appear in the channel's statistics.  It does not have to be unique.
+		*/
+		explicit InstrumentedOne2OneChannel(const std::string& name)
+		{
+			this->setName(name);
+		}
+
+		#ifdef CPPCSP_DOXYGEN
+		///Gets the reading end of the channel
+		AltChanin<DATA_TYPE> reader();
+
+		///Gets the writing end of the channel
+		AltChanout<DATA_TYPE> writer();
+		#endif
+
+		///Gets a snapshot of the channel's statistics
+		using internal::ChannelStats::statistics;
+
+		///Resets the channel's statistics to zero
+		using internal::ChannelStats::resetStatistics;
+
+		friend class csp::InstrumentedOne2AnyChannel<DATA_TYPE>;
+		friend class csp::InstrumentedAny2OneChannel<DATA_TYPE>;
+		friend class csp::InstrumentedAny2AnyChannel<DATA_TYPE>;
+
+		//For testing:
+		friend class ::InstrumentedChannelTest;
+	};
+
+	/**
+	*	A One2AnyChannel that records statistics about its use.  @see InstrumentedOne2OneChannel
+	*/
+	template <typename DATA_TYPE>
+	class InstrumentedOne2AnyChannel
+		:	public internal::One2AnyAdapter<InstrumentedOne2OneChannel<DATA_TYPE>,DATA_TYPE,internal::CountingMutex<internal::QueuedMutex> >
+	{
+	public:
+		explicit InstrumentedOne2AnyChannel(const std::string& name)
+		{
+			this->setName(name);
+			this->attachMutex(&this->readerMutex);
+		}
+
+		using internal::ChannelStats::statistics;
+		using internal::ChannelStats::resetStatistics;
+
+		//For testing:
+		friend class ::InstrumentedChannelTest;
+	};
+
+	/**
+	*	An Any2OneChannel that records statistics about its use.  @see InstrumentedOne2OneChannel
+	*/
+	template <typename DATA_TYPE>
+	class InstrumentedAny2OneChannel
+		:	public internal::Any2OneAdapter<InstrumentedOne2OneChannel<DATA_TYPE>,DATA_TYPE,internal::CountingMutex<internal::QueuedMutex> >
+	{
+	public:
+		explicit InstrumentedAny2OneChannel(const std::string& name)
+		{
+			this->setName(name);
+			this->attachMutex(&this->writerMutex);
+		}
+
+		using internal::ChannelStats::statistics;
+		using internal::ChannelStats::resetStatistics;
+
+		//For testing:
+		friend class ::InstrumentedChannelTest;
+	};
+
+	/**
+	*	An Any2AnyChannel that records statistics about its use.  @see InstrumentedOne2OneChannel
+	*/
+	template <typename DATA_TYPE>
+	class InstrumentedAny2AnyChannel
+		:	public internal::Any2AnyAdapter<InstrumentedOne2OneChannel<DATA_TYPE>,DATA_TYPE,internal::CountingMutex<internal::QueuedMutex> >
+	{
+	public:
+		explicit InstrumentedAny2AnyChannel(const std::string& name)
+		{
+			this->setName(name);
+			this->attachMutex(&this->writerMutex);
+			this->attachMutex(&this->readerMutex);
+		}
+
+		using internal::ChannelStats::statistics;
+		using internal::ChannelStats::resetStatistics;
+
+		//For testing:
+		friend class ::InstrumentedChannelTest;
+	};
+
+	/**
+	*	A BufferedOne2OneChannel that records statistics about its use.  @see InstrumentedOne2OneChannel
+	*/
+	template <typename DATA_TYPE>
+	class InstrumentedBufferedOne2OneChannel
+		:	public internal::_BufferedOne2OneChannel<DATA_TYPE,internal::CountingMutex<internal::PureSpinMutex>,internal::ChannelStats>
+	{
+	protected:
+		//For the any2 and 2any channels:
+		InstrumentedBufferedOne2OneChannel()
+		{
+		}
+	public:
+		/**
+		*	Constructs the channel.
+		*
+		*	@param name The name that will appear in the channel's statistics.  It does not have to be unique.
+		*	@param bufferFactory The factory for the channel's buffer
+		*/
+		InstrumentedBufferedOne2OneChannel(const std::string& name,const ChannelBufferFactory<DATA_TYPE>& bufferFactory)
+			:	internal::_BufferedOne2OneChannel<DATA_TYPE,internal::CountingMutex<internal::PureSpinMutex>,internal::ChannelStats>(bufferFactory)
+		{
+			this->setName(name);
+		}
+
+		using internal::ChannelStats::statistics;
+		using internal::ChannelStats::resetStatistics;
+
+		friend class csp::InstrumentedBufferedOne2AnyChannel<DATA_TYPE>;
+		friend class csp::InstrumentedBufferedAny2OneChannel<DATA_TYPE>;
+		friend class csp::InstrumentedBufferedAny2AnyChannel<DATA_TYPE>;
+
+		//For testing:
+		friend class ::InstrumentedChannelTest;
+	};
+
+	/**
+	*	A BufferedOne2AnyChannel that records statistics about its use.  @see InstrumentedOne2OneChannel
+	*/
+	template <typename DATA_TYPE>
+	class InstrumentedBufferedOne2AnyChannel
+		:	public internal::One2AnyAdapter<InstrumentedBufferedOne2OneChannel<DATA_TYPE>,DATA_TYPE,internal::CountingMutex<internal::QueuedMutex> >
+	{
+	public:
+		InstrumentedBufferedOne2AnyChannel(const std::string& name,const ChannelBufferFactory<DATA_TYPE>& bufferFactory)
+		{
+			this->buffer = bufferFactory.createBuffer();
+			this->setName(name);
+			this->attachMutex(&this->readerMutex);
+		}
+
+		using internal::ChannelStats::statistics;
+		using internal::ChannelStats::resetStatistics;
+
+		//For testing:
+		friend class ::InstrumentedChannelTest;
+	};
+
+	/**
+	*	A BufferedAny2OneChannel that records statistics about its use.  @see InstrumentedOne2OneChannel
+	*/
+	template <typename DATA_TYPE>
+	class InstrumentedBufferedAny2OneChannel
+		:	public internal::Any2OneAdapter<InstrumentedBufferedOne2OneChannel<DATA_TYPE>,DATA_TYPE,internal::CountingMutex<internal::QueuedMutex> >
+	{
+	public:
+		InstrumentedBufferedAny2OneChannel(const std::string& name,const ChannelBufferFactory<DATA_TYPE>& bufferFactory)
+		{
+			this->buffer = bufferFactory.createBuffer();
+			this->setName(name);
+			this->attachMutex(&this->writerMutex);
+		}
+
+		using internal::ChannelStats::statistics;
+		using internal::ChannelStats::resetStatistics;
+
+		//For testing:
+		friend class ::InstrumentedChannelTest;
+	};
+
+	/**
+	*	A BufferedAny2AnyChannel that records statistics about its use.  @see InstrumentedOne2OneChannel
+	*/
+	template <typename DATA_TYPE>
+	class InstrumentedBufferedAny2AnyChannel
+		:	public internal::Any2AnyAdapter<InstrumentedBufferedOne2OneChannel<DATA_TYPE>,DATA_TYPE,internal::CountingMutex<internal::QueuedMutex> >
+	{
+	public:
+		InstrumentedBufferedAny2AnyChannel(const std::string& name,const ChannelBufferFactory<DATA_TYPE>& bufferFactory)
+		{
+			this->buffer = bufferFactory.createBuffer();
+			this->setName(name);
+			this->attachMutex(&this->writerMutex);
+			this->attachMutex(&this->readerMutex);
+		}
+
+		using internal::ChannelStats::statistics;
+		using internal::ChannelStats::resetStatistics;
+
+		//For testing:
+		friend class ::InstrumentedChannelTest;
+	};
+
+} //namespace csp
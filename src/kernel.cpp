@@ -26,10 +26,17 @@ using namespace csp;
 using namespace csp::internal;
 using namespace std;
 
-std::list<internal::Process const *> Kernel::KernelData::blocks; 
+boost::array<internal::Process const *,32> Kernel::KernelData::blocks = {{NULL}};
+unsigned int Kernel::KernelData::blocksNext = 0;
 PureSpinMutex Kernel::KernelData::blocksMutex;
+std::vector<unsigned int> Kernel::KernelData::freeIndexes;
+unsigned int Kernel::KernelData::nextIndex = 0;
+PureSpinMutex Kernel::KernelData::indexesMutex;
 Kernel::KernelData* Kernel::KernelData::originalThreadKernelData = NULL;
 bool Kernel::KernelData::deadlocked = false;
+__CPPCSP_ALIGNED_USIGN32 QuiescentState::GlobalEpoch = 1;
+std::vector<QuiescentState*> QuiescentState::states;
+PureSpinMutex QuiescentState::statesMutex;
 
 template <>
 __CPPCSP_ALIGNED_USIGN32 _AtomicProcessQueue< MutexAndEvent<OSBlockingMutex,1> >::ThreadsRunning = 0;
@@ -134,10 +141,69 @@ namespace csp
 		
 			//delete the initial process:
 			delete kernel->data.initialProcess;
+			
+			#ifdef CPPCSP_LINUX
+				IoRing* const ring = kernel->data.ioRing;
+				kernel->data.ioRing = NULL;
+				delete ring;
+			#endif
+		}
+		
+	#ifdef CPPCSP_LINUX
+		IoRing* Kernel::ioRing()
+		{
+			if (data.ioRing == NULL)
+			{
+				data.ioRing = new IoRing(data.runQueue);
+			}
+			return data.ioRing;
 		}
+	#endif
 		
 		void ContextSwitch(Context* from, Context* to);
 		
+		void QuiescentState::add()
+		{
+			statesMutex.claim();
+				epoch = CurrentEpoch();
+				states.push_back(this);
+			statesMutex.release();
+		}
+		
+		void QuiescentState::remove()
+		{
+			statesMutex.claim();
+				states.erase(std::remove(states.begin(),states.end(),this),states.end());
+			statesMutex.release();
+		}
+		
+		usign32 QuiescentState::Advance()
+		{
+			usign32 ret = AtomicIncrement(&GlobalEpoch);
+			if (ret == 0)
+			{
+				//Zero means offline, so skip it:
+				ret = AtomicIncrement(&GlobalEpoch);
+			}
+			return ret;
+		}
+		
+		usign32 QuiescentState::Reached()
+		{
+			usign32 ret = CurrentEpoch();
+			statesMutex.claim();
+				for (unsigned int i = 0;i < states.size();i++)
+				{
+					const usign32 passed = AtomicGet(&(states[i]->epoch));
+					if (passed != 0 && false == After(passed,ret))
+					{
+						ret = passed;
+					}
+				}
+			statesMutex.release();
+			return ret;
+		}
+		
 		bool Kernel::ReSchedule(KernelData* data)
 		{					
 			ProcessPtr oldProcess = data->currentProcess;
@@ -145,6 +211,10 @@ namespace csp
 			Time t;
 			Time* pt = NULL;
 			
+			//The process that is blocking is not half-way through reading anything, so unless
+			//another of our processes holds a snapshot, this is a quiescent point:
+			data->quiescent.passed();
+			
 			try
 			{
 				do
@@ -157,9 +227,45 @@ namespace csp
 						t = data->timeoutQueue.soonestTimeout();
 							pt = &t;
 					}
+					
+				#ifdef CPPCSP_LINUX
+					//While our processes have file I/O in flight, we reap its completions each time round,
+					//and wait on the ring rather than the run queue when we have nothing to run:
+					if (data->ioRing != NULL && data->ioRing->inFlight() > 0)
+					{
+						const bool idle = data->runQueue.empty();
+						if (idle && data->quiescent.snapshots == 0)
+						{
+							data->quiescent.goOffline();
+							data->ioRing->complete(true,pt);
+							data->quiescent.goOnline();
+						}
+						else
+						{
+							data->ioRing->complete(idle,pt);
+						}
+						
+						if (data->runQueue.empty())
+						{
+							//Nothing completed (or we were woken needlessly); check the timeouts and the ring again:
+							data->currentProcess = NullProcessPtr;
+							continue;
+						}
+					}
+				#endif
 
 					//Get the next process to run:
-					data->currentProcess = data->runQueue.popHead(pt);
+					if (data->quiescent.snapshots == 0 && data->runQueue.empty())
+					{
+						//We will wait, and no-one needs to wait for us in the mean-time:
+						data->quiescent.goOffline();
+						data->currentProcess = data->runQueue.popHead(pt);
+						data->quiescent.goOnline();
+					}
+					else
+					{
+						data->currentProcess = data->runQueue.popHead(pt);
+					}
 				}
 				while (data->currentProcess == NullProcessPtr);
 					
@@ -193,7 +299,7 @@ namespace csp
 					if (KernelData::deadlocked)
 					{
 						//No need to claim the mutex -- we must be the only process running!
-						throw DeadlockError(KernelData::blocks);
+						throw DeadlockError(KernelData::RecentBlocks());
 					}
 				}
 			}
@@ -235,6 +341,14 @@ namespace csp
 			{
 				data->runQueue.pushChain(head,tail);
 			}
+			
+		#ifdef CPPCSP_LINUX
+			//The kernel may be waiting on its ring rather than its run queue:
+			if (data->ioRing != NULL)
+			{
+				data->ioRing->wake();
+			}
+		#endif
 			return true;
 		}
 	}
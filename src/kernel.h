@@ -300,6 +300,90 @@ namespace csp
 			}			
 		};
 		
+		/**
+		*	The quiescent state of a kernel, for reclaiming memory that processes may still be reading (see SharedValue).
+		*
+		*	Processes take snapshots (pointers to shared data) without any atomic operations, by counting them in their kernel's
+		*	snapshots.  Whenever the kernel reschedules while it has no snapshots, none of its processes can be reading
+		*	anything that was retired before then, so it records the global epoch it has passed.  Data retired at epoch E
+		*	(see Advance()) can be freed once every kernel has passed E (see Reached()).
+		*
+		*	A kernel that is waiting for a process to run, with no snapshots, is offline (epoch is zero) and does not hold
+		*	anything up.  A kernel that never reschedules (or keeps a snapshot for ever) holds up all reclamation.
+		*/
+		class QuiescentState : public boost::noncopyable
+		{
+		private:
+			///The epoch the kernel has passed, or zero when it is offline
+			__CPPCSP_ALIGNED_USIGN32 epoch;
+
+			static __CPPCSP_ALIGNED_USIGN32 GlobalEpoch;
+			static std::vector<QuiescentState*> states;
+			static PureSpinMutex statesMutex;
+
+			///The current global epoch.  It is never zero (which means offline)
+			inline static usign32 CurrentEpoch()
+			{
+				usign32 ret;
+				while ((ret = GlobalEpoch) == 0)
+				{
+					//Only while it wraps round:
+				}
+				return ret;
+			}
+		public:
+			///The number of snapshots held by processes in the kernel.  Only used by the kernel's own thread
+			usign32 snapshots;
+
+			///True if epoch a has passed epoch b (allowing for wrap-around)
+			inline static bool After(usign32 a,usign32 b)
+			{
+				return static_cast<sign32>(a - b) >= 0;
+			}
+
+			inline QuiescentState()
+				:	epoch(0),snapshots(0)
+			{
+			}
+
+			///Called by the kernel's thread at a point where it may be quiescent
+			inline void passed()
+			{
+				if (snapshots == 0)
+				{
+					//Our reads of anything retired must be finished before anyone sees this:
+					CompilerBarrier();
+					epoch = CurrentEpoch();
+				}
+			}
+
+			///Called by the kernel's thread before waiting for a process, with no snapshots
+			inline void goOffline()
+			{
+				CompilerBarrier();
+				epoch = 0;
+			}
+
+			///Called by the kernel's thread once it has a process to run again
+			inline void goOnline()
+			{
+				//Either a writer sees that we are online, or we see what it published:
+				AtomicSwap(&epoch,CurrentEpoch());
+			}
+
+			///Adds the kernel to those that must pass an epoch.  Called from the kernel's constructor
+			void add();
+
+			///Removes the kernel.  Called from the kernel's destructor
+			void remove();
+
+			///Starts a new epoch (after retiring some data), and returns it
+			static usign32 Advance();
+
+			///Gets the latest epoch that every kernel has passed
+			static usign32 Reached();
+		};
+
 	class Kernel : public boost::noncopyable
 	{
 	private:
@@ -317,27 +401,73 @@ namespace csp
 			TimeoutQueue timeoutQueue;
 			
 			ThreadId threadId;
+			
+			//A small index for the kernel, unique among the kernels that currently exist.  The indexes of
+			//destroyed kernels are reused, so that per-kernel slots (see KernelSlots) stay dense:
+			unsigned int index;
+			static std::vector<unsigned int> freeIndexes;
+			static unsigned int nextIndex;
+			static PureSpinMutex indexesMutex;
+			inline static unsigned int AllocateIndex()
+			{
+				unsigned int ret;
+				indexesMutex.claim();
+					if (freeIndexes.empty())
+					{
+						ret = nextIndex++;
+					}
+					else
+					{
+						ret = freeIndexes.back();
+						freeIndexes.pop_back();
+					}
+				indexesMutex.release();
+				return ret;
+			}
+			inline static void ReleaseIndex(unsigned int index)
+			{
+				indexesMutex.claim();
+					freeIndexes.push_back(index);
+				indexesMutex.release();
+			}
 
-			//a rolling list of the previous blocks, ready for deadlocks		
-			static std::list<internal::Process const *> blocks; 
+			//a rolling record of the previous blocks, ready for deadlocks.  It is a fixed-size ring, so that
+			//blocking never allocates memory:
+			static boost::array<internal::Process const *,32> blocks; 
+			//The index of the oldest block in the ring, which will be overwritten by the next block:
+			static unsigned int blocksNext;
 			static PureSpinMutex blocksMutex;
 			inline static bool RecordBlock(KernelData* data)
 			{
 				blocksMutex.claim();
-					blocks.push_back(data->currentProcess);
-					if (blocks.size() > 32)
-						blocks.pop_front();
+					blocks[blocksNext] = data->currentProcess;
+					blocksNext = (blocksNext + 1) % blocks.size();
 				blocksMutex.release();
 				return true;
 			}
+			//The recorded blocks, oldest first (blocksMutex must be held, unless everything has deadlocked):
+			inline static std::list<internal::Process const *> RecentBlocks()
+			{
+				std::list<internal::Process const *> ret;
+				for (unsigned int i = 0;i < blocks.size();i++)
+				{
+					internal::Process const * const block = blocks[(blocksNext + i) % blocks.size()];
+					if (block != NULL)
+					{
+						ret.push_back(block);
+					}
+				}
+				return ret;
+			}
 			inline static void DumpBlocks(std::ostream& out)
 			{
 				blocksMutex.claim();
 					out << "Block list (oldest first):" << std::endl;
+					const std::list<internal::Process const *> recent(RecentBlocks());
 					int i = 0;
-					for (std::list<internal::Process const *>::const_iterator it = blocks.begin();it != blocks.end();it++)
+					for (std::list<internal::Process const *>::const_iterator it = recent.begin();it != recent.end();it++)
 					{
-						out << i << ": " << *it << std::endl;
+						out << i++ << ": " << *it << std::endl;
 					}
 				blocksMutex.release();
 			}
@@ -350,19 +480,37 @@ namespace csp
 			
 			std::list< std::pair<ProcessPtr,ProcessDelInfo> > stacksToDelete;
 			
+			QuiescentState quiescent;
+			
+		#ifdef CPPCSP_LINUX
+			//The ring for our processes' file I/O, created when one of them first needs it:
+			IoRing* ioRing;
+		#endif
+			
 			friend class Kernel;			
 			friend class TestInfo;
 			friend void csp::Start_CPPCSP();			
 			
 			inline KernelData()
 				:	initialProcess(NullProcessPtr),
-					currentProcess(NullProcessPtr)								
+					currentProcess(NullProcessPtr)
+				#ifdef CPPCSP_LINUX
+					,ioRing(NULL)
+				#endif
 			{
 			}
 			
 			void init(ThreadId _threadId)
 			{
 				threadId = _threadId;
+				index = AllocateIndex();
+				quiescent.add();
+			}
+			
+			inline ~KernelData()
+			{
+				quiescent.remove();
+				ReleaseIndex(index);
 			}
 					
 		} data;
@@ -386,6 +534,15 @@ namespace csp
 	
 	inline internal::ProcessPtr currentProcess() { return data.currentProcess; }
 	
+	inline unsigned int index() const { return data.index; }
+	
+	inline QuiescentState* quiescentState() { return &(data.quiescent); }
+	
+#ifdef CPPCSP_LINUX
+	//Creates the ring on first use:
+	IoRing* ioRing();
+#endif
+	
 	static bool ReSchedule(KernelData*);
 	static bool AddProcess(KernelData*,internal::ProcessPtr,internal::ProcessPtr);
 	//Initialises a new thread, to be used just after its creation/use in C++CSP	
@@ -133,8 +133,10 @@ namespace csp
 			*	be released and let this call return once it has claimed the mutex.
 			*						
 			*	Calling claim() twice without calling release() will result in undefined behaviour.
+			*
+			*	@return True if the process had to queue for the mutex, false if it was unclaimed
 			*/
-			inline void claim(Key* key)
+			inline bool claim(Key* key)
 			{
 				key->process = currentProcess();
 				key->link = NULL;
@@ -144,6 +146,7 @@ namespace csp
 				if (oldTail == NULL)
 				{
 					//We have the lock now
+					return false;
 				}
 				else
 				{
@@ -151,6 +154,7 @@ namespace csp
 					
 					reschedule();
 					//Now we have the lock
+					return true;
 				}
 			}
 			
@@ -1130,6 +1134,15 @@ namespace csp
 			*/
 			inline ProcessPtr popHead(csp::Time* timeout = NULL);
 			
+			/**
+			*	Checks whether the queue is empty, without claiming the mutex.  Only the queue's owner (who is the only
+			*	one that pops processes) can rely on the answer: if the queue is not empty, popHead() will not block.
+			*/
+			inline bool empty() const
+			{
+				return head == NullProcessPtr;
+			}
+			
 			/**
 			*	Pushes a single process onto the tail of the queue
 			*/
@@ -1139,7 +1152,25 @@ namespace csp
 			*	Pushes a pre-built chain of processes onto the tail of the queue
 			*/
 			inline void pushChain(ProcessPtr head,ProcessPtr tail);
-			
+
+			/**
+			*	Counts a thread outside the kernels as running while it waits for an external event
+			*	on behalf of a blocked process (that it will then free).
+			*
+			*	Without this, a process waiting on something outside of C++CSP2 (such as another OS process)
+			*	could leave every kernel-thread idle, and the run-time would wrongly report deadlock.
+			*	Each call must be matched by a call to EndExternalWait(), made after the process is freed.
+			*/
+			static inline void BeginExternalWait()
+			{
+				AtomicIncrement(&ThreadsRunning);
+			}
+
+			static inline void EndExternalWait()
+			{
+				AtomicDecrement(&ThreadsRunning);
+			}
+
 			//TODO later remove this
 			static volatile usign32 waitFP_calls;
 		};				
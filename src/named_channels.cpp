@@ -0,0 +1,544 @@
+/*
+*	The Kent C++CSP Library
+*	Copyright (C) 2002-2007 Neil Brown
+*
+*	This library is free software; you can redistribute it and/or
+*	modify it under the terms of the GNU Lesser General Public
+*	License as published by the Free Software Foundation; either
+*	version 2.1 of the License, or (at your option) any later version.
+*
+*	This library is distributed in the hope that it will be useful,
+*	but WITHOUT ANY WARRANTY; without even the implied warranty of
+*	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+*	Lesser General Public License for more details.
+*
+*	You should have received a copy of the GNU Lesser General Public
+*	License along with this library; if not, write to the Free Software
+*	Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#include "cppcsp.h"
+
+#ifdef CPPCSP_LINUX
+
+#include <set>
+#include <string.h>
+
+using namespace csp;
+using namespace csp::internal;
+using namespace std;
+
+/*
+*	The name server talks to each node over a NetChannel<std::string>, one request and one reply at a time:
+*
+*		"register <port> <name>"	-> "ok", or "taken"
+*		"unregister <name>"			-> "ok", or "unknown"
+*		"resolve <name>"			-> "ok <port> <address>", or "unknown"
+*
+*	A writer connects to the node that reads the channel and sends the name as a NetFrame.  The node replies with the
+*	four-byte bufferSize of the channel (or closes the connection if it has no such channel), after which the writer
+*	sends the values as NetFrames and the node sends back one byte for each value that the reader has taken.
+*/
+
+namespace
+{
+	//The processes that serve the name service do little more than channel communications:
+	const unsigned NameProcessStackSize = 65536;
+
+	///Formats an address as text
+	class AddressFormatter : public boost::static_visitor<string>
+	{
+	public:
+		string operator()(const IPv4Address& address) const
+		{
+			char text[INET_ADDRSTRLEN];
+			return (NULL == inet_ntop(AF_INET,&(address[0]),text,sizeof(text))) ? string() : string(text);
+		}
+
+		string operator()(const IPv6Address& address) const
+		{
+			char text[INET6_ADDRSTRLEN];
+			return (NULL == inet_ntop(AF_INET6,&(address[0]),text,sizeof(text))) ? string() : string(text);
+		}
+	};
+
+	///Parses an address formatted by AddressFormatter, returning false if it is not valid
+	bool ParseAddress(const string& text,IPAddress* address)
+	{
+		IPv4Address v4;
+		IPv6Address v6;
+		if (1 == inet_pton(AF_INET,text.c_str(),&(v4[0])))
+		{
+			*address = v4;
+			return true;
+		}
+		else if (1 == inet_pton(AF_INET6,text.c_str(),&(v6[0])))
+		{
+			*address = v6;
+			return true;
+		}
+		return false;
+	}
+
+	///Splits the first word off text, returning it and leaving the rest in text
+	string FirstWord(string* text)
+	{
+		const string::size_type space = text->find(' ');
+		const string word = text->substr(0,space);
+		text->erase(0,space == string::npos ? space : space + 1);
+		return word;
+	}
+}
+
+namespace csp
+{
+	namespace internal
+	{
+		/**@internal
+		*	The state of a ChannelNameServer, shared by it and the processes of the name server.  The names are only
+		*	used by those processes, which all run in the network thread, so they need no mutex.
+		*/
+		class NameServerState : public boost::noncopyable
+		{
+		public:
+			Mobile<TCPSocketAccepterChannel> accepter;
+			map<string,CPPCSPAddress> names;
+		private:
+			__CPPCSP_ALIGNED_USIGN32 references;
+		public:
+			inline explicit NameServerState(const Mobile<TCPSocketAccepterChannel>& _accepter)
+				:	accepter(_accepter),
+					//The ChannelNameServer and the NameServerProcess:
+					references(2)
+			{
+			}
+
+			inline void addReference()
+			{
+				AtomicIncrement(&references);
+			}
+
+			inline void release()
+			{
+				if (0 == AtomicDecrement(&references))
+				{
+					delete this;
+				}
+			}
+		};
+	}
+}
+
+namespace
+{
+	/**
+	*	Serves the requests of one node, until it closes; the names that it registered are then removed.
+	*/
+	class NameServerSession : public CSProcess
+	{
+	private:
+		NameServerState* const state;
+		Mobile<TCPSocketChannel> socket;
+		///The names registered by this node
+		set<string> owned;
+		///The address of the node, as we see it
+		IPAddress host;
+
+		string handle(string request)
+		{
+			const string command = FirstWord(&request);
+			if (command == "register")
+			{
+				const string port = FirstWord(&request);
+				usign16 number;
+				try
+				{
+					number = boost::lexical_cast<usign16>(port);
+				}
+				catch (boost::bad_lexical_cast&)
+				{
+					return "error";
+				}
+
+				if (false == state->names.insert(make_pair(request,CPPCSPAddress(host,number))).second)
+				{
+					return "taken";
+				}
+				owned.insert(request);
+				return "ok";
+			}
+			else if (command == "unregister")
+			{
+				if (0 == owned.erase(request))
+				{
+					return "unknown";
+				}
+				state->names.erase(request);
+				return "ok";
+			}
+			else if (command == "resolve")
+			{
+				map<string,CPPCSPAddress>::const_iterator it = state->names.find(request);
+				if (it == state->names.end())
+				{
+					return "unknown";
+				}
+				return "ok " + boost::lexical_cast<string>(it->second.second) + " " + boost::apply_visitor(AddressFormatter(),it->second.first);
+			}
+			return "error";
+		}
+	protected:
+		void run()
+		{
+			host = socket->remoteAddress().first;
+
+			{
+				NetChannel<string> chan(socket,16);
+				string request;
+				try
+				{
+					while (true)
+					{
+						chan.reader() >> request;
+						chan.writer() << handle(request);
+					}
+				}
+				catch (PoisonException&)
+				{
+				}
+			}
+
+			for (set<string>::const_iterator it = owned.begin();it != owned.end();it++)
+			{
+				state->names.erase(*it);
+			}
+			state->release();
+		}
+	public:
+		inline NameServerSession(NameServerState* _state,const Mobile<TCPSocketChannel>& _socket)
+			:	CSProcess(NameProcessStackSize),state(_state),socket(_socket)
+		{
+		}
+	};
+
+	/**
+	*	Starts a NameServerSession for each node that connects, until the ChannelNameServer is destroyed
+	*/
+	class NameServerProcess : public CSProcess
+	{
+	private:
+		NameServerState* const state;
+	protected:
+		void run()
+		{
+			AltChanin< Mobile<TCPSocketChannel> > in = state->accepter->reader();
+			try
+			{
+				while (true)
+				{
+					Mobile<TCPSocketChannel> socket;
+					in >> socket;
+					state->addReference();
+					NetworkHandler::Fork(new NameServerSession(state,socket));
+				}
+			}
+			catch (PoisonException&)
+			{
+			}
+
+			state->release();
+		}
+	public:
+		inline explicit NameServerProcess(NameServerState* _state)
+			:	CSProcess(NameProcessStackSize),state(_state)
+		{
+		}
+	};
+
+	/**
+	*	Reads the name that a writer sends when it connects to a node, and passes the connection to that named channel
+	*/
+	class NodeHandshake : public CSProcess
+	{
+	private:
+		ChannelNodeState* const state;
+		Mobile<TCPSocketChannel> socket;
+		string name;
+		bool named;
+	protected:
+		void run()
+		{
+			vector<unsigned char> data;
+			NetFrameParser parser;
+			try
+			{
+				while (false == named)
+				{
+					socket->reader() >> data;
+					if (false == parser.parse(data,*this))
+					{
+						break;
+					}
+				}
+			}
+			catch (PoisonException&)
+			{
+			}
+
+			if (named)
+			{
+				NamedEndpoint* endpoint = state->find(name);
+				if (endpoint != NULL)
+				{
+					endpoint->connect(socket);
+					endpoint->release();
+				}
+			}
+
+			//Closes the connection if it was not passed on, which tells the writer that there is no such channel:
+			socket.blank();
+			state->release();
+		}
+	public:
+		inline NodeHandshake(ChannelNodeState* _state,const Mobile<TCPSocketChannel>& _socket)
+			:	CSProcess(NameProcessStackSize),state(_state),socket(_socket),named(false)
+		{
+		}
+
+		bool frame(const unsigned char* data,usign32 size)
+		{
+			name.assign(reinterpret_cast<const char*>(data),size);
+			named = true;
+			//Nothing more is sent until we reply:
+			return false;
+		}
+
+		inline bool marker(usign32)
+		{
+			return false;
+		}
+	};
+
+	/**
+	*	Starts a NodeHandshake for each writer that connects to a node, until the ChannelNode is destroyed
+	*/
+	class NodeAccepter : public CSProcess
+	{
+	private:
+		ChannelNodeState* const state;
+	protected:
+		void run()
+		{
+			AltChanin< Mobile<TCPSocketChannel> > in = state->accepter->reader();
+			try
+			{
+				while (true)
+				{
+					Mobile<TCPSocketChannel> socket;
+					in >> socket;
+					state->addReference();
+					NetworkHandler::Fork(new NodeHandshake(state,socket));
+				}
+			}
+			catch (PoisonException&)
+			{
+			}
+
+			state->release();
+		}
+	public:
+		inline explicit NodeAccepter(ChannelNodeState* _state)
+			:	CSProcess(NameProcessStackSize),state(_state)
+		{
+		}
+	};
+}
+
+ChannelNodeState::ChannelNodeState(const Mobile<TCPSocketChannel>& nameServerSocket,const Mobile<TCPSocketAccepterChannel>& _accepter)
+	:	nameServer(nameServerSocket,1),requestLock(1),
+		//The ChannelNode and the NodeAccepter:
+		references(2),
+		accepter(_accepter),port(accepter->localAddress().second)
+{
+}
+
+void ChannelNodeState::release()
+{
+	if (0 == AtomicDecrement(&references))
+	{
+		delete this;
+	}
+}
+
+string ChannelNodeState::request(const string& text)
+{
+	string reply;
+	requestLock.acquire();
+	try
+	{
+		nameServer.writer() << text;
+		nameServer.reader() >> reply;
+	}
+	catch (PoisonException&)
+	{
+		//The name server has gone
+		reply.clear();
+	}
+	requestLock.release();
+	return reply;
+}
+
+bool ChannelNodeState::add(const string& name,NamedEndpoint* endpoint)
+{
+	mutex.claim();
+		const bool added = endpoints.insert(make_pair(name,endpoint)).second;
+	mutex.release();
+
+	if (added && request("register " + boost::lexical_cast<string>(port) + " " + name) == "ok")
+	{
+		return true;
+	}
+
+	if (added)
+	{
+		mutex.claim();
+			endpoints.erase(name);
+		mutex.release();
+	}
+	return false;
+}
+
+void ChannelNodeState::remove(const string& name)
+{
+	request("unregister " + name);
+
+	mutex.claim();
+		endpoints.erase(name);
+	mutex.release();
+}
+
+NamedEndpoint* ChannelNodeState::find(const string& name)
+{
+	NamedEndpoint* endpoint = NULL;
+	mutex.claim();
+		map<string,NamedEndpoint*>::iterator it = endpoints.find(name);
+		if (it != endpoints.end())
+		{
+			endpoint = it->second;
+			endpoint->addReference();
+		}
+	mutex.release();
+	return endpoint;
+}
+
+Mobile<TCPSocketChannel> ChannelNodeState::connect(const string& name,usign32* bufferSize)
+{
+	string reply = request("resolve " + name);
+	IPAddress address;
+	usign16 port;
+
+	try
+	{
+		if (FirstWord(&reply) != "ok")
+		{
+			return Mobile<TCPSocketChannel>();
+		}
+		port = boost::lexical_cast<usign16>(FirstWord(&reply));
+		if (false == ParseAddress(reply,&address))
+		{
+			return Mobile<TCPSocketChannel>();
+		}
+	}
+	catch (boost::bad_lexical_cast&)
+	{
+		return Mobile<TCPSocketChannel>();
+	}
+
+	Mobile<TCPSocketChannel> socket = ConnectTCPSocket(CPPCSPAddress(address,port),65536);
+	if (!socket)
+	{
+		return socket;
+	}
+
+	try
+	{
+		//Send the name, then wait for the bufferSize:
+		Mobile< vector<unsigned char> > hello(new vector<unsigned char>(NetFrame::HeaderSize));
+		NetFrame::WriteLength(&((*hello)[0]),static_cast<usign32>(name.size()));
+		hello->insert(hello->end(),name.begin(),name.end());
+		socket->writer() << hello;
+
+		vector<unsigned char> header,data;
+		while (header.size() < NetFrame::HeaderSize)
+		{
+			socket->reader() >> data;
+			header.insert(header.end(),data.begin(),data.end());
+		}
+		*bufferSize = NetFrame::ReadLength(&(header[0]));
+	}
+	catch (PoisonException&)
+	{
+		//The node has no such channel (it may have just been removed):
+		socket.blank();
+	}
+	return socket;
+}
+
+namespace csp
+{
+	ChannelNode::~ChannelNode()
+	{
+		//Stops the NodeAccepter:
+		state->accepter->reader().poison();
+		state->release();
+	}
+
+	ChannelNameServer::~ChannelNameServer()
+	{
+		//Stops the NameServerProcess:
+		state->accepter->reader().poison();
+		state->release();
+	}
+
+	CPPCSPAddress ChannelNameServer::address() const
+	{
+		return state->accepter->localAddress();
+	}
+
+	Mobile<ChannelNameServer> OpenChannelNameServer(const usign16 port,const NetworkInterface& netInterface)
+	{
+		Mobile<TCPSocketAccepterChannel> accepter = OpenTCPSocketAccepter(port,netInterface,4096);
+		if (!accepter)
+		{
+			return Mobile<ChannelNameServer>();
+		}
+
+		NameServerState* state = new NameServerState(accepter);
+		Mobile<ChannelNameServer> server(new ChannelNameServer(state));
+		NetworkHandler::Fork(new NameServerProcess(state));
+		return server;
+	}
+
+	Mobile<ChannelNode> JoinChannelNameServer(const CPPCSPAddress& nameServer,const NetworkInterface& netInterface)
+	{
+		Mobile<TCPSocketChannel> socket = ConnectTCPSocket(nameServer,4096);
+		if (!socket)
+		{
+			return Mobile<ChannelNode>();
+		}
+
+		//Writers connect to a port of our own:
+		Mobile<TCPSocketAccepterChannel> accepter = OpenTCPSocketAccepter(0,netInterface,65536);
+		if (!accepter)
+		{
+			return Mobile<ChannelNode>();
+		}
+
+		ChannelNodeState* state = new ChannelNodeState(socket,accepter);
+		Mobile<ChannelNode> node(new ChannelNode(state));
+		NetworkHandler::Fork(new NodeAccepter(state));
+		return node;
+	}
+} //namespace csp
+
+#endif //CPPCSP_LINUX
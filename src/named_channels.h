@@ -0,0 +1,723 @@
+/*
+*	The Kent C++CSP Library
+*	Copyright (C) 2002-2007 Neil Brown
+*
+*	This library is free software; you can redistribute it and/or
+*	modify it under the terms of the GNU Lesser General Public
+*	License as published by the Free Software Foundation; either
+*	version 2.1 of the License, or (at your option) any later version.
+*
+*	This library is distributed in the hope that it will be useful,
+*	but WITHOUT ANY WARRANTY; without even the implied warranty of
+*	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+*	Lesser General Public License for more details.
+*
+*	You should have received a copy of the GNU Lesser General Public
+*	License along with this library; if not, write to the Free Software
+*	Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+/** @file named_channels.h
+*	@brief Contains the channel name server, ChannelNode and the named channels
+*
+*	This file is \#included from cppcsp.h on Linux only
+*/
+
+#ifndef INCLUDED_FROM_CPPCSP_H
+#error This file should only be included by csp.h, not individually
+#endif
+
+namespace csp
+{
+	class ChannelNameServer;
+	class ChannelNode;
+
+	template <typename DATA_TYPE,typename SERIALIZER>
+	class NamedChannelReader;
+
+	template <typename DATA_TYPE,typename SERIALIZER>
+	class NamedChannelWriter;
+
+	namespace internal
+	{
+		class NameServerState;
+
+		/**@internal
+		*	The reading end of a named channel, as its ChannelNode sees it: the node passes it each connection that a
+		*	writer makes to its name.  It is shared by the NamedChannelReader and the processes serving its connections,
+		*	and deleted once they have all finished with it.
+		*/
+		class NamedEndpoint : public boost::noncopyable
+		{
+		private:
+			__CPPCSP_ALIGNED_USIGN32 references;
+		public:
+			///The number of values that each writer may send before the reader has taken them
+			const usign32 bufferSize;
+
+			inline explicit NamedEndpoint(usign32 _bufferSize)
+				:	references(1),bufferSize(_bufferSize)
+			{
+			}
+
+			virtual ~NamedEndpoint()
+			{
+			}
+
+			inline void addReference()
+			{
+				AtomicIncrement(&references);
+			}
+
+			inline void release()
+			{
+				if (0 == AtomicDecrement(&references))
+				{
+					delete this;
+				}
+			}
+
+			/**@internal
+			*	Starts serving a connection from a writer (which has sent the name).  It is called in the network thread.
+			*/
+			virtual void connect(const Mobile<TCPSocketChannel>& socket) = 0;
+		};
+
+		/**@internal
+		*	The state of a ChannelNode: its connection to the name server, the socket that writers connect to, and the
+		*	named channels that it is reading from.  It is shared by the ChannelNode, its named channels and the processes
+		*	that accept connections for them.
+		*/
+		class ChannelNodeState : public boost::noncopyable
+		{
+		private:
+			NetChannel<std::string> nameServer;
+			///Lets one process at a time make a request of the name server
+			Semaphore requestLock;
+			std::map<std::string,NamedEndpoint*> endpoints;
+			///Protects endpoints, which the network thread reads
+			PureSpinMutex mutex;
+			__CPPCSP_ALIGNED_USIGN32 references;
+
+			///Sends a request to the name server and returns its reply, or an empty string if it cannot be reached
+			std::string request(const std::string& text);
+		public:
+			///The socket that writers connect to
+			Mobile<TCPSocketAccepterChannel> accepter;
+			///The port of accepter
+			const usign16 port;
+
+			ChannelNodeState(const Mobile<TCPSocketChannel>& nameServerSocket,const Mobile<TCPSocketAccepterChannel>& _accepter);
+
+			inline void addReference()
+			{
+				AtomicIncrement(&references);
+			}
+
+			void release();
+
+			/**@internal
+			*	Registers a named channel with the name server, returning false if the name is already taken
+			*/
+			bool add(const std::string& name,NamedEndpoint* endpoint);
+
+			/**@internal
+			*	Removes a named channel, which must have been added
+			*/
+			void remove(const std::string& name);
+
+			/**@internal
+			*	Gets the named channel that is read on this node, with a reference added for the caller, or NULL if there is none
+			*/
+			NamedEndpoint* find(const std::string& name);
+
+			/**@internal
+			*	Looks up a named channel and connects to it, returning the connected socket (or a blank mobile if there is
+			*	no such channel, or it cannot be reached) and the reader's bufferSize.
+			*/
+			Mobile<TCPSocketChannel> connect(const std::string& name,usign32* bufferSize);
+		};
+
+		template <typename DATA_TYPE,typename SERIALIZER>
+		class NamedReceiver;
+
+		/**@internal
+		*	The reading end of a named channel, into which the NamedReceiver for each writer sends the values.
+		*/
+		template <typename DATA_TYPE,typename SERIALIZER>
+		class NamedReaderEndpoint : public NamedEndpoint
+		{
+		private:
+			///The sockets of the connected writers, which are shut down when the reader is closed
+			std::list<TCPSocketChannel*> sockets;
+			PureSpinMutex mutex;
+			bool closed;
+		public:
+			Any2OneChannel<DATA_TYPE> channel;
+
+			inline explicit NamedReaderEndpoint(usign32 _bufferSize)
+				:	NamedEndpoint(_bufferSize),closed(false)
+			{
+			}
+
+			void connect(const Mobile<TCPSocketChannel>& socket)
+			{
+				//For the NamedReceiver:
+				addReference();
+				NetworkHandler::Fork(new NamedReceiver<DATA_TYPE,SERIALIZER>(this,socket));
+			}
+
+			///Adds the socket of a writer, returning false if the reader has already closed
+			bool attach(TCPSocketChannel* socket)
+			{
+				mutex.claim();
+					const bool ret = (false == closed);
+					if (ret)
+					{
+						sockets.push_back(socket);
+					}
+				mutex.release();
+				return ret;
+			}
+
+			///Removes the socket of a writer, before it is destroyed
+			void detach(TCPSocketChannel* socket)
+			{
+				mutex.claim();
+					sockets.remove(socket);
+				mutex.release();
+			}
+
+			///Poisons the channel, and stops reading from the writers
+			void close()
+			{
+				channel.reader().poison();
+				mutex.claim();
+					closed = true;
+					for (std::list<TCPSocketChannel*>::iterator it = sockets.begin();it != sockets.end();it++)
+					{
+						(*it)->reader().poison();
+					}
+				mutex.release();
+			}
+		};
+
+		/**@internal
+		*	Serves one writer's connection to a named channel: it decodes the values and sends them down the channel, then
+		*	acknowledges each one once the reader has taken it.  The writer only sends as many values ahead as the reader's
+		*	bufferSize (or one, which it waits for, for an unbuffered channel), so that it cannot run further ahead than
+		*	the channel would allow.
+		*/
+		template <typename DATA_TYPE,typename SERIALIZER>
+		class NamedReceiver : public CSProcess
+		{
+		private:
+			NamedReaderEndpoint<DATA_TYPE,SERIALIZER>* const endpoint;
+			Mobile<TCPSocketChannel> socket;
+			Chanout<DATA_TYPE> out;
+			Chanout< Mobile< std::vector<unsigned char> > > acks;
+			DATA_TYPE value;
+			///The number of values taken by the reader that have yet to be acknowledged
+			usign32 taken;
+
+			///Sends one byte for each value taken
+			void acknowledge()
+			{
+				if (taken > 0)
+				{
+					acks << Mobile< std::vector<unsigned char> >(new std::vector<unsigned char>(taken));
+					taken = 0;
+				}
+			}
+		protected:
+			void run()
+			{
+				if (endpoint->attach(socket.get()))
+				{
+					AltChanin< std::vector<unsigned char> > in = socket->reader();
+					std::vector<unsigned char> data;
+					NetFrameParser parser;
+
+					try
+					{
+						//Accept the writer, telling it how far ahead it may send:
+						Mobile< std::vector<unsigned char> > reply(new std::vector<unsigned char>(NetFrame::HeaderSize));
+						NetFrame::WriteLength(&((*reply)[0]),endpoint->bufferSize);
+						acks << reply;
+
+						while (true)
+						{
+							in >> data;
+							if (false == parser.parse(data,*this))
+							{
+								break;
+							}
+							acknowledge();
+						}
+					}
+					catch (PoisonException&)
+					{
+						//The reader (or the connection) was closed
+					}
+
+					endpoint->detach(socket.get());
+				}
+
+				//Closing the connection tells the writer that the channel has gone:
+				socket.blank();
+				endpoint->release();
+			}
+		public:
+			inline NamedReceiver(NamedReaderEndpoint<DATA_TYPE,SERIALIZER>* _endpoint,const Mobile<TCPSocketChannel>& _socket)
+				:	endpoint(_endpoint),socket(_socket),out(_endpoint->channel.writer()),acks(socket->writer()),taken(0)
+			{
+			}
+
+			///Decodes one value and sends it to the reader.  Returns false if the frame is not valid
+			bool frame(const unsigned char* data,usign32 size)
+			{
+				if (false == SERIALIZER::Read(data,size,&value))
+				{
+					return false;
+				}
+				out << value;
+
+				//An unbuffered writer waits for each acknowledgement, but a buffered one can take them in batches:
+				if (++taken >= std::max<usign32>(1,endpoint->bufferSize / 2))
+				{
+					acknowledge();
+				}
+				return true;
+			}
+
+			///The writer has finished; if it was poisoned, so is the reader
+			bool marker(usign32 marker)
+			{
+				if (marker == NetFrame::PoisonMarker)
+				{
+					out.poison();
+				}
+				return false;
+			}
+		};
+
+		/**@internal
+		*	The state of a NamedChannelWriter, shared with its NamedSender
+		*/
+		template <typename DATA_TYPE>
+		class NamedWriterState : public boost::noncopyable
+		{
+		public:
+			Mobile<TCPSocketChannel> socket;
+			One2OneChannel<DATA_TYPE> channel;
+			///The bufferSize of the reader
+			const usign32 bufferSize;
+			///Set when the NamedChannelWriter is destroyed, which closes the connection without poisoning the reader
+			volatile bool closed;
+		private:
+			__CPPCSP_ALIGNED_USIGN32 references;
+		public:
+			inline NamedWriterState(const Mobile<TCPSocketChannel>& _socket,usign32 _bufferSize)
+				:	socket(_socket),bufferSize(_bufferSize),closed(false),
+					//The NamedChannelWriter and the NamedSender:
+					references(2)
+			{
+			}
+
+			void release()
+			{
+				if (0 == AtomicDecrement(&references))
+				{
+					delete this;
+				}
+			}
+		};
+
+		/**@internal
+		*	Sends the values written to a NamedChannelWriter to the reader.
+		*
+		*	If the reader's bufferSize is 0, each value is taken with an extended input, which lasts until the reader
+		*	has acknowledged it, so the writer is blocked until the remote reader has the value, just as it would be
+		*	on an unbuffered channel.  Otherwise, up to bufferSize values are sent ahead without waiting (framed into one
+		*	buffer if they are written together), and the writer only blocks once that many are unacknowledged.
+		*/
+		template <typename DATA_TYPE,typename SERIALIZER>
+		class NamedSender : public CSProcess
+		{
+		private:
+			NamedWriterState<DATA_TYPE>* const state;
+			Chanout< Mobile< std::vector<unsigned char> > > out;
+			AltChanin< std::vector<unsigned char> > acks;
+			DATA_TYPE value;
+			///The number of values that may be sent before waiting for acknowledgements
+			usign32 credits;
+			///Whether the connection is still open
+			bool connected;
+
+			void encode(std::vector<unsigned char>& buffer)
+			{
+				const size_t start = buffer.size();
+				buffer.resize(start + NetFrame::HeaderSize);
+				SERIALIZER::Write(value,buffer);
+				NetFrame::WriteLength(&(buffer[start]),static_cast<usign32>(buffer.size() - start - NetFrame::HeaderSize));
+			}
+
+			void send(Mobile< std::vector<unsigned char> >& buffer)
+			{
+				try
+				{
+					out << buffer;
+				}
+				catch (PoisonException&)
+				{
+					connected = false;
+				}
+			}
+
+			///Takes the acknowledgements that have arrived, first waiting for one if wait is true
+			void takeAcks(bool wait)
+			{
+				std::vector<unsigned char> data;
+				try
+				{
+					while (wait || acks.pending())
+					{
+						acks >> data;
+						credits += static_cast<usign32>(data.size());
+						wait = false;
+					}
+				}
+				catch (PoisonException&)
+				{
+					connected = false;
+				}
+			}
+		protected:
+			void run()
+			{
+				AltChanin<DATA_TYPE> in = state->channel.reader();
+				bool poisoned = false;
+
+				try
+				{
+					while (connected && false == poisoned)
+					{
+						Mobile< std::vector<unsigned char> > buffer(new std::vector<unsigned char>);
+
+						if (state->bufferSize == 0)
+						{
+							ScopedExtInput<DATA_TYPE> extInput(in,&value);
+							encode(*buffer);
+							send(buffer);
+							while (connected && credits == 0)
+							{
+								takeAcks(true);
+							}
+
+							if (connected)
+							{
+								credits--;
+							}
+							else
+							{
+								//So that the writer does not think the value arrived:
+								in.poison();
+							}
+						}
+						else
+						{
+							while (connected && credits == 0)
+							{
+								takeAcks(true);
+							}
+
+							try
+							{
+								if (connected)
+								{
+									in >> value;
+									encode(*buffer);
+									credits--;
+									while (credits > 0 && buffer->size() < NetEncoder<DATA_TYPE,SERIALIZER>::BatchSize && in.pending())
+									{
+										in >> value;
+										encode(*buffer);
+										credits--;
+									}
+								}
+							}
+							catch (PoisonException&)
+							{
+								//Send what we have first:
+								poisoned = true;
+							}
+
+							if (connected && false == buffer->empty())
+							{
+								send(buffer);
+							}
+							if (connected)
+							{
+								takeAcks(false);
+							}
+						}
+					}
+				}
+				catch (PoisonException&)
+				{
+					poisoned = true;
+				}
+
+				if (connected && poisoned && false == state->closed)
+				{
+					//Pass the poison on to the reader:
+					Mobile< std::vector<unsigned char> > marker(new std::vector<unsigned char>(NetFrame::HeaderSize));
+					NetFrame::WriteLength(&((*marker)[0]),NetFrame::PoisonMarker);
+					send(marker);
+				}
+
+				in.poison();
+				acks.poison();
+				//Closes our side of the connection, once everything has been sent:
+				out.poison();
+				state->release();
+			}
+		public:
+			inline explicit NamedSender(NamedWriterState<DATA_TYPE>* _state)
+				:	state(_state),out(_state->socket->writer()),acks(_state->socket->reader()),credits(_state->bufferSize),connected(true)
+			{
+			}
+		};
+	} //namespace internal
+
+	/**
+	*	The reading end of a named channel, obtained from ChannelNode::openReader().  Writers in any program that has
+	*	joined the same name server can connect to it by its name, with ChannelNode::connectWriter().
+	*
+	*	Reading from reader() receives the values written by all the connected writers, as for an Any2OneChannel;
+	*	it can be used in an Alternative.
+	*
+	*	Destroying the NamedChannelReader removes the name, and closes the connections of its writers, whose writing
+	*	ends are then poisoned.  Poisoning reader() does the same to the writers, the next time each of them writes.
+	*/
+	template <typename DATA_TYPE,typename SERIALIZER = NetSerializer<DATA_TYPE> >
+	class NamedChannelReader : public boost::noncopyable
+	{
+	private:
+		internal::ChannelNodeState* const node;
+		internal::NamedReaderEndpoint<DATA_TYPE,SERIALIZER>* const endpoint;
+		const std::string name;
+
+		inline NamedChannelReader(internal::ChannelNodeState* _node,internal::NamedReaderEndpoint<DATA_TYPE,SERIALIZER>* _endpoint,const std::string& _name)
+			:	node(_node),endpoint(_endpoint),name(_name)
+		{
+			node->addReference();
+		}
+
+		friend class ChannelNode;
+	public:
+		~NamedChannelReader()
+		{
+			node->remove(name);
+			endpoint->close();
+			endpoint->release();
+			node->release();
+		}
+
+		/**
+		*	Gets the reading end, which receives the values sent by the writers
+		*/
+		inline AltChanin<DATA_TYPE> reader()
+		{
+			return endpoint->channel.reader();
+		}
+	};
+
+	/**
+	*	A writer connected to a named channel, obtained from ChannelNode::connectWriter().
+	*
+	*	Writing to writer() sends the value to the reader.  If the reader was opened with a bufferSize of 0, the write
+	*	does not complete until the reader (in the other program) has taken the value, just as for an unbuffered
+	*	channel.  Otherwise, up to bufferSize values may be on their way to the reader before a write blocks; they are
+	*	pipelined, so that writing them costs no more than one round trip.
+	*
+	*	Poisoning writer() poisons the reader, once everything written has arrived.  Destroying the NamedChannelWriter only
+	*	closes the connection, so the reader can carry on reading from other writers.  If the reader is closed or poisoned
+	*	(or the connection fails), writer() is poisoned; any buffered values that the reader had not taken are lost.
+	*/
+	template <typename DATA_TYPE,typename SERIALIZER = NetSerializer<DATA_TYPE> >
+	class NamedChannelWriter : public boost::noncopyable
+	{
+	private:
+		internal::NamedWriterState<DATA_TYPE>* const state;
+
+		inline explicit NamedChannelWriter(internal::NamedWriterState<DATA_TYPE>* _state)
+			:	state(_state)
+		{
+			internal::NetworkHandler::Fork(new internal::NamedSender<DATA_TYPE,SERIALIZER>(state));
+		}
+
+		friend class ChannelNode;
+	public:
+		~NamedChannelWriter()
+		{
+			state->closed = true;
+			state->channel.writer().poison();
+			//Wakes the NamedSender if it is waiting for acknowledgements:
+			state->socket->reader().poison();
+			state->release();
+		}
+
+		/**
+		*	Gets the writing end, which sends values to the reader
+		*/
+		inline Chanout<DATA_TYPE> writer()
+		{
+			return state->channel.writer();
+		}
+	};
+
+	/**
+	*	A program's membership of a name service, through which a process network can be spread across several programs
+	*	(on the same machine, or on others) without being rewritten: a channel between two processes in different programs
+	*	is replaced by a NamedChannelReader in one and a NamedChannelWriter in the other, and the processes use their
+	*	ends as before.
+	*
+	*	One program runs the name server (see OpenChannelNameServer()), and each program joins it with JoinChannelNameServer():
+	*	@code
+		//In the program with the reading process:
+		Mobile<ChannelNode> node = JoinChannelNameServer(CPPCSPAddress(IPAddress_Localhost,7000));
+		Mobile< NamedChannelReader<Reading> > readings = node->openReader<Reading>("readings");
+		Run(new Logger(readings->reader()));
+
+		//In the program with the writing process:
+		Mobile<ChannelNode> node = JoinChannelNameServer(CPPCSPAddress(IPAddress_Localhost,7000));
+		Mobile< NamedChannelWriter<Reading> > readings = node->connectWriter<Reading>("readings");
+		Run(new Sensor(readings->writer()));
+		@endcode
+	*
+	*	Each node listens on a port of its own for the writers of its named channels, which is registered with the name server
+	*	along with the names; the name server gives the node's address as it saw it when the node joined.  The names of
+	*	a node are removed when the node (or its connection to the name server) closes.
+	*
+	*	The values are sent as a NetChannel sends them, using SERIALIZER (by default, NetSerializer<DATA_TYPE>).  The
+	*	ChannelNode must not be destroyed until all its readers and writers have been; it is safe to use from any thread.
+	*/
+	class ChannelNode : public boost::noncopyable
+	{
+	private:
+		internal::ChannelNodeState* const state;
+
+		inline explicit ChannelNode(internal::ChannelNodeState* _state)
+			:	state(_state)
+		{
+		}
+
+		friend Mobile<ChannelNode> JoinChannelNameServer(const CPPCSPAddress& nameServer,const NetworkInterface& netInterface);
+	public:
+		~ChannelNode();
+
+		/**
+		*	Opens a named channel for reading, using NetSerializer<DATA_TYPE>.  See the other version of this function.
+		*/
+		template <typename DATA_TYPE>
+		inline Mobile< NamedChannelReader< DATA_TYPE,NetSerializer<DATA_TYPE> > > openReader(const std::string& name,usign32 bufferSize = 0)
+		{
+			return openReader< DATA_TYPE,NetSerializer<DATA_TYPE> >(name,bufferSize);
+		}
+
+		/**
+		*	Opens a named channel for reading, and registers its name with the name server.
+		*
+		*	@param name The name of the channel, which must not be registered by any other node
+		*	@param bufferSize The number of values that each writer may send before the reader has taken them.  With 0,
+		*	each write completes only once the value has been read
+		*	@return The reading end, or a blank mobile if the name is already taken (or the name server cannot be reached)
+		*/
+		template <typename DATA_TYPE,typename SERIALIZER>
+		Mobile< NamedChannelReader<DATA_TYPE,SERIALIZER> > openReader(const std::string& name,usign32 bufferSize = 0)
+		{
+			internal::NamedReaderEndpoint<DATA_TYPE,SERIALIZER>* endpoint = new internal::NamedReaderEndpoint<DATA_TYPE,SERIALIZER>(bufferSize);
+			if (false == state->add(name,endpoint))
+			{
+				endpoint->release();
+				return Mobile< NamedChannelReader<DATA_TYPE,SERIALIZER> >();
+			}
+			return Mobile< NamedChannelReader<DATA_TYPE,SERIALIZER> >(new NamedChannelReader<DATA_TYPE,SERIALIZER>(state,endpoint,name));
+		}
+
+		/**
+		*	Connects a writer to a named channel, using NetSerializer<DATA_TYPE>.  See the other version of this function.
+		*/
+		template <typename DATA_TYPE>
+		inline Mobile< NamedChannelWriter< DATA_TYPE,NetSerializer<DATA_TYPE> > > connectWriter(const std::string& name)
+		{
+			return connectWriter< DATA_TYPE,NetSerializer<DATA_TYPE> >(name);
+		}
+
+		/**
+		*	Connects a writer to a named channel, which may be read in this program or another.  Other processes in the same
+		*	thread continue to run while the name is looked up and the connection is made.
+		*
+		*	@param name The name of the channel
+		*	@return The writing end, or a blank mobile if there is no such channel (or it cannot be reached)
+		*/
+		template <typename DATA_TYPE,typename SERIALIZER>
+		Mobile< NamedChannelWriter<DATA_TYPE,SERIALIZER> > connectWriter(const std::string& name)
+		{
+			usign32 bufferSize;
+			Mobile<TCPSocketChannel> socket = state->connect(name,&bufferSize);
+			if (!socket)
+			{
+				return Mobile< NamedChannelWriter<DATA_TYPE,SERIALIZER> >();
+			}
+			return Mobile< NamedChannelWriter<DATA_TYPE,SERIALIZER> >(
+				new NamedChannelWriter<DATA_TYPE,SERIALIZER>(new internal::NamedWriterState<DATA_TYPE>(socket,bufferSize)));
+		}
+	};
+
+	/**
+	*	The name server for named channels, obtained from OpenChannelNameServer().  It keeps the names registered by
+	*	each ChannelNode, and looks them up for the others.
+	*
+	*	Destroying it stops accepting new nodes; those already joined are served until they close.
+	*/
+	class ChannelNameServer : public boost::noncopyable
+	{
+	private:
+		internal::NameServerState* const state;
+
+		inline explicit ChannelNameServer(internal::NameServerState* _state)
+			:	state(_state)
+		{
+		}
+
+		friend Mobile<ChannelNameServer> OpenChannelNameServer(const usign16 port,const NetworkInterface& netInterface);
+	public:
+		~ChannelNameServer();
+
+		/**
+		*	Gets the address and port that the name server is listening on
+		*/
+		CPPCSPAddress address() const;
+	};
+
+	/**
+	*	Starts a name server for named channels.  It is run by the network thread, like the socket channels.
+	*
+	*	@param port The port to listen on (or 0 for any free port; see ChannelNameServer::address())
+	*	@param netInterface The address of the interface to listen on, such as IPAddress_Any
+	*	@return The name server, or a blank mobile if the port could not be listened on
+	*/
+	Mobile<ChannelNameServer> OpenChannelNameServer(const usign16 port,const NetworkInterface& netInterface = IPAddress_Any);
+
+	/**
+	*	Joins a name server, so that this program can read and write named channels.
+	*
+	*	@param nameServer The address and port of the name server
+	*	@param netInterface The address of the interface on which the node listens for writers, such as IPAddress_Any
+	*	@return The node, or a blank mobile if the name server could not be reached
+	*/
+	Mobile<ChannelNode> JoinChannelNameServer(const CPPCSPAddress& nameServer,const NetworkInterface& netInterface = IPAddress_Any);
+
+} //namespace csp
@@ -0,0 +1,1623 @@
+/*
+*	The Kent C++CSP Library
+*	Copyright (C) 2002-2007 Neil Brown
+*
+*	This library is free software; you can redistribute it and/or
+*	modify it under the terms of the GNU Lesser General Public
+*	License as published by the Free Software Foundation; either
+*	version 2.1 of the License, or (at your option) any later version.
+*
+*	This library is distributed in the hope that it will be useful,
+*	but WITHOUT ANY WARRANTY; without even the implied warranty of
+*	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+*	Lesser General Public License for more details.
+*
+*	You should have received a copy of the GNU Lesser General Public
+*	License along with this library; if not, write to the Free Software
+*	Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+/** @internal@file net_channels.cpp
+*	@brief Implements the TCP and UDP socket channels, and the epoll-driven network handler behind them
+*/
+
+#include "cppcsp.h"
+
+#ifdef CPPCSP_LINUX
+
+#include <sys/epoll.h>
+#include <sys/uio.h>
+#include <sys/un.h>
+#include <netinet/tcp.h>
+#include <linux/errqueue.h>
+#include <deque>
+#include <unistd.h>
+#include <stddef.h>
+#include <errno.h>
+#include <string.h>
+
+using namespace csp;
+using namespace csp::internal;
+using namespace std;
+
+namespace
+{
+	//The most events taken from epoll at once:
+	const int MaxEvents = 256;
+
+	//The processes that serve the sockets do little more than system calls and channel communications,
+	//and there may be tens of thousands of them:
+	const unsigned SocketProcessStackSize = 65536;
+
+	inline string ErrorString(const string& what)
+	{
+		return what + ": " + strerror(errno);
+	}
+
+	///Fills in a sockaddr for an IPAddress, returning its length
+	class SockAddrFiller : public boost::static_visitor<socklen_t>
+	{
+	private:
+		sockaddr_storage* const storage;
+		const usign16 port;
+	public:
+		inline SockAddrFiller(sockaddr_storage* _storage,usign16 _port)
+			:	storage(_storage),port(_port)
+		{
+			memset(storage,0,sizeof(sockaddr_storage));
+		}
+
+		socklen_t operator()(const IPv4Address& address) const
+		{
+			sockaddr_in* in = reinterpret_cast<sockaddr_in*>(storage);
+			in->sin_family = AF_INET;
+			in->sin_port = htons(port);
+			memcpy(&(in->sin_addr),&(address[0]),address.size());
+			return sizeof(sockaddr_in);
+		}
+
+		socklen_t operator()(const IPv6Address& address) const
+		{
+			sockaddr_in6* in6 = reinterpret_cast<sockaddr_in6*>(storage);
+			in6->sin6_family = AF_INET6;
+			in6->sin6_port = htons(port);
+			memcpy(&(in6->sin6_addr),&(address[0]),address.size());
+			return sizeof(sockaddr_in6);
+		}
+	};
+
+	inline socklen_t ToSockAddr(const IPAddress& address,usign16 port,sockaddr_storage* storage)
+	{
+		SockAddrFiller filler(storage,port);
+		return boost::apply_visitor(filler,address);
+	}
+
+	///Gets the address and port from a sockaddr
+	TCPUDPAddress FromSockAddr(const sockaddr_storage& storage)
+	{
+		if (storage.ss_family == AF_INET6)
+		{
+			const sockaddr_in6* in6 = reinterpret_cast<const sockaddr_in6*>(&storage);
+			IPv6Address address;
+			memcpy(&(address[0]),&(in6->sin6_addr),address.size());
+			return TCPUDPAddress(address,ntohs(in6->sin6_port));
+		}
+		else
+		{
+			const sockaddr_in* in = reinterpret_cast<const sockaddr_in*>(&storage);
+			IPv4Address address;
+			memcpy(&(address[0]),&(in->sin_addr),address.size());
+			return TCPUDPAddress(address,ntohs(in->sin_port));
+		}
+	}
+
+	/**
+	*	The buffers written to a socket that have yet to be sent (or, for zero-copy sends, that the kernel may
+	*	still be reading from).
+	*
+	*	The buffers are owned by the queue, so they are sent straight from the memory that the writer filled in:
+	*	as many as possible go in one sendmsg() call (gathered with an iovec each), and large sends use MSG_ZEROCOPY
+	*	so that the kernel does not copy them either.  A zero-copy buffer must not be freed until the kernel
+	*	says (on the socket's error queue) that it has finished with it, so those are kept until reap() sees that.
+	*	If the kernel reports that it had to copy the data after all (as it does on loopback), zero-copy is turned off.
+	*/
+	class SendQueue : public boost::noncopyable
+	{
+	private:
+		typedef Mobile< vector<unsigned char> > Buffer;
+
+		NetSocket* const socket;
+		///The buffers to send, the first of which has had offset bytes sent already
+		list<Buffer> queue;
+		size_t queued;
+		size_t offset;
+		///True if the last send did not take everything, in which case the socket is full
+		bool full;
+
+		bool zeroCopy;
+		///The number the kernel will give to the next zero-copy send
+		usign32 nextId;
+		///True if part of the first buffer has gone in a zero-copy send (numbered frontId)
+		bool frontZeroCopied;
+		usign32 frontId;
+		///Buffers that have been sent with zero-copy but that the kernel may still be using, and the number of the last send of each
+		list<Buffer> inFlight;
+		deque<usign32> inFlightIds;
+
+		///Removes the first buffer, which has been sent, keeping it if the kernel may still be using it
+		void retireFront(bool copyless,usign32 id)
+		{
+			if (copyless || frontZeroCopied)
+			{
+				inFlight.splice(inFlight.end(),queue,queue.begin());
+				inFlightIds.push_back(copyless ? id : frontId);
+			}
+			else
+			{
+				queue.pop_front();
+			}
+			queued--;
+			offset = 0;
+			frontZeroCopied = false;
+		}
+
+		///Frees the buffers of the zero-copy sends up to and including the given one
+		void complete(usign32 last)
+		{
+			//TCP completes its sends in order:
+			while (false == inFlightIds.empty() && static_cast<sign32>(last - inFlightIds.front()) >= 0)
+			{
+				inFlight.pop_front();
+				inFlightIds.pop_front();
+			}
+		}
+	public:
+		///The most buffers sent at once
+		static const size_t MaxIovecs = 64;
+		///The smallest buffers that are worth sending with zero-copy (smaller ones cost more to pin and track than to copy)
+		static const size_t ZeroCopyThreshold = 16384;
+
+		explicit SendQueue(NetSocket* _socket)
+			:	socket(_socket),queued(0),offset(0),full(false),zeroCopy(false),nextId(0),frontZeroCopied(false),frontId(0)
+		{
+			#ifdef SO_ZEROCOPY
+				int one = 1;
+				zeroCopy = (0 == setsockopt(socket->fd,SOL_SOCKET,SO_ZEROCOPY,&one,sizeof(one)));
+			#endif
+		}
+
+		inline bool empty() const
+		{
+			return queued == 0;
+		}
+
+		inline size_t size() const
+		{
+			return queued;
+		}
+
+		///Takes a buffer to send, leaving the mobile blank
+		void push(Buffer& buffer)
+		{
+			if (buffer && false == buffer->empty())
+			{
+				queue.push_back(buffer);
+				queued++;
+			}
+		}
+
+		/**
+		*	Sends as many of the queued buffers as the socket will take in one sendmsg(), waiting first if the socket
+		*	is full.  There must be something queued.
+		*
+		*	@return False if the connection has failed
+		*/
+		bool send()
+		{
+			if (full)
+			{
+				socket->wait(NetSocket::Writable);
+				full = false;
+			}
+
+			iovec iov[MaxIovecs];
+			size_t count = 0,total = 0;
+			for (list<Buffer>::iterator it = queue.begin();it != queue.end() && count < MaxIovecs;it++,count++)
+			{
+				const size_t start = (count == 0 ? offset : 0);
+				iov[count].iov_base = &((**it)[start]);
+				iov[count].iov_len = (*it)->size() - start;
+				total += iov[count].iov_len;
+			}
+
+			msghdr msg;
+			memset(&msg,0,sizeof(msg));
+			msg.msg_iov = iov;
+			msg.msg_iovlen = count;
+
+			//A send gathered from many small buffers is copied; on loopback, zero-copy sends of those can stall until TCP retransmits:
+			bool copyless = zeroCopy && total >= ZeroCopyThreshold * count;
+			ssize_t n;
+			while (true)
+			{
+				#ifdef MSG_ZEROCOPY
+					n = sendmsg(socket->fd,&msg,MSG_NOSIGNAL | (copyless ? MSG_ZEROCOPY : 0));
+				#else
+					n = sendmsg(socket->fd,&msg,MSG_NOSIGNAL);
+				#endif
+				if (n >= 0)
+				{
+					break;
+				}
+				else if (errno == ENOBUFS && copyless)
+				{
+					//Too much is waiting for zero-copy completions; copy this one:
+					copyless = false;
+				}
+				else if (errno == EAGAIN || errno == EWOULDBLOCK)
+				{
+					socket->wait(NetSocket::Writable);
+				}
+				else if (errno != EINTR)
+				{
+					return false;
+				}
+			}
+
+			const usign32 id = nextId;
+			if (copyless)
+			{
+				nextId++;
+			}
+
+			//A partial zero-copy send does not necessarily mean that the socket is full, so we only wait after plain ones:
+			full = (false == copyless && static_cast<size_t>(n) < total);
+			for (size_t remaining = static_cast<size_t>(n);remaining > 0;)
+			{
+				const size_t left = queue.front()->size() - offset;
+				if (remaining < left)
+				{
+					offset += remaining;
+					if (copyless)
+					{
+						frontZeroCopied = true;
+						frontId = id;
+					}
+					break;
+				}
+				remaining -= left;
+				retireFront(copyless,id);
+			}
+			return true;
+		}
+
+		/**
+		*	Frees the buffers that the kernel has finished sending with zero-copy.  Does not block.
+		*/
+		void reap()
+		{
+			while (false == inFlight.empty())
+			{
+				char control[128];
+				msghdr msg;
+				memset(&msg,0,sizeof(msg));
+				msg.msg_control = control;
+				msg.msg_controllen = sizeof(control);
+
+				if (-1 == recvmsg(socket->fd,&msg,MSG_ERRQUEUE))
+				{
+					//Nothing more has finished yet:
+					return;
+				}
+
+				for (cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);cmsg != NULL;cmsg = CMSG_NXTHDR(&msg,cmsg))
+				{
+					if ((cmsg->cmsg_level == SOL_IP && cmsg->cmsg_type == IP_RECVERR)
+						|| (cmsg->cmsg_level == SOL_IPV6 && cmsg->cmsg_type == IPV6_RECVERR))
+					{
+						const sock_extended_err* error = reinterpret_cast<const sock_extended_err*>(CMSG_DATA(cmsg));
+						#ifdef SO_EE_ORIGIN_ZEROCOPY
+						if (error->ee_origin == SO_EE_ORIGIN_ZEROCOPY)
+						{
+							if (error->ee_code & SO_EE_CODE_ZEROCOPY_COPIED)
+							{
+								//Zero-copy is not saving anything on this connection:
+								zeroCopy = false;
+							}
+							complete(error->ee_data);
+						}
+						#endif
+					}
+				}
+			}
+		}
+
+		/**
+		*	Waits until the kernel has finished with all the buffers sent with zero-copy, so that they can be freed.
+		*	Nothing more may be sent afterwards.
+		*/
+		void drain()
+		{
+			if (frontZeroCopied)
+			{
+				retireFront(false,0);
+			}
+
+			while (false == inFlight.empty())
+			{
+				reap();
+				if (false == inFlight.empty())
+				{
+					//The completions are on the error queue, which the poller hears about as an error:
+					socket->wait(NetSocket::Writable);
+				}
+			}
+		}
+	};
+
+	/**
+	*	Moves data from a connected socket into its fromNetwork channel (or gives it to a receiver, if it has one),
+	*	until the connection is closed (or fails) or the channel is poisoned (or the receiver wants no more).
+	*/
+	class TCPReader : public CSProcess
+	{
+	private:
+		TCPConnection* const connection;
+		TCPReceiver* const receiver;
+	protected:
+		void run()
+		{
+			NetSocket* socket = connection->socket;
+			Chanout< vector<unsigned char> > out = connection->fromNetwork.writer();
+			vector<unsigned char> data;
+
+			try
+			{
+				while (true)
+				{
+					data.resize(connection->bufSize);
+					const ssize_t n = recv(socket->fd,&(data[0]),data.size(),0);
+					if (n > 0 && receiver != NULL)
+					{
+						if (false == receiver->received(&(data[0]),static_cast<size_t>(n)))
+						{
+							shutdown(socket->fd,SHUT_RD);
+							break;
+						}
+					}
+					else if (n > 0)
+					{
+						data.resize(static_cast<size_t>(n));
+						out << data;
+					}
+					else if (n == -1 && (errno == EAGAIN || errno == EWOULDBLOCK))
+					{
+						socket->wait(NetSocket::Readable);
+					}
+					else if (n == 0 || errno != EINTR)
+					{
+						//Closed by the other end, or failed:
+						break;
+					}
+				}
+			}
+			catch (PoisonException&)
+			{
+				//No-one is reading any more:
+				shutdown(socket->fd,SHUT_RD);
+			}
+
+			if (receiver != NULL)
+			{
+				receiver->finished();
+			}
+			else
+			{
+				out.poison();
+			}
+			connection->release();
+		}
+	public:
+		inline TCPReader(TCPConnection* _connection,TCPReceiver* _receiver)
+			:	CSProcess(SocketProcessStackSize),connection(_connection),receiver(_receiver)
+		{
+		}
+	};
+
+	/**
+	*	Gives a receiver the data from the fromNetwork channel of a socket that was already being read into the
+	*	channel when the receiver was given, until the channel is poisoned or the receiver wants no more.
+	*/
+	class TCPReceiverFeeder : public CSProcess
+	{
+	private:
+		TCPConnection* const connection;
+		TCPReceiver* const receiver;
+	protected:
+		void run()
+		{
+			AltChanin< vector<unsigned char> > in = connection->fromNetwork.reader();
+			vector<unsigned char> data;
+
+			try
+			{
+				bool ok = true;
+				while (ok)
+				{
+					in >> data;
+					ok = data.empty() || receiver->received(&(data[0]),data.size());
+				}
+			}
+			catch (PoisonException&)
+			{
+			}
+
+			in.poison();
+			receiver->finished();
+			connection->release();
+		}
+	public:
+		inline TCPReceiverFeeder(TCPConnection* _connection,TCPReceiver* _receiver)
+			:	CSProcess(SocketProcessStackSize),connection(_connection),receiver(_receiver)
+		{
+		}
+	};
+
+	/**
+	*	Moves data from the toNetwork channel of a connected socket into the socket, until the connection fails
+	*	or the channel is poisoned.
+	*/
+	class TCPWriter : public CSProcess
+	{
+	private:
+		TCPConnection* const connection;
+	protected:
+		void run()
+		{
+			NetSocket* socket = connection->socket;
+			AltChanin< Mobile< vector<unsigned char> > > in = connection->toNetwork.reader();
+			SendQueue queue(socket);
+			Mobile< vector<unsigned char> > buffer;
+			bool ok = true;
+
+			try
+			{
+				while (ok)
+				{
+					if (queue.empty())
+					{
+						queue.reap();
+						in >> buffer;
+						queue.push(buffer);
+					}
+
+					//Take everything else that has been written without blocking, so that it all goes in one sendmsg():
+					while (queue.size() < SendQueue::MaxIovecs && in.pending())
+					{
+						in >> buffer;
+						queue.push(buffer);
+					}
+
+					queue.reap();
+					ok = queue.send();
+				}
+			}
+			catch (PoisonException&)
+			{
+				//Send what is left:
+				while (ok && false == queue.empty())
+				{
+					ok = queue.send();
+				}
+			}
+
+			if (ok)
+			{
+				//Everything written has been sent, so close our side of the connection:
+				shutdown(socket->fd,SHUT_WR);
+			}
+			else
+			{
+				in.poison();
+			}
+
+			queue.drain();
+			connection->release();
+		}
+	public:
+		inline explicit TCPWriter(TCPConnection* _connection)
+			:	CSProcess(SocketProcessStackSize),connection(_connection)
+		{
+		}
+	};
+
+	/**
+	*	Accepts connections on a listening socket and sends them down the accepter's channel, until the socket is
+	*	shut down or the channel is poisoned.  ACCEPTER is TCPAccepter or UnixAccepter.
+	*/
+	template <typename ACCEPTER>
+	class AccepterProcess : public CSProcess
+	{
+	private:
+		ACCEPTER* const accepter;
+	protected:
+		void run()
+		{
+			NetSocket* socket = accepter->socket;
+			Chanout< Mobile<typename ACCEPTER::Channel> > out = accepter->channel.writer();
+
+			try
+			{
+				//Shutting down a listening Unix socket wakes us, but does not make accept fail, so we check the flag too:
+				while (false == accepter->closed)
+				{
+					const Socket fd = accept4(socket->fd,NULL,NULL,SOCK_NONBLOCK | SOCK_CLOEXEC);
+					if (fd != -1)
+					{
+						NetSocket* connected;
+						try
+						{
+							connected = NetworkHandler::Add(fd);
+						}
+						catch (OutOfResourcesException&)
+						{
+							//The connection has been closed; the next one may fare better:
+							continue;
+						}
+
+						Mobile<typename ACCEPTER::Channel> channel = accepter->start(connected);
+						out << channel;
+					}
+					else if (errno == EAGAIN || errno == EWOULDBLOCK)
+					{
+						socket->wait(NetSocket::Readable);
+					}
+					else if (errno == EMFILE || errno == ENFILE || errno == ENOBUFS || errno == ENOMEM)
+					{
+						//The connection stays queued until we have the resources to take it:
+						SleepFor(MilliSeconds(10));
+					}
+					else if (errno == EINVAL || errno == EBADF || errno == ENOTSOCK)
+					{
+						//Shut down by the accepter channel:
+						break;
+					}
+					//Anything else is a problem with that one connection (which has been dropped)
+				}
+			}
+			catch (PoisonException&)
+			{
+			}
+
+			out.poison();
+			accepter->release();
+		}
+	public:
+		inline explicit AccepterProcess(ACCEPTER* _accepter)
+			:	CSProcess(SocketProcessStackSize),accepter(_accepter)
+		{
+		}
+	};
+
+	/**
+	*	The most descriptors that Linux passes in one message (SCM_MAX_FD)
+	*/
+	const usign32 MaxPassedDescriptors = 253;
+
+	/**
+	*	Takes ownership of the descriptors in the SCM_RIGHTS control messages of a received message
+	*/
+	void TakeDescriptors(msghdr* msg,std::list< Mobile<FileDescriptor> >* fds)
+	{
+		for (cmsghdr* cmsg = CMSG_FIRSTHDR(msg);cmsg != NULL;cmsg = CMSG_NXTHDR(msg,cmsg))
+		{
+			if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS)
+			{
+				const size_t count = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+				const unsigned char* data = CMSG_DATA(cmsg);
+				for (size_t i = 0;i < count;i++)
+				{
+					int fd;
+					memcpy(&fd,data + i * sizeof(int),sizeof(int));
+					fds->push_back(Mobile<FileDescriptor>(new FileDescriptor(fd)));
+				}
+			}
+		}
+	}
+
+	/**
+	*	Moves messages (and passed descriptors) from a connected Unix socket into its fromNetwork channel, until the
+	*	connection is closed (or fails) or the channel is poisoned.
+	*/
+	class UnixReader : public CSProcess
+	{
+	private:
+		UnixConnection* const connection;
+	protected:
+		void run()
+		{
+			NetSocket* socket = connection->socket;
+			Chanout<UnixMessage> out = connection->fromNetwork.writer();
+			vector<unsigned char> data(connection->bufSize);
+			union
+			{
+				cmsghdr align;
+				unsigned char buffer[CMSG_SPACE(sizeof(int) * MaxPassedDescriptors)];
+			} control;
+
+			try
+			{
+				while (true)
+				{
+					iovec iov;
+					iov.iov_base = &(data[0]);
+					iov.iov_len = data.size();
+
+					msghdr msg;
+					memset(&msg,0,sizeof(msg));
+					msg.msg_iov = &iov;
+					msg.msg_iovlen = 1;
+					msg.msg_control = control.buffer;
+					msg.msg_controllen = sizeof(control.buffer);
+
+					const ssize_t n = recvmsg(socket->fd,&msg,MSG_CMSG_CLOEXEC);
+					if (n == -1)
+					{
+						if (errno == EAGAIN || errno == EWOULDBLOCK)
+						{
+							socket->wait(NetSocket::Readable);
+							continue;
+						}
+						else if (errno == EINTR)
+						{
+							continue;
+						}
+						//Failed:
+						break;
+					}
+
+					//Any descriptors are closed with the message if it is dropped:
+					UnixMessage message;
+					TakeDescriptors(&msg,&message.fds);
+
+					if (n == 0 && message.fds.empty())
+					{
+						//Closed by the other end (we never send empty messages):
+						break;
+					}
+
+					if ((msg.msg_flags & MSG_TRUNC) == 0)
+					{
+						message.data.assign(data.begin(),data.begin() + n);
+						out << message;
+					}
+					//else it was a packet longer than our buffer, which is dropped
+				}
+			}
+			catch (PoisonException&)
+			{
+				//No-one is reading any more:
+				shutdown(socket->fd,SHUT_RD);
+			}
+
+			out.poison();
+			connection->release();
+		}
+	public:
+		inline explicit UnixReader(UnixConnection* _connection)
+			:	CSProcess(SocketProcessStackSize),connection(_connection)
+		{
+		}
+	};
+
+	/**
+	*	Moves messages from the toNetwork channel of a connected Unix socket into the socket, until the connection
+	*	fails or the channel is poisoned.
+	*/
+	class UnixWriter : public CSProcess
+	{
+	private:
+		UnixConnection* const connection;
+
+		/**
+		*	Sends a message and closes our copies of its descriptors.  Returns false if the connection has failed.
+		*/
+		bool send(UnixMessage& message)
+		{
+			NetSocket* socket = connection->socket;
+			vector<unsigned char>& data = message.data;
+
+			//There is nothing to send, or (for a stream) nothing to send the descriptors with:
+			if (data.empty() && (connection->type == UnixStream || message.fds.empty()))
+			{
+				message.fds.clear();
+				return true;
+			}
+
+			vector<int> fds;
+			for (std::list< Mobile<FileDescriptor> >::iterator it = message.fds.begin();it != message.fds.end();it++)
+			{
+				if (*it)
+				{
+					fds.push_back((*it)->get());
+				}
+			}
+
+			//vector's storage is suitably aligned for the cmsghdr:
+			vector<cmsghdr> control;
+			if (false == fds.empty())
+			{
+				control.resize(CMSG_SPACE(sizeof(int) * fds.size()) / sizeof(cmsghdr) + 1);
+			}
+
+			bool first = true;
+			size_t offset = 0;
+			while (first || offset < data.size())
+			{
+				iovec iov;
+				iov.iov_base = data.empty() ? NULL : &(data[offset]);
+				iov.iov_len = data.size() - offset;
+
+				msghdr msg;
+				memset(&msg,0,sizeof(msg));
+				msg.msg_iov = &iov;
+				msg.msg_iovlen = 1;
+
+				//The descriptors go with the first part of the message only:
+				if (first && false == fds.empty())
+				{
+					msg.msg_control = &(control[0]);
+					msg.msg_controllen = CMSG_SPACE(sizeof(int) * fds.size());
+					cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+					cmsg->cmsg_level = SOL_SOCKET;
+					cmsg->cmsg_type = SCM_RIGHTS;
+					cmsg->cmsg_len = CMSG_LEN(sizeof(int) * fds.size());
+					memcpy(CMSG_DATA(cmsg),&(fds[0]),sizeof(int) * fds.size());
+				}
+
+				const ssize_t n = sendmsg(socket->fd,&msg,MSG_NOSIGNAL);
+				if (n >= 0)
+				{
+					first = false;
+					offset += static_cast<size_t>(n);
+				}
+				else if (errno == EAGAIN || errno == EWOULDBLOCK)
+				{
+					socket->wait(NetSocket::Writable);
+				}
+				else if (first && (errno == EMSGSIZE || errno == ETOOMANYREFS || errno == EBADF || errno == EINVAL))
+				{
+					//A problem with this message (too long a packet, or bad or too many descriptors), which is dropped:
+					break;
+				}
+				else if (errno != EINTR)
+				{
+					return false;
+				}
+			}
+
+			//The receiver has its own descriptors now:
+			message.fds.clear();
+			return true;
+		}
+	protected:
+		void run()
+		{
+			AltChanin<UnixMessage> in = connection->toNetwork.reader();
+			UnixMessage message;
+			bool ok = true;
+
+			try
+			{
+				while (ok)
+				{
+					in >> message;
+					ok = send(message);
+				}
+			}
+			catch (PoisonException&)
+			{
+			}
+
+			if (ok)
+			{
+				//Everything written has been sent, so close our side of the connection:
+				shutdown(connection->socket->fd,SHUT_WR);
+			}
+			else
+			{
+				in.poison();
+			}
+
+			connection->release();
+		}
+	public:
+		inline explicit UnixWriter(UnixConnection* _connection)
+			:	CSProcess(SocketProcessStackSize),connection(_connection)
+		{
+		}
+	};
+
+	/**
+	*	Fills in a sockaddr_un for the given path, returning its length (or 0 if the path is too long)
+	*/
+	socklen_t ToUnixAddr(const std::string& path,sockaddr_un* addr)
+	{
+		memset(addr,0,sizeof(sockaddr_un));
+		addr->sun_family = AF_UNIX;
+		if (path.empty() || path.size() >= sizeof(addr->sun_path))
+		{
+			return 0;
+		}
+		memcpy(addr->sun_path,path.data(),path.size());
+
+		//An abstract name is exactly the bytes given, whereas a file name is terminated:
+		const bool abstract = (path[0] == '\0');
+		return static_cast<socklen_t>(offsetof(sockaddr_un,sun_path) + path.size() + (abstract ? 0 : 1));
+	}
+
+	/**
+	*	The most datagrams received or sent by one system call
+	*/
+	const unsigned UDPBatchSize = 32;
+
+	/**
+	*	Moves the datagrams that arrive at a UDP socket into its fromNetwork channel, until the channel is poisoned or the
+	*	UDPSocketChannel is destroyed.
+	*/
+	class UDPReader : public CSProcess
+	{
+	private:
+		UDPConnection* const connection;
+	protected:
+		void run()
+		{
+			NetSocket* socket = connection->socket;
+			Chanout<UDPDatagram> out = connection->fromNetwork.writer();
+			const usign32 slotSize = connection->maxDatagramSize;
+
+			//One slot per datagram in a batch:
+			vector<unsigned char> storage(UDPBatchSize * slotSize);
+			sockaddr_storage addresses[UDPBatchSize];
+			iovec iov[UDPBatchSize];
+			mmsghdr messages[UDPBatchSize];
+			UDPDatagram datagram;
+
+			try
+			{
+				while (false == connection->closed)
+				{
+					for (unsigned i = 0;i < UDPBatchSize;i++)
+					{
+						iov[i].iov_base = &(storage[i * slotSize]);
+						iov[i].iov_len = slotSize;
+						memset(&(messages[i]),0,sizeof(mmsghdr));
+						messages[i].msg_hdr.msg_name = &(addresses[i]);
+						messages[i].msg_hdr.msg_namelen = sizeof(sockaddr_storage);
+						messages[i].msg_hdr.msg_iov = &(iov[i]);
+						messages[i].msg_hdr.msg_iovlen = 1;
+					}
+
+					const int n = recvmmsg(socket->fd,messages,UDPBatchSize,MSG_DONTWAIT,NULL);
+					if (n > 0)
+					{
+						for (int i = 0;i < n;i++)
+						{
+							if (0 == (messages[i].msg_hdr.msg_flags & MSG_TRUNC))
+							{
+								const unsigned char* data = &(storage[i * slotSize]);
+								datagram.address = FromSockAddr(addresses[i]);
+								datagram.data.assign(data,data + messages[i].msg_len);
+								out << datagram;
+							}
+						}
+					}
+					else if (n == -1 && (errno == EAGAIN || errno == EWOULDBLOCK))
+					{
+						socket->wait(NetSocket::Readable);
+					}
+					else if (n == -1 && (errno == EBADF || errno == EINVAL || errno == ENOTSOCK))
+					{
+						break;
+					}
+					//Anything else is an error reported for an earlier datagram, which we ignore like the datagram itself
+				}
+			}
+			catch (PoisonException&)
+			{
+			}
+
+			out.poison();
+			connection->release();
+		}
+	public:
+		inline explicit UDPReader(UDPConnection* _connection)
+			:	CSProcess(SocketProcessStackSize),connection(_connection)
+		{
+		}
+	};
+
+	/**
+	*	Sends the datagrams from the toNetwork channel of a UDP socket, until the channel is poisoned.
+	*/
+	class UDPWriter : public CSProcess
+	{
+	private:
+		UDPConnection* const connection;
+	protected:
+		void run()
+		{
+			NetSocket* socket = connection->socket;
+			AltChanin<UDPDatagram> in = connection->toNetwork.reader();
+
+			vector<UDPDatagram> batch(UDPBatchSize);
+			sockaddr_storage addresses[UDPBatchSize];
+			iovec iov[UDPBatchSize];
+			mmsghdr messages[UDPBatchSize];
+			unsigned count = 0;
+			bool open = true;
+
+			while (open || count > 0)
+			{
+				if (open)
+				{
+					try
+					{
+						if (count == 0)
+						{
+							in >> batch[0];
+							count = 1;
+						}
+
+						//Take everything else that has been written without blocking, so that it all goes in one sendmmsg():
+						while (count < UDPBatchSize && in.pending())
+						{
+							in >> batch[count];
+							count++;
+						}
+					}
+					catch (PoisonException&)
+					{
+						//Send what is left:
+						open = false;
+						if (count == 0)
+						{
+							break;
+						}
+					}
+				}
+
+				for (unsigned i = 0;i < count;i++)
+				{
+					memset(&(messages[i]),0,sizeof(mmsghdr));
+					messages[i].msg_hdr.msg_name = &(addresses[i]);
+					messages[i].msg_hdr.msg_namelen = ToSockAddr(batch[i].address.first,batch[i].address.second,&(addresses[i]));
+					iov[i].iov_base = batch[i].data.empty() ? NULL : &(batch[i].data[0]);
+					iov[i].iov_len = batch[i].data.size();
+					messages[i].msg_hdr.msg_iov = &(iov[i]);
+					messages[i].msg_hdr.msg_iovlen = 1;
+				}
+
+				unsigned done = 0;
+				const int n = sendmmsg(socket->fd,messages,count,MSG_NOSIGNAL);
+				if (n > 0)
+				{
+					done = static_cast<unsigned>(n);
+				}
+				else if (errno == EAGAIN || errno == EWOULDBLOCK)
+				{
+					socket->wait(NetSocket::Writable);
+				}
+				else if (errno != EINTR)
+				{
+					//The first datagram cannot be sent, so it is dropped:
+					done = 1;
+				}
+
+				//Move the unsent datagrams to the front (swapping, so that the vectors' memory is reused):
+				for (unsigned i = done;i < count;i++)
+				{
+					std::swap(batch[i - done],batch[i]);
+				}
+				count -= done;
+			}
+
+			connection->release();
+		}
+	public:
+		inline explicit UDPWriter(UDPConnection* _connection)
+			:	CSProcess(SocketProcessStackSize),connection(_connection)
+		{
+		}
+	};
+}
+
+NetSocket::NetSocket(Socket _fd)
+	:	fd(_fd)
+{
+	waiting[Readable] = waiting[Writable] = NullProcessPtr;
+	ready[Readable] = ready[Writable] = false;
+}
+
+void NetSocket::wait(Direction direction)
+{
+	mutex.claim();
+		if (ready[direction])
+		{
+			//It became ready while we were not waiting:
+			ready[direction] = false;
+			mutex.release();
+			return;
+		}
+
+		waiting[direction] = currentProcess();
+		//Don't let the run-time think we are deadlocked while we wait for the network:
+		AtomicProcessQueue::BeginExternalWait();
+	mutex.release();
+
+	reschedule();
+}
+
+void NetSocket::signal(Direction direction)
+{
+	mutex.claim();
+		if (waiting[direction] != NullProcessPtr)
+		{
+			freeProcessNoAlt(waiting[direction]);
+			waiting[direction] = NullProcessPtr;
+			AtomicProcessQueue::EndExternalWait();
+		}
+		else
+		{
+			ready[direction] = true;
+		}
+	mutex.release();
+}
+
+NetworkHandler* NetworkHandler::Instance = NULL;
+PureSpinMutex NetworkHandler::InstanceMutex;
+int NetworkHandler::EpollFd = -1;
+bool NetworkHandler::PollerStarted = false;
+std::vector<NetSocket*> NetworkHandler::Retired;
+PureSpinMutex NetworkHandler::RetiredMutex;
+
+NetworkHandler::NetworkHandler()
+	:	requestChan(InfiniteFIFOBuffer<CSProcessPtr>::Factory())
+{
+}
+
+void NetworkHandler::run()
+{
+	ScopedForking forking;
+	Chanin<CSProcessPtr> in = requestChan.reader();
+
+	while (true)
+	{
+		CSProcessPtr process;
+		in >> process;
+		try
+		{
+			forking.forkInThisThread(process);
+		}
+		catch (OutOfResourcesException&)
+		{
+			//The process has been deleted, so its socket will stay open, but the other sockets carry on
+		}
+	}
+}
+
+void NetworkHandler::Start()
+{
+	InstanceMutex.claim();
+		try
+		{
+			if (EpollFd == -1)
+			{
+				EpollFd = epoll_create1(EPOLL_CLOEXEC);
+				if (EpollFd == -1)
+				{
+					throw OutOfResourcesException(ErrorString("Could not create epoll set"));
+				}
+			}
+
+			if (false == PollerStarted)
+			{
+				pthread_t poller;
+				if (0 != pthread_create(&poller,NULL,&PollerFunc,NULL))
+				{
+					throw OutOfResourcesException("Could not create pthread for the network poller");
+				}
+				pthread_detach(poller);
+				PollerStarted = true;
+			}
+
+			if (Instance == NULL)
+			{
+				NetworkHandler* handler = new NetworkHandler;
+				//The forking is never finished, so the handler runs (in its own thread) until the program exits:
+				(new ScopedForking)->fork(handler);
+				Instance = handler;
+			}
+		}
+		catch (OutOfResourcesException&)
+		{
+			InstanceMutex.release();
+			throw;
+		}
+	InstanceMutex.release();
+}
+
+void* NetworkHandler::PollerFunc(void*)
+{
+	epoll_event events[MaxEvents];
+	std::vector<NetSocket*> toDelete;
+
+	while (true)
+	{
+		//Anything retired by now has left the epoll set, so it cannot be in any batch that we have yet to take
+		//(and we have finished with the batches that we have taken):
+		RetiredMutex.claim();
+			toDelete.swap(Retired);
+		RetiredMutex.release();
+
+		for (std::vector<NetSocket*>::iterator it = toDelete.begin();it != toDelete.end();it++)
+		{
+			delete *it;
+		}
+		toDelete.clear();
+
+		const int n = epoll_wait(EpollFd,events,MaxEvents,-1);
+
+		for (int i = 0;i < n;i++)
+		{
+			NetSocket* socket = static_cast<NetSocket*>(events[i].data.ptr);
+			const usign32 flags = events[i].events;
+
+			if (flags & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR))
+			{
+				socket->signal(NetSocket::Readable);
+			}
+			if (flags & (EPOLLOUT | EPOLLHUP | EPOLLERR))
+			{
+				socket->signal(NetSocket::Writable);
+			}
+		}
+	}
+
+	return NULL;
+}
+
+NetSocket* NetworkHandler::Add(Socket fd)
+{
+	NetSocket* socket = new NetSocket(fd);
+
+	epoll_event event;
+	event.events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET;
+	event.data.ptr = socket;
+
+	if (0 != epoll_ctl(EpollFd,EPOLL_CTL_ADD,fd,&event))
+	{
+		const string error = ErrorString("Could not add socket to epoll set");
+		delete socket;
+		close(fd);
+		throw OutOfResourcesException(error);
+	}
+
+	return socket;
+}
+
+void NetworkHandler::Close(NetSocket* socket)
+{
+	epoll_ctl(EpollFd,EPOLL_CTL_DEL,socket->fd,NULL);
+	close(socket->fd);
+
+	//The poller deletes it, once it cannot have any events left for it:
+	RetiredMutex.claim();
+		Retired.push_back(socket);
+	RetiredMutex.release();
+}
+
+void NetworkHandler::Fork(CSProcessPtr process)
+{
+	Instance->requestChan.writer() << process;
+}
+
+TCPConnection::TCPConnection(NetSocket* _socket,usign32 _bufSize)
+	:	socket(_socket),bufSize(_bufSize == 0 ? 1 : _bufSize),
+		fromNetwork(PrimitiveAggregatingFIFOBuffer<unsigned char>::Factory(bufSize)),
+		toNetwork(MobileCollectionFIFOBuffer< vector<unsigned char> >::Factory(bufSize)),
+		reading(false),
+		//The TCPSocketChannel and the TCPWriter (the TCPReader adds its own once it is started):
+		references(2)
+{
+}
+
+void TCPConnection::release()
+{
+	if (0 == AtomicDecrement(&references))
+	{
+		NetworkHandler::Close(socket);
+		delete this;
+	}
+}
+
+Mobile<TCPSocketChannel> TCPConnection::Start(NetSocket* socket,usign32 bufSize)
+{
+	//We aggregate the writes ourselves, so Nagle's algorithm would only add latency:
+	int one = 1;
+	setsockopt(socket->fd,IPPROTO_TCP,TCP_NODELAY,&one,sizeof(one));
+
+	TCPConnection* connection = new TCPConnection(socket,bufSize);
+	Mobile<TCPSocketChannel> channel(new TCPSocketChannel(connection));
+	NetworkHandler::Fork(new TCPWriter(connection));
+	return channel;
+}
+
+void TCPConnection::startReading(TCPReceiver* receiver)
+{
+	AtomicIncrement(&references);
+	if (reading)
+	{
+		//Some of the data may already be in the channel, so the receiver has to take it all from there:
+		NetworkHandler::Fork(new TCPReceiverFeeder(this,receiver));
+	}
+	else
+	{
+		reading = true;
+		NetworkHandler::Fork(new TCPReader(this,receiver));
+	}
+}
+
+TCPAccepter::TCPAccepter(NetSocket* _socket,usign32 _bufSize)
+	:	socket(_socket),bufSize(_bufSize),closed(false),
+		//The TCPSocketAccepterChannel and the AccepterProcess:
+		references(2)
+{
+}
+
+void TCPAccepter::release()
+{
+	if (0 == AtomicDecrement(&references))
+	{
+		NetworkHandler::Close(socket);
+		delete this;
+	}
+}
+
+Mobile<TCPSocketChannel> TCPAccepter::start(NetSocket* connected)
+{
+	return TCPConnection::Start(connected,bufSize);
+}
+
+UnixConnection::UnixConnection(NetSocket* _socket,UnixSocketType _type,usign32 _bufSize)
+	:	socket(_socket),type(_type),bufSize(_bufSize == 0 ? 1 : _bufSize),
+		fromNetwork(FIFOBuffer<UnixMessage>::Factory(BufferedMessages)),
+		toNetwork(FIFOBuffer<UnixMessage>::Factory(BufferedMessages)),
+		//The UnixSocketChannel, the UnixReader and the UnixWriter:
+		references(3)
+{
+}
+
+void UnixConnection::release()
+{
+	if (0 == AtomicDecrement(&references))
+	{
+		NetworkHandler::Close(socket);
+		delete this;
+	}
+}
+
+Mobile<UnixSocketChannel> UnixConnection::Start(NetSocket* socket,UnixSocketType type,usign32 bufSize)
+{
+	UnixConnection* connection = new UnixConnection(socket,type,bufSize);
+	Mobile<UnixSocketChannel> channel(new UnixSocketChannel(connection));
+	NetworkHandler::Fork(new UnixReader(connection));
+	NetworkHandler::Fork(new UnixWriter(connection));
+	return channel;
+}
+
+UnixAccepter::UnixAccepter(NetSocket* _socket,UnixSocketType _type,usign32 _bufSize,const std::string& _path)
+	:	socket(_socket),type(_type),bufSize(_bufSize),path(_path),closed(false),
+		//The UnixSocketAccepterChannel and the AccepterProcess:
+		references(2)
+{
+}
+
+void UnixAccepter::release()
+{
+	if (0 == AtomicDecrement(&references))
+	{
+		NetworkHandler::Close(socket);
+		delete this;
+	}
+}
+
+Mobile<UnixSocketChannel> UnixAccepter::start(NetSocket* connected)
+{
+	return UnixConnection::Start(connected,type,bufSize);
+}
+
+UDPConnection::UDPConnection(NetSocket* _socket,usign32 bufferSize,usign32 _maxDatagramSize)
+	:	socket(_socket),maxDatagramSize(_maxDatagramSize == 0 ? 1 : _maxDatagramSize),
+		fromNetwork(FIFOBuffer<UDPDatagram>::Factory(bufferSize == 0 ? 1 : bufferSize)),
+		toNetwork(FIFOBuffer<UDPDatagram>::Factory(bufferSize == 0 ? 1 : bufferSize)),
+		closed(false),
+		//The UDPSocketChannel, the UDPReader and the UDPWriter:
+		references(3)
+{
+}
+
+void UDPConnection::release()
+{
+	if (0 == AtomicDecrement(&references))
+	{
+		NetworkHandler::Close(socket);
+		delete this;
+	}
+}
+
+namespace csp
+{
+	TCPSocketChannel::~TCPSocketChannel()
+	{
+		connection->fromNetwork.reader().poison();
+		connection->toNetwork.writer().poison();
+		stopReading();
+		connection->release();
+	}
+
+	void TCPSocketChannel::receive(internal::TCPReceiver* receiver)
+	{
+		connection->startReading(receiver);
+	}
+
+	void TCPSocketChannel::stopReading()
+	{
+		//Wakes the TCPReader if it is waiting for data:
+		shutdown(connection->socket->fd,SHUT_RD);
+	}
+
+	TCPUDPAddress TCPSocketChannel::localAddress() const
+	{
+		sockaddr_storage addr;
+		socklen_t length = sizeof(addr);
+		memset(&addr,0,sizeof(addr));
+		getsockname(connection->socket->fd,reinterpret_cast<sockaddr*>(&addr),&length);
+		return FromSockAddr(addr);
+	}
+
+	TCPUDPAddress TCPSocketChannel::remoteAddress() const
+	{
+		sockaddr_storage addr;
+		socklen_t length = sizeof(addr);
+		memset(&addr,0,sizeof(addr));
+		getpeername(connection->socket->fd,reinterpret_cast<sockaddr*>(&addr),&length);
+		return FromSockAddr(addr);
+	}
+
+	TCPSocketAccepterChannel::~TCPSocketAccepterChannel()
+	{
+		accepter->closed = true;
+		accepter->channel.reader().poison();
+		//Wakes the AccepterProcess, which then finishes:
+		shutdown(accepter->socket->fd,SHUT_RDWR);
+		accepter->release();
+	}
+
+	TCPUDPAddress TCPSocketAccepterChannel::localAddress() const
+	{
+		sockaddr_storage addr;
+		socklen_t length = sizeof(addr);
+		memset(&addr,0,sizeof(addr));
+		getsockname(accepter->socket->fd,reinterpret_cast<sockaddr*>(&addr),&length);
+		return FromSockAddr(addr);
+	}
+
+	Mobile<TCPSocketChannel> ConnectTCPSocket(const TCPUDPAddress& address, const usign32 bufSize)
+	{
+		NetworkHandler::Start();
+
+		sockaddr_storage addr;
+		const socklen_t length = ToSockAddr(address.first,address.second,&addr);
+
+		const Socket fd = socket(addr.ss_family,SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC,0);
+		if (fd == -1)
+		{
+			throw OutOfResourcesException(ErrorString("Could not create socket"));
+		}
+
+		const int ret = connect(fd,reinterpret_cast<sockaddr*>(&addr),length);
+		if (ret == -1 && errno != EINPROGRESS && errno != EINTR)
+		{
+			close(fd);
+			return Mobile<TCPSocketChannel>();
+		}
+
+		NetSocket* socket = NetworkHandler::Add(fd);
+
+		if (ret == -1)
+		{
+			//The socket becomes writable when the connection is made (or fails); other processes run meanwhile:
+			socket->wait(NetSocket::Writable);
+
+			int error = 0;
+			socklen_t errorLength = sizeof(error);
+			if (0 != getsockopt(fd,SOL_SOCKET,SO_ERROR,&error,&errorLength) || error != 0)
+			{
+				NetworkHandler::Close(socket);
+				return Mobile<TCPSocketChannel>();
+			}
+		}
+
+		return TCPConnection::Start(socket,bufSize);
+	}
+
+	Mobile<TCPSocketAccepterChannel> OpenTCPSocketAccepter(const usign16 port, const NetworkInterface& netInterface, const usign32 bufSize)
+	{
+		NetworkHandler::Start();
+
+		sockaddr_storage addr;
+		const socklen_t length = ToSockAddr(netInterface,port,&addr);
+
+		const Socket fd = socket(addr.ss_family,SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC,0);
+		if (fd == -1)
+		{
+			throw OutOfResourcesException(ErrorString("Could not create socket"));
+		}
+
+		int one = 1;
+		setsockopt(fd,SOL_SOCKET,SO_REUSEADDR,&one,sizeof(one));
+
+		if (0 != bind(fd,reinterpret_cast<sockaddr*>(&addr),length) || 0 != listen(fd,SOMAXCONN))
+		{
+			close(fd);
+			return Mobile<TCPSocketAccepterChannel>();
+		}
+
+		TCPAccepter* accepter = new TCPAccepter(NetworkHandler::Add(fd),bufSize);
+		Mobile<TCPSocketAccepterChannel> channel(new TCPSocketAccepterChannel(accepter));
+		NetworkHandler::Fork(new AccepterProcess<TCPAccepter>(accepter));
+		return channel;
+	}
+
+	UDPSocketChannel::~UDPSocketChannel()
+	{
+		connection->closed = true;
+		connection->fromNetwork.reader().poison();
+		connection->toNetwork.writer().poison();
+		//Wakes the UDPReader if it is waiting for datagrams:
+		shutdown(connection->socket->fd,SHUT_RD);
+		connection->release();
+	}
+
+	Mobile<UDPSocketChannel> OpenUDPChannel(const usign16 port, const NetworkInterface& netInterface, const usign32 bufferSize, const usign32 maxDatagramSize)
+	{
+		NetworkHandler::Start();
+
+		sockaddr_storage addr;
+		const socklen_t length = ToSockAddr(netInterface,port,&addr);
+
+		const Socket fd = socket(addr.ss_family,SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC,0);
+		if (fd == -1)
+		{
+			throw OutOfResourcesException(ErrorString("Could not create socket"));
+		}
+
+		if (0 != bind(fd,reinterpret_cast<sockaddr*>(&addr),length))
+		{
+			close(fd);
+			return Mobile<UDPSocketChannel>();
+		}
+
+		UDPConnection* connection = new UDPConnection(NetworkHandler::Add(fd),bufferSize,maxDatagramSize);
+		Mobile<UDPSocketChannel> channel(new UDPSocketChannel(connection));
+		NetworkHandler::Fork(new UDPReader(connection));
+		NetworkHandler::Fork(new UDPWriter(connection));
+		return channel;
+	}
+
+	FileDescriptor::~FileDescriptor()
+	{
+		if (fd != -1)
+		{
+			close(fd);
+		}
+	}
+
+	UnixSocketChannel::~UnixSocketChannel()
+	{
+		connection->fromNetwork.reader().poison();
+		connection->toNetwork.writer().poison();
+		//Wakes the UnixReader if it is waiting for data:
+		shutdown(connection->socket->fd,SHUT_RD);
+		connection->release();
+	}
+
+	UnixSocketAccepterChannel::~UnixSocketAccepterChannel()
+	{
+		accepter->closed = true;
+		accepter->channel.reader().poison();
+		if (accepter->path[0] != '\0')
+		{
+			unlink(accepter->path.c_str());
+		}
+		//Wakes the AccepterProcess, which then finishes:
+		shutdown(accepter->socket->fd,SHUT_RDWR);
+		accepter->release();
+	}
+
+	Mobile<UnixSocketChannel> ConnectUnixSocket(const std::string& path, const UnixSocketType type, const usign32 bufSize)
+	{
+		NetworkHandler::Start();
+
+		sockaddr_un addr;
+		const socklen_t length = ToUnixAddr(path,&addr);
+		if (length == 0)
+		{
+			return Mobile<UnixSocketChannel>();
+		}
+
+		const Socket fd = socket(AF_UNIX,(type == UnixStream ? SOCK_STREAM : SOCK_SEQPACKET) | SOCK_NONBLOCK | SOCK_CLOEXEC,0);
+		if (fd == -1)
+		{
+			throw OutOfResourcesException(ErrorString("Could not create socket"));
+		}
+
+		//A Unix socket connects at once, unless the listener's backlog is full, in which case we try again shortly:
+		while (0 != connect(fd,reinterpret_cast<sockaddr*>(&addr),length))
+		{
+			if (errno == EAGAIN)
+			{
+				SleepFor(MilliSeconds(1));
+			}
+			else if (errno != EINTR)
+			{
+				close(fd);
+				return Mobile<UnixSocketChannel>();
+			}
+		}
+
+		return UnixConnection::Start(NetworkHandler::Add(fd),type,bufSize);
+	}
+
+	Mobile<UnixSocketAccepterChannel> OpenUnixSocketAccepter(const std::string& path, const UnixSocketType type, const usign32 bufSize)
+	{
+		NetworkHandler::Start();
+
+		sockaddr_un addr;
+		const socklen_t length = ToUnixAddr(path,&addr);
+		if (length == 0)
+		{
+			return Mobile<UnixSocketAccepterChannel>();
+		}
+
+		const Socket fd = socket(AF_UNIX,(type == UnixStream ? SOCK_STREAM : SOCK_SEQPACKET) | SOCK_NONBLOCK | SOCK_CLOEXEC,0);
+		if (fd == -1)
+		{
+			throw OutOfResourcesException(ErrorString("Could not create socket"));
+		}
+
+		if (0 != bind(fd,reinterpret_cast<sockaddr*>(&addr),length))
+		{
+			close(fd);
+			return Mobile<UnixSocketAccepterChannel>();
+		}
+
+		if (0 != listen(fd,SOMAXCONN))
+		{
+			close(fd);
+			if (path[0] != '\0')
+			{
+				unlink(path.c_str());
+			}
+			return Mobile<UnixSocketAccepterChannel>();
+		}
+
+		UnixAccepter* accepter = new UnixAccepter(NetworkHandler::Add(fd),type,bufSize,path);
+		Mobile<UnixSocketAccepterChannel> channel(new UnixSocketAccepterChannel(accepter));
+		NetworkHandler::Fork(new AccepterProcess<UnixAccepter>(accepter));
+		return channel;
+	}
+} //namespace csp
+
+#endif //CPPCSP_LINUX
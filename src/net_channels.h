@@ -1,5 +1,5 @@
 /*
-*	The Kent C++CSP Library 
+*	The Kent C++CSP Library
 *	Copyright (C) 2002-2007 Neil Brown
 *
 *	This library is free software; you can redistribute it and/or
@@ -17,97 +17,1133 @@
 *	Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
 */
 
+/** @file net_channels.h
+*	@brief Contains the TCP, UDP and Unix domain socket channels, and NetChannel
+*
+*	This file is \#included from cppcsp.h on Linux only
+*/
+
+#ifndef INCLUDED_FROM_CPPCSP_H
+#error This file should only be included by csp.h, not individually
+#endif
+
 #include <vector>
-#include <map>
+#include <algorithm>
+#include <string.h>
+#include <boost/type_traits/has_trivial_copy.hpp>
+#include <boost/type_traits/has_trivial_destructor.hpp>
 
 namespace csp
 {
+	class TCPSocketChannel;
+	class TCPSocketAccepterChannel;
+	class UDPSocketChannel;
+	class UnixSocketChannel;
+	class UnixSocketAccepterChannel;
+
+	/**
+	*	A UDP datagram, as sent and received on a UDPSocketChannel
+	*/
+	class UDPDatagram
+	{
+	public:
+		///The address that the datagram came from, or is to be sent to
+		TCPUDPAddress address;
+		///The payload of the datagram
+		std::vector<unsigned char> data;
+
+		inline UDPDatagram()
+		{
+		}
+
+		inline UDPDatagram(const TCPUDPAddress& _address,const std::vector<unsigned char>& _data)
+			:	address(_address),data(_data)
+		{
+		}
+	};
+
+	/**
+	*	An open file descriptor, which is closed when the object is destroyed.  It is held in a Mobile, so that it can be
+	*	passed between processes, and over a UnixSocketChannel to other programs, without being duplicated.
+	*/
+	class FileDescriptor : public boost::noncopyable
+	{
+	private:
+		int fd;
+	public:
+		///Takes ownership of the given descriptor
+		inline explicit FileDescriptor(int _fd)
+			:	fd(_fd)
+		{
+		}
+
+		///Closes the descriptor (unless it has been released)
+		~FileDescriptor();
+
+		///Gets the descriptor, which remains owned by this object
+		inline int get() const
+		{
+			return fd;
+		}
+
+		///Gives up ownership of the descriptor, returning it
+		inline int release()
+		{
+			const int ret = fd;
+			fd = -1;
+			return ret;
+		}
+	};
+
+	/**
+	*	The kinds of Unix domain socket
+	*/
+	enum UnixSocketType
+	{
+		///A byte stream, like TCP: the messages read need not match the messages written
+		UnixStream,
+		///Messages that arrive whole and in order, as they were written
+		UnixSeqPacket
+	};
+
+	/**
+	*	A message sent or received on a UnixSocketChannel: some bytes, and any file descriptors passed along with them
+	*/
+	class UnixMessage
+	{
+	public:
+		std::vector<unsigned char> data;
+		///Writing the message moves the descriptors (leaving these mobiles blank), and they are closed once sent
+		std::list< Mobile<FileDescriptor> > fds;
+	};
+
+	namespace internal
+	{
+		/**@internal
+		*	A non-blocking socket in the network handler's epoll set, and the process (if any) that is waiting for it
+		*	in each direction.
+		*
+		*	Sockets are registered edge-triggered, so the poller thread only hears when a socket becomes ready.  A process
+		*	must therefore read (or write) until the call would block before it waits.  An edge that arrives while
+		*	no process is waiting is remembered, so that the next wait() returns straight away.
+		*/
+		class NetSocket : public boost::noncopyable, private Primitive
+		{
+		public:
+			enum Direction
+			{
+				Readable = 0,
+				Writable = 1
+			};
+
+			const Socket fd;
+		private:
+			PureSpinMutex mutex;
+			ProcessPtr waiting[2];
+			bool ready[2];
+		public:
+			explicit NetSocket(Socket _fd);
+
+			/**@internal
+			*	Blocks the current process until the socket is (or may be) ready in the given direction.  The process
+			*	must have found the socket not ready in that direction since it last waited.
+			*/
+			void wait(Direction direction);
+
+			/**@internal
+			*	Called by the poller thread when the socket becomes ready in the given direction.
+			*/
+			void signal(Direction direction);
+		};
+
+		/**@internal
+		*	Runs all the sockets, without a thread per socket.
+		*
+		*	A poller thread waits on every socket at once with edge-triggered epoll, and frees the processes waiting
+		*	for them.  Those processes, which move data between each socket and its channels, are forked in the
+		*	kernel-thread of the NetworkHandler process.  Both threads are started on first use, and run until the
+		*	program exits.
+		*/
+		class NetworkHandler : public ThreadCSProcess
+		{
+		private:
+			BufferedAny2OneChannel<CSProcessPtr> requestChan;
+
+			static NetworkHandler* Instance;
+			static PureSpinMutex InstanceMutex;
+
+			static int EpollFd;
+			static bool PollerStarted;
+			///Sockets that have been closed, but that the poller may still have events for
+			static std::vector<NetSocket*> Retired;
+			static PureSpinMutex RetiredMutex;
+
+			NetworkHandler();
+			static void* PollerFunc(void*);
+		protected:
+			void run();
+		public:
+			/**@internal
+			*	Starts the poller thread and the NetworkHandler process, if they are not already running.
+			*/
+			static void Start();
+
+			/**@internal
+			*	Adds a non-blocking socket to the epoll set.  If it cannot be added, the socket is closed and
+			*	an OutOfResourcesException is thrown.
+			*/
+			static NetSocket* Add(Socket fd);
+
+			/**@internal
+			*	Removes a socket from the epoll set and closes it.  No process may be waiting for it.
+			*/
+			static void Close(NetSocket* socket);
+
+			/**@internal
+			*	Forks the given process in the network kernel-thread.  Does not block.
+			*/
+			static void Fork(CSProcessPtr process);
+		};
+
+		/**@internal
+		*	Takes the data read from a TCP socket in place of the socket's fromNetwork channel (see TCPSocketChannel::receive()).
+		*	Its methods are called by the process that reads the socket, in the network thread.
+		*/
+		class TCPReceiver
+		{
+		public:
+			/**@internal
+			*	Called with each piece of data as it is read, straight from the buffer it was read into.  Returns false
+			*	to stop reading.  May throw a PoisonException, which also stops reading.
+			*/
+			virtual bool received(const unsigned char* data,size_t size) = 0;
+
+			/**@internal
+			*	Called once no more data will be given to the receiver, which must not be used again.
+			*/
+			virtual void finished() = 0;
+
+			virtual ~TCPReceiver() {}
+		};
+
+		/**@internal
+		*	A connected TCP socket and its channels.  It is shared by the TCPSocketChannel and the two processes
+		*	that serve it (one per direction), and is deleted (closing the socket) once all three have finished with it.
+		*	The process that reads the socket is only started once something wants the data.
+		*/
+		class TCPConnection : public boost::noncopyable
+		{
+		public:
+			NetSocket* const socket;
+			///The most that is read from the socket at once
+			const usign32 bufSize;
+			BufferedOne2OneChannel< std::vector<unsigned char> > fromNetwork;
+			BufferedOne2OneChannel< Mobile< std::vector<unsigned char> > > toNetwork;
+			///Whether the socket is being read, into fromNetwork or a TCPReceiver
+			bool reading;
+		private:
+			__CPPCSP_ALIGNED_USIGN32 references;
+		public:
+			TCPConnection(NetSocket* _socket,usign32 _bufSize);
+
+			void release();
+
+			/**@internal
+			*	Starts reading the socket, into the receiver if it is not NULL, or else into fromNetwork.  If the socket
+			*	is already being read into fromNetwork, the receiver is fed from there instead.
+			*/
+			void startReading(TCPReceiver* receiver);
+
+			/**@internal
+			*	Starts serving a connected socket, and returns the channel for it.
+			*/
+			static Mobile<TCPSocketChannel> Start(NetSocket* socket,usign32 bufSize);
+		};
+
+		/**@internal
+		*	A listening TCP socket and the channel that its connections are sent down.  It is shared by the
+		*	TCPSocketAccepterChannel and the process that accepts the connections.
+		*/
+		class TCPAccepter : public boost::noncopyable
+		{
+		public:
+			typedef TCPSocketChannel Channel;
+
+			NetSocket* const socket;
+			///The bufSize of the accepted connections
+			const usign32 bufSize;
+			One2OneChannel< Mobile<TCPSocketChannel> > channel;
+			///Set when the TCPSocketAccepterChannel is destroyed, to stop the accepting process
+			volatile bool closed;
+		private:
+			__CPPCSP_ALIGNED_USIGN32 references;
+		public:
+			TCPAccepter(NetSocket* _socket,usign32 _bufSize);
+
+			void release();
+
+			///Starts serving an accepted connection
+			Mobile<TCPSocketChannel> start(NetSocket* connected);
+		};
+
+		/**@internal
+		*	A connected Unix domain socket and its channels.  It is shared like a TCPConnection.
+		*/
+		class UnixConnection : public boost::noncopyable
+		{
+		public:
+			NetSocket* const socket;
+			const UnixSocketType type;
+			///The most that is read from the socket at once
+			const usign32 bufSize;
+			BufferedOne2OneChannel<UnixMessage> fromNetwork;
+			BufferedOne2OneChannel<UnixMessage> toNetwork;
+
+			///The number of messages that each channel holds
+			static const usign32 BufferedMessages = 16;
+		private:
+			__CPPCSP_ALIGNED_USIGN32 references;
+		public:
+			UnixConnection(NetSocket* _socket,UnixSocketType _type,usign32 _bufSize);
+
+			void release();
+
+			/**@internal
+			*	Starts serving a connected socket, and returns the channel for it.
+			*/
+			static Mobile<UnixSocketChannel> Start(NetSocket* socket,UnixSocketType type,usign32 bufSize);
+		};
+
+		/**@internal
+		*	A listening Unix domain socket.  It is shared like a TCPAccepter.
+		*/
+		class UnixAccepter : public boost::noncopyable
+		{
+		public:
+			typedef UnixSocketChannel Channel;
+
+			NetSocket* const socket;
+			const UnixSocketType type;
+			///The bufSize of the accepted connections
+			const usign32 bufSize;
+			One2OneChannel< Mobile<UnixSocketChannel> > channel;
+			///The path the socket is bound to, which is removed when the socket is closed
+			const std::string path;
+			///Set when the UnixSocketAccepterChannel is destroyed, to stop the accepting process
+			volatile bool closed;
+		private:
+			__CPPCSP_ALIGNED_USIGN32 references;
+		public:
+			UnixAccepter(NetSocket* _socket,UnixSocketType _type,usign32 _bufSize,const std::string& _path);
+
+			void release();
+
+			///Starts serving an accepted connection
+			Mobile<UnixSocketChannel> start(NetSocket* connected);
+		};
+
+		/**@internal
+		*	A bound UDP socket and its channels.  It is shared by the UDPSocketChannel and the two processes that serve it
+		*	(one per direction), and is deleted (closing the socket) once all three have finished with it.
+		*/
+		class UDPConnection : public boost::noncopyable
+		{
+		public:
+			NetSocket* const socket;
+			///The largest datagram that can be received
+			const usign32 maxDatagramSize;
+			BufferedOne2OneChannel<UDPDatagram> fromNetwork;
+			BufferedOne2OneChannel<UDPDatagram> toNetwork;
+			///Set when the UDPSocketChannel is destroyed, to stop the UDPReader
+			volatile bool closed;
+		private:
+			__CPPCSP_ALIGNED_USIGN32 references;
+		public:
+			UDPConnection(NetSocket* _socket,usign32 bufferSize,usign32 _maxDatagramSize);
+
+			void release();
+		};
+	} //namespace internal
+
+	/**
+	*	A connected TCP socket, used through a pair of channels: reading from reader() receives data from the network, and
+	*	writing to writer() sends it.  They are obtained from ConnectTCPSocket() or from a TCPSocketAccepterChannel.
+	*
+	*	The data is a stream of bytes, so the vectors read need not match the vectors written at the other end; a
+	*	read returns everything that has arrived since the last read, up to (roughly) the buffer size of the channel.
+	*
+	*	The vectors written are mobiles, so they are queued and sent without being copied:
+	*	@code
+		Mobile< std::vector<unsigned char> > message(new std::vector<unsigned char>);
+		//... fill in *message ...
+		chan->writer() << message; //message is now blank
+		@endcode
+	*	Everything written since the socket last had room is sent together by one sendmsg() call, so many small writes do not
+	*	each cost a system call.  Large buffers are sent with MSG_ZEROCOPY, where the kernel supports it, so that the kernel does not
+	*	copy them either.  Writes only block when the buffer is full.  When the other end closes
+	*	the connection (or it fails), the reading end is poisoned once the data that arrived before has been read;
+	*	if the connection fails, the writing end is poisoned too.
+	*
+	*	Poisoning the writing end closes the sending side of the socket once everything written has been sent.  Destroying
+	*	the TCPSocketChannel does the same, and stops reading.  The reading end can be used in an alt.
+	*
+	*	All the sockets are run by one extra kernel-thread and one poller thread (using edge-triggered epoll), however many
+	*	sockets there are.
+	*/
 	class TCPSocketChannel : public boost::noncopyable
 	{
 	private:
-		BufferedOne2OneChannel< std::vector<unsigned char> > fromNetwork;
-		BufferedOne2OneChannel< std::vector<unsigned char> > toNetwork;
-		
-		inline explicit TCPSocketChannel(const usign32 bufSize)
-			:	fromNetwork(PrimitiveAggregatingFIFOBuffer<unsigned char>::Factory(bufSize)),
-				toNetwork(PrimitiveAggregatingFIFOBuffer<unsigned char>::Factory(bufSize))
+		internal::TCPConnection* const connection;
+
+		inline explicit TCPSocketChannel(internal::TCPConnection* _connection)
+			:	connection(_connection)
 		{
 		}
-		
+
+		friend class internal::TCPConnection;
 	public:
-	
-		AltChanin< std::vector<unsigned char> > reader()
+		~TCPSocketChannel();
+
+		/**
+		*	Gets the reading end, which receives the data that arrives from the network
+		*/
+		inline AltChanin< std::vector<unsigned char> > reader()
 		{
-			return fromNetwork.reader();
+			if (false == connection->reading)
+			{
+				connection->startReading(NULL);
+			}
+			return connection->fromNetwork.reader();
 		}
-		
-		Chanout< std::vector<unsigned char> > writer()
+
+		/**
+		*	Gets the writing end, which sends data over the network
+		*/
+		inline Chanout< Mobile< std::vector<unsigned char> > > writer()
 		{
-			return toNetwork.writer();
+			return connection->toNetwork.writer();
 		}
-	};	
-	
+
+		/**
+		*	Gets the address and port of this end of the connection
+		*/
+		TCPUDPAddress localAddress() const;
+
+		/**
+		*	Gets the address and port of the other end of the connection
+		*/
+		TCPUDPAddress remoteAddress() const;
+
+		/**@internal
+		*	Has the data that arrives given to the receiver as it is read, rather than copied into the reading end
+		*	(which is then never poisoned by the connection).  This is how NetChannel parses its frames where
+		*	they are received.  It should be called before reader() is used, and only once.
+		*/
+		void receive(internal::TCPReceiver* receiver);
+
+		/**@internal
+		*	Stops reading from the socket, waking the process that reads it
+		*/
+		void stopReading();
+	};
+
+	/**
+	*	A listening TCP socket, obtained from OpenTCPSocketAccepter().  Each connection that is made to it
+	*	is sent down the channel, as a TCPSocketChannel.
+	*
+	*	Connections are only accepted while a process is reading from the channel; the rest wait in the operating
+	*	system's queue.  Destroying the TCPSocketAccepterChannel closes the socket.
+	*/
 	class TCPSocketAccepterChannel : public boost::noncopyable
 	{
-		One2OneChannel< Mobile<TCPSocketChannel> > channel;
-		
-		
+	private:
+		internal::TCPAccepter* const accepter;
+
+		inline explicit TCPSocketAccepterChannel(internal::TCPAccepter* _accepter)
+			:	accepter(_accepter)
+		{
+		}
+
+		friend Mobile<TCPSocketAccepterChannel> OpenTCPSocketAccepter(const usign16 port, const NetworkInterface& netInterface, const usign32 bufSize);
 	public:
-		AltChanin< Mobile<TCPSocketChannel> > reader()
+		~TCPSocketAccepterChannel();
+
+		/**
+		*	Gets the reading end, which receives the new connections
+		*/
+		inline AltChanin< Mobile<TCPSocketChannel> > reader()
 		{
-			return channel.reader();
+			return accepter->channel.reader();
 		}
+
+		/**
+		*	Gets the address and port that the socket is listening on; this is how to find the port chosen when
+		*	OpenTCPSocketAccepter() is given port 0
+		*/
+		TCPUDPAddress localAddress() const;
 	};
 
+	/**
+	*	Connects to a listening TCP socket.  Other processes in the same thread continue to run while the connection is made.
+	*
+	*	@param address The address and port to connect to
+	*	@param bufSize The size of the buffers (in bytes) of the channel's two ends
+	*	@return The connected channel, or a blank mobile if the connection could not be made
+	*/
 	Mobile<TCPSocketChannel> ConnectTCPSocket(const TCPUDPAddress& address, const usign32 bufSize);
-	
-	Mobile<TCPSocketAccepterChannel> OpenTCPSocketAccepter(const usign16 port, const NetworkInterface& netInterface, const usign32 bufSize /*of the new channels*/);
+
+	/**
+	*	Opens a listening TCP socket.
+	*
+	*	@param port The port to listen on
+	*	@param netInterface The address of the interface to listen on, such as IPAddress_Any
+	*	@param bufSize The size of the buffers (in bytes) of the channels of the accepted connections
+	*	@return The accepter channel, or a blank mobile if the socket could not be opened (for example, if the port is already in use)
+	*/
+	Mobile<TCPSocketAccepterChannel> OpenTCPSocketAccepter(const usign16 port, const NetworkInterface& netInterface, const usign32 bufSize);
+
+	/**
+	*	A bound UDP socket, obtained from OpenUDPChannel().  Reading from reader() receives the datagrams that arrive
+	*	at the socket, along with the address each came from; writing a datagram to writer() sends it to the address
+	*	given in it:
+	*	@code
+		Mobile<UDPSocketChannel> chan = OpenUDPChannel(9000,IPAddress_Any);
+		UDPDatagram datagram;
+		chan->reader() >> datagram;
+		//Reply to the sender:
+		chan->writer() << datagram;
+		@endcode
+	*
+	*	The socket is served by the same network thread as the TCP socket channels.  Datagrams are received in batches
+	*	with recvmmsg(), and everything written since the socket last sent is sent together with sendmmsg(), so a burst
+	*	of datagrams costs one system call per batch rather than one per datagram.
+	*
+	*	UDP is unreliable, and so is this channel: datagrams that arrive while the reading end's buffer is full wait in the
+	*	socket's buffer, and are dropped by the operating system when that fills.  Datagrams longer than the maximum size
+	*	given to OpenUDPChannel() are dropped, as are datagrams that cannot be sent (for example, to an address of the
+	*	other IP version than the socket's).
+	*
+	*	Poisoning the writing end stops sending once everything written has been sent.  Destroying the UDPSocketChannel
+	*	does the same, and closes the socket.  The reading end can be used in an alt.
+	*/
+	class UDPSocketChannel : public boost::noncopyable
+	{
+	private:
+		internal::UDPConnection* const connection;
+
+		inline explicit UDPSocketChannel(internal::UDPConnection* _connection)
+			:	connection(_connection)
+		{
+		}
+
+		friend Mobile<UDPSocketChannel> OpenUDPChannel(const usign16 port, const NetworkInterface& netInterface, const usign32 bufferSize, const usign32 maxDatagramSize);
+	public:
+		~UDPSocketChannel();
+
+		/**
+		*	Gets the reading end, which receives the datagrams that arrive at the socket
+		*/
+		inline AltChanin<UDPDatagram> reader()
+		{
+			return connection->fromNetwork.reader();
+		}
+
+		/**
+		*	Gets the writing end, which sends datagrams from the socket
+		*/
+		inline Chanout<UDPDatagram> writer()
+		{
+			return connection->toNetwork.writer();
+		}
+	};
+
+	/**
+	*	Opens a UDP socket.
+	*
+	*	@param port The port to bind to
+	*	@param netInterface The address of the interface to bind to, such as IPAddress_Any.  Datagrams can only be sent
+	*	to addresses of the same IP version
+	*	@param bufferSize The number of datagrams that each end of the channel can hold
+	*	@param maxDatagramSize The largest datagram (in bytes) that can be received; longer ones are dropped
+	*	@return The channel, or a blank mobile if the socket could not be bound (for example, if the port is already in use)
+	*/
+	Mobile<UDPSocketChannel> OpenUDPChannel(const usign16 port, const NetworkInterface& netInterface, const usign32 bufferSize = 1024, const usign32 maxDatagramSize = 2048);
+
+	/**
+	*	A connected Unix domain socket, for talking to other programs on the same machine without going through the TCP stack.
+	*	It is obtained from ConnectUnixSocket() or from a UnixSocketAccepterChannel, and is used like a TCPSocketChannel,
+	*	except that the data is sent and received as UnixMessages.
+	*
+	*	As well as bytes, a message can carry open file descriptors (using SCM_RIGHTS), which arrive at the other program
+	*	as new descriptors for the same open files.  So a process can hand a file or socket to another program without
+	*	any of its data being copied:
+	*	@code
+		UnixMessage message;
+		message.data.push_back('F');
+		message.fds.push_back(Mobile<FileDescriptor>(new FileDescriptor(open("log.txt",O_RDONLY))));
+		chan->writer() << message;	//message.fds now holds a blank mobile, and our copy of the descriptor is closed once sent
+		@endcode
+	*
+	*	With UnixStream, the bytes are a stream as for TCP; the descriptors arrive with the bytes that were sent with
+	*	them, and a read never joins bytes that carry descriptors onto bytes sent by an earlier write.  Descriptors
+	*	must be sent with at least one byte.  With UnixSeqPacket, each message arrives whole; messages longer than the
+	*	bufSize of the receiving end are dropped, and empty messages without descriptors are not sent.
+	*
+	*	Each end of the channel holds up to 16 messages.  Closing and poisoning behave as they do for a TCPSocketChannel,
+	*	and the reading end can be used in an alt.
+	*/
+	class UnixSocketChannel : public boost::noncopyable
+	{
+	private:
+		internal::UnixConnection* const connection;
+
+		inline explicit UnixSocketChannel(internal::UnixConnection* _connection)
+			:	connection(_connection)
+		{
+		}
+
+		friend class internal::UnixConnection;
+	public:
+		~UnixSocketChannel();
+
+		/**
+		*	Gets the reading end, which receives the messages that arrive on the socket
+		*/
+		inline AltChanin<UnixMessage> reader()
+		{
+			return connection->fromNetwork.reader();
+		}
+
+		/**
+		*	Gets the writing end, which sends messages on the socket
+		*/
+		inline Chanout<UnixMessage> writer()
+		{
+			return connection->toNetwork.writer();
+		}
+	};
+
+	/**
+	*	A listening Unix domain socket, obtained from OpenUnixSocketAccepter().  Each connection that is made to it
+	*	is sent down the channel, as a UnixSocketChannel.
+	*
+	*	Destroying the UnixSocketAccepterChannel closes the socket, and removes its path from the file system.
+	*/
+	class UnixSocketAccepterChannel : public boost::noncopyable
+	{
+	private:
+		internal::UnixAccepter* const accepter;
+
+		inline explicit UnixSocketAccepterChannel(internal::UnixAccepter* _accepter)
+			:	accepter(_accepter)
+		{
+		}
+
+		friend Mobile<UnixSocketAccepterChannel> OpenUnixSocketAccepter(const std::string& path, const UnixSocketType type, const usign32 bufSize);
+	public:
+		~UnixSocketAccepterChannel();
+
+		/**
+		*	Gets the reading end, which receives the new connections
+		*/
+		inline AltChanin< Mobile<UnixSocketChannel> > reader()
+		{
+			return accepter->channel.reader();
+		}
+	};
+
+	/**
+	*	Connects to a listening Unix domain socket.  Other processes in the same thread continue to run while the connection is made.
+	*
+	*	@param path The path of the socket.  A path beginning with a zero byte is in Linux's abstract namespace
+	*	@param type The kind of socket, which must match the listening socket
+	*	@param bufSize The largest read (in bytes) from the socket, which for UnixSeqPacket is the largest message that can be received
+	*	@return The connected channel, or a blank mobile if the connection could not be made
+	*/
+	Mobile<UnixSocketChannel> ConnectUnixSocket(const std::string& path, const UnixSocketType type, const usign32 bufSize);
+
+	/**
+	*	Opens a listening Unix domain socket.
+	*
+	*	@param path The path to bind the socket to, which must not already exist.  A path beginning with a zero byte is in
+	*	Linux's abstract namespace
+	*	@param type The kind of socket
+	*	@param bufSize The largest read (in bytes) from the accepted connections, which for UnixSeqPacket is the largest message that can be received
+	*	@return The accepter channel, or a blank mobile if the socket could not be opened (for example, if the path already exists)
+	*/
+	Mobile<UnixSocketAccepterChannel> OpenUnixSocketAccepter(const std::string& path, const UnixSocketType type, const usign32 bufSize);
+
+	/**
+	*	The default serializer for a NetChannel, which sends values as their bytes in memory.
+	*
+	*	The value is simply copied into and out of the frame, so DATA_TYPE must be trivially copyable (this is checked
+	*	when compiling) and must not contain pointers.  Both ends must also agree on its layout (size, padding and
+	*	byte order), so this is only suitable for talking to the same program built for the same kind of machine.
+	*
+	*	To send other types, specialize NetSerializer for them (as is done for std::string and std::vector<unsigned char>),
+	*	or pass a different serializer to NetChannel.  A serializer must have these two static functions:
+	*	@code
+		//Appends the encoding of value to the end of buffer:
+		static void Write(const DATA_TYPE& value,std::vector<unsigned char>& buffer);
+
+		//Decodes a value from the size bytes of a frame, returning false if they are not a valid encoding:
+		static bool Read(const unsigned char* data,usign32 size,DATA_TYPE* value);
+		@endcode
+	*
+	*	Read() is given the frame where it lies in the received data, so it should decode straight from there.
+	*/
+	template <typename DATA_TYPE>
+	class NetSerializer
+	{
+	private:
+		BOOST_STATIC_ASSERT(boost::has_trivial_copy<DATA_TYPE>::value && boost::has_trivial_destructor<DATA_TYPE>::value);
+	public:
+		static void Write(const DATA_TYPE& value,std::vector<unsigned char>& buffer)
+		{
+			const unsigned char* bytes = reinterpret_cast<const unsigned char*>(&value);
+			buffer.insert(buffer.end(),bytes,bytes + sizeof(DATA_TYPE));
+		}
+
+		static bool Read(const unsigned char* data,usign32 size,DATA_TYPE* value)
+		{
+			if (size != sizeof(DATA_TYPE))
+			{
+				return false;
+			}
+			memcpy(value,data,sizeof(DATA_TYPE));
+			return true;
+		}
+	};
+
+	///Sends a string as its characters
+	template <>
+	class NetSerializer<std::string>
+	{
+	public:
+		static void Write(const std::string& value,std::vector<unsigned char>& buffer)
+		{
+			buffer.insert(buffer.end(),value.begin(),value.end());
+		}
+
+		static bool Read(const unsigned char* data,usign32 size,std::string* value)
+		{
+			value->assign(reinterpret_cast<const char*>(data),size);
+			return true;
+		}
+	};
+
+	///Sends a byte vector as it is, so that NetChannel can carry messages of raw bytes
+	template <>
+	class NetSerializer< std::vector<unsigned char> >
+	{
+	public:
+		static void Write(const std::vector<unsigned char>& value,std::vector<unsigned char>& buffer)
+		{
+			buffer.insert(buffer.end(),value.begin(),value.end());
+		}
+
+		static bool Read(const unsigned char* data,usign32 size,std::vector<unsigned char>* value)
+		{
+			value->assign(data,data + size);
+			return true;
+		}
+	};
+
+	/**
+	*	The reading end of a NetChannel.  It is an ordinary AltChanin, so it can be used in an Alternative.
+	*/
+	template <typename DATA_TYPE>
+	class NetChanin : public AltChanin<DATA_TYPE>
+	{
+	public:
+		inline explicit NetChanin(const AltChanin<DATA_TYPE>& in)
+			:	AltChanin<DATA_TYPE>(in)
+		{
+		}
+	};
+
+	/**
+	*	The writing end of a NetChannel.  It is an ordinary Chanout.
+	*/
+	template <typename DATA_TYPE>
+	class NetChanout : public Chanout<DATA_TYPE>
+	{
+	public:
+		inline explicit NetChanout(const Chanout<DATA_TYPE>& out)
+			:	Chanout<DATA_TYPE>(out)
+		{
+		}
+	};
 
 	namespace internal
 	{
-		typedef std::pair< Chanin< std::vector<unsigned char> > , Chanout< std::vector<unsigned char> > > NetChanPair;
+		/**@internal
+		*	The frame format of NetChannel: each value is sent as a four-byte length (in network byte order) followed by that
+		*	many bytes from the serializer.
+		*
+		*	A length above MaxSize is not a frame, but a marker on its own.  NetChannel sends none; the named channels
+		*	send PoisonMarker when their writing end is poisoned.
+		*/
+		class NetFrame
+		{
+		public:
+			static const usign32 HeaderSize = 4;
+			///Frames longer than this are taken to be corrupt
+			static const usign32 MaxSize = 0x40000000;
+			static const usign32 PoisonMarker = 0xFFFFFFFF;
+
+			static inline usign32 ReadLength(const unsigned char* header)
+			{
+				return (static_cast<usign32>(header[0]) << 24) | (static_cast<usign32>(header[1]) << 16)
+					| (static_cast<usign32>(header[2]) << 8) | static_cast<usign32>(header[3]);
+			}
 
-		class SocketConnectRequest
+			static inline void WriteLength(unsigned char* header,usign32 length)
+			{
+				header[0] = static_cast<unsigned char>(length >> 24);
+				header[1] = static_cast<unsigned char>(length >> 16);
+				header[2] = static_cast<unsigned char>(length >> 8);
+				header[3] = static_cast<unsigned char>(length);
+			}
+		};
+
+		/**@internal
+		*	Splits the data that arrives on a socket into frames.  Whole frames are passed on where they lie in the
+		*	received data; only a frame that is split between two reads is put together in a separate buffer first.
+		*/
+		class NetFrameParser
+		{
+		private:
+			std::vector<unsigned char> partial;
+		public:
+			/**
+			*	Passes each frame that the data completes to handler.frame(data,size), and each marker to handler.marker(length).
+			*	Either returns false to stop parsing, in which case this returns false and the parser must not be used again.
+			*/
+			template <typename HANDLER>
+			inline bool parse(const std::vector<unsigned char>& data,HANDLER& handler)
+			{
+				return data.empty() || parse(&(data[0]),data.size(),handler);
+			}
+
+			///As above, for the size bytes at data
+			template <typename HANDLER>
+			bool parse(const unsigned char* data,size_t size,HANDLER& handler)
+			{
+				const unsigned char* next = data;
+				const unsigned char* const end = next + size;
+
+				//Finish the frame left over from the last read, a piece at a time:
+				while (next != end && false == partial.empty())
+				{
+					usign32 wanted = NetFrame::HeaderSize;
+					if (partial.size() >= NetFrame::HeaderSize)
+					{
+						wanted += NetFrame::ReadLength(&(partial[0]));
+					}
+
+					const size_t taken = std::min<size_t>(wanted - partial.size(),end - next);
+					partial.insert(partial.end(),next,next + taken);
+					next += taken;
+
+					if (partial.size() < NetFrame::HeaderSize)
+					{
+						continue;
+					}
+
+					const usign32 length = NetFrame::ReadLength(&(partial[0]));
+					if (length > NetFrame::MaxSize)
+					{
+						partial.clear();
+						if (false == handler.marker(length))
+						{
+							return false;
+						}
+					}
+					else if (partial.size() == NetFrame::HeaderSize + length)
+					{
+						const bool ok = handler.frame(&(partial[0]) + NetFrame::HeaderSize,length);
+						partial.clear();
+						if (false == ok)
+						{
+							return false;
+						}
+					}
+				}
+
+				//Then the whole frames straight out of the data:
+				while (static_cast<size_t>(end - next) >= NetFrame::HeaderSize)
+				{
+					const usign32 length = NetFrame::ReadLength(next);
+					if (length > NetFrame::MaxSize)
+					{
+						next += NetFrame::HeaderSize;
+						if (false == handler.marker(length))
+						{
+							return false;
+						}
+					}
+					else if (static_cast<size_t>(end - next) - NetFrame::HeaderSize < length)
+					{
+						break;
+					}
+					else
+					{
+						const unsigned char* frame = next + NetFrame::HeaderSize;
+						next += NetFrame::HeaderSize + length;
+						if (false == handler.frame(frame,length))
+						{
+							return false;
+						}
+					}
+				}
+
+				if (next != end)
+				{
+					partial.assign(next,end);
+				}
+				return true;
+			}
+		};
+
+		/**@internal
+		*	The state of a NetChannel, shared by the NetChannel and the two processes that encode and decode its frames.
+		*	It is deleted (closing the socket) once all three have finished with it.
+		*/
+		template <typename DATA_TYPE>
+		class NetChannelState : public boost::noncopyable
 		{
 		public:
-			TCPUDPAddress address;
-			usign32 bufSize;
-			NetChanPair channels;
+			Mobile<TCPSocketChannel> socket;
+			BufferedOne2OneChannel<DATA_TYPE> fromNetwork;
+			BufferedOne2OneChannel<DATA_TYPE> toNetwork;
+		private:
+			__CPPCSP_ALIGNED_USIGN32 references;
+		public:
+			inline NetChannelState(const Mobile<TCPSocketChannel>& _socket,usign32 bufferSize)
+				:	socket(_socket),
+					fromNetwork(typename FIFOBuffer<DATA_TYPE>::Factory(bufferSize == 0 ? 1 : bufferSize)),
+					toNetwork(typename FIFOBuffer<DATA_TYPE>::Factory(bufferSize == 0 ? 1 : bufferSize)),
+					//The NetChannel, the NetDecoder and the NetEncoder:
+					references(3)
+			{
+			}
+
+			void release()
+			{
+				if (0 == AtomicDecrement(&references))
+				{
+					delete this;
+				}
+			}
 		};
-		
-		class SocketOpenAcceptRequest
+
+		/**@internal
+		*	Parses the frames out of the data that arrives on a socket, and sends the values down the NetChannel.
+		*	It is given the data by the process that reads the socket, as it is read (see TCPSocketChannel::receive()),
+		*	so the frames are parsed straight out of the buffer that was read into.
+		*/
+		template <typename DATA_TYPE,typename SERIALIZER>
+		class NetDecoder : public TCPReceiver
 		{
+		private:
+			NetChannelState<DATA_TYPE>* const state;
+			Chanout<DATA_TYPE> out;
+			NetFrameParser parser;
+			DATA_TYPE value;
 		public:
-			usign16 port;
-			NetworkInterface netInterface;			
+			inline explicit NetDecoder(NetChannelState<DATA_TYPE>* _state)
+				:	state(_state),out(_state->fromNetwork.writer())
+			{
+			}
+
+			virtual bool received(const unsigned char* data,size_t size)
+			{
+				return parser.parse(data,size,*this);
+			}
+
+			virtual void finished()
+			{
+				out.poison();
+				NetChannelState<DATA_TYPE>* const s = state;
+				delete this;
+				s->release();
+			}
+
+			///Decodes one frame and sends the value on.  Returns false if the frame is not valid
+			bool frame(const unsigned char* data,usign32 size)
+			{
+				if (false == SERIALIZER::Read(data,size,&value))
+				{
+					return false;
+				}
+				out << value;
+				return true;
+			}
+
+			///NetChannel sends no markers, so they are not valid
+			inline bool marker(usign32)
+			{
+				return false;
+			}
 		};
-		
-		typedef std::pair< boost::variant<SocketConnectRequest,SocketOpenAcceptRequest> , Chanout<bool> > SocketRequest;
-
-		class NetworkHandler
-		{
-		private:	
-			std::map< Socket, NetChanPair > tcpSockets;
-			std::map< Socket, NetChanPair > udpSockets;
-			
-			BufferedAny2OneChannel< SocketRequest > requestChan;
-			Chanin< SocketRequest > requestIn;
-			static Chanout< SocketRequest > requestOut;
-			
-			Time selectTimeout;
-			
-			class Writer  : public ThreadCSProcess {};
-			class Reader  : public ThreadCSProcess {};
+
+		/**@internal
+		*	Frames the values written to a NetChannel, and sends them on the socket.  Everything written since the last
+		*	send (up to BatchSize bytes) is framed into one buffer, which the socket then sends without copying.
+		*/
+		template <typename DATA_TYPE,typename SERIALIZER>
+		class NetEncoder : public CSProcess
+		{
+		private:
+			NetChannelState<DATA_TYPE>* const state;
+			DATA_TYPE value;
+
+			void encode(std::vector<unsigned char>& buffer)
+			{
+				const size_t start = buffer.size();
+				buffer.resize(start + NetFrame::HeaderSize);
+				SERIALIZER::Write(value,buffer);
+				NetFrame::WriteLength(&(buffer[start]),static_cast<usign32>(buffer.size() - start - NetFrame::HeaderSize));
+			}
 		protected:
-			void run();
+			void run()
+			{
+				AltChanin<DATA_TYPE> in = state->toNetwork.reader();
+				Chanout< Mobile< std::vector<unsigned char> > > out = state->socket->writer();
+				bool open = true;
+
+				try
+				{
+					while (open)
+					{
+						Mobile< std::vector<unsigned char> > buffer(new std::vector<unsigned char>);
+						try
+						{
+							in >> value;
+							encode(*buffer);
+							while (buffer->size() < BatchSize && in.pending())
+							{
+								in >> value;
+								encode(*buffer);
+							}
+						}
+						catch (PoisonException&)
+						{
+							//Send what we have first:
+							open = false;
+						}
+
+						if (false == buffer->empty())
+						{
+							out << buffer;
+						}
+					}
+				}
+				catch (PoisonException&)
+				{
+					//The connection has failed
+				}
+
+				in.poison();
+				//Closes our side of the connection, once everything has been sent:
+				out.poison();
+				state->release();
+			}
 		public:
-		
-			friend Mobile<TCPSocketChannel> ConnectTCPSocket(const TCPUDPAddress& address, const usign32 bufSize);
-			friend Mobile<TCPSocketAccepterChannel> OpenTCPSocketAccepter(const usign16 port, const NetworkInterface& netInterface, const usign32 bufSize /*of the new channels*/);
+			static const size_t BatchSize = 65536;
+
+			inline explicit NetEncoder(NetChannelState<DATA_TYPE>* _state)
+				:	state(_state)
+			{
+			}
 		};
-	
-	} //namespace internal	
+	} //namespace internal
 
-} //namespace csp
+	/**
+	*	A channel that carries values of DATA_TYPE over a TCP connection, between two programs that each have a NetChannel on
+	*	either end of the connection.  Values written to writer() at one end arrive, in order, at reader() at the other end:
+	*	@code
+		struct Reading
+		{
+			usign32 sensor;
+			double value;
+		};
+
+		//In the server:
+		Mobile<TCPSocketChannel> connection;
+		accepter->reader() >> connection;
+		NetChannel<Reading> chan(connection);
+		Reading reading;
+		chan.reader() >> reading;
 
+		//In the client:
+		NetChannel<Reading> chan(ConnectTCPSocket(TCPUDPAddress(IPAddress_Localhost,port),65536));
+		chan.writer() << reading;
+		@endcode
+	*
+	*	Each value is sent as a frame: a four-byte length, in network byte order, and then the bytes that SERIALIZER gives
+	*	for the value.  By default, that is NetSerializer, which copies the value's bytes for trivially copyable types.
+	*	Values written in quick succession are framed into one buffer and sent together.  The frames that arrive are
+	*	parsed by the process that reads the socket, straight out of the buffer it reads into, and the values are sent
+	*	on from there; only a frame split between two reads is copied first.  The framing and the parsing are done in
+	*	the network thread (see TCPSocketChannel), so they do not slow the processes using the channel.
+	*
+	*	The channel is buffered at both ends, holding up to bufferSize values.  The reading end can be used in an
+	*	Alternative, and only ever has whole values ready.
+	*
+	*	If the connection closes, fails or receives a frame that cannot be decoded, the reading end is poisoned (once
+	*	the values that arrived before have been read), and nothing more is read from the connection.  If the connection fails, the
+	*	writing end is poisoned too.  Poisoning the writing end closes the sending side of the connection once
+	*	everything written has been sent.  Destroying the NetChannel does the same, and stops reading.
+	*
+	*	@section tempreq DATA_TYPE Requirements
+	*
+	*	DATA_TYPE must be default-constructible and assignable, and SERIALIZER must be able to encode and decode it.
+	*/
+	template <typename DATA_TYPE,typename SERIALIZER = NetSerializer<DATA_TYPE> >
+	class NetChannel : public boost::noncopyable
+	{
+	private:
+		internal::NetChannelState<DATA_TYPE>* const state;
+	public:
+		/**
+		*	Starts using a connected TCP socket as a NetChannel.
+		*
+		*	@param socket The socket to use, which must not be blank.  The NetChannel takes it over, so the mobile is blanked
+		*	@param bufferSize The number of values that each end can hold
+		*/
+		inline explicit NetChannel(const Mobile<TCPSocketChannel>& socket,usign32 bufferSize = 64)
+			:	state(new internal::NetChannelState<DATA_TYPE>(socket,bufferSize))
+		{
+			state->socket->receive(new internal::NetDecoder<DATA_TYPE,SERIALIZER>(state));
+			internal::NetworkHandler::Fork(new internal::NetEncoder<DATA_TYPE,SERIALIZER>(state));
+		}
+
+		~NetChannel()
+		{
+			state->fromNetwork.reader().poison();
+			state->toNetwork.writer().poison();
+			//Wakes the process reading the socket if it is waiting for data:
+			state->socket->stopReading();
+			state->release();
+		}
 
+		/**
+		*	Gets the reading end, which receives the values sent from the other end of the connection
+		*/
+		inline NetChanin<DATA_TYPE> reader()
+		{
+			return NetChanin<DATA_TYPE>(state->fromNetwork.reader());
+		}
+
+		/**
+		*	Gets the writing end, which sends values to the other end of the connection
+		*/
+		inline NetChanout<DATA_TYPE> writer()
+		{
+			return NetChanout<DATA_TYPE>(state->toNetwork.writer());
+		}
+	};
+
+} //namespace csp
@@ -558,6 +558,23 @@ namespace csp
 				return CurrentThreadId();
 			}
 			
+			unsigned int Primitive::currentKernelIndex()
+			{
+				return GetKernel()->index();
+			}
+			
+			QuiescentState* Primitive::currentQuiescentState()
+			{
+				return GetKernel()->quiescentState();
+			}
+			
+		#ifdef CPPCSP_LINUX
+			IoRing* Primitive::currentIoRing()
+			{
+				return GetKernel()->ioRing();
+			}
+		#endif
+			
 			ThreadId Primitive::getThreadId(Process* ptr)
 			{
 				return ptr->threadId;
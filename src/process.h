@@ -91,6 +91,8 @@ namespace csp
 		class Kernel;
 		class TimeoutQueue;
 		class Primitive;
+		class QuiescentState;
+		class IoRing;
 		template <typename CONDITION>
 		class _AtomicProcessQueue;
 		
@@ -117,6 +119,9 @@ namespace csp
 			//0 means not alting
 			__CPPCSP_ALIGNED_USIGN32 alting;
 			
+			///The guard that the process has been committed to selecting during its current alt (see Primitive::altCommit), or NULL
+			csp::Guard* volatile altCommitted;
+			
 			Time timeout;
 			///Only used when in the timeout queue:
 			ProcessPtr timeout_nextProcess;
@@ -135,6 +140,7 @@ namespace csp
 			inline Process(Kernel* _kernel,ThreadId _threadId,usign32 _stackSize)
 				:	nextProcess(NULL),					
 					alting(0),
+					altCommitted(NULL),
 					timeout_nextProcess(NULL),
 					timeout_prevProcessPtr(NULL),
 					kernel(_kernel),
@@ -179,6 +185,17 @@ namespace csp
 			
 			static ThreadId currentThread();
 			
+			///A small index of the current thread's kernel, for per-kernel slots (see KernelSlots)
+			static unsigned int currentKernelIndex();
+			
+			///The quiescent state of the current thread's kernel (see QuiescentState)
+			static QuiescentState* currentQuiescentState();
+			
+		#ifdef CPPCSP_LINUX
+			///The file I/O ring of the current thread's kernel (see IoRing), created on first use
+			static IoRing* currentIoRing();
+		#endif
+			
 			static ThreadId getThreadId(Process*);
 			
 			///Frees an entire process chain.  They must belong to the same thread, and must not be involved in an alt
@@ -224,9 +241,30 @@ namespace csp
 			static void altFinish(AltingProcessPtr proc)
 			{
 				//Just set us to not-alting:
+				proc->altCommitted = NULL;
 				AtomicPut(&(proc->alting),___ALTING_NOT);
 			}
 			
+			/**
+			*	Commits an alting process to selecting the given guard, which it must currently have enabled, and frees the process.
+			*
+			*	This is for guards that synchronise several alting processes at once (such as those of AltBarrier),
+			*	where it is not enough for the guard to be ready - every process involved must select it.  The alter checks
+			*	altCommitted() once it has disabled its guards, and selects the committed guard regardless of its priority.
+			*	The caller must make sure that a process is committed to at most one guard in each alt.
+			*/
+			static void altCommit(AltingProcessPtr proc,csp::Guard* guard)
+			{
+				proc->altCommitted = guard;
+				freeProcessMaybe(proc);
+			}
+			
+			///The guard that the alting process has been committed to (see altCommit()), or NULL
+			static inline csp::Guard* altCommitted(AltingProcessPtr proc)
+			{
+				return proc->altCommitted;
+			}
+			
 			///Frees the process, taking account of its alting status
 			static void freeProcessMaybe(AltingProcessPtr proc)
 			{
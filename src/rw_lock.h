@@ -0,0 +1,374 @@
+/*
+*	The Kent C++CSP Library
+*	Copyright (C) 2002-2007 Neil Brown
+*
+*	This library is free software; you can redistribute it and/or
+*	modify it under the terms of the GNU Lesser General Public
+*	License as published by the Free Software Foundation; either
+*	version 2.1 of the License, or (at your option) any later version.
+*
+*	This library is distributed in the hope that it will be useful,
+*	but WITHOUT ANY WARRANTY; without even the implied warranty of
+*	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+*	Lesser General Public License for more details.
+*
+*	You should have received a copy of the GNU Lesser General Public
+*	License along with this library; if not, write to the Free Software
+*	Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+/** @file rw_lock.h
+*	@brief Contains ReadWriteLock and its scoped helpers
+*
+*	This file is \#included from cppcsp.h
+*/
+
+#ifndef INCLUDED_FROM_CPPCSP_H
+#error This file should only be included by csp.h, not individually
+#endif
+
+namespace csp
+{
+	/**
+	*	A reader/writer lock for processes.  Any number of processes may hold the lock for reading at once, or
+	*	one process may hold it for writing.  A process that cannot have the lock blocks (like it would on a channel),
+	*	leaving the other processes in its thread to run.
+	*
+	*	It is intended for shared data that is read far more often than it is changed, such as a routing table
+	*	read by many processes:
+	*	@code
+		ReadWriteLock lock;
+		std::map<int,std::string> routes;
+
+		//In the readers:
+		{
+			ScopedReadLock _(lock);
+			std::map<int,std::string>::iterator it = routes.find(destination);
+			//...
+		}
+
+		//In the (rare) writer:
+		{
+			ScopedWriteLock _(lock);
+			routes[destination] = route;
+		}
+		@endcode
+	*
+	*	Each thread counts its readers in its own slot (on its own cache line), with no mutex or atomic operations, so readers
+	*	in different threads do not slow each other down.  The cost is moved to the writers: a writer must stop new readers
+	*	using their slots (which involves a csp::internal::AsymmetricBarrier, a system call on most platforms) and then wait
+	*	for every slot to empty.  There are ReaderSlots slots; threads beyond that many use a count shared under the mutex.
+	*
+	*	While a writer holds the lock or is waiting for it, new readers queue up behind it.  When a writer releases the lock,
+	*	all the queued readers are let in before the next writer, so neither readers nor writers can be starved.
+	*
+	*	The lock is not recursive; a process that claims it twice (in either mode) without releasing it in between may deadlock.
+	*	Each release must be made by the process that made the claim.  The lock must not be destroyed while it is held.
+	*
+	*	@see ScopedReadLock, ScopedWriteLock, Semaphore
+	*/
+	class ReadWriteLock : private internal::Primitive, public boost::noncopyable
+	{
+	public:
+		///The number of threads that can have their own reader slot
+		static const unsigned int ReaderSlots = 32;
+	private:
+		///The readers of one thread, on its own cache line
+		class Slot
+		{
+		public:
+			///Only ever changed by the slot's own thread
+			volatile usign32 readers;
+			char _pad[64 - sizeof(usign32)];
+		};
+
+		///A reader waiting for a writer to finish.  It lives on the reader's stack
+		class WaitingReader
+		{
+		public:
+			internal::ProcessPtr process;
+			WaitingReader* next;
+		};
+
+		char _pad0[64];
+		Slot slots[ReaderSlots];
+
+		/**
+		*	True while a writer holds the lock, or is waiting for it.  Readers may only use their slots without the
+		*	mutex while this is false.  Only changed under the mutex
+		*/
+		volatile bool blocked;
+		///True while a writer holds the lock
+		bool writing;
+		///The readers counted under the mutex, rather than in a slot
+		usign32 sharedReaders;
+		///The queue of writers waiting for the lock.  The head is the next writer
+		internal::ProcessPtr writersHead,writersTail;
+		///The readers waiting for the current writer
+		WaitingReader* readers;
+		internal::PureSpinMutex mutex;
+
+		///Gets our slot, or NULL if our thread does not have one
+		inline Slot* ourSlot()
+		{
+			const unsigned int index = currentKernelIndex();
+			return index < ReaderSlots ? &(slots[index]) : NULL;
+		}
+
+		///True if there are no readers.  The mutex must be held, and new readers must be blocked
+		bool drained()
+		{
+			if (sharedReaders != 0)
+			{
+				return false;
+			}
+			for (unsigned int i = 0;i < ReaderSlots;i++)
+			{
+				if (slots[i].readers != 0)
+				{
+					return false;
+				}
+			}
+			return true;
+		}
+
+		///Gives the lock to the next writer if the readers have all gone.  The mutex must be held
+		void admitWriter()
+		{
+			if (false == writing && writersHead != NullProcessPtr && drained())
+			{
+				writing = true;
+				internal::ProcessPtr writer = writersHead;
+				writersHead = getNextProcess(writer);
+				freeProcessNoAlt(writer);
+			}
+		}
+
+		///Claims the lock for reading, counting us in our slot (if we have one) or the shared count.  The mutex must be held
+		void lockedClaimRead(Slot* slot)
+		{
+			if (false == writing && writersHead == NullProcessPtr)
+			{
+				if (slot != NULL)
+				{
+					slot->readers++;
+				}
+				else
+				{
+					sharedReaders++;
+				}
+				mutex.release();
+			}
+			else
+			{
+				//Wait for the writer.  It will count us in the shared count when it lets us in:
+				WaitingReader us;
+				us.process = currentProcess();
+				us.next = readers;
+				readers = &us;
+				mutex.release();
+
+				reschedule();
+
+				if (slot != NULL)
+				{
+					//Move ourselves into our slot, so that releaseRead() can find us:
+					mutex.claim();
+						sharedReaders--;
+						slot->readers++;
+					mutex.release();
+				}
+			}
+		}
+	public:
+		/**
+		*	Constructs the lock, unheld
+		*/
+		ReadWriteLock()
+			:	blocked(false),writing(false),sharedReaders(0),writersHead(NullProcessPtr),writersTail(NullProcessPtr),readers(NULL)
+		{
+			for (unsigned int i = 0;i < ReaderSlots;i++)
+			{
+				slots[i].readers = 0;
+			}
+		}
+
+		/**
+		*	Claims the lock for reading.  If a writer holds the lock (or is waiting for it), the process blocks until that writer
+		*	has released it.
+		*
+		*	If no writer is about, this involves no mutex or atomic operations.
+		*/
+		void claimRead()
+		{
+			Slot* slot = ourSlot();
+
+			if (slot != NULL)
+			{
+				slot->readers++;
+				internal::CompilerBarrier();
+				if (false == blocked)
+				{
+					//A writer that blocks readers after this will see our count (see claimWrite()):
+					return;
+				}
+
+				//A writer is about; back out, and do it properly:
+				slot->readers--;
+				internal::CompilerBarrier();
+			}
+
+			mutex.claim();
+				//We may have been holding up a writer while we backed out:
+				admitWriter();
+			lockedClaimRead(slot);
+		}
+
+		/**
+		*	Releases the lock after claimRead().
+		*
+		*	If no writer is about, this involves no mutex or atomic operations.  Otherwise, the last reader to release the
+		*	lock lets the waiting writer have it.
+		*/
+		void releaseRead()
+		{
+			Slot* slot = ourSlot();
+
+			if (slot != NULL)
+			{
+				slot->readers--;
+				internal::CompilerBarrier();
+				if (false == blocked)
+				{
+					return;
+				}
+
+				mutex.claim();
+					admitWriter();
+				mutex.release();
+			}
+			else
+			{
+				mutex.claim();
+					sharedReaders--;
+					admitWriter();
+				mutex.release();
+			}
+		}
+
+		/**
+		*	Claims the lock for writing.  The process blocks until all the readers, and any writers that were
+		*	already waiting, have released the lock.
+		*/
+		void claimWrite()
+		{
+			mutex.claim();
+				if (false == writing && writersHead == NullProcessPtr)
+				{
+					if (false == blocked)
+					{
+						blocked = true;
+
+						//Either the readers see that they are blocked, or we see their counts:
+						internal::AsymmetricBarrier();
+					}
+
+					if (drained())
+					{
+						writing = true;
+						mutex.release();
+						return;
+					}
+				}
+
+				//The last reader out, or the writer before us, will give us the lock:
+				addProcessToQueue(&writersHead,&writersTail,currentProcess());
+			mutex.release();
+
+			reschedule();
+		}
+
+		/**
+		*	Releases the lock after claimWrite().
+		*
+		*	Any readers that queued up while the lock was held for writing get the lock next, followed by
+		*	the next writer.
+		*/
+		void releaseWrite()
+		{
+			mutex.claim();
+				writing = false;
+
+				if (readers != NULL)
+				{
+					//Let all the waiting readers in.  They move themselves into their slots:
+					for (WaitingReader* reader = readers;reader != NULL;)
+					{
+						//The reader may be gone as soon as it is freed:
+						WaitingReader* next = reader->next;
+						sharedReaders++;
+						freeProcessNoAlt(reader->process);
+						reader = next;
+					}
+					readers = NULL;
+				}
+
+				if (writersHead == NullProcessPtr)
+				{
+					blocked = false;
+				}
+				else
+				{
+					//New readers are still blocked; the next writer gets the lock once the readers have gone:
+					admitWriter();
+				}
+			mutex.release();
+		}
+	};
+
+	/**
+	*	Holds a ReadWriteLock for reading for the lifetime of the object.  The lock is claimed by the constructor,
+	*	and released by the destructor (including when an exception is thrown).
+	*/
+	class ScopedReadLock : public boost::noncopyable
+	{
+	private:
+		ReadWriteLock* lock;
+	public:
+		///Claims the lock for reading
+		inline explicit ScopedReadLock(ReadWriteLock& _lock)
+			:	lock(&_lock)
+		{
+			lock->claimRead();
+		}
+
+		///Releases the lock
+		inline ~ScopedReadLock()
+		{
+			lock->releaseRead();
+		}
+	};
+
+	/**
+	*	Holds a ReadWriteLock for writing for the lifetime of the object.  The lock is claimed by the constructor,
+	*	and released by the destructor (including when an exception is thrown).
+	*/
+	class ScopedWriteLock : public boost::noncopyable
+	{
+	private:
+		ReadWriteLock* lock;
+	public:
+		///Claims the lock for writing
+		inline explicit ScopedWriteLock(ReadWriteLock& _lock)
+			:	lock(&_lock)
+		{
+			lock->claimWrite();
+		}
+
+		///Releases the lock
+		inline ~ScopedWriteLock()
+		{
+			lock->releaseWrite();
+		}
+	};
+}
@@ -0,0 +1,181 @@
+/*
+*	The Kent C++CSP Library
+*	Copyright (C) 2002-2007 Neil Brown
+*
+*	This library is free software; you can redistribute it and/or
+*	modify it under the terms of the GNU Lesser General Public
+*	License as published by the Free Software Foundation; either
+*	version 2.1 of the License, or (at your option) any later version.
+*
+*	This library is distributed in the hope that it will be useful,
+*	but WITHOUT ANY WARRANTY; without even the implied warranty of
+*	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+*	Lesser General Public License for more details.
+*
+*	You should have received a copy of the GNU Lesser General Public
+*	License along with this library; if not, write to the Free Software
+*	Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+/** @file shared_value.h
+*	@brief Contains the SharedValue class
+*
+*	This file is \#included from cppcsp.h
+*/
+
+#ifndef INCLUDED_FROM_CPPCSP_H
+#error This file should only be included by csp.h, not individually
+#endif
+
+namespace csp
+{
+	/**
+	*	A value that is read by many processes and occasionally replaced, without copying it for each reader or locking it.
+	*
+	*	Readers take a Snapshot of the current version, and may read it (but not change it) for as long as they hold the
+	*	snapshot.  A writer publishes a whole new version with set(); readers that already have a snapshot keep reading
+	*	the old version, and the next snapshots see the new one.  An old version is deleted once no snapshot can
+	*	still refer to it.  For example, a routing table shared by many processes:
+	*	@code
+		SharedValue< std::map<int,std::string> > routes;
+
+		//In the readers:
+		{
+			SharedValue< std::map<int,std::string> >::Snapshot current(routes);
+			std::map<int,std::string>::const_iterator it = current->find(destination);
+			//...
+		}
+
+		//In the (rare) writer:
+		{
+			std::map<int,std::string> updated(*SharedValue< std::map<int,std::string> >::Snapshot(routes));
+			updated[destination] = route;
+			routes.set(updated);
+		}
+		@endcode
+	*
+	*	Taking and releasing a snapshot involves no mutex or atomic operations; the snapshots are simply counted by
+	*	the reader's thread.  When a thread reschedules with no snapshots held by any of its processes, it cannot
+	*	be reading any old version (see csp::internal::QuiescentState).  Old versions are deleted by set(), once
+	*	every thread has done that since the version was replaced, and the rest by the destructor.
+	*
+	*	So it is fine to hold a snapshot while blocking (e.g. communicating on a channel), but it holds up the deletion of
+	*	old versions (of every SharedValue) until it is released.  The same goes for a thread that never blocks.
+	*
+	*	Concurrent calls to set() are safe, but each replaces the whole value; if writers must update the value
+	*	based on its current contents, they should agree on a mutex (or a single writer process) between them.
+	*
+	*	DATA_TYPE must be copy-constructible.
+	*
+	*	@see ReadWriteLock
+	*/
+	template <typename DATA_TYPE>
+	class SharedValue : private internal::Primitive, public boost::noncopyable
+	{
+	private:
+		///The version that new snapshots see
+		DATA_TYPE* volatile current;
+		///Replaced versions, with the epoch at which they were replaced (oldest first)
+		std::list< std::pair<usign32,DATA_TYPE*> > retired;
+		internal::PureSpinMutex mutex;
+	public:
+		/**
+		*	A read-only handle on the version of a SharedValue that was current when the snapshot was taken.  It must be
+		*	released (destroyed) by the process that took it.
+		*/
+		class Snapshot : private internal::Primitive, public boost::noncopyable
+		{
+		private:
+			internal::QuiescentState* state;
+			const DATA_TYPE* value;
+		public:
+			///Takes a snapshot of the value's current version
+			inline explicit Snapshot(SharedValue<DATA_TYPE>& shared)
+				:	state(currentQuiescentState())
+			{
+				//There is no reschedule between counting the snapshot and reading the pointer:
+				state->snapshots++;
+				value = shared.current;
+			}
+
+			///Releases the snapshot
+			inline ~Snapshot()
+			{
+				state->snapshots--;
+			}
+
+			inline const DATA_TYPE& operator*() const {return *value;}
+
+			inline const DATA_TYPE* operator->() const {return value;}
+
+			inline const DATA_TYPE* get() const {return value;}
+		};
+
+		friend class Snapshot;
+
+		/**
+		*	Constructs the value.
+		*
+		*	@param initial The first version of the value
+		*/
+		inline explicit SharedValue(const DATA_TYPE& initial = DATA_TYPE())
+			:	current(new DATA_TYPE(initial))
+		{
+		}
+
+		/**
+		*	Deletes all the versions of the value.  No process may hold a snapshot of it.
+		*/
+		~SharedValue()
+		{
+			delete current;
+			for (typename std::list< std::pair<usign32,DATA_TYPE*> >::iterator it = retired.begin();it != retired.end();it++)
+			{
+				delete it->second;
+			}
+		}
+
+		/**
+		*	Publishes a new version of the value.  The value is copied; snapshots taken after this call returns will see
+		*	the copy.  Any old versions that no snapshot can still refer to are deleted.
+		*/
+		void set(const DATA_TYPE& value)
+		{
+			DATA_TYPE* version = new DATA_TYPE(value);
+			std::list< std::pair<usign32,DATA_TYPE*> > reclaimed;
+
+			mutex.claim();
+				DATA_TYPE* old = current;
+				current = version;
+				//Advancing the epoch also makes the new version visible, before we look at the kernels:
+				retired.push_back(std::make_pair(internal::QuiescentState::Advance(),old));
+
+				//Our thread is between processes, so it is quiescent (if no-one here holds a snapshot):
+				currentQuiescentState()->passed();
+
+				const usign32 reached = internal::QuiescentState::Reached();
+				while (false == retired.empty() && internal::QuiescentState::After(reached,retired.front().first))
+				{
+					reclaimed.splice(reclaimed.end(),retired,retired.begin());
+				}
+			mutex.release();
+
+			//Deleting them may take a while, so it is done without the mutex:
+			for (typename std::list< std::pair<usign32,DATA_TYPE*> >::iterator it = reclaimed.begin();it != reclaimed.end();it++)
+			{
+				delete it->second;
+			}
+		}
+
+		/**
+		*	Gets the number of replaced versions that have not yet been deleted.
+		*/
+		usign32 pending()
+		{
+			mutex.claim();
+				const usign32 ret = static_cast<usign32>(retired.size());
+			mutex.release();
+			return ret;
+		}
+	};
+}
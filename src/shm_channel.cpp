@@ -0,0 +1,440 @@
+/*
+*	The Kent C++CSP Library
+*	Copyright (C) 2002-2007 Neil Brown
+*
+*	This library is free software; you can redistribute it and/or
+*	modify it under the terms of the GNU Lesser General Public
+*	License as published by the Free Software Foundation; either
+*	version 2.1 of the License, or (at your option) any later version.
+*
+*	This library is distributed in the hope that it will be useful,
+*	but WITHOUT ANY WARRANTY; without even the implied warranty of
+*	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+*	Lesser General Public License for more details.
+*
+*	You should have received a copy of the GNU Lesser General Public
+*	License along with this library; if not, write to the Free Software
+*	Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+/** @internal@file shm_channel.cpp
+*	@brief Implements the shared-memory ring and futex waiting behind SharedMemoryChannel
+*/
+
+#include "cppcsp.h"
+
+#ifdef CPPCSP_LINUX
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sched.h>
+#include <errno.h>
+#include <string.h>
+#include <limits.h>
+
+using namespace csp;
+using namespace csp::internal;
+using namespace std;
+
+namespace
+{
+	//"CSP2" -- written last by the creator of a channel, once the header is filled in:
+	const usign32 ShmMagic = 0x43535032;
+
+	//How many times to poll the channel, spinning in between, before handing the wait over to the watcher thread.
+	//The other OS process is often only just behind us, and a hand-off costs two thread wake-ups:
+	const int ShmPollCount = 256;
+
+	//We use the non-private futex operations because the futexes are shared between OS processes:
+
+	inline void FutexWait(__CPPCSP_ALIGNED_USIGN32_PTR address,usign32 value)
+	{
+		syscall(SYS_futex,const_cast<usign32*>(address),FUTEX_WAIT,value,NULL,NULL,0);
+	}
+
+	inline void FutexWake(__CPPCSP_ALIGNED_USIGN32_PTR address)
+	{
+		syscall(SYS_futex,const_cast<usign32*>(address),FUTEX_WAKE,INT_MAX,NULL,NULL,0);
+	}
+
+	inline string ErrorString(const string& what,const string& name)
+	{
+		return what + " shared memory channel " + name + ": " + strerror(errno);
+	}
+}
+
+ShmWatcher::ShmWatcher(ShmRing* _ring,bool _forReader)
+	:	ring(_ring),forReader(_forReader),target(0),waitingProcess(NullProcessPtr),
+		started(false),requested(false),shutdown(false)
+{
+	pthread_mutex_init(&requestMutex,NULL);
+	pthread_cond_init(&requestCond,NULL);
+}
+
+ShmWatcher::~ShmWatcher()
+{
+	stop();
+	pthread_cond_destroy(&requestCond);
+	pthread_mutex_destroy(&requestMutex);
+}
+
+void* ShmWatcher::ThreadFunc(void* watcher)
+{
+	static_cast<ShmWatcher*>(watcher)->run();
+	return NULL;
+}
+
+bool ShmWatcher::ready() const
+{
+	return forReader ? ring->inputReady() : ring->outputReady(target);
+}
+
+void ShmWatcher::run()
+{
+	ShmChannelHeader* header = ring->header;
+	__CPPCSP_ALIGNED_USIGN32_PTR events = forReader ? &(header->readerEvents) : &(header->writerEvents);
+	__CPPCSP_ALIGNED_USIGN32_PTR sleeping = forReader ? &(header->readerSleeping) : &(header->writerSleeping);
+
+	while (true)
+	{
+		pthread_mutex_lock(&requestMutex);
+			while (false == requested && false == shutdown)
+			{
+				pthread_cond_wait(&requestCond,&requestMutex);
+			}
+			requested = false;
+		pthread_mutex_unlock(&requestMutex);
+
+		//Sleep on the event-count until the channel is ready.  We must read the count before we check
+		//the channel, so that if it changes after we check, the futex wait will return straight away:
+		while (false == shutdown)
+		{
+			usign32 seen = AtomicGet(events);
+			AtomicSwap(sleeping,1);
+			__sync_synchronize();
+
+			if (ready())
+				break;
+
+			FutexWait(events,seen);
+		}
+		AtomicPut(sleeping,0);
+
+		if (shutdown)
+			return;
+
+		mutex.claim();
+			if (waitingProcess != NullProcessPtr)
+			{
+				//Might be alting, might not:
+				freeProcessMaybe(waitingProcess);
+				waitingProcess = NullProcessPtr;
+				AtomicProcessQueue::EndExternalWait();
+			}
+		mutex.release();
+	}
+}
+
+void ShmWatcher::watch(AltingProcessPtr proc,usign32 _target)
+{
+	if (false == started)
+	{
+		if (0 != pthread_create(&thread,NULL,&ThreadFunc,this))
+		{
+			throw OutOfResourcesException("Could not create pthread for shared memory channel");
+		}
+		started = true;
+	}
+
+	mutex.claim();
+		target = _target;
+		waitingProcess = proc;
+		//Don't let the run-time think we are deadlocked while we wait for the other OS process:
+		AtomicProcessQueue::BeginExternalWait();
+	mutex.release();
+
+	pthread_mutex_lock(&requestMutex);
+		requested = true;
+		pthread_cond_signal(&requestCond);
+	pthread_mutex_unlock(&requestMutex);
+}
+
+void ShmWatcher::cancel()
+{
+	mutex.claim();
+		if (waitingProcess != NullProcessPtr)
+		{
+			waitingProcess = NullProcessPtr;
+			AtomicProcessQueue::EndExternalWait();
+		}
+	mutex.release();
+}
+
+void ShmWatcher::stop()
+{
+	if (started)
+	{
+		pthread_mutex_lock(&requestMutex);
+			shutdown = true;
+			pthread_cond_signal(&requestCond);
+		pthread_mutex_unlock(&requestMutex);
+
+		//It may be asleep on the futex:
+		if (forReader)
+			ring->signal(&(ring->header->readerEvents),&(ring->header->readerSleeping));
+		else
+			ring->signal(&(ring->header->writerEvents),&(ring->header->writerSleeping));
+
+		pthread_join(thread,NULL);
+		started = false;
+	}
+}
+
+ShmRing::ShmRing(const string& name,usign32 elementSize,usign32 bufferSize)
+	:	header(NULL),slots(NULL),stride((elementSize + 7) & ~static_cast<usign32>(7)),mappedSize(0),
+		readerWatcher(this,true),writerWatcher(this,false)
+{
+	const usign32 capacity = (bufferSize == 0) ? 1 : bufferSize;
+	mappedSize = sizeof(ShmChannelHeader) + static_cast<size_t>(capacity) * stride;
+
+	bool creator = true;
+	int fd = shm_open(name.c_str(),O_RDWR | O_CREAT | O_EXCL,0600);
+	if (fd == -1 && errno == EEXIST)
+	{
+		creator = false;
+		fd = shm_open(name.c_str(),O_RDWR,0600);
+	}
+
+	if (fd == -1)
+	{
+		throw OutOfResourcesException(ErrorString("Could not open",name));
+	}
+
+	if (creator)
+	{
+		//The new segment is filled with zeroes, which is the right initial state for everything except the magic number:
+		if (0 != ftruncate(fd,mappedSize))
+		{
+			string error = ErrorString("Could not size",name);
+			close(fd);
+			shm_unlink(name.c_str());
+			throw OutOfResourcesException(error);
+		}
+	}
+	else
+	{
+		//Wait for the creator to size the segment:
+		struct stat st;
+		do
+		{
+			if (0 != fstat(fd,&st))
+			{
+				string error = ErrorString("Could not examine",name);
+				close(fd);
+				throw OutOfResourcesException(error);
+			}
+			if (st.st_size == 0)
+				sched_yield();
+		}
+		while (st.st_size == 0);
+
+		if (static_cast<size_t>(st.st_size) != mappedSize)
+		{
+			close(fd);
+			throw CPPCSPError("Shared memory channel " + name + " already exists with a different element size or buffer size");
+		}
+	}
+
+	void* mem = mmap(NULL,mappedSize,PROT_READ | PROT_WRITE,MAP_SHARED,fd,0);
+	close(fd);
+
+	if (mem == MAP_FAILED)
+	{
+		throw OutOfResourcesException(ErrorString("Could not map",name));
+	}
+
+	header = static_cast<ShmChannelHeader*>(mem);
+	slots = static_cast<unsigned char*>(mem) + sizeof(ShmChannelHeader);
+
+	if (creator)
+	{
+		header->elementSize = elementSize;
+		header->capacity = capacity;
+		header->bufferSize = bufferSize;
+		__sync_synchronize();
+		AtomicPut(&(header->magic),ShmMagic);
+	}
+	else
+	{
+		while (AtomicGet(&(header->magic)) != ShmMagic)
+		{
+			sched_yield();
+		}
+		__sync_synchronize();
+
+		if (header->elementSize != elementSize || header->bufferSize != bufferSize)
+		{
+			munmap(mem,mappedSize);
+			throw CPPCSPError("Shared memory channel " + name + " already exists with a different element size or buffer size");
+		}
+	}
+}
+
+ShmRing::~ShmRing()
+{
+	//The watchers use the header, so they must finish before we unmap it:
+	readerWatcher.stop();
+	writerWatcher.stop();
+
+	munmap(header,mappedSize);
+}
+
+void ShmRing::signal(__CPPCSP_ALIGNED_USIGN32_PTR events,__CPPCSP_ALIGNED_USIGN32_PTR sleeping)
+{
+	__sync_synchronize();
+	AtomicIncrement(events);
+	__sync_synchronize();
+
+	//Only make the system call if the other side is (or is about to be) asleep:
+	if (AtomicGet(sleeping) != 0)
+	{
+		FutexWake(events);
+	}
+}
+
+void ShmRing::waitForInput()
+{
+	for (int i = 0;i < ShmPollCount && false == inputReady();i++)
+	{
+		spin(i + 1);
+	}
+
+	while (false == inputReady())
+	{
+		readerWatcher.watch(currentProcess());
+		reschedule();
+	}
+}
+
+void ShmRing::waitForOutput(usign32 target)
+{
+	for (int i = 0;i < ShmPollCount && false == outputReady(target);i++)
+	{
+		spin(i + 1);
+	}
+
+	while (false == outputReady(target))
+	{
+		writerWatcher.watch(currentProcess(),target);
+		reschedule();
+	}
+}
+
+void ShmRing::takeItem()
+{
+	usign32 slot = header->tailSlot + 1;
+	header->tailSlot = (slot == header->capacity) ? 0 : slot;
+
+	//The copy out of the slot must be complete before the writer can see the slot as free:
+	__sync_synchronize();
+	AtomicPut(&(header->tail),header->tail + 1);
+
+	signal(&(header->writerEvents),&(header->writerSleeping));
+}
+
+void ShmRing::read(void* dest)
+{
+	beginRead(dest);
+	takeItem();
+}
+
+void ShmRing::beginRead(void* dest)
+{
+	waitForInput();
+
+	//Like the normal channels, a buffered channel only shows poison once it is empty, an unbuffered one immediately:
+	if (AtomicGet(&(header->poisoned)) != 0 && (header->bufferSize == 0 || AtomicGet(&(header->head)) == header->tail))
+	{
+		throw PoisonException();
+	}
+
+	__sync_synchronize();
+	memcpy(dest,slots + static_cast<size_t>(header->tailSlot) * stride,header->elementSize);
+}
+
+void ShmRing::endRead()
+{
+	//This method will never throw a poison exception
+	if (AtomicGet(&(header->head)) != header->tail)
+	{
+		takeItem();
+	}
+}
+
+void ShmRing::write(const void* src)
+{
+	//Wait for a free slot:
+	waitForOutput(header->capacity - 1);
+
+	if (AtomicGet(&(header->poisoned)) != 0)
+	{
+		throw PoisonException();
+	}
+
+	memcpy(slots + static_cast<size_t>(header->headSlot) * stride,src,header->elementSize);
+
+	usign32 slot = header->headSlot + 1;
+	header->headSlot = (slot == header->capacity) ? 0 : slot;
+
+	//The copy into the slot must be complete before the reader can see it:
+	__sync_synchronize();
+	const usign32 head = header->head + 1;
+	AtomicPut(&(header->head),head);
+
+	signal(&(header->readerEvents),&(header->readerSleeping));
+
+	if (header->bufferSize == 0)
+	{
+		//Unbuffered, so wait for the reader to take it:
+		waitForOutput(0);
+
+		if (AtomicGet(&(header->tail)) != head)
+		{
+			//We were freed by poison instead:
+			throw PoisonException();
+		}
+	}
+}
+
+void ShmRing::poison()
+{
+	AtomicPut(&(header->poisoned),1);
+	signal(&(header->readerEvents),&(header->readerSleeping));
+	signal(&(header->writerEvents),&(header->writerSleeping));
+}
+
+bool ShmRing::enableInput(AltingProcessPtr proc)
+{
+	if (inputReady())
+		return true;
+
+	readerWatcher.watch(proc);
+	return false;
+}
+
+bool ShmRing::disableInput()
+{
+	readerWatcher.cancel();
+	return inputReady();
+}
+
+void ShmRing::Unlink(const string& name)
+{
+	shm_unlink(name.c_str());
+}
+
+#endif //CPPCSP_LINUX
@@ -0,0 +1,348 @@
+/*
+*	The Kent C++CSP Library
+*	Copyright (C) 2002-2007 Neil Brown
+*
+*	This library is free software; you can redistribute it and/or
+*	modify it under the terms of the GNU Lesser General Public
+*	License as published by the Free Software Foundation; either
+*	version 2.1 of the License, or (at your option) any later version.
+*
+*	This library is distributed in the hope that it will be useful,
+*	but WITHOUT ANY WARRANTY; without even the implied warranty of
+*	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+*	Lesser General Public License for more details.
+*
+*	You should have received a copy of the GNU Lesser General Public
+*	License along with this library; if not, write to the Free Software
+*	Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+/** @file shm_channel.h
+*	@brief Contains the header for SharedMemoryChannel
+*
+*	This file is \#included from cppcsp.h on Linux only
+*/
+
+#ifndef INCLUDED_FROM_CPPCSP_H
+#error This file should only be included by csp.h, not individually
+#endif
+
+#include <boost/static_assert.hpp>
+#include <boost/type_traits/has_trivial_copy.hpp>
+#include <boost/type_traits/has_trivial_destructor.hpp>
+
+class ShmChannelTest;
+
+namespace csp
+{
+	namespace internal
+	{
+		/**@internal
+		*	The header at the start of a shared-memory channel's segment.
+		*
+		*	Everything in here is shared between all the OS processes that have the channel open, so it
+		*	must only contain plain data.  head is only written by the writer and tail only by the reader; each
+		*	is on its own cache line, together with the futex words that the other side sleeps on.
+		*
+		*	The events words are event-counts: they are incremented every time something happens that the
+		*	sleeping side might be waiting for, and the sleeping side waits on the futex for them to change.
+		*/
+		class ShmChannelHeader
+		{
+		public:
+			__CPPCSP_ALIGNED_USIGN32 magic;
+			usign32 elementSize;
+			usign32 capacity;
+			usign32 bufferSize;
+			__CPPCSP_ALIGNED_USIGN32 poisoned;
+			char _pad0[64 - 5 * sizeof(usign32)];
+
+			//Written by the writer:
+			__CPPCSP_ALIGNED_USIGN32 head;
+			usign32 headSlot;
+			__CPPCSP_ALIGNED_USIGN32 readerEvents;
+			__CPPCSP_ALIGNED_USIGN32 readerSleeping;
+			char _pad1[64 - 4 * sizeof(usign32)];
+
+			//Written by the reader:
+			__CPPCSP_ALIGNED_USIGN32 tail;
+			usign32 tailSlot;
+			__CPPCSP_ALIGNED_USIGN32 writerEvents;
+			__CPPCSP_ALIGNED_USIGN32 writerSleeping;
+			char _pad2[64 - 4 * sizeof(usign32)];
+		};
+
+		class ShmRing;
+
+		/**@internal
+		*	A thread that waits (on a futex) for the other OS process, on behalf of one side of a shared-memory channel.
+		*
+		*	When a process needs to wait for the other side of the channel, it registers with the watcher
+		*	and blocks as normal.  The watcher thread sleeps on the futex until the process can proceed, then frees it.
+		*	The thread is only started the first time that it is needed.
+		*/
+		class ShmWatcher : public boost::noncopyable, private Primitive
+		{
+		private:
+			ShmRing* const ring;
+			const bool forReader;
+
+			///For the writer's side, the number of outstanding items that the writer is waiting to drop to
+			volatile usign32 target;
+
+			PureSpinMutex mutex;
+			AltingProcessPtr waitingProcess;
+
+			bool started;
+			pthread_t thread;
+			pthread_mutex_t requestMutex;
+			pthread_cond_t requestCond;
+			bool requested;
+			volatile bool shutdown;
+
+			static void* ThreadFunc(void*);
+			void run();
+			bool ready() const;
+		public:
+			ShmWatcher(ShmRing* _ring,bool _forReader);
+			~ShmWatcher();
+
+			/**@internal
+			*	Stops the watcher thread, if it was started.  The ring must still be mapped.
+			*/
+			void stop();
+
+			/**@internal
+			*	Asks the watcher to free the given process once the channel is ready.  Does not block.
+			*
+			*	@param proc The process (possibly alting) to free
+			*	@param _target For the writer's side, the number of outstanding items to wait for
+			*/
+			void watch(AltingProcessPtr proc,usign32 _target = 0);
+
+			/**@internal
+			*	Cancels a previous call to watch(), if the process has not already been freed.
+			*/
+			void cancel();
+
+			//For testing:
+			friend class ::ShmChannelTest;
+		};
+
+		/**@internal
+		*	The untyped part of a SharedMemoryChannel: the shared-memory segment and the operations on it.
+		*
+		*	The segment holds a ShmChannelHeader followed by a ring of fixed-size slots.  head and tail count
+		*	the items ever written and taken (wrapping around), so the number of outstanding items is head - tail;
+		*	headSlot and tailSlot are the corresponding positions in the ring.
+		*	The writer waits before writing until there is a free slot, and for unbuffered channels it also waits
+		*	afterwards until the reader has taken the item.
+		*/
+		class ShmRing : public boost::noncopyable, private Primitive
+		{
+		private:
+			ShmChannelHeader* header;
+			unsigned char* slots;
+			usign32 stride;
+			size_t mappedSize;
+
+			ShmWatcher readerWatcher;
+			ShmWatcher writerWatcher;
+
+			inline usign32 outstanding() const
+			{
+				return AtomicGet(&(header->head)) - AtomicGet(&(header->tail));
+			}
+
+			inline bool outputReady(const usign32 target) const
+			{
+				return outstanding() <= target || AtomicGet(&(header->poisoned)) != 0;
+			}
+
+			void waitForInput();
+			void waitForOutput(usign32 target);
+			void takeItem();
+			void signal(__CPPCSP_ALIGNED_USIGN32_PTR events,__CPPCSP_ALIGNED_USIGN32_PTR sleeping);
+
+			//For testing:
+			friend class ::ShmChannelTest;
+			friend class ShmWatcher;
+		public:
+			ShmRing(const std::string& name,usign32 elementSize,usign32 bufferSize);
+			~ShmRing();
+
+			void read(void* dest);
+			void beginRead(void* dest);
+			void endRead();
+			void write(const void* src);
+			void poison();
+
+			inline bool inputReady() const
+			{
+				return AtomicGet(&(header->head)) != AtomicGet(&(header->tail)) || AtomicGet(&(header->poisoned)) != 0;
+			}
+
+			bool enableInput(AltingProcessPtr proc);
+			bool disableInput();
+
+			static void Unlink(const std::string& name);
+		};
+	} //namespace internal
+
+	/**
+	*	A one-to-one channel between two OS processes on the same machine, using POSIX shared memory.
+	*
+	*	Each OS process constructs a SharedMemoryChannel with the same name.  One of them then uses the
+	*	reading end and the other uses the writing end, exactly as it would with a One2OneChannel (when
+	*	the buffer size is zero) or a BufferedOne2OneChannel with a FIFOBuffer (when the buffer size is positive):
+	*	@code
+		//In the writing OS process:
+		SharedMemoryChannel<Sample> c("/samples",16);
+		Chanout<Sample> out = c.writer();
+
+		//In the reading OS process:
+		SharedMemoryChannel<Sample> c("/samples",16);
+		AltChanin<Sample> in = c.reader();
+		@endcode
+	*
+	*	The data is copied directly into and out of a ring of slots in the shared memory, so DATA_TYPE must be
+	*	trivially copyable (this is checked when compiling) and must not contain pointers, as they would not be
+	*	valid in the other OS process.
+	*
+	*	The reading end may be used in an Alternative.  When one side of the channel has to wait for the other,
+	*	it blocks like any other channel communication, and a thread belonging to the channel waits on a futex in
+	*	the shared memory for the other OS process (the waiting process does not count as deadlocked while it waits).
+	*	As long as neither side has to wait, a communication involves no system calls at all.
+	*
+	*	Poison behaves as it does for the equivalent normal channel, and is seen by both OS processes.
+	*
+	*	The shared memory segment is created by whichever OS process gets there first, and persists until
+	*	Unlink() is called, even after both processes have closed the channel.  The channel's state persists
+	*	along with it, so you should call Unlink() once both processes have opened the channel (or before
+	*	creating it, if a previous run may have left it behind).  Opening an existing channel with a
+	*	different DATA_TYPE size or buffer size throws a CPPCSPError.
+	*
+	*	This class is currently only available on Linux.
+	*
+	*	@section tempreq DATA_TYPE Requirements
+	*
+	*	DATA_TYPE must have a trivial copy constructor and a trivial destructor.
+	*/
+	template <typename DATA_TYPE>
+	class SharedMemoryChannel : protected internal::BaseAltChan<DATA_TYPE>
+	{
+	private:
+		BOOST_STATIC_ASSERT(boost::has_trivial_copy<DATA_TYPE>::value && boost::has_trivial_destructor<DATA_TYPE>::value);
+
+		internal::ShmRing ring;
+
+		void input(DATA_TYPE* const dest)
+		{
+			ring.read(dest);
+		}
+
+		void beginExtInput(DATA_TYPE* const dest)
+		{
+			ring.beginRead(dest);
+		}
+
+		void endExtInput()
+		{
+			ring.endRead();
+		}
+
+		void output(const DATA_TYPE* const src)
+		{
+			ring.write(src);
+		}
+
+		void poisonIn()
+		{
+			ring.poison();
+		}
+
+		void poisonOut()
+		{
+			ring.poison();
+		}
+
+		class __ChannelGuard : public Guard
+		{
+		private:
+			internal::ShmRing* ring;
+		protected:
+			bool enable(internal::AltingProcessPtr proc)
+			{
+				return ring->enableInput(proc);
+			}
+
+			bool disable(internal::AltingProcessPtr)
+			{
+				return ring->disableInput();
+			}
+		public:
+			inline explicit __ChannelGuard(internal::ShmRing* _ring)
+				:	ring(_ring)
+			{
+			}
+		};
+
+		Guard* inputGuard()
+		{
+			return new __ChannelGuard(&ring);
+		}
+		
+		Guard* inputGuard(internal::GuardStorage* storage)
+		{
+			return new (storage->place<__ChannelGuard>()) __ChannelGuard(&ring);
+		}
+
+		bool pending()
+		{
+			return ring.inputReady();
+		}
+	public:
+		/**
+		*	Opens the shared memory channel with the given name, creating it if it does not already exist.
+		*
+		*	@param name The name of the channel; as for shm_open, it should begin with a slash and contain no others
+		*	@param bufferSize The number of items that may be buffered in the channel.  Zero gives an unbuffered channel.
+		*	@throw OutOfResourcesException If the shared memory could not be created or opened
+		*	@throw CPPCSPError If the channel already exists with a different element size or buffer size
+		*/
+		inline explicit SharedMemoryChannel(const std::string& name,const usign32 bufferSize = 0)
+			:	ring(name,sizeof(DATA_TYPE),bufferSize)
+		{
+		}
+
+		/**
+		*	Gets the reading end of the channel.
+		*/
+		AltChanin<DATA_TYPE> reader()
+		{
+			return AltChanin<DATA_TYPE>(this,true);
+		}
+
+		/**
+		*	Gets the writing end of the channel.
+		*/
+		Chanout<DATA_TYPE> writer()
+		{
+			return Chanout<DATA_TYPE>(this,true);
+		}
+
+		/**
+		*	Removes the name of a shared memory channel, so that later opens of that name create a new channel.
+		*
+		*	Channels that are already open are unaffected.
+		*/
+		static void Unlink(const std::string& name)
+		{
+			internal::ShmRing::Unlink(name);
+		}
+
+		//For testing:
+		friend class ::ShmChannelTest;
+	};
+
+} //namespace csp
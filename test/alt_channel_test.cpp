@@ -24,6 +24,7 @@
 #include "../src/cppcsp.h"
 
 #include "../src/common/basic.h"
+#include "../src/thread_local.h"
 
 using namespace csp;
 using namespace csp::internal;
@@ -32,9 +33,73 @@ using namespace boost::assign;
 using namespace boost;
 
 #include <list>
+#include <cstdlib>
+#include <new>
 
 using namespace std;
 
+namespace
+{
+	//While a test in this thread points this at a counter, each allocation the thread makes with the global
+	//operator new is counted there.  Other threads, and the tests that do not count, are unaffected:
+	DeclareThreadLocalPointer(usign32) CountedAllocations;
+
+	//Counts this thread's allocations for as long as it exists:
+	class AllocationCounter
+	{
+	private:
+		usign32 count;
+	public:
+		inline AllocationCounter()
+			:	count(0)
+		{
+			CountedAllocations = &count;
+		}
+		
+		inline ~AllocationCounter()
+		{
+			CountedAllocations = NULL;
+		}
+		
+		inline usign32 allocations() const
+		{
+			return count;
+		}
+	};
+}
+
+#if __cplusplus >= 201103L
+void* operator new(std::size_t size)
+#else
+void* operator new(std::size_t size) throw (std::bad_alloc)
+#endif
+{
+	if (CountedAllocations != NULL)
+	{
+		(*CountedAllocations)++;
+	}
+	void* p = std::malloc(size == 0 ? 1 : size);
+	if (p == NULL)
+		throw std::bad_alloc();
+	return p;
+}
+
+#if __cplusplus >= 201103L
+void operator delete(void* p) noexcept
+#else
+void operator delete(void* p) throw ()
+#endif
+{
+	std::free(p);
+}
+
+#ifdef __cpp_sized_deallocation
+void operator delete(void* p,std::size_t) noexcept
+{
+	std::free(p);
+}
+#endif
+
 
 class StressedAlter : public CSProcess
 {
@@ -109,6 +174,51 @@ public:
 	}
 };
 
+//Reads a number of values from a channel, and adds them to a total:
+class SummingReader : public CSProcess
+{
+private:
+	Chanin<int> in;
+	const int reads;
+	int* const total;
+protected:
+	void run()
+	{
+		for (int i = 0;i < reads;i++)
+		{
+			int n;
+			in >> n;
+			*total += n;
+		}
+	}
+public:
+	SummingReader(const Chanin<int>& _in,const int _reads,int* const _total)
+		:	in(_in),reads(_reads),total(_total)
+	{
+	}
+};
+
+//Alts on a channel, and then reads one value from it:
+class AltingReader : public CSProcess
+{
+private:
+	AltChanin<int> in;
+	int* const value;
+protected:
+	void run()
+	{
+		list<Guard*> guards = list_of<Guard*>(in.inputGuard());
+		Alternative alt(guards);
+		alt.priSelect();
+		in >> *value;
+	}
+public:
+	AltingReader(const AltChanin<int>& _in,int* const _value)
+		:	in(_in),value(_value)
+	{
+	}
+};
+
 class AltChannelTest : public Test, public virtual internal::TestInfo, public SchedulerRecorder
 {
 public:
@@ -1122,6 +1232,605 @@ public:
 		);
 	}
 
+	/**
+	*	Tests a ReadinessAlternative's priSelect over one-to-one channels: the highest priority ready channel is picked,
+	*	channels that have been read from are no longer selected, and it waits correctly when no channel is ready
+	*/
+	static TestResult testReadiness0()
+	{
+		One2OneChannel<int> c0,c1,c2;
+		
+		BEGIN_TEST()
+		
+		vector<Guard*> guards;
+		guards.push_back(c0.reader().inputGuard());
+		guards.push_back(c1.reader().inputGuard());
+		guards.push_back(c2.reader().inputGuard());
+		
+		ReadinessAlternative alt(guards);
+		
+		//Only channel 0 is attached to us:
+		ASSERTEQ(&(alt.readySet),c0.readySet,"Channel not attached",__LINE__);
+		ASSERTEQ(0u,c0.readyIndex,"Channel attached with wrong index",__LINE__);
+		ASSERTEQ(2u,c2.readyIndex,"Channel attached with wrong index",__LINE__);
+		
+		{
+			ScopedForking forking;
+			
+			forking.forkInThisThread(new WriterProcess<int>(c2.writer(),2));
+			forking.forkInThisThread(new WriterProcess<int>(c0.writer(),0));
+			
+			CPPCSP_Yield();
+			
+			//Both writers have signalled:
+			ASSERTEQ(2u,alt.readySet.pending.size(),"Ready set not as expected",__LINE__);
+			
+			int n;
+			ASSERTEQ(0u,alt.priSelect(),"Wrong guard selected",__LINE__);
+			c0.reader() >> n;
+			ASSERTEQ(0,n,"Wrong value read",__LINE__);
+			
+			ASSERTEQ(2u,alt.priSelect(),"Wrong guard selected",__LINE__);
+			c2.reader() >> n;
+			ASSERTEQ(2,n,"Wrong value read",__LINE__);
+			
+			//Nothing is ready; we will wait until the writer arrives:
+			forking.forkInThisThread(new WriterProcess<int>(c1.writer(),1));
+			ASSERTEQ(1u,alt.priSelect(),"Wrong guard selected",__LINE__);
+			c1.reader() >> n;
+			ASSERTEQ(1,n,"Wrong value read",__LINE__);
+		}
+		
+		END_TEST("ReadinessAlternative Test 0 (unbuffered, priSelect)");
+	}
+	
+	/**
+	*	Tests a ReadinessAlternative's fairSelect and sameSelect over buffered channels, and poison
+	*/
+	static TestResult testReadiness1()
+	{
+		FIFOBuffer<int>::Factory factory(10);
+		BufferedOne2OneChannel<int> c0(factory),c1(factory),c2(factory);
+		
+		BEGIN_TEST()
+		
+		for (int i = 0;i < 4;i++)
+		{
+			c0.writer() << 0;
+			c1.writer() << 1;
+			c2.writer() << 2;
+		}
+		
+		int n;
+		
+		{
+			list<Guard*> guards;
+			guards.push_back(c0.reader().inputGuard());
+			guards.push_back(c1.reader().inputGuard());
+			guards.push_back(c2.reader().inputGuard());
+			
+			ReadinessAlternative alt(guards);
+			
+			for (unsigned i = 0;i < 6;i++)
+			{
+				ASSERTEQ(i % 3,alt.fairSelect(),"Wrong guard selected by fairSelect",__LINE__);
+				AltChanin<int> in = (i % 3 == 0 ? c0.reader() : (i % 3 == 1 ? c1.reader() : c2.reader()));
+				in >> n;
+				ASSERTEQ(static_cast<int>(i % 3),n,"Wrong value read",__LINE__);
+			}
+		}
+		
+		//The channels are free to be attached again:
+		ASSERTEQ(static_cast<AltReadySet*>(NULL),c0.readySet,"Channel not detached",__LINE__);
+		
+		{
+			list<Guard*> guards;
+			guards.push_back(c0.reader().inputGuard());
+			guards.push_back(c1.reader().inputGuard());
+			guards.push_back(c2.reader().inputGuard());
+			
+			ReadinessAlternative alt(guards);
+			
+			ASSERTEQ(0u,alt.fairSelect(),"Wrong guard selected by fairSelect",__LINE__);
+			c0.reader() >> n;
+			
+			//sameSelect now favours channel 1 until it is empty:
+			ASSERTEQ(1u,alt.sameSelect(),"Wrong guard selected by sameSelect",__LINE__);
+			c1.reader() >> n;
+			ASSERTEQ(1u,alt.sameSelect(),"Wrong guard selected by sameSelect",__LINE__);
+			c1.reader() >> n;
+			ASSERTEQ(2u,alt.sameSelect(),"Wrong guard selected by sameSelect",__LINE__);
+			c2.reader() >> n;
+			
+			//Channels 0 and 2 have one item left; empty channel 0 so that the poisoned channel has priority:
+			ASSERTEQ(0u,alt.priSelect(),"Wrong guard selected by priSelect",__LINE__);
+			c0.reader() >> n;
+			
+			c1.writer().poison();
+			ASSERTEQ(1u,alt.priSelect(),"Poisoned channel not selected",__LINE__);
+			
+			bool threw = false;
+			try
+			{
+				c1.reader() >> n;
+			}
+			catch (PoisonException&)
+			{
+				threw = true;
+			}
+			ASSERTEQ(true,threw,"Poisoned channel did not throw",__LINE__);
+		}
+		
+		END_TEST("ReadinessAlternative Test 1 (buffered, fairSelect, sameSelect)");
+	}
+	
+	/**
+	*	Tests a ReadinessAlternative with guards that cannot be attached: a skip guard, and a channel
+	*	that appears twice (only its first guard is attached)
+	*/
+	static TestResult testReadiness2()
+	{
+		One2OneChannel<int> c0;
+		FIFOBuffer<int>::Factory factory(10);
+		BufferedOne2OneChannel<int> c1(factory);
+		
+		BEGIN_TEST()
+		
+		list<Guard*> guards;
+		guards.push_back(c0.reader().inputGuard());
+		guards.push_back(c1.reader().inputGuard());
+		guards.push_back(c1.reader().inputGuard());
+		guards.push_back(new SkipGuard);
+		
+		ReadinessAlternative alt(guards);
+		
+		ASSERTEQ(true,alt.attached[1],"Channel not attached",__LINE__);
+		ASSERTEQ(false,alt.attached[2],"Channel attached twice",__LINE__);
+		ASSERTEQ(2u,alt.unattached.size(),"Unattached guards not as expected",__LINE__);
+		
+		//Nothing is ready, so the skip guard is selected:
+		ASSERTEQ(3u,alt.priSelect(),"Skip guard not selected",__LINE__);
+		
+		int n;
+		c1.writer() << 5;
+		c1.writer() << 6;
+		ASSERTEQ(1u,alt.priSelect(),"Wrong guard selected",__LINE__);
+		c1.reader() >> n;
+		
+		//Fair select starts at 2, the unattached guard for the same channel:
+		ASSERTEQ(2u,alt.fairSelect(),"Wrong guard selected",__LINE__);
+		c1.reader() >> n;
+		ASSERTEQ(6,n,"Wrong value read",__LINE__);
+		
+		ASSERTEQ(3u,alt.fairSelect(),"Skip guard not selected",__LINE__);
+		
+		//Replacing a guard detaches the old one:
+		Guard* old = alt.replaceGuard(1,new SkipGuard);
+		ASSERTEQ(static_cast<AltReadySet*>(NULL),c1.readySet,"Channel not detached by replaceGuard",__LINE__);
+		delete old;
+		ASSERTEQ(1u,alt.priSelect(),"Replacement guard not selected",__LINE__);
+		
+		END_TEST("ReadinessAlternative Test 2 (unattached guards)");
+	}
+	
+	/**
+	*	Tests a ReadinessAlternative with many writers in another thread
+	*/
+	static TestResult testReadiness3()
+	{
+		const unsigned CHANNELS = 50;
+		const int COMMS_EACH = 200;
+		
+		vector< One2OneChannel<int>* > channels(CHANNELS);
+		for (unsigned i = 0;i < CHANNELS;i++)
+		{
+			channels[i] = new One2OneChannel<int>;
+		}
+		
+		BEGIN_TEST()
+		
+		vector<Guard*> guards(CHANNELS);
+		list<CSProcessPtr> writers;
+		for (unsigned i = 0;i < CHANNELS;i++)
+		{
+			guards[i] = channels[i]->reader().inputGuard();
+			writers.push_back(new WriterProcess<int>(channels[i]->writer(),static_cast<int>(i),COMMS_EACH));
+		}
+		
+		{
+			ReadinessAlternative alt(guards);
+			vector<int> counts(CHANNELS,0);
+			
+			ScopedForking forking;
+			forking.fork(InParallelOneThread(writers.begin(),writers.end()));
+			
+			for (unsigned i = 0;i < CHANNELS * COMMS_EACH;i++)
+			{
+				unsigned sel = alt.fairSelect();
+				int n;
+				channels[sel]->reader() >> n;
+				ASSERTEQ(static_cast<int>(sel),n,"Wrong value read",__LINE__);
+				counts[sel]++;
+			}
+			
+			for (unsigned i = 0;i < CHANNELS;i++)
+			{
+				ASSERTEQ(COMMS_EACH,counts[i],"Wrong number of values read from channel",__LINE__);
+			}
+		}
+		
+		for (unsigned i = 0;i < CHANNELS;i++)
+		{
+			delete channels[i];
+		}
+		
+		END_TEST_C("ReadinessAlternative Test 3 (writers in another thread)",
+			for (unsigned i = 0;i < CHANNELS;i++) channels[i]->reader().poison()
+		);
+	}
+	
+	/**
+	*	Tests InputGuard: it selects the same as the guards from inputGuard(), and is not deleted by the Alternative,
+	*	so it can be used in several Alternatives one after the other
+	*/
+	static TestResult testEmbedded0()
+	{
+		One2OneChannel<int> c0,c1;
+		FIFOBuffer<int>::Factory factory(10);
+		BufferedOne2OneChannel<int> c2(factory);
+		
+		BEGIN_TEST()
+		
+		InputGuard<int> g0(c0.reader()),g1(c1.reader()),g2(c2.reader());
+		Guard* guards[] = {&g0,&g1,&g2};
+		
+		for (int round = 0;round < 2;round++)
+		{
+			Alternative alt(guards,3);
+			
+			ScopedForking forking;
+			forking.forkInThisThread(new WriterProcess<int>(c1.writer(),1,1));
+			c2.writer() << 2;
+			//Let the writer get to the channel:
+			CPPCSP_Yield();
+			
+			ASSERTEQ(1u,alt.priSelect(),"Wrong guard selected",__LINE__);
+			int n;
+			c1.reader() >> n;
+			ASSERTEQ(1,n,"Wrong value read",__LINE__);
+			
+			ASSERTEQ(2u,alt.priSelect(),"Wrong guard selected",__LINE__);
+			c2.reader() >> n;
+			ASSERTEQ(2,n,"Wrong value read",__LINE__);
+			
+			forking.forkInThisThread(new WriterProcess<int>(c0.writer(),0,1));
+			ASSERTEQ(0u,alt.fairSelect(),"Wrong guard selected",__LINE__);
+			c0.reader() >> n;
+			ASSERTEQ(0,n,"Wrong value read",__LINE__);
+		}
+		
+		END_TEST_C("Embedded Guard Test 0",
+			c0.reader().poison();c1.reader().poison();c2.reader().poison()
+		);
+	}
+	
+	/**
+	*	Tests that re-arming an Alternative of InputGuards with different subsets, and selecting on it, does not allocate memory
+	*	(neither for the guards nor anywhere else, such as the kernel's record of blocked processes)
+	*/
+	static TestResult testEmbedded1()
+	{
+		const unsigned CHANNELS = 3;
+		const int COMMS = 100;
+		
+		//Each channel is in two-thirds of the selects, so fill them enough that none can run out:
+		FIFOBuffer<int>::Factory factory(2 * COMMS);
+		BufferedOne2OneChannel<int> c0(factory),c1(factory),c2(factory);
+		One2OneChannel<int> c3;
+		
+		BEGIN_TEST()
+		
+		AltChanin<int> in[CHANNELS] = {c0.reader(),c1.reader(),c2.reader()};
+		for (int i = 0;i < 2 * COMMS;i++)
+		{
+			c0.writer() << 0;
+			c1.writer() << 1;
+			c2.writer() << 2;
+		}
+		
+		InputGuard<int> g0(in[0]),g1(in[1]),g2(in[2]),g3(c3.reader());
+		Guard* all[] = {&g0,&g1,&g2,&g3};
+		Guard* subset[CHANNELS];
+		unsigned channelOf[CHANNELS];
+		Alternative alt(all,CHANNELS + 1);
+		
+		ScopedForking forking;
+		forking.forkInThisThread(new WriterProcess<int>(c3.writer(),3,COMMS));
+		
+		//The channels' guards are constructed inside the InputGuards, not on the heap:
+		for (unsigned i = 0;i <= CHANNELS;i++)
+		{
+			const InputGuard<int>* g = static_cast<InputGuard<int>*>(all[i]);
+			const char* guard = reinterpret_cast<const char*>(g->guard);
+			const char* storage = reinterpret_cast<const char*>(&g->storage);
+			ASSERTL(guard >= storage && guard < storage + sizeof(g->storage),"Channel guard was not constructed in the InputGuard's storage",__LINE__);
+		}
+		
+		//Re-arming with no more guards than before keeps the Alternative's array:
+		Guard* const * const array = &alt.guards[0];
+		const size_t capacity = alt.guards.capacity();
+		usign32 allocations;
+		{
+			AllocationCounter counter;
+			for (int i = 0;i < static_cast<int>(CHANNELS) * COMMS;i++)
+			{
+				//Alternately leave out each of the buffered channels:
+				const unsigned leaveOut = static_cast<unsigned>(i) % CHANNELS;
+				unsigned n = 0;
+				for (unsigned j = 0;j < CHANNELS;j++)
+				{
+					if (j != leaveOut)
+					{
+						channelOf[n] = j;
+						subset[n++] = all[j];
+					}
+				}
+				alt.rearm(subset,subset + n);
+				
+				const unsigned channel = channelOf[alt.fairSelect()];
+				int x;
+				in[channel] >> x;
+				ASSERTEQ(static_cast<int>(channel),x,"Wrong value read",__LINE__);
+			}
+			allocations = counter.allocations();
+		}
+		ASSERTL(array == &alt.guards[0] && capacity == alt.guards.capacity(),"Guard array reallocated while re-arming",__LINE__);
+		ASSERTEQ(0u,allocations,"Memory allocated while re-arming and selecting on buffered channels",__LINE__);
+		
+		//Now with the one-to-one channel, whose writer has to be scheduled between selects:
+		alt.rearm(all + CHANNELS,all + CHANNELS + 1);
+		{
+			AllocationCounter counter;
+			for (int i = 0;i < COMMS;i++)
+			{
+				ASSERTEQ(0u,alt.priSelect(),"Wrong guard selected",__LINE__);
+				int x;
+				c3.reader() >> x;
+				ASSERTEQ(3,x,"Wrong value read",__LINE__);
+			}
+			allocations = counter.allocations();
+		}
+		ASSERTL(array == &alt.guards[0] && capacity == alt.guards.capacity(),"Guard array reallocated while selecting",__LINE__);
+		ASSERTEQ(0u,allocations,"Memory allocated while selecting on one-to-one channel",__LINE__);
+		
+		END_TEST_C("Embedded Guard Test 1 (no allocation per select)",
+			c3.reader().poison()
+		);
+	}
+
+	/**
+	*	Tests output guards on one-to-one channels: ready when a reader is committed to an input, not ready otherwise
+	*	(including when the reader is alting), woken by a reader arriving, and ready when the channel is poisoned
+	*/
+	static TestResult testOutput0()
+	{
+		One2OneChannel<int> c0,c1;
+		
+		BEGIN_TEST()
+		
+		int n = 5;
+		int total0 = 0,total1 = 0;
+		AltChanout<int> out0(c0.writer()),out1(c1.writer());
+		list<Guard*> guards = list_of<Guard*>(out0.outputGuard(&n))(out1.outputGuard(&n))(new SkipGuard);
+		Alternative alt(guards);
+		
+		ASSERTEQ(2u,alt.priSelect(),"No reader is waiting, so the skip guard should be selected",__LINE__);
+		
+		{
+			ScopedForking forking;
+			forking.forkInThisThread(new SummingReader(c1.reader(),1,&total1));
+			CPPCSP_Yield();
+			
+			ASSERTEQ(1u,alt.priSelect(),"Wrong guard selected",__LINE__);
+			out1 << n;
+		}
+		ASSERTEQ(5,total1,"Wrong value read",__LINE__);
+		
+		{
+			//An alting reader does not make the output guard ready, but an output to it still completes:
+			ScopedForking forking;
+			forking.forkInThisThread(new AltingReader(c0.reader(),&total0));
+			CPPCSP_Yield();
+			ASSERTEQ(2u,alt.priSelect(),"Only an alting reader is waiting, so the skip guard should be selected",__LINE__);
+			out0 << n;
+		}
+		ASSERTEQ(5,total0,"Wrong value read",__LINE__);
+		
+		//Now wait, until a reader arrives:
+		total0 = 0;
+		{
+			list<Guard*> waitingGuards = list_of<Guard*>(out0.outputGuard(&n))(out1.outputGuard(&n));
+			Alternative waitingAlt(waitingGuards);
+			ScopedForking forking;
+			forking.forkInThisThread(new SummingReader(c0.reader(),1,&total0));
+			
+			ASSERTEQ(0u,waitingAlt.priSelect(),"Wrong guard selected",__LINE__);
+			out0 << n;
+		}
+		ASSERTEQ(5,total0,"Wrong value read",__LINE__);
+		
+		c1.reader().poison();
+		{
+			list<Guard*> poisonGuards = list_of<Guard*>(out0.outputGuard(&n))(out1.outputGuard(&n));
+			Alternative poisonAlt(poisonGuards);
+			ASSERTEQ(1u,poisonAlt.priSelect(),"Poisoned channel's guard should be ready",__LINE__);
+			bool poisoned = false;
+			try
+			{
+				out1 << n;
+			}
+			catch (PoisonException&)
+			{
+				poisoned = true;
+			}
+			ASSERTEQ(true,poisoned,"Output on poisoned channel should throw",__LINE__);
+		}
+		
+		END_TEST_C("Output Guard Test 0 (one-to-one)",
+			c0.reader().poison();c1.reader().poison()
+		);
+	}
+	
+	/**
+	*	Tests output guards on buffered channels: ready while the buffer has space, and woken by a reader making space
+	*/
+	static TestResult testOutput1()
+	{
+		FIFOBuffer<int>::Factory factory(1);
+		BufferedOne2OneChannel<int> c0(factory),c1(factory);
+		
+		BEGIN_TEST()
+		
+		int n = 7;
+		int total0 = 0;
+		AltChanout<int> out0(c0.writer()),out1(c1.writer());
+		OutputGuard<int> g0(out0,&n),g1(out1,&n);
+		Guard* guards[] = {&g0,&g1};
+		Alternative alt(guards,2);
+		
+		ASSERTEQ(0u,alt.priSelect(),"Buffer has space, so the first guard should be selected",__LINE__);
+		out0 << n;
+		ASSERTEQ(1u,alt.priSelect(),"Only the second buffer has space",__LINE__);
+		out1 << n;
+		
+		{
+			ScopedForking forking;
+			forking.forkInThisThread(new SummingReader(c0.reader(),2,&total0));
+			
+			//Both buffers are full, so this waits for the reader to make space:
+			ASSERTEQ(0u,alt.priSelect(),"Wrong guard selected",__LINE__);
+			out0 << n;
+		}
+		ASSERTEQ(14,total0,"Wrong values read",__LINE__);
+		
+		int m;
+		c1.reader() >> m;
+		ASSERTEQ(7,m,"Wrong value read",__LINE__);
+		
+		END_TEST_C("Output Guard Test 1 (buffered)",
+			c0.reader().poison();c1.reader().poison()
+		);
+	}
+	
+	/**
+	*	Tests a load-balancer that alts over its outputs to readers in another thread, sending each value to whichever
+	*	reader is ready
+	*/
+	static TestResult testOutput2()
+	{
+		const unsigned READERS = 4;
+		const int VALUES = 2000;
+		
+		vector< One2OneChannel<int>* > channels(READERS);
+		for (unsigned i = 0;i < READERS;i++)
+		{
+			channels[i] = new One2OneChannel<int>;
+		}
+		
+		BEGIN_TEST()
+		
+		int n;
+		vector<int> totals(READERS,0);
+		vector< AltChanout<int> > outs;
+		vector<Guard*> guards;
+		list<CSProcessPtr> readers;
+		for (unsigned i = 0;i < READERS;i++)
+		{
+			outs.push_back(channels[i]->writer());
+			guards.push_back(outs[i].outputGuard(&n));
+			readers.push_back(new SummingReader(channels[i]->reader(),VALUES * static_cast<int>(READERS),&totals[i]));
+		}
+		
+		{
+			Alternative alt(guards);
+			ScopedForking forking;
+			forking.fork(InParallelOneThread(readers.begin(),readers.end()));
+			
+			for (n = 0;n < VALUES * static_cast<int>(READERS);n++)
+			{
+				outs[alt.fairSelect()] << n;
+			}
+			
+			//The readers may not have read the same number each, so poison them when we are done:
+			for (unsigned i = 0;i < READERS;i++)
+			{
+				outs[i].poison();
+			}
+		}
+		
+		int total = 0;
+		for (unsigned i = 0;i < READERS;i++)
+		{
+			total += totals[i];
+		}
+		const int all = VALUES * static_cast<int>(READERS);
+		ASSERTEQ((all - 1) * all / 2,total,"Values were lost or duplicated",__LINE__);
+		
+		for (unsigned i = 0;i < READERS;i++)
+		{
+			delete channels[i];
+		}
+		
+		END_TEST_C("Output Guard Test 2 (load-balancer)",
+			for (unsigned i = 0;i < READERS;i++) channels[i]->reader().poison()
+		);
+	}
+
+	/**
+	*	Times selects over many channels, only one of which is ever ready
+	*/
+	template <unsigned CHANNELS, typename ALTERNATIVE>
+	static TestResult testSparseAlt()
+	{
+		const int COMMS = 20000;
+		
+		vector< One2OneChannel<int>* > channels(CHANNELS);
+		vector<Guard*> guards(CHANNELS);
+		for (unsigned i = 0;i < CHANNELS;i++)
+		{
+			channels[i] = new One2OneChannel<int>;
+			guards[i] = channels[i]->reader().inputGuard();
+		}
+		
+		Time t;
+		{
+			ALTERNATIVE alt(guards);
+			
+			ScopedForking forking;
+			forking.fork(new WriterProcess<int>(channels[CHANNELS / 2]->writer(),0,COMMS));
+			
+			Time t0;
+			CurrentTime(&t0);
+			for (int i = 0;i < COMMS;i++)
+			{
+				int n;
+				channels[alt.fairSelect()]->reader() >> n;
+			}
+			CurrentTime(&t);
+			t -= t0;
+		}
+		
+		for (unsigned i = 0;i < CHANNELS;i++)
+		{
+			delete channels[i];
+		}
+		
+		return TestResultPass("Sparse Alter Test, " + lexical_cast<string>(CHANNELS) + " channels with one writer in another thread, "
+			+ std::string(boost::is_same<ALTERNATIVE,ReadinessAlternative>::value ? "ReadinessAlternative" : "Alternative") + ": "
+			+ lexical_cast<string>(1000000.0 * (GetSeconds(&t) / static_cast<double>(COMMS))) + " microseconds per fairSelect() and input"
+		);
+	}
+
 	std::list<TestResult (*)()> tests()
 	{
 		us = currentProcess();
@@ -1130,6 +1839,12 @@ public:
 			(testBuf0) (testBuf1) (testBuf2) (testBuf3) (testBuf4)			
 			
 			(testRepGuard0) (testRepGuard1)
+			
+			(testReadiness0) (testReadiness1) (testReadiness2) (testReadiness3)
+			
+			(testEmbedded0) (testEmbedded1)
+			
+			(testOutput0) (testOutput1) (testOutput2)
 		;
 	}
 	
@@ -1145,6 +1860,9 @@ public:
 			( testStressedAlt<10,100,100,false, StandardChannelFactory<int> > )
 			( testStressedAlt<100,10,100,false, StandardChannelFactory<int> > )
 			( testStressedAlt<50,50,100,false, StandardChannelFactory<int> > )			
+			
+			( testSparseAlt<10,Alternative> ) ( testSparseAlt<10,ReadinessAlternative> )
+			( testSparseAlt<2000,Alternative> ) ( testSparseAlt<2000,ReadinessAlternative> )
 		;
 	}	
 	
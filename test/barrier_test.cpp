@@ -22,6 +22,7 @@
 
 #include "../src/cppcsp.h"
 #include "../src/common/barrier_bucket.h"
+#include "../src/common/basic.h"
 
 using namespace csp;
 using namespace csp::internal;
@@ -30,6 +31,7 @@ using namespace boost::assign;
 using namespace boost;
 
 #include <list>
+#include <numeric>
 
 using namespace std;
 
@@ -143,6 +145,315 @@ public:
 	}
 };
 
+//The InterThreadBarrier as it was before it used per-kernel slots, for comparison in the performance tests:
+template <typename MUTEX>
+class MapInterThreadBarrier : private internal::Primitive, public boost::noncopyable
+{
+	class Data
+	{
+	public:
+		volatile usign32 leftToSync;
+		volatile usign32 enrolled;
+		volatile ProcessPtr queueHead;
+		volatile ProcessPtr queueTail;
+	};
+	std::map<ThreadId,Data> processes;
+	__CPPCSP_ALIGNED_USIGN32 threadsLeftToSync;
+	MUTEX mutex;			
+	
+	/**
+	*	@return true if the sync completed, false if it didn't (i.e. false means we are blocked)
+	*
+	*	May block temporarily to grab the mutex
+	*/			
+	inline bool syncWholeThread(const ProcessPtr& process,usign32* numWhoSynced)
+	{
+	
+			typename MUTEX::End mutexEnd(mutex.end());
+
+			usign32 val = AtomicDecrement(&threadsLeftToSync);
+			
+			if (val == 0)
+			{
+				//We can complete the sync, as long as nobody enrolls in the mean-time.  Must grab the mutex:
+				mutexEnd.claim();
+			
+				//All the other processes were blocked, so the only person that could have come along since
+				//our atomic decrement was an enrolling process.  If they've enrolled (but not synced)
+				//we must also wait - they will complete the sync
+			
+				if (AtomicGet(&threadsLeftToSync) == 0)
+				{
+					//We need to put the count back, ready for any processes that we free who sync quickly.
+					//First we must make a pass to count the number that will be left:
+					
+					usign32 threadsLeft = 0;
+					for (typename std::map<ThreadId,Data>::iterator it = processes.begin();it != processes.end();it++)
+					{
+						if (it->second.enrolled > 0)
+						{
+							threadsLeft += 1;
+						}
+					}
+					
+					AtomicPut(&threadsLeftToSync,threadsLeft);
+					
+					if (numWhoSynced != NULL)
+						*numWhoSynced = 0;
+				
+					//No-one enrolled before we claimed the mutex - sync by freeing everyone in the map (except us!)
+					for (typename std::map<ThreadId,Data>::iterator it = processes.begin();it != processes.end();)
+					{
+						ProcessPtr queueHead = it->second.queueHead;
+						ProcessPtr queueTail = it->second.queueTail;
+						
+						if (numWhoSynced != NULL)
+							*numWhoSynced += it->second.enrolled;
+					
+						if (it->second.enrolled > 0)
+						{
+							it->second.queueHead = NullProcessPtr;
+							it->second.queueTail = NullProcessPtr;
+							it->second.leftToSync = it->second.enrolled;
+							
+							it++;
+						}
+						else
+						{									
+						#ifdef CPPCSP_MSVC
+							it = processes.erase(it);
+						#else
+							processes.erase(it++);
+						#endif
+						}							
+					
+						if (queueHead != NullProcessPtr)
+						{
+							if (queueHead == process)
+							{
+								//Miss out ourselves:
+								ProcessPtr next = getNextProcess(process);
+								if (next != NULL)
+								{
+									freeProcessChain(next,queueTail);
+								}										
+							}
+							else
+							{
+								//We weren't in there - free them all:
+								freeProcessChain(queueHead,queueTail);
+							}
+						}								
+					}
+										
+					mutexEnd.release();
+					return true;
+				}
+				else
+				{
+					//Someone has enrolled.  We must sleep ourselves!
+					mutexEnd.release();
+					return false;
+				}
+			}
+			else
+			{
+				//Not all threads are ready
+				return false;
+			}
+	}						
+	
+public:
+	typedef Data* Key;
+
+	inline MapInterThreadBarrier()
+		:	threadsLeftToSync(0)
+	{
+	}			
+
+	//If it performs the sync, returns the number of processes who synced 
+	//If it did not perform the sync itself, returns 0;
+	inline usign32 sync(const Key key)
+	{
+	
+		const ProcessPtr process ( currentProcess() );
+		addProcessToQueueAtHead(&(key->queueHead),&(key->queueTail),process);
+		usign32 num = 0;
+		bool synced;
+		if (--(key->leftToSync) == 0)
+		{
+			synced = syncWholeThread(process,&num);
+		}
+		else
+		{
+			//Not everyone in this thread is ready yet
+			synced = false;
+		}
+
+		
+		if (false == synced)
+		{
+			//We may already be back on the run queue by now, but that doesn't matter
+			reschedule();
+		}
+		
+		return num;
+	}
+
+	inline Key enroll()
+	{
+		const ThreadId& threadId = currentThread();
+		typename MUTEX::End mutexEnd = mutex.end();
+		mutexEnd.claim();
+		
+		//It's ok if we add ourselves to the map, as no-one else will be altering the map while we hold the mutex
+		
+		typename std::map<ThreadId,Data>::iterator it = processes.find(threadId);
+		
+		if (it == processes.end())
+		{
+			Data data;
+			data.leftToSync = 1;
+			data.enrolled = 1;
+			data.queueHead = NullProcessPtr;
+			data.queueTail = NullProcessPtr;
+			it = processes.insert(std::make_pair(threadId,data)).first;
+			AtomicIncrement(&threadsLeftToSync);
+		}
+		else
+		{
+			it->second.leftToSync += 1;
+			it->second.enrolled += 1;
+			if (it->second.leftToSync == 1)
+			{
+				//Everyone else was done already - but not any more!
+				AtomicIncrement(&threadsLeftToSync);
+			}
+		}
+		
+		mutexEnd.release();
+		
+		return &(it->second);
+	}
+	
+	inline void halfEnroll()
+	{
+		typename MUTEX::End mutexEnd = mutex.end();
+		mutexEnd.claim();
+		
+		AtomicIncrement(&threadsLeftToSync);
+		
+		mutexEnd.release();
+	}
+	
+	inline Key completeEnroll()
+	{
+
+		const ThreadId& threadId = currentThread();
+		typename MUTEX::End mutexEnd = mutex.end();
+		mutexEnd.claim();
+		
+		//It's ok if we add ourselves to the map, as no-one else will be altering the map while we hold the mutex
+		
+		typename std::map<ThreadId,Data>::iterator it = processes.find(threadId);
+		
+		if (it == processes.end())
+		{
+			Data data;
+			data.leftToSync = 1;
+			data.enrolled = 1;
+			data.queueHead = NullProcessPtr;
+			data.queueTail = NullProcessPtr;
+			it = processes.insert(std::make_pair(threadId,data)).first;
+			
+			//threadsLeftToSync is already one greater than it should be because of our half-enrollment
+			//so don't touch it
+		}
+		else
+		{
+			it->second.leftToSync += 1;
+			it->second.enrolled += 1;
+			//threadsLeftToSync is already one greater than it should be because of our half-enrollment
+			//so we should reverse that, if appropriate:
+			if (it->second.leftToSync == 1)
+			{
+				//Everyone else was done already - but not any more!
+				//no need to reverse
+			}
+			else
+			{
+				//reverse it:
+				AtomicDecrement(&threadsLeftToSync);
+			}					
+		}
+		
+		mutexEnd.release();
+		
+		
+		
+		return &(it->second);				
+	}
+	
+	//Returns true if the barrier is now empty
+	inline bool resign(const Key key)
+	{
+
+		key->enrolled -= 1;
+		if (--(key->leftToSync) == 0)
+		{
+			usign32 num = 1; //Just so long as it's not zero!
+			syncWholeThread(NullProcessPtr,&num);
+			
+			return (num == 0);
+		}
+			
+		return false;
+	}
+};
+
+class MapBarrier : public BarrierBase
+{
+private:
+	MapInterThreadBarrier<PureSpinMutex> barrier;
+public:
+	virtual void* enroll()
+	{
+		return barrier.enroll();
+	}
+	
+	virtual void halfEnroll()
+	{
+		barrier.halfEnroll();
+	}
+	
+	virtual void* completeEnroll()
+	{
+		return barrier.completeEnroll();
+	}
+	
+	virtual void resign(void* key)
+	{
+		barrier.resign(static_cast<MapInterThreadBarrier<PureSpinMutex>::Key>(key));
+	}
+	
+	virtual void sync(void* key)
+	{
+		barrier.sync(static_cast<MapInterThreadBarrier<PureSpinMutex>::Key>(key));
+	}
+	
+	Mobile<BarrierEnd> end()
+	{
+		return Mobile<BarrierEnd>(new BarrierEnd(this));
+	}
+	
+	Mobile<BarrierEnd> enrolledEnd()
+	{
+		halfEnroll();
+		BarrierBase* base = this;
+		return Mobile<BarrierEnd>(new BarrierEnd(base,base));
+	}
+};
+
 		class BucketJoiner : public CSProcess
 		{
 		private:
@@ -161,6 +472,258 @@ public:
 		};
 
 
+//Offers to sync on an AltBarrier in an Alternative, like BarrierSyncer does with sync():
+class AltBarrierSyncer : public CSProcess
+{
+private:
+	Mobile<AltBarrierEnd> end;
+	int times;
+protected:
+	void run()
+	{
+		list<Guard*> guards = list_of<Guard*>(end->guard());
+		Alternative alt(guards);
+		for (int i = 0;i < times;i++)
+		{
+			alt.priSelect();
+		}
+		end->resign();
+	}
+public:
+	inline AltBarrierSyncer(const Mobile<AltBarrierEnd>& _end, const int _times = 1)
+		:	CSProcess(65536),end(_end),times(_times)
+	{
+	}
+	
+	inline virtual ~AltBarrierSyncer()
+	{
+		if (end)
+			end->resign();
+	}
+};
+
+//Alts over a channel and a barrier (in that priority order), and records which was selected:
+class ChannelBarrierAlter : public CSProcess
+{
+private:
+	Mobile<AltBarrierEnd> end;
+	AltChanin<int> in;
+	int* selected;
+protected:
+	void run()
+	{
+		list<Guard*> guards = list_of<Guard*>(in.inputGuard())(end->guard());
+		Alternative alt(guards);
+		*selected = static_cast<int>(alt.priSelect());
+		end->resign();
+	}
+public:
+	inline ChannelBarrierAlter(const Mobile<AltBarrierEnd>& _end,const AltChanin<int>& _in,int* _selected)
+		:	end(_end),in(_in),selected(_selected)
+	{
+	}
+};
+
+//Alts over two barriers, then over the first one alone, and records the selections:
+class TwoBarrierAlter : public CSProcess
+{
+private:
+	Mobile<AltBarrierEnd> endX;
+	Mobile<AltBarrierEnd> endY;
+	int* first;
+	int* second;
+protected:
+	void run()
+	{
+		{
+			list<Guard*> guards = list_of<Guard*>(endX->guard())(endY->guard());
+			Alternative alt(guards);
+			*first = static_cast<int>(alt.priSelect());
+		}
+		{
+			list<Guard*> guards = list_of<Guard*>(endX->guard());
+			Alternative alt(guards);
+			*second = static_cast<int>(alt.priSelect());
+		}
+		endX->resign();
+		endY->resign();
+	}
+public:
+	inline TwoBarrierAlter(const Mobile<AltBarrierEnd>& _endX,const Mobile<AltBarrierEnd>& _endY,int* _first,int* _second)
+		:	endX(_endX),endY(_endY),first(_first),second(_second)
+	{
+	}
+};
+
+//The syncing process used with each type of barrier by the performance tests:
+template <typename BARRIER>
+struct PerfSyncer
+{
+	typedef BarrierSyncer Type;
+};
+
+template <>
+struct PerfSyncer<AltBarrier>
+{
+	typedef AltBarrierSyncer Type;
+};
+
+//Does some work that takes time but does not block:
+inline void BusyWork(int amount)
+{
+	volatile int x = 0;
+	for (int i = 0;i < amount;i++)
+	{
+		x = x + i;
+	}
+}
+
+//A stencil-style worker: computes its boundary, makes it available, computes its interior, and then needs everyone's boundaries.
+//The interior takes longer on one worker each iteration, in turn.  The time spent blocked on the barrier is added to blocked:
+class PhaseWorker : public CSProcess
+{
+private:
+	Mobile<BarrierEnd> end;
+	int id,numWorkers,iterations,work;
+	bool splitPhase;
+	Time* blocked;
+protected:
+	void run()
+	{
+		Time start,finish;
+		end->enroll();
+		for (int i = 0;i < iterations;i++)
+		{
+			BusyWork(work);
+			
+			if (splitPhase)
+			{
+				BarrierPhase phase = end->arrive();
+				BusyWork(((i + id) % numWorkers == 0) ? work * 8 : work);
+				CurrentTime(&start);
+				end->wait(phase);
+			}
+			else
+			{
+				BusyWork(((i + id) % numWorkers == 0) ? work * 8 : work);
+				CurrentTime(&start);
+				end->sync();
+			}
+			
+			CurrentTime(&finish);
+			finish -= start;
+			*blocked += finish;
+		}
+		end->resign();
+	}
+public:
+	inline PhaseWorker(const Mobile<BarrierEnd>& _end,int _id,int _numWorkers,int _iterations,int _work,bool _splitPhase,Time* _blocked)
+		:	CSProcess(65536),end(_end),id(_id),numWorkers(_numWorkers),iterations(_iterations),work(_work),splitPhase(_splitPhase),blocked(_blocked)
+	{
+	}
+};
+
+//Syncs on a ReducingBarrier with id + i in sync i, and counts the results that are not expected + (numProcesses * i):
+class ReducingSyncer : public CSProcess
+{
+private:
+	Mobile< ReducingBarrierEnd<int> > end;
+	int id,numProcesses,times,expected;
+	int* wrong;
+protected:
+	void run()
+	{
+		end->enroll();
+		for (int i = 0;i < times;i++)
+		{
+			if (end->sync(id + i) != expected + numProcesses * i)
+			{
+				*wrong += 1;
+			}
+		}
+		end->resign();
+	}
+public:
+	inline ReducingSyncer(const Mobile< ReducingBarrierEnd<int> >& _end,int _id,int _numProcesses,int _times,int _expected,int* _wrong)
+		:	CSProcess(65536),end(_end),id(_id),numProcesses(_numProcesses),times(_times),expected(_expected),wrong(_wrong)
+	{
+	}
+};
+
+//The same as ReducingSyncer, but using a barrier, and an aggregator process that sums the values and sends back the total:
+class ChannelReducingSyncer : public CSProcess
+{
+private:
+	Mobile<BarrierEnd> end;
+	Chanout<int> out;
+	Chanin<int> in;
+	int id,numProcesses,times,expected;
+	int* wrong;
+protected:
+	void run()
+	{
+		int total;
+		end->enroll();
+		for (int i = 0;i < times;i++)
+		{
+			end->sync();
+			out << (id + i);
+			in >> total;
+			if (total != expected + numProcesses * i)
+			{
+				*wrong += 1;
+			}
+		}
+		end->resign();
+	}
+public:
+	inline ChannelReducingSyncer(const Mobile<BarrierEnd>& _end,const Chanout<int>& _out,const Chanin<int>& _in,int _id,int _numProcesses,int _times,int _expected,int* _wrong)
+		:	CSProcess(65536),end(_end),out(_out),in(_in),id(_id),numProcesses(_numProcesses),times(_times),expected(_expected),wrong(_wrong)
+	{
+	}
+};
+
+class ReducingAggregator : public CSProcess
+{
+private:
+	Chanin<int> in;
+	vector< Chanout<int> > outs;
+	int times;
+protected:
+	void run()
+	{
+		int value,total;
+		for (int i = 0;i < times;i++)
+		{
+			total = 0;
+			for (unsigned int j = 0;j < outs.size();j++)
+			{
+				in >> value;
+				total += value;
+			}
+			for (unsigned int j = 0;j < outs.size();j++)
+			{
+				outs[j] << total;
+			}
+		}
+	}
+public:
+	inline ReducingAggregator(const Chanin<int>& _in,const vector< Chanout<int> >& _outs,int _times)
+		:	CSProcess(65536),in(_in),outs(_outs),times(_times)
+	{
+	}
+};
+
+inline Mobile<BarrierEnd> PlainEnd(const Mobile<BarrierEnd>& end)
+{
+	return end;
+}
+
+inline Mobile<BarrierEnd> PlainEnd(const Mobile<AltBarrierEnd>& end)
+{
+	return NoAlt(end);
+}
+
 class BarrierTest : public Test, public virtual internal::TestInfo, public SchedulerRecorder
 {
 public:
@@ -170,8 +733,10 @@ public:
 	{
 		us = currentProcess();
 		return list_of<TestResult (*) ()>
-			(test0)(test1)(test2)(test3)
+			(test0)(test1)(test2)(test3)(test4)(test5)(test6)
+			(testReducing0)(testReducing1)
 			(testBucket0)(testBucket1)(testBucket2)
+			(testAlt0)(testAlt1)(testAlt2)
 		;
 	}
 
@@ -181,6 +746,12 @@ public:
 		return list_of<TestResult (*) ()>
 			(oneThreadPerfTest100)(oneThreadPerfTest1000)(oneThreadPerfTest10000)(multiThreadPerfTest2)(multiThreadPerfTest2_5000)(multiThreadPerfTest10)(multiThreadPerfTest100) (multiThreadPerfTest100_100)
 			(simple_oneThreadPerfTest100)(simple_oneThreadPerfTest1000)(simple_oneThreadPerfTest10000)(simple_multiThreadPerfTest2)(simple_multiThreadPerfTest2_5000)(simple_multiThreadPerfTest10)(simple_multiThreadPerfTest100)	(simple_multiThreadPerfTest100_100)
+			(alt_oneThreadPerfTest100)(alt_oneThreadPerfTest1000)(alt_multiThreadPerfTest2)(alt_multiThreadPerfTest10)(alt_multiThreadPerfTest100)
+			(altOfferPerfTest0)(altOfferPerfTest100)(altOfferPerfTest10000)
+			(threadsPerfTest2)(threadsPerfTest8)(threadsPerfTest32)(threadsPerfTest64)(threadsPerfTest128)
+			(map_threadsPerfTest2)(map_threadsPerfTest8)(map_threadsPerfTest32)(map_threadsPerfTest64)(map_threadsPerfTest128)
+			(syncPhasePerfTest2)(splitPhasePerfTest2)(syncPhasePerfTest4)(splitPhasePerfTest4)
+			(reducingPerfTest1_10)(channelReducingPerfTest1_10)(reducingPerfTest4_1)(channelReducingPerfTest4_1)(reducingPerfTest4_10)(channelReducingPerfTest4_10)
 		;
 	}
 
@@ -525,27 +1096,359 @@ public:
 		END_TEST("Barrier Test 3");
 	}
 
-	template <typename BARRIER>	
-	static TestResult _barrierPerfTest(const char* name,int numThreads, int numProcessesPerThread,int numSyncs)
+	//Syncing while everyone is in our thread, and then with someone in another thread:
+	static TestResult test4()
 	{
-		Time start,finish;
-		usign32 calls;
-		double microsPerSync;
-	
 		BEGIN_TEST()
+	
+		SetUp setup;
+		Barrier barrier;
 		
-		BARRIER barrier;
+		Mobile<BarrierEnd> endUs(barrier.end());
 		
-		list< list<CSProcessPtr> > syncers;
-		list<CSProcessPtr> specialSyncers;
+		CSProcessPtr _syncer = new BarrierSyncer(barrier.end(),2);
+		ProcessPtr syncer(getProcessPtr(_syncer));
 		
-		for (int i = 0;i < (numThreads - 1);i++)
-		{
-			list<CSProcessPtr> subSyncers;
-			
-			for (int j = 0;j < numProcessesPerThread;j++)
+		bool localAfterEnroll,localAfterSync,localAfterHalfEnroll,localAfterResign;
+		usign32 groupsAfterSync;
+		
+		EventList expA = tuple_list_of
+			(us,syncer,syncer) //We complete the barrier, and free them, but don't context switch
+		;
+		
+		EventList actA;
+		
+		{
+			ScopedForking forking;
+			
+			endUs->enroll();
+			
+			forking.forkInThisThread(_syncer);
+			CPPCSP_Yield();
+			
+			localAfterEnroll = (barrier.barrier.localSlot != NULL);
+			
+			{
+				RecordEvents _(&actA);
+				
+				endUs->sync();
+			}
+			
+			localAfterSync = (barrier.barrier.localSlot != NULL);
+			groupsAfterSync = barrier.barrier.groupsLeftToSync;
+			
+			//The enrollment could be completed in any thread:
+			Mobile<BarrierEnd> endThem(barrier.enrolledEnd());
+			localAfterHalfEnroll = (barrier.barrier.localSlot != NULL);
+			
+			forking.fork(new BarrierSyncer(endThem));
+			
+			//The syncer in our thread, and the new one in the other thread, must both sync with us:
+			endUs->sync();
+			
+			endUs->resign();
+		}
+		
+		localAfterResign = (barrier.barrier.localSlot != NULL);
+		
+		ASSERTEQ(true,localAfterEnroll,"Barrier was not local with all processes in one thread",__LINE__);
+		ASSERTEQ(expA,actA,"Local sync not as expected",__LINE__);
+		ASSERTEQ(true,localAfterSync,"Barrier was not local after a local sync",__LINE__);
+		ASSERTEQ(1,groupsAfterSync,"Combining tree did not count the local slot",__LINE__);
+		ASSERTEQ(false,localAfterHalfEnroll,"Barrier was local with a half-enrolled process",__LINE__);
+		ASSERTEQ(false,localAfterResign,"Barrier was local with no-one enrolled",__LINE__);
+		
+		END_TEST("Barrier Test 4");
+	}
+
+	//Arriving and waiting, with one other process in our thread:
+	static TestResult test5()
+	{
+		BEGIN_TEST()
+	
+		SetUp setup;
+		Barrier barrier;
+		
+		Mobile<BarrierEnd> endUs(barrier.end());
+		
+		//They are half-enrolled before they run, so they count from the start:
+		CSProcessPtr _syncer = new BarrierSyncer(barrier.enrolledEnd(),3);
+		
+		bool completedBeforeThem,completedAfterThem,completedAlone;
+		
+		{
+			ScopedForking forking;
+			
+			endUs->enroll();
+			forking.forkInThisThread(_syncer);
+			
+			//They have not run yet:
+			BarrierPhase phase = endUs->arrive();
+			completedBeforeThem = endUs->tryWait(phase);
+			
+			//They sync, which completes the phase, and then block in their second sync:
+			CPPCSP_Yield();
+			completedAfterThem = endUs->tryWait(phase);
+			
+			//This completes their second sync, and then our sync is their third:
+			endUs->arrive();
+			endUs->sync();
+			
+			//They have finished and resigned, so we complete the phase on our own:
+			CPPCSP_Yield();
+			phase = endUs->arrive();
+			completedAlone = endUs->tryWait(phase);
+			
+			endUs->resign();
+		}
+		
+		ASSERTEQ(false,completedBeforeThem,"Phase completed before the other process arrived",__LINE__);
+		ASSERTEQ(true,completedAfterThem,"Phase not completed after the other process synced",__LINE__);
+		ASSERTEQ(true,completedAlone,"Phase not completed with only us enrolled",__LINE__);
+		
+		END_TEST("Barrier Split-Phase Test 0");
+	}
+	
+	//Arriving and waiting, with processes in other threads syncing, arriving and waiting:
+	static TestResult test6()
+	{
+		BEGIN_TEST()
+		
+		SetUp setup;
+		Barrier barrier;
+		Time blocked[2];
+		
+		Mobile<BarrierEnd> endUs(barrier.enrolledEnd());
+		
+		{
+			ScopedForking forking;
+			
+			blocked[0] = blocked[1] = MicroSeconds(0);
+			forking.fork(new BarrierSyncer(barrier.enrolledEnd(),1000));
+			forking.fork(new PhaseWorker(barrier.enrolledEnd(),0,2,1000,10,true,&blocked[0]));
+			forking.forkInThisThread(new PhaseWorker(barrier.enrolledEnd(),1,2,1000,10,true,&blocked[1]));
+			
+			for (int i = 0;i < 1000;i++)
+			{
+				BarrierPhase phase = endUs->arrive();
+				if (i % 2 == 0)
+				{
+					while (false == endUs->tryWait(phase))
+					{
+						CPPCSP_Yield();
+					}
+				}
+				else
+				{
+					endUs->wait(phase);
+				}
+			}
+			
+			endUs->resign();
+		}
+		
+		//Getting here without deadlock is the test:
+		
+		END_TEST("Barrier Split-Phase Test 1");
+	}
+
+	//Reducing in one thread, including with half-enrolled ends, resignations and another operation:
+	static TestResult testReducing0()
+	{
+		BEGIN_TEST()
+		
+		SetUp setup;
+		ReducingBarrier<int> barrier;
+		ReducingBarrier<int,std::multiplies<int> > product;
+		int wrong = 0;
+		int alone,first,second,afterResign,productResult;
+		
+		Mobile< ReducingBarrierEnd<int> > endUs(barrier.end());
+		Mobile< ReducingBarrierEnd<int,std::multiplies<int> > > productEnd(product.enrolledEnd());
+		
+		endUs->enroll();
+		alone = endUs->sync(5);
+		
+		{
+			ScopedForking forking;
+			
+			//Values 1 and 2 in the first sync, 2 and 3 in the second, so with ours the totals are 13 and 16:
+			forking.forkInThisThread(new ReducingSyncer(barrier.enrolledEnd(),1,3,2,13,&wrong));
+			forking.forkInThisThread(new ReducingSyncer(barrier.enrolledEnd(),2,3,2,13,&wrong));
+			
+			first = endUs->sync(10);
+			second = endUs->sync(11);
+		}
+		
+		//They have resigned, so they do not contribute:
+		afterResign = endUs->sync(7);
+		endUs->resign();
+		
+		productResult = productEnd->sync(6);
+		productEnd->resign();
+		
+		ASSERTEQ(5,alone,"Sync on our own did not return our value",__LINE__);
+		ASSERTEQ(13,first,"First sync did not combine all the values",__LINE__);
+		ASSERTEQ(16,second,"Second sync did not combine all the values",__LINE__);
+		ASSERTEQ(0,wrong,"Syncers got the wrong results",__LINE__);
+		ASSERTEQ(7,afterResign,"Sync after resignations did not return our value",__LINE__);
+		ASSERTEQ(6,productResult,"Product on our own did not return our value",__LINE__);
+		
+		END_TEST("Reducing Barrier Test 0");
+	}
+	
+	//Reducing across several threads:
+	static TestResult testReducing1()
+	{
+		const int numThreads = 4;
+		const int perThread = 3;
+		const int times = 1000;
+		
+		BEGIN_TEST()
+		
+		SetUp setup;
+		ReducingBarrier<int> barrier;
+		//The ids are 0 to n-1, so the first sync's total is n(n-1)/2:
+		const int n = numThreads * perThread;
+		vector<int> wrong(n,0);
+		
+		//Everyone must be enrolled before anyone syncs:
+		vector< list<CSProcessPtr> > syncers(numThreads);
+		for (int i = 0;i < numThreads;i++)
+		{
+			for (int j = 0;j < perThread;j++)
+			{
+				const int id = i * perThread + j;
+				syncers[i].push_back(new ReducingSyncer(barrier.enrolledEnd(),id,n,times,(n * (n - 1)) / 2,&wrong[id]));
+			}
+		}
+		
+		{
+			ScopedForking forking;
+			for (int i = 0;i < numThreads;i++)
+			{
+				forking.fork(InParallelOneThread(syncers[i].begin(),syncers[i].end()).process());
+			}
+		}
+		
+		ASSERTEQ(0,std::accumulate(wrong.begin(),wrong.end(),0),"Syncers got the wrong results",__LINE__);
+		
+		END_TEST("Reducing Barrier Test 1");
+	}
+	
+	static TestResult _reducingPerfTest(int numThreads,int perThread,bool channels)
+	{
+		const int times = 10000;
+		const int n = numThreads * perThread;
+		Time start,finish;
+		double microsPerSync;
+		
+		BEGIN_TEST()
+		
+		ReducingBarrier<int> reducing;
+		Barrier barrier;
+		Any2OneChannel<int> toAggregator;
+		vector< One2OneChannel<int>* > fromAggregator;
+		vector< Chanout<int> > outs;
+		vector<int> wrong(n,0);
+		
+		for (int i = 0;i < n;i++)
+		{
+			fromAggregator.push_back(new One2OneChannel<int>);
+			outs.push_back(fromAggregator[i]->writer());
+		}
+		
+		vector< list<CSProcessPtr> > syncers(numThreads);
+		for (int i = 0;i < numThreads;i++)
+		{
+			for (int j = 0;j < perThread;j++)
+			{
+				const int id = i * perThread + j;
+				if (channels)
+					syncers[i].push_back(new ChannelReducingSyncer(barrier.enrolledEnd(),toAggregator.writer(),fromAggregator[id]->reader(),id,n,times,(n * (n - 1)) / 2,&wrong[id]));
+				else
+					syncers[i].push_back(new ReducingSyncer(reducing.enrolledEnd(),id,n,times,(n * (n - 1)) / 2,&wrong[id]));
+			}
+		}
+		
+		CurrentTime(&start);
+		{
+			ScopedForking forking;
+			for (int i = 0;i < numThreads;i++)
+			{
+				forking.fork(InParallelOneThread(syncers[i].begin(),syncers[i].end()).process());
+			}
+			if (channels)
+			{
+				forking.forkInThisThread(new ReducingAggregator(toAggregator.reader(),outs,times));
+			}
+		}
+		CurrentTime(&finish);
+		finish -= start;
+		
+		for (int i = 0;i < n;i++)
+		{
+			delete fromAggregator[i];
+		}
+		
+		microsPerSync = (GetSeconds(&finish) / static_cast<double>(times)) * 1000000.0;
+		
+		ASSERTEQ(0,std::accumulate(wrong.begin(),wrong.end(),0),"Syncers got the wrong results",__LINE__);
+		
+		END_TEST(string(channels ? "Barrier and Channel" : "Reducing Barrier") + " Reduction Performance Test, " + lexical_cast<string>(numThreads) + " threads, each with " + lexical_cast<string>(perThread) + " processes: " + lexical_cast<string>(microsPerSync) + " microseconds per reduction");
+	}
+	
+	static TestResult reducingPerfTest1_10()
+	{
+		return _reducingPerfTest(1,10,false);
+	}
+	
+	static TestResult channelReducingPerfTest1_10()
+	{
+		return _reducingPerfTest(1,10,true);
+	}
+	
+	static TestResult reducingPerfTest4_1()
+	{
+		return _reducingPerfTest(4,1,false);
+	}
+	
+	static TestResult channelReducingPerfTest4_1()
+	{
+		return _reducingPerfTest(4,1,true);
+	}
+	
+	static TestResult reducingPerfTest4_10()
+	{
+		return _reducingPerfTest(4,10,false);
+	}
+	
+	static TestResult channelReducingPerfTest4_10()
+	{
+		return _reducingPerfTest(4,10,true);
+	}
+
+	template <typename BARRIER>	
+	static TestResult _barrierPerfTest(const char* name,int numThreads, int numProcessesPerThread,int numSyncs)
+	{
+		Time start,finish;
+		usign32 calls;
+		double microsPerSync;
+	
+		BEGIN_TEST()
+		
+		BARRIER barrier;
+		
+		list< list<CSProcessPtr> > syncers;
+		list<CSProcessPtr> specialSyncers;
+		
+		for (int i = 0;i < (numThreads - 1);i++)
+		{
+			list<CSProcessPtr> subSyncers;
+			
+			for (int j = 0;j < numProcessesPerThread;j++)
 			{
-				subSyncers.push_back(new BarrierSyncer(barrier.enrolledEnd(),numSyncs + 3));
+				subSyncers.push_back(new typename PerfSyncer<BARRIER>::Type(barrier.enrolledEnd(),numSyncs + 3));
 			}
 			
 			syncers.push_back(subSyncers);
@@ -553,10 +1456,10 @@ public:
 		
 		for (int j = 0;j < numProcessesPerThread - 1;j++)
 		{
-			specialSyncers.push_back(new BarrierSyncer(barrier.enrolledEnd(),numSyncs + 3));
+			specialSyncers.push_back(new typename PerfSyncer<BARRIER>::Type(barrier.enrolledEnd(),numSyncs + 3));
 		}
 		
-		Mobile<BarrierEnd> endUs(barrier.enrolledEnd());
+		Mobile<BarrierEnd> endUs(PlainEnd(barrier.enrolledEnd()));
 		
 		endUs->enroll();
 		
@@ -608,6 +1511,72 @@ public:
 	}
 
 
+	/**
+	*	Each thread has one worker, and one worker (in turn) has eight times the work of the others in each iteration.
+	*	Syncing makes everyone wait for the slowest worker every iteration; arriving after computing the boundary
+	*	only makes them wait for the slowest worker's boundary, so the extra work is overlapped with the next iteration.
+	*/
+	static TestResult _phasePerfTest(int numThreads,bool splitPhase)
+	{
+		const int iterations = 2000;
+		const int work = 20000;
+		Time start,finish;
+		double microsPerIteration,blockedPercent;
+		
+		BEGIN_TEST()
+		
+		Barrier barrier;
+		vector<Time> blocked(numThreads,MicroSeconds(0));
+		list<CSProcessPtr> workers;
+		
+		for (int i = 0;i < numThreads;i++)
+		{
+			workers.push_back(new PhaseWorker(barrier.enrolledEnd(),i,numThreads,iterations,work,splitPhase,&blocked[i]));
+		}
+		
+		CurrentTime(&start);
+		{
+			ScopedForking forking;
+			for (list<CSProcessPtr>::iterator it = workers.begin();it != workers.end();it++)
+			{
+				forking.fork(*it);
+			}
+		}
+		CurrentTime(&finish);
+		finish -= start;
+		
+		Time totalBlocked = MicroSeconds(0);
+		for (int i = 0;i < numThreads;i++)
+		{
+			totalBlocked += blocked[i];
+		}
+		
+		microsPerIteration = (GetSeconds(&finish) / static_cast<double>(iterations)) * 1000000.0;
+		blockedPercent = 100.0 * GetSeconds(&totalBlocked) / (GetSeconds(&finish) * numThreads);
+		
+		END_TEST(string("Barrier ") + (splitPhase ? "Split-Phase" : "Sync") + " Performance Test, " + lexical_cast<string>(numThreads) + " threads: " + lexical_cast<string>(microsPerIteration) + " microseconds per iteration, " + lexical_cast<string>(blockedPercent) + "% of the time blocked");
+	}
+	
+	static TestResult syncPhasePerfTest2()
+	{
+		return _phasePerfTest(2,false);
+	}
+	
+	static TestResult splitPhasePerfTest2()
+	{
+		return _phasePerfTest(2,true);
+	}
+	
+	static TestResult syncPhasePerfTest4()
+	{
+		return _phasePerfTest(4,false);
+	}
+	
+	static TestResult splitPhasePerfTest4()
+	{
+		return _phasePerfTest(4,true);
+	}
+
 	static TestResult oneThreadPerfTest100()
 	{
 		return _barrierPerfTest<Barrier>("Barrier",1,100,10000);
@@ -692,8 +1661,264 @@ public:
 	}
 	
 	
+	//Many threads, each with one process, comparing the per-kernel slots against the map that they replaced:
+	
+	static TestResult threadsPerfTest2()
+	{
+		return _barrierPerfTest<Barrier>("Barrier",2,1,100000);
+	}
+	
+	static TestResult threadsPerfTest8()
+	{
+		return _barrierPerfTest<Barrier>("Barrier",8,1,20000);
+	}
+	
+	static TestResult threadsPerfTest32()
+	{
+		return _barrierPerfTest<Barrier>("Barrier",32,1,5000);
+	}
+	
+	static TestResult threadsPerfTest64()
+	{
+		return _barrierPerfTest<Barrier>("Barrier",64,1,2000);
+	}
+	
+	static TestResult threadsPerfTest128()
+	{
+		return _barrierPerfTest<Barrier>("Barrier",128,1,1000);
+	}
+	
+	static TestResult map_threadsPerfTest2()
+	{
+		return _barrierPerfTest<MapBarrier>("Map Barrier",2,1,100000);
+	}
+	
+	static TestResult map_threadsPerfTest8()
+	{
+		return _barrierPerfTest<MapBarrier>("Map Barrier",8,1,20000);
+	}
+	
+	static TestResult map_threadsPerfTest32()
+	{
+		return _barrierPerfTest<MapBarrier>("Map Barrier",32,1,5000);
+	}
+	
+	static TestResult map_threadsPerfTest64()
+	{
+		return _barrierPerfTest<MapBarrier>("Map Barrier",64,1,2000);
+	}
+	
+	static TestResult map_threadsPerfTest128()
+	{
+		return _barrierPerfTest<MapBarrier>("Map Barrier",128,1,1000);
+	}
+	
+	static TestResult alt_oneThreadPerfTest100()
+	{
+		return _barrierPerfTest<AltBarrier>("AltBarrier",1,100,10000);
+	}
+	
+	static TestResult alt_oneThreadPerfTest1000()
+	{
+		return _barrierPerfTest<AltBarrier>("AltBarrier",1,1000,1000);
+	}
+	
+	static TestResult alt_multiThreadPerfTest2()
+	{
+		return _barrierPerfTest<AltBarrier>("AltBarrier",2,1,100000);
+	}
+	
+	static TestResult alt_multiThreadPerfTest10()
+	{
+		return _barrierPerfTest<AltBarrier>("AltBarrier",10,1,10000);
+	}
+	
+	static TestResult alt_multiThreadPerfTest100()
+	{
+		return _barrierPerfTest<AltBarrier>("AltBarrier",100,1,1000);
+	}
+	
+	//Measures offering to sync on an AltBarrier (and withdrawing the offer) while other members are enrolled but not offering:
+	static TestResult _altOfferPerfTest(int idleMembers,int numOffers)
+	{
+		Time start,finish;
+		double microsPerOffer;
+		
+		BEGIN_TEST()
+		
+		AltBarrier barrier;
+		list< Mobile<AltBarrierEnd> > idle;
+		for (int i = 0;i < idleMembers;i++)
+		{
+			idle.push_back(barrier.enrolledEnd());
+		}
+		
+		Mobile<AltBarrierEnd> endUs(barrier.enrolledEnd());
+		
+		{
+			//The skip guard is always ready, so each select offers on the barrier and then withdraws:
+			list<Guard*> guards = list_of<Guard*>(endUs->guard())(new SkipGuard);
+			Alternative alt(guards);
+			
+			CurrentTime(&start);
+			
+			for (int i = 0;i < numOffers;i++)
+			{
+				alt.priSelect();
+			}
+			
+			CurrentTime(&finish);
+		}
+		
+		finish -= start;
+		microsPerOffer = (GetSeconds(&finish) / static_cast<double>(numOffers)) * 1000000.0;
+		
+		endUs->resign();
+		for (list< Mobile<AltBarrierEnd> >::iterator it = idle.begin();it != idle.end();it++)
+		{
+			(*it)->resign();
+		}
+		
+		END_TEST("AltBarrier Offer Performance Test, " + lexical_cast<string>(idleMembers) + " members not offering: " + lexical_cast<string>(microsPerOffer) + " microseconds per offer");
+	}
+	
+	static TestResult altOfferPerfTest0()
+	{
+		return _altOfferPerfTest(0,1000000);
+	}
+	
+	static TestResult altOfferPerfTest100()
+	{
+		return _altOfferPerfTest(100,1000000);
+	}
+	
+	static TestResult altOfferPerfTest10000()
+	{
+		return _altOfferPerfTest(10000,1000000);
+	}
+	
 	//TODO later test multi-threading
 	
+	//Just us, alting and syncing:
+	static TestResult testAlt0()
+	{
+		BEGIN_TEST()
+		
+		AltBarrier barrier;
+		Mobile<AltBarrierEnd> end(barrier.end());
+		
+		//Not enrolled yet:
+		bool threw = false;
+		try
+		{
+			delete end->guard();
+		}
+		catch (BarrierError&)
+		{
+			threw = true;
+		}
+		ASSERTEQ(true,threw,"Getting a guard from a non-enrolled end did not throw",__LINE__);
+		
+		end->enroll();
+		
+		{
+			//We are the only member, so offering completes the sync straight away:
+			list<Guard*> guards = list_of<Guard*>(end->guard())(new SkipGuard);
+			Alternative alt(guards);
+			
+			ASSERTEQ(0,alt.fairSelect(),"Barrier not selected",__LINE__);
+			ASSERTEQ(1,alt.fairSelect(),"Skip not selected",__LINE__);
+			ASSERTEQ(0,alt.fairSelect(),"Barrier not selected",__LINE__);
+		}
+		
+		end->sync();
+		end->resign();
+		
+		END_TEST("AltBarrier Test 0");
+	}
+	
+	//A process alting over a channel and the barrier, with us syncing normally:
+	static TestResult testAlt1()
+	{
+		int selected0 = -1, selected1 = -1, n = 0;
+		
+		BEGIN_TEST()
+		
+		AltBarrier barrier;
+		One2OneChannel<int> c;
+		Mobile<AltBarrierEnd> endUs(barrier.enrolledEnd());
+		
+		{
+			ScopedForking forking;
+			
+			//They offer on the barrier, which cannot complete until we sync:
+			forking.forkInThisThread(new ChannelBarrierAlter(barrier.enrolledEnd(),c.reader(),&selected0));
+			CPPCSP_Yield();
+			
+			endUs->sync();
+			CPPCSP_Yield();
+		}
+		
+		{
+			ScopedForking forking;
+			
+			forking.forkInThisThread(new ChannelBarrierAlter(barrier.enrolledEnd(),c.reader(),&selected1));
+			CPPCSP_Yield();
+			
+			//The channel becomes ready (and has priority) before they run again, but the barrier
+			//completes as well, so they must select the barrier:
+			forking.forkInThisThread(new WriterProcess<int>(c.writer(),7,1));
+			CPPCSP_Yield();
+			
+			endUs->sync();
+			CPPCSP_Yield();
+			
+			c.reader() >> n;
+		}
+		
+		endUs->resign();
+		
+		ASSERTEQ(1,selected0,"Barrier not selected",__LINE__);
+		ASSERTEQ(1,selected1,"Barrier not selected when channel was also ready",__LINE__);
+		ASSERTEQ(7,n,"Wrong value from channel",__LINE__);
+		
+		END_TEST("AltBarrier Test 1");
+	}
+	
+	//A process alting over two barriers, each of which becomes ready:
+	static TestResult testAlt2()
+	{
+		int first = -1, second = -1;
+		
+		BEGIN_TEST()
+		
+		AltBarrier barrierX, barrierY;
+		
+		//Everyone is enrolled before anyone syncs:
+		CSProcessPtr alter = new TwoBarrierAlter(barrierX.enrolledEnd(),barrierY.enrolledEnd(),&first,&second);
+		CSProcessPtr syncerY = new BarrierSyncer(NoAlt(barrierY.enrolledEnd()));
+		CSProcessPtr syncerX = new BarrierSyncer(NoAlt(barrierX.enrolledEnd()));
+		
+		{
+			ScopedForking forking;
+			
+			forking.forkInThisThread(alter);
+			CPPCSP_Yield();
+			
+			//The first completes Y, committing the alter to it.  The second would then complete X,
+			//but must not, because the alter has already been committed to Y.
+			//The alter's second alt then completes X:
+			forking.forkInThisThread(syncerY);
+			forking.forkInThisThread(syncerX);
+			CPPCSP_Yield();
+		}
+		
+		ASSERTEQ(1,first,"Barrier Y not selected",__LINE__);
+		ASSERTEQ(0,second,"Barrier X not selected",__LINE__);
+		
+		END_TEST("AltBarrier Test 2");
+	}
+	
 	
 	static TestResult testBucket0()
 	{
@@ -702,8 +1927,8 @@ public:
 		SetUp setup;
 		Bucket bucket;
 								
-		ASSERTL(bucket.processes.empty(),"Bucket not empty",__LINE__);
-		ASSERTEQ(0,bucket.processCount,"Bucket not empty",__LINE__);
+		ASSERTL(bucket.queues().empty(),"Bucket not empty",__LINE__);
+		ASSERTEQ(0,bucket.holding(),"Bucket not empty",__LINE__);
 		ASSERTEQ(false,bucket.mutex.isClaimed(),"Bucket not empty",__LINE__);
 		
 		EventList expA; //empty
@@ -716,8 +1941,8 @@ public:
 		}
 		
 		ASSERTEQ(expA,actA,"Emptying an empty bucket did something",__LINE__);
-		ASSERTL(bucket.processes.empty(),"Bucket not empty",__LINE__);
-		ASSERTEQ(0,bucket.processCount,"Bucket not empty",__LINE__);
+		ASSERTL(bucket.queues().empty(),"Bucket not empty",__LINE__);
+		ASSERTEQ(0,bucket.holding(),"Bucket not empty",__LINE__);
 		ASSERTEQ(false,bucket.mutex.isClaimed(),"Bucket not empty",__LINE__);							
 
 		END_TEST("Bucket Test 0");
@@ -754,8 +1979,8 @@ public:
 		expProcessesA[CurrentThreadId()] = make_pair(joiner,joiner);
 		
 		ASSERTEQ(expA,actA,"Events not as expected",__LINE__);
-		ASSERTEQ(expProcessesA,bucket.processes,"Bucket processes not as expected",__LINE__);
-		ASSERTEQ(1,bucket.processCount,"Bucket count not as expected",__LINE__);
+		ASSERTEQ(expProcessesA,bucket.queues(),"Bucket processes not as expected",__LINE__);
+		ASSERTEQ(1,bucket.holding(),"Bucket count not as expected",__LINE__);
 		ASSERTEQ(false,bucket.mutex.isClaimed(),"Bucket mutex is claimed",__LINE__);
 		
 		CSProcessPtr _joiner2 = new BucketJoiner(&bucket);
@@ -780,9 +2005,10 @@ public:
 		expProcessesB[CurrentThreadId()] = make_pair(joiner,joiner2);
 		
 		ASSERTEQ(expB,actB,"Events not as expected",__LINE__);
-		ASSERTEQ(expProcessesB,bucket.processes,"Bucket processes not as expected",__LINE__);
-		ASSERTEQ(2,bucket.processCount,"Bucket count not as expected",__LINE__);
+		ASSERTEQ(expProcessesB,bucket.queues(),"Bucket processes not as expected",__LINE__);
+		ASSERTEQ(2,bucket.holding(),"Bucket count not as expected",__LINE__);
 		ASSERTEQ(false,bucket.mutex.isClaimed(),"Bucket mutex is claimed",__LINE__);
+		ASSERTL(bucket.localSlot != NULL,"Bucket used in one thread was not local",__LINE__);
 
 
 		EventList expC = tuple_list_of
@@ -799,8 +2025,8 @@ public:
 		std::map<ThreadId,std::pair<ProcessPtr,ProcessPtr> > expProcessesC;		
 		
 		ASSERTEQ(expC,actC,"Events not as expected",__LINE__);
-		ASSERTEQ(expProcessesC,bucket.processes,"Bucket processes not as expected",__LINE__);
-		ASSERTEQ(0,bucket.processCount,"Bucket count not as expected",__LINE__);
+		ASSERTEQ(expProcessesC,bucket.queues(),"Bucket processes not as expected",__LINE__);
+		ASSERTEQ(0,bucket.holding(),"Bucket count not as expected",__LINE__);
 		ASSERTEQ(false,bucket.mutex.isClaimed(),"Bucket mutex is claimed",__LINE__);
 
 
@@ -857,8 +2083,9 @@ public:
 		expProcessesB.insert(make_pair(joiner2,joiner1));
 		expProcessesB.insert(make_pair(joiner3,joiner3));
 		
-		ASSERTEQ1OF2(expProcessesA,expProcessesB,values(bucket.processes),"Bucket processes not as expected",__LINE__);		
+		ASSERTEQ1OF2(expProcessesA,expProcessesB,values(bucket.queues()),"Bucket processes not as expected",__LINE__);		
 		ASSERTEQ(false,bucket.mutex.isClaimed(),"Bucket mutex is claimed",__LINE__);
+		ASSERTL(bucket.shared && bucket.localSlot == NULL,"Bucket used in several threads was still local",__LINE__);
 		
 		bucket.flush();
 
@@ -0,0 +1,723 @@
+/*
+*	The Kent C++CSP Library
+*	Copyright (C) 2002-2007 Neil Brown
+*
+*	This library is free software; you can redistribute it and/or
+*	modify it under the terms of the GNU Lesser General Public
+*	License as published by the Free Software Foundation; either
+*	version 2.1 of the License, or (at your option) any later version.
+*
+*	This library is distributed in the hope that it will be useful,
+*	but WITHOUT ANY WARRANTY; without even the implied warranty of
+*	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+*	Lesser General Public License for more details.
+*
+*	You should have received a copy of the GNU Lesser General Public
+*	License along with this library; if not, write to the Free Software
+*	Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#include "test.h"
+#include <boost/assign/list_of.hpp>
+
+#include "../src/cppcsp.h"
+
+#include "../src/common/basic.h"
+
+using namespace csp;
+using namespace csp::internal;
+using namespace csp::common;
+using namespace boost::assign;
+using namespace boost;
+
+#include <list>
+
+using namespace std;
+
+class BroadcastChannelTest : public Test, public virtual internal::TestInfo, public SchedulerRecorder
+{
+public:
+	static ProcessPtr us;
+
+	typedef BroadcastSubscription<int> Subscription;
+
+	static TestResult testFanOut()
+	{
+		BEGIN_TEST()
+
+		SetUp setup;
+
+		BroadcastChannel<int> c;
+		Mobile<Subscription> sub0 = c.subscribe();
+		Mobile<Subscription> sub1 = c.subscribe();
+
+		ASSERTEQ(2u,c.subscriberCount,"Subscriber count not as expected",__LINE__);
+
+		{
+			ScopedForking forking;
+
+			ReaderProcess<int>* _reader0 = new ReaderProcess<int>(sub0->reader());
+			ProcessPtr reader0(getProcessPtr(_reader0));
+			ReaderProcess<int>* _reader1 = new ReaderProcess<int>(sub1->reader());
+			ProcessPtr reader1(getProcessPtr(_reader1));
+
+			EventList expA;
+
+			expA = tuple_list_of
+				(us,reader0,reader0) (us,reader1,reader1) //We fork them
+				(us,us,us) (us,NullProcessPtr,NullProcessPtr) //We yield
+				(reader0,NullProcessPtr,NullProcessPtr) //They both wait on their subscriptions
+				(reader1,NullProcessPtr,NullProcessPtr)
+			;
+
+			EventList actA;
+			{
+				RecordEvents _(&actA);
+
+				forking.forkInThisThread(_reader0);
+				forking.forkInThisThread(_reader1);
+
+				CPPCSP_Yield();
+			}
+
+			ASSERTEQ(expA,actA,"Channel events not as expected in part A",__LINE__);
+			ASSERTEQ(reader0,sub0->waitingProcess,"Reader not waiting on subscription",__LINE__);
+			ASSERTEQ(reader1,sub1->waitingProcess,"Reader not waiting on subscription",__LINE__);
+
+			EventList expB;
+
+			//The most recent subscriber is first in the list:
+			expB = tuple_list_of
+				(us,reader1,reader1) (us,reader0,reader0) //We free both readers
+				(us,NullProcessPtr,NullProcessPtr) //We wait for them to take the item
+				(NullProcessPtr,NullProcessPtr,NullProcessPtr) //reader1 takes it and finishes
+				(reader0,us,us) //reader0 takes it last and frees us
+				(NullProcessPtr,NullProcessPtr,NullProcessPtr) //reader0 finishes
+			;
+
+			EventList actB;
+			{
+				RecordEvents _(&actB);
+
+				c.writer() << 5;
+			}
+
+			ASSERTEQ(expB,actB,"Channel events not as expected in part B",__LINE__);
+			ASSERTEQ(0u,c.outstanding,"Items still outstanding",__LINE__);
+			ASSERTL(c.itemsHead == NULL,"Items not freed",__LINE__);
+			ASSERTL(c.itemsTail == NULL,"Items not freed",__LINE__);
+			ASSERTEQ(false,c.mutex.isClaimed(),"Channel mutex claimed",__LINE__);
+		}
+
+		END_TEST("BroadcastChannel Fan-Out Test");
+	}
+
+	static TestResult testSharedCopy()
+	{
+		BEGIN_TEST()
+
+		SetUp setup;
+
+		BroadcastChannel<int> c(2);
+		Mobile<Subscription> sub0 = c.subscribe();
+		Mobile<Subscription> sub1 = c.subscribe();
+
+		c.writer() << 8;
+		c.writer() << 9;
+
+		ASSERTEQ(2u,c.outstanding,"Items outstanding not as expected",__LINE__);
+		ASSERTL(c.itemsHead != NULL && c.itemsHead != c.itemsTail,"Item list not as expected",__LINE__);
+
+		//Both subscribers share the same copy of each item:
+		ASSERTEQ(c.itemsHead,sub0->nextItem,"Subscriber's next item not as expected",__LINE__);
+		ASSERTEQ(c.itemsHead,sub1->nextItem,"Subscriber's next item not as expected",__LINE__);
+		ASSERTEQ(2u,c.itemsHead->remaining,"Item's remaining count not as expected",__LINE__);
+		ASSERTEQ(8,c.itemsHead->data,"Item data not as expected",__LINE__);
+		ASSERTEQ(c.itemsTail,c.itemsHead->next,"Item list not as expected",__LINE__);
+
+		int n = 0;
+		sub0->reader() >> n;
+		ASSERTEQ(8,n,"Subscriber did not read the right value",__LINE__);
+		ASSERTEQ(c.itemsTail,sub0->nextItem,"Subscriber's next item not as expected",__LINE__);
+		ASSERTEQ(1u,c.itemsHead->remaining,"Item's remaining count not as expected",__LINE__);
+		ASSERTEQ(2u,c.outstanding,"Items outstanding not as expected",__LINE__);
+
+		sub1->reader() >> n;
+		ASSERTEQ(8,n,"Subscriber did not read the right value",__LINE__);
+		ASSERTEQ(1u,c.outstanding,"Items outstanding not as expected",__LINE__);
+		ASSERTEQ(c.itemsTail,c.itemsHead,"First item not freed",__LINE__);
+
+		sub1->reader() >> n;
+		ASSERTEQ(9,n,"Subscriber did not read the right value",__LINE__);
+		ASSERTL(sub1->nextItem == NULL,"Subscriber not caught up",__LINE__);
+		ASSERTEQ(false,sub1->reader().pending(),"Subscriber pending when caught up",__LINE__);
+		ASSERTEQ(true,sub0->reader().pending(),"Subscriber not pending",__LINE__);
+
+		sub0->reader() >> n;
+		ASSERTEQ(9,n,"Subscriber did not read the right value",__LINE__);
+		ASSERTEQ(0u,c.outstanding,"Items still outstanding",__LINE__);
+		ASSERTL(c.itemsHead == NULL,"Items not freed",__LINE__);
+
+		END_TEST("BroadcastChannel Shared Copy Test");
+	}
+
+	static TestResult testBuffered()
+	{
+		BEGIN_TEST()
+
+		SetUp setup;
+
+		BroadcastChannel<int> c(2);
+		Mobile<Subscription> sub = c.subscribe();
+
+		{
+			ScopedForking forking;
+
+			//We can write two items without blocking:
+			EventList expA;
+			EventList actA;
+			{
+				RecordEvents _(&actA);
+
+				c.writer() << 1;
+				c.writer() << 2;
+			}
+
+			ASSERTEQ(expA,actA,"Channel events not as expected in part A",__LINE__);
+
+			WriterProcess<int>* _writer = new WriterProcess<int>(c.writer(),3);
+			ProcessPtr writer(getProcessPtr(_writer));
+
+			EventList expB;
+
+			expB = tuple_list_of
+				(us,writer,writer) //We fork the writer
+				(us,us,us) (us,NullProcessPtr,NullProcessPtr) //We yield
+				(writer,NullProcessPtr,NullProcessPtr) //The buffer is full, so the writer blocks
+			;
+
+			EventList actB;
+			{
+				RecordEvents _(&actB);
+
+				forking.forkInThisThread(_writer);
+				CPPCSP_Yield();
+			}
+
+			ASSERTEQ(expB,actB,"Channel events not as expected in part B",__LINE__);
+			ASSERTEQ(writer,c.waitingWriter,"Writer not waiting",__LINE__);
+			ASSERTEQ(3u,c.outstanding,"Items outstanding not as expected",__LINE__);
+
+			EventList expC;
+
+			expC = tuple_list_of
+				(us,writer,writer) //Taking an item makes room for the writer
+			;
+
+			EventList actC;
+			int n = 0;
+			{
+				RecordEvents _(&actC);
+
+				sub->reader() >> n;
+			}
+
+			ASSERTEQ(expC,actC,"Channel events not as expected in part C",__LINE__);
+			ASSERTEQ(1,n,"Subscriber did not read the right value",__LINE__);
+			ASSERTL(c.waitingWriter == NullProcessPtr,"Writer still waiting",__LINE__);
+
+			sub->reader() >> n;
+			ASSERTEQ(2,n,"Subscriber did not read the right value",__LINE__);
+			sub->reader() >> n;
+			ASSERTEQ(3,n,"Subscriber did not read the right value",__LINE__);
+		}
+
+		END_TEST("BroadcastChannel Buffered Test");
+	}
+
+	static TestResult testSubscribe()
+	{
+		BEGIN_TEST()
+
+		SetUp setup;
+
+		BroadcastChannel<int> c(4);
+
+		//With no subscribers, items are discarded:
+		c.writer() << 1;
+		ASSERTEQ(0u,c.outstanding,"Item kept with no subscribers",__LINE__);
+		ASSERTL(c.itemsHead == NULL,"Item kept with no subscribers",__LINE__);
+
+		Mobile<Subscription> sub0 = c.subscribe();
+		c.writer() << 2;
+
+		//A new subscriber only sees items written after it subscribed:
+		Mobile<Subscription> sub1 = c.subscribe();
+		ASSERTEQ(false,sub1->reader().pending(),"New subscriber pending",__LINE__);
+		c.writer() << 3;
+
+		ASSERTEQ(1u,c.itemsHead->remaining,"Item's remaining count not as expected",__LINE__);
+		ASSERTEQ(2u,c.itemsTail->remaining,"Item's remaining count not as expected",__LINE__);
+
+		int n = 0;
+		sub1->reader() >> n;
+		ASSERTEQ(3,n,"Subscriber did not read the right value",__LINE__);
+		sub0->reader() >> n;
+		ASSERTEQ(2,n,"Subscriber did not read the right value",__LINE__);
+		sub0->reader() >> n;
+		ASSERTEQ(3,n,"Subscriber did not read the right value",__LINE__);
+
+		ASSERTEQ(0u,c.outstanding,"Items still outstanding",__LINE__);
+
+		//Destroying a subscription unsubscribes it:
+		sub1 = Mobile<Subscription>();
+		ASSERTEQ(1u,c.subscriberCount,"Subscriber count not as expected",__LINE__);
+		ASSERTEQ(sub0.get(),c.subscribers,"Subscriber list not as expected",__LINE__);
+		ASSERTL(sub0->prevSubscriber == NULL && sub0->nextSubscriber == NULL,"Subscriber list not as expected",__LINE__);
+
+		sub0->unsubscribe();
+		sub0->unsubscribe(); //Has no effect
+		ASSERTEQ(0u,c.subscriberCount,"Subscriber count not as expected",__LINE__);
+		ASSERTL(c.subscribers == NULL,"Subscriber list not empty",__LINE__);
+
+		END_TEST("BroadcastChannel Subscribe Test");
+	}
+
+	static TestResult testUnsubscribe()
+	{
+		BEGIN_TEST()
+
+		SetUp setup;
+
+		BroadcastChannel<int> c;
+		Mobile<Subscription> sub0 = c.subscribe();
+		Mobile<Subscription> sub1 = c.subscribe();
+
+		{
+			ScopedForking forking;
+
+			WriterProcess<int>* _writer = new WriterProcess<int>(c.writer(),4);
+			ProcessPtr writer(getProcessPtr(_writer));
+
+			forking.forkInThisThread(_writer);
+			CPPCSP_Yield();
+
+			ASSERTEQ(writer,c.waitingWriter,"Writer not waiting",__LINE__);
+
+			int n = 0;
+			sub0->reader() >> n;
+			ASSERTEQ(4,n,"Subscriber did not read the right value",__LINE__);
+			ASSERTEQ(writer,c.waitingWriter,"Writer not still waiting",__LINE__);
+
+			EventList expA;
+
+			expA = tuple_list_of
+				(us,writer,writer) //The slow subscriber leaving frees the writer
+			;
+
+			EventList actA;
+			{
+				RecordEvents _(&actA);
+
+				sub1->unsubscribe();
+			}
+
+			ASSERTEQ(expA,actA,"Channel events not as expected in part A",__LINE__);
+			ASSERTEQ(0u,c.outstanding,"Items still outstanding",__LINE__);
+			ASSERTL(c.itemsHead == NULL,"Items not freed",__LINE__);
+		}
+
+		END_TEST("BroadcastChannel Unsubscribe Test");
+	}
+
+	static TestResult testPoison()
+	{
+		BEGIN_TEST()
+
+		SetUp setup;
+
+		BroadcastChannel<int> c(2);
+		Mobile<Subscription> sub0 = c.subscribe();
+		Mobile<Subscription> sub1 = c.subscribe();
+
+		c.writer() << 1;
+		c.writer().poison();
+
+		ASSERTEQ(true,c.isPoisoned,"Channel not poisoned",__LINE__);
+
+		bool threw = false;
+		try
+		{
+			c.writer() << 2;
+		}
+		catch (PoisonException&)
+		{
+			threw = true;
+		}
+		ASSERTEQ(true,threw,"Writer did not see poison",__LINE__);
+
+		//Readers get the items written before the poison first:
+		int n = 0;
+		sub0->reader() >> n;
+		ASSERTEQ(1,n,"Subscriber did not read the right value",__LINE__);
+
+		threw = false;
+		try
+		{
+			sub0->reader() >> n;
+		}
+		catch (PoisonException&)
+		{
+			threw = true;
+		}
+		ASSERTEQ(true,threw,"Reader did not see poison",__LINE__);
+
+		ASSERTEQ(true,sub1->reader().pending(),"Subscriber not pending",__LINE__);
+		sub1->reader() >> n;
+		ASSERTEQ(1,n,"Subscriber did not read the right value",__LINE__);
+
+		END_TEST("BroadcastChannel Poison Test");
+	}
+
+	static TestResult testPoisonWaiting()
+	{
+		BEGIN_TEST()
+
+		SetUp setup;
+
+		BroadcastChannel<int> c;
+		Mobile<Subscription> sub = c.subscribe();
+
+		{
+			ScopedForking forking;
+
+			ReaderProcess<int>* _reader = new ReaderProcess<int>(sub->reader());
+			ProcessPtr reader(getProcessPtr(_reader));
+
+			forking.forkInThisThread(_reader);
+			CPPCSP_Yield();
+
+			ASSERTEQ(reader,sub->waitingProcess,"Reader not waiting on subscription",__LINE__);
+
+			EventList expA;
+
+			expA = tuple_list_of
+				(us,reader,reader) //We poison the channel, freeing the reader
+			;
+
+			EventList actA;
+			{
+				RecordEvents _(&actA);
+
+				c.writer().poison();
+			}
+
+			ASSERTEQ(expA,actA,"Channel events not as expected in part A",__LINE__);
+			ASSERTL(sub->waitingProcess == NullProcessPtr,"Reader still waiting",__LINE__);
+		}
+
+		{
+			BroadcastChannel<int> c2;
+			Mobile<Subscription> sub2 = c2.subscribe();
+
+			ScopedForking forking;
+
+			WriterProcess<int>* _writer = new WriterProcess<int>(c2.writer(),6);
+			ProcessPtr writer(getProcessPtr(_writer));
+
+			forking.forkInThisThread(_writer);
+			CPPCSP_Yield();
+
+			ASSERTEQ(writer,c2.waitingWriter,"Writer not waiting",__LINE__);
+
+			EventList expB;
+
+			expB = tuple_list_of
+				(us,writer,writer) //We poison the channel, freeing the writer
+			;
+
+			EventList actB;
+			{
+				RecordEvents _(&actB);
+
+				sub2->reader().poison();
+			}
+
+			ASSERTEQ(expB,actB,"Channel events not as expected in part B",__LINE__);
+			ASSERTL(c2.waitingWriter == NullProcessPtr,"Writer still waiting",__LINE__);
+		}
+
+		END_TEST("BroadcastChannel Poison Waiting Test");
+	}
+
+	static TestResult testExt()
+	{
+		BEGIN_TEST()
+
+		SetUp setup;
+
+		BroadcastChannel<int> c;
+		Mobile<Subscription> sub = c.subscribe();
+
+		{
+			ScopedForking forking;
+
+			WriterProcess<int>* _writer = new WriterProcess<int>(c.writer(),7);
+			ProcessPtr writer(getProcessPtr(_writer));
+
+			forking.forkInThisThread(_writer);
+			CPPCSP_Yield();
+
+			EventList expA;
+
+			expA = tuple_list_of
+				(us,writer,writer) //The writer is only freed at the end of the extended input
+			;
+
+			EventList actA;
+			int n = 0;
+			{
+				RecordEvents _(&actA);
+
+				{
+					ScopedExtInput<int> extInput(sub->reader(),&n);
+
+					ASSERTEQ(7,n,"Extended input did not read the right value",__LINE__);
+					ASSERTEQ(writer,c.waitingWriter,"Writer freed during extended input",__LINE__);
+				}
+			}
+
+			ASSERTEQ(expA,actA,"Channel events not as expected in part A",__LINE__);
+			ASSERTL(sub->nextItem == NULL,"Item not taken",__LINE__);
+		}
+
+		END_TEST("BroadcastChannel Extended Input Test");
+	}
+
+	static TestResult testAlt()
+	{
+		BEGIN_TEST()
+
+		SetUp setup;
+
+		BroadcastChannel<int> c0(1),c1(1);
+		Mobile<Subscription> sub0 = c0.subscribe();
+		Mobile<Subscription> sub1 = c1.subscribe();
+
+		{
+			ScopedForking forking;
+
+			std::list<Guard*> guards;
+			guards.push_back(sub0->reader().inputGuard());
+			guards.push_back(sub1->reader().inputGuard());
+			Alternative alt(guards);
+
+			WriterProcess<int>* _writer = new WriterProcess<int>(c1.writer(),3);
+			ProcessPtr writer(getProcessPtr(_writer));
+
+			forking.forkInThisThread(_writer);
+
+			EventList expA;
+
+			expA = tuple_list_of
+				(us,NullProcessPtr,NullProcessPtr) //We wait in the alt
+				(writer,us,us) //The writer frees us
+				(NullProcessPtr,NullProcessPtr,NullProcessPtr) //The buffer has room, so the writer finishes
+			;
+
+			EventList actA;
+			unsigned selected;
+			{
+				RecordEvents _(&actA);
+
+				selected = alt.priSelect();
+			}
+
+			ASSERTEQ(expA,actA,"Channel events not as expected in part A",__LINE__);
+			ASSERTEQ(1u,selected,"Alt did not select the right subscription",__LINE__);
+			ASSERTL(sub0->waitingProcess == NullProcessPtr,"Alting process left waiting",__LINE__);
+
+			int n = 0;
+			sub1->reader() >> n;
+			ASSERTEQ(3,n,"Subscriber did not read the right value",__LINE__);
+
+			c0.writer() << 2;
+			ASSERTEQ(0u,alt.priSelect(),"Alt did not select the right subscription",__LINE__);
+		}
+
+		END_TEST("BroadcastChannel Alt Test");
+	}
+
+	template <typename DATA_TYPE>
+	class BroadcastProcess : public CSProcess
+	{
+	private:
+		Chanin<DATA_TYPE> in;
+		BroadcastChannel<DATA_TYPE>* out;
+	protected:
+		void run()
+		{
+			DATA_TYPE t;
+			try
+			{
+				Chanout<DATA_TYPE> o(out->writer());
+				while (true)
+				{
+					in >> t;
+					o << t;
+				}
+			}
+			catch (PoisonException&)
+			{
+				in.poison();
+				out->writer().poison();
+			}
+		}
+	public:
+		inline BroadcastProcess(const Chanin<DATA_TYPE>& _in,BroadcastChannel<DATA_TYPE>* _out)
+			:	CSProcess(65536),in(_in),out(_out)
+		{
+		}
+	};
+
+	//Sends items from one writer to two readers (all in this thread), either through a Delta or a BroadcastChannel:
+	static TestResult _fanOutPerfTest(bool useDelta)
+	{
+		const int iterations = 100000;
+		double microsPerItem = 0;
+
+		BEGIN_TEST()
+
+		One2OneChannel<int> in,out0,out1;
+		BroadcastChannel<int> c;
+		Mobile<Subscription> sub0 = c.subscribe();
+		Mobile<Subscription> sub1 = c.subscribe();
+
+		{
+			ScopedForking forking;
+
+			if (useDelta)
+			{
+				forking.forkInThisThread(new Delta<int>(in.reader(),out0.writer(),out1.writer()));
+				forking.forkInThisThread(new ReaderProcess<int>(out0.reader(),iterations));
+				forking.forkInThisThread(new ReaderProcess<int>(out1.reader(),iterations));
+			}
+			else
+			{
+				forking.forkInThisThread(new BroadcastProcess<int>(in.reader(),&c));
+				forking.forkInThisThread(new ReaderProcess<int>(sub0->reader(),iterations));
+				forking.forkInThisThread(new ReaderProcess<int>(sub1->reader(),iterations));
+			}
+
+			Chanout<int> o(in.writer());
+
+			Time start,finish;
+			CurrentTime(&start);
+
+			for (int i = 0;i < iterations;i++)
+			{
+				o << i;
+			}
+
+			CurrentTime(&finish);
+			finish -= start;
+
+			microsPerItem = (GetSeconds(&finish) / static_cast<double>(iterations)) * 1000000.0;
+
+			o.poison();
+		}
+
+		END_TEST(string("Fan-Out Test (") + (useDelta ? "Delta" : "BroadcastChannel") + "), one writer to two readers: " + lexical_cast<string>(microsPerItem) + " microseconds per item");
+	}
+
+	static TestResult fanOutPerfTest0()
+	{
+		return _fanOutPerfTest(true);
+	}
+
+	static TestResult fanOutPerfTest1()
+	{
+		return _fanOutPerfTest(false);
+	}
+
+	//Sends items to many subscribers, each in its own thread:
+	static TestResult broadcastPerfTest(int readers,usign32 bufferSize)
+	{
+		const int iterations = 20000;
+		double microsPerItem = 0;
+
+		BEGIN_TEST()
+
+		BroadcastChannel<int> c(bufferSize);
+
+		{
+			std::list< Mobile<Subscription> > subs;
+			for (int i = 0;i < readers;i++)
+			{
+				subs.push_back(c.subscribe());
+			}
+
+			ScopedForking forking;
+
+			for (std::list< Mobile<Subscription> >::iterator it = subs.begin();it != subs.end();it++)
+			{
+				forking.fork(new ReaderProcess<int>((*it)->reader(),iterations));
+			}
+
+			Chanout<int> o(c.writer());
+
+			Time start,finish;
+			CurrentTime(&start);
+
+			for (int i = 0;i < iterations;i++)
+			{
+				o << i;
+			}
+
+			CurrentTime(&finish);
+			finish -= start;
+
+			microsPerItem = (GetSeconds(&finish) / static_cast<double>(iterations)) * 1000000.0;
+		}
+
+		END_TEST("BroadcastChannel Test, " + lexical_cast<string>(readers) + " readers in separate threads, buffer size " + lexical_cast<string>(bufferSize) + ": " + lexical_cast<string>(microsPerItem) + " microseconds per item");
+	}
+
+	static TestResult broadcastPerfTest0()
+	{
+		return broadcastPerfTest(8,0);
+	}
+
+	static TestResult broadcastPerfTest1()
+	{
+		return broadcastPerfTest(8,16);
+	}
+
+	std::list<TestResult (*)()> tests()
+	{
+		us = currentProcess();
+		return list_of<TestResult (*) ()>
+			(testFanOut) (testSharedCopy) (testBuffered) (testSubscribe) (testUnsubscribe)
+			(testPoison) (testPoisonWaiting) (testExt) (testAlt)
+		;
+	}
+
+	std::list<TestResult (*)()> perfTests()
+	{
+		us = currentProcess();
+		return list_of<TestResult (*) ()>
+			(fanOutPerfTest0) (fanOutPerfTest1) (broadcastPerfTest0) (broadcastPerfTest1)
+		;
+	}
+
+	inline virtual ~BroadcastChannelTest()
+	{
+	}
+};
+
+ProcessPtr BroadcastChannelTest::us;
+
+Test* GetBroadcastChannelTest()
+{
+	return new BroadcastChannelTest;
+}
@@ -2118,7 +2118,45 @@ public:
 		ASSERTEQ(true,buffer.outputWouldSucceed(&n),"Buffer not behaving properly",__LINE__);
 		ASSERTEQ(false,buffer.inputWouldSucceed(),"Buffer not behaving properly",__LINE__);
 		ASSERTEQ(3,n,"Data value not as expected",__LINE__);
-		
+
+		//Now put in enough to span several storage segments, and take half of it out again while adding more,
+		//so that drained segments get re-used:
+
+		for (n = 0;n < 2000;n++)
+		{
+			buffer.put(&n);
+		}
+
+		for (int i = 0;i < 1000;i++)
+		{
+			buffer.get(&n);
+			ASSERTEQ(i,n,"Data value not as expected",__LINE__);
+			n = 2000 + i;
+			buffer.put(&n);
+		}
+
+		for (int i = 1000;i < 3000;i++)
+		{
+			ASSERTEQ(true,buffer.inputWouldSucceed(),"Buffer not behaving properly",__LINE__);
+			buffer.get(&n);
+			ASSERTEQ(i,n,"Data value not as expected",__LINE__);
+		}
+		ASSERTEQ(false,buffer.inputWouldSucceed(),"Buffer not behaving properly",__LINE__);
+
+		//Check clear() empties it:
+
+		for (n = 0;n < 500;n++)
+		{
+			buffer.put(&n);
+		}
+		buffer.clear();
+		ASSERTEQ(false,buffer.inputWouldSucceed(),"Buffer not behaving properly",__LINE__);
+
+		n = 7;buffer.put(&n);
+		n = 99;buffer.get(&n);
+		ASSERTEQ(7,n,"Data value not as expected",__LINE__);
+		ASSERTEQ(false,buffer.inputWouldSucceed(),"Buffer not behaving properly",__LINE__);
+
 		END_TEST("InfiniteFIFOBuffer Test");
 	}			
 	
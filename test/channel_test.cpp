@@ -343,7 +343,6 @@ public:
 	static void checkReadMutex(One2AnyChannel<int>& c,bool claimed,int line) {ASSERTEQ(claimed,c.readerMutex.isClaimed(),"Read mutex (is/not) claimed",line);}
 	static void checkReadMutex(Any2AnyChannel<int>& c,bool claimed,int line) {ASSERTEQ(claimed,c.readerMutex.isClaimed(),"Read mutex (is/not) claimed",line);}
 	static void checkWriteMutex(One2OneChannel<int>&,bool,int) {}
-	static void checkWriteMutex(Any2OneChannel<int>& c,bool claimed,int line) {ASSERTEQ(claimed,c.writerMutex.isClaimed(),"Write mutex (is/not) claimed",line);}
 	static void checkWriteMutex(Any2AnyChannel<int>& c,bool claimed,int line) {ASSERTEQ(claimed,c.writerMutex.isClaimed(),"Write mutex (is/not) claimed",line);}
 	
 	template <typename CHANNEL>
@@ -2427,9 +2426,443 @@ public:
 		END_TEST(ChannelName<CHANNEL>::Name() + " late poison test");
 	}		
 
+	typedef _Any2OneChannel<int> QueuedAny2One;
+	
+	/**
+	*	Tests that writers queue on an Any2OneChannel, and are served in the order they arrived
+	*/
+	static TestResult testQueuedAny2One0()
+	{
+		BEGIN_TEST()
+		
+		SetUp setup;
+		
+		Any2OneChannel<int> c;
+		
+		{
+			ScopedForking forking;
+			
+			WriterProcess<int>* _writer0 = new WriterProcess<int>(c.writer(),7,1);
+			ProcessPtr writer0(getProcessPtr(_writer0));
+			WriterProcess<int>* _writer1 = new WriterProcess<int>(c.writer(),8,1);
+			ProcessPtr writer1(getProcessPtr(_writer1));
+			
+			EventList expA;
+			
+			expA = tuple_list_of
+				(us,writer0,writer0) (us,writer1,writer1) //We fork them
+				(us,us,us) (us,NullProcessPtr,NullProcessPtr) //We yield
+				(writer0,NullProcessPtr,NullProcessPtr) //They both block on the channel
+				(writer1,NullProcessPtr,NullProcessPtr)
+			;
+			
+			EventList actA;
+			{
+				RecordEvents _(&actA);
+				
+				forking.forkInThisThread(_writer0);
+				forking.forkInThisThread(_writer1);
+				
+				CPPCSP_Yield();
+			}
+			
+			ASSERTEQ(expA,actA,"Channel events not as expected in part A",__LINE__);
+			
+			//Most recent writer on top:
+			ASSERTL(ACCESS(QueuedAny2One,c,writerStack) != NULL,"Channel writer stack empty",__LINE__);
+			ASSERTEQ(writer1,ACCESS(QueuedAny2One,c,writerStack)->process,"Channel data (writerStack) not as expected",__LINE__);
+			ASSERTEQ(&(_writer1->t),ACCESS(QueuedAny2One,c,writerStack)->src,"Channel data (writerStack) not as expected",__LINE__);
+			ASSERTL(ACCESS(QueuedAny2One,c,writerStack)->next != NULL,"Channel writer stack too short",__LINE__);
+			ASSERTEQ(writer0,ACCESS(QueuedAny2One,c,writerStack)->next->process,"Channel data (writerStack) not as expected",__LINE__);
+			ASSERTL(ACCESS(QueuedAny2One,c,readerQueueHead) == NULL,"Channel reader queue not empty",__LINE__);
+			ASSERTEQ(false,ACCESS(QueuedAny2One,c,mutex).isClaimed(),"Channel mutex claimed",__LINE__);
+			
+			EventList expB;
+			
+			expB = tuple_list_of
+				(us,writer0,writer0) //We read from the first writer and release them
+			;
+			
+			EventList actB;
+			int n = 0;
+			{
+				RecordEvents _(&actB);
+				
+				c.reader() >> n;
+			}
+			
+			ASSERTEQ(expB,actB,"Channel events not as expected in part B",__LINE__);
+			ASSERTEQ(7,n,"Writers not served in order",__LINE__);
+			ASSERTL(ACCESS(QueuedAny2One,c,writerStack) == NULL,"Channel writer stack not empty",__LINE__);
+			ASSERTL(ACCESS(QueuedAny2One,c,readerQueueHead) != NULL,"Channel reader queue empty",__LINE__);
+			ASSERTEQ(writer1,ACCESS(QueuedAny2One,c,readerQueueHead)->process,"Channel data (readerQueueHead) not as expected",__LINE__);
+			
+			EventList expC;
+			
+			expC = tuple_list_of
+				(us,writer1,writer1) //We read from the second writer and release them
+				(us,us,us) (us,NullProcessPtr,NullProcessPtr) //We yield
+				(NullProcessPtr,NullProcessPtr,NullProcessPtr) //They both finish
+				(NullProcessPtr,NullProcessPtr,NullProcessPtr)
+			;
+			
+			EventList actC;
+			{
+				RecordEvents _(&actC);
+				
+				c.reader() >> n;
+				CPPCSP_Yield();
+			}
+			
+			ASSERTEQ(expC,actC,"Channel events not as expected in part C",__LINE__);
+			ASSERTEQ(8,n,"Writers not served in order",__LINE__);
+			ASSERTL(ACCESS(QueuedAny2One,c,readerQueueHead) == NULL,"Channel reader queue not empty",__LINE__);
+			ASSERTL(ACCESS(QueuedAny2One,c,writerStack) == NULL,"Channel writer stack not empty",__LINE__);
+		}
+		
+		END_TEST("Any2OneChannel Queued Writers Test");
+	}
+	
+	/**
+	*	Tests that a writer arriving at a waiting reader completes the communication without blocking
+	*/
+	static TestResult testQueuedAny2One1()
+	{
+		BEGIN_TEST()
+		
+		SetUp setup;
+		
+		Any2OneChannel<int> c;
+		
+		{
+			ScopedForking forking;
+			
+			ReaderProcess<int>* _reader = new ReaderProcess<int>(c.reader(),1);
+			ProcessPtr reader(getProcessPtr(_reader));
+			
+			EventList expA;
+			
+			expA = tuple_list_of
+				(us,reader,reader) //We fork them
+				(us,us,us) (us,NullProcessPtr,NullProcessPtr) //We yield
+				(reader,NullProcessPtr,NullProcessPtr) //They block on the channel
+			;
+			
+			EventList actA;
+			{
+				RecordEvents _(&actA);
+				
+				forking.forkInThisThread(_reader);
+				
+				CPPCSP_Yield();
+			}
+			
+			ASSERTEQ(expA,actA,"Channel events not as expected in part A",__LINE__);
+			ASSERTL(ACCESS(QueuedAny2One,c,writerStack) == &(ACCESS(QueuedAny2One,c,readerWaitingMarker)),"Reader not marked as waiting",__LINE__);
+			ASSERTEQ(reader,ACCESS(QueuedAny2One,c,readerProcess),"Channel data (readerProcess) not as expected",__LINE__);
+			ASSERTEQ(&(_reader->t),ACCESS(QueuedAny2One,c,readerDest),"Channel data (readerDest) not as expected",__LINE__);
+			
+			EventList expB;
+			
+			expB = tuple_list_of
+				(us,reader,reader) //We release them from the channel, without blocking
+			;
+			
+			EventList actB;
+			{
+				RecordEvents _(&actB);
+				
+				c.writer() << 5;
+			}
+			
+			ASSERTEQ(expB,actB,"Channel events not as expected in part B",__LINE__);
+			ASSERTEQ(5,_reader->t,"Reader did not receive the data",__LINE__);
+			ASSERTL(ACCESS(QueuedAny2One,c,writerStack) == NULL,"Channel writer stack not empty",__LINE__);
+			ASSERTEQ(false,ACCESS(QueuedAny2One,c,mutex).isClaimed(),"Channel mutex claimed",__LINE__);
+		}
+		
+		END_TEST("Any2OneChannel Waiting Reader Test");
+	}
+	
+	/**
+	*	Tests extended input on an Any2OneChannel, with one writer already queued and one arriving later
+	*/
+	static TestResult testQueuedAny2OneExt()
+	{
+		BEGIN_TEST()
+		
+		SetUp setup;
+		
+		Any2OneChannel<int> c;
+		
+		{
+			ScopedForking forking;
+			
+			WriterProcess<int>* _writer0 = new WriterProcess<int>(c.writer(),3,1);
+			ProcessPtr writer0(getProcessPtr(_writer0));
+			
+			forking.forkInThisThread(_writer0);
+			CPPCSP_Yield();
+			
+			int n = 0;
+			
+			EventList expA;
+			
+			expA = tuple_list_of
+				(us,writer0,writer0) //We release the writer at the end of the extended input
+			;
+			
+			EventList actA;
+			{
+				RecordEvents _(&actA);
+				
+				ScopedExtInput<int> extInput(c.reader(),&n);
+				
+				ASSERTEQ(3,n,"Extended input did not receive the data",__LINE__);
+				ASSERTL(ACCESS(QueuedAny2One,c,extWriter) != NULL,"Channel data (extWriter) not set",__LINE__);
+				ASSERTEQ(writer0,ACCESS(QueuedAny2One,c,extWriter)->process,"Channel data (extWriter) not as expected",__LINE__);
+			}
+			
+			ASSERTEQ(expA,actA,"Channel events not as expected in part A",__LINE__);
+			ASSERTL(ACCESS(QueuedAny2One,c,extWriter) == NULL,"Channel data (extWriter) not cleared",__LINE__);
+			
+			//Now a writer that arrives while we are waiting for an extended input:
+			
+			WriterProcess<int>* _writer1 = new WriterProcess<int>(c.writer(),4,1);
+			ProcessPtr writer1(getProcessPtr(_writer1));
+			
+			forking.forkInThisThread(_writer1);
+			
+			EventList expB;
+			
+			expB = tuple_list_of
+				(us,NullProcessPtr,NullProcessPtr) //We block on the channel
+				(NullProcessPtr,NullProcessPtr,NullProcessPtr) //The first writer finishes
+				(writer1,us,us) //The second writer queues up and frees us
+				(writer1,NullProcessPtr,NullProcessPtr) //They block on the channel
+				(us,writer1,writer1) //We release them at the end of the extended input
+			;
+			
+			EventList actB;
+			{
+				RecordEvents _(&actB);
+				
+				ScopedExtInput<int> extInput(c.reader(),&n);
+				
+				ASSERTEQ(4,n,"Extended input did not receive the data",__LINE__);
+			}
+			
+			ASSERTEQ(expB,actB,"Channel events not as expected in part B",__LINE__);
+		}
+		
+		END_TEST("Any2OneChannel Extended Input Test");
+	}
+	
+	/**
+	*	Tests that poisoning an Any2OneChannel releases every queued writer, including those already
+	*	taken by the reader
+	*/
+	static TestResult testQueuedAny2OnePoison()
+	{
+		BEGIN_TEST()
+		
+		SetUp setup;
+		
+		Any2OneChannel<int> c;
+		
+		{
+			ScopedForking forking;
+			
+			WriterProcess<int>* _writer0 = new WriterProcess<int>(c.writer(),0,2);
+			ProcessPtr writer0(getProcessPtr(_writer0));
+			WriterProcess<int>* _writer1 = new WriterProcess<int>(c.writer(),1,1);
+			ProcessPtr writer1(getProcessPtr(_writer1));
+			WriterProcess<int>* _writer2 = new WriterProcess<int>(c.writer(),2,1);
+			ProcessPtr writer2(getProcessPtr(_writer2));
+			
+			forking.forkInThisThread(_writer0);
+			forking.forkInThisThread(_writer1);
+			CPPCSP_Yield();
+			
+			//Takes both writers off the stack, leaving writer1 in the reader's queue:
+			int n;
+			c.reader() >> n;
+			ASSERTEQ(0,n,"Writers not served in order",__LINE__);
+			
+			forking.forkInThisThread(_writer2);
+			
+			//writer0 writes again, and writer2 joins, both on the stack:
+			CPPCSP_Yield();
+			
+			ASSERTL(ACCESS(QueuedAny2One,c,readerQueueHead) != NULL,"Channel reader queue empty",__LINE__);
+			ASSERTEQ(writer1,ACCESS(QueuedAny2One,c,readerQueueHead)->process,"Channel data (readerQueueHead) not as expected",__LINE__);
+			ASSERTL(ACCESS(QueuedAny2One,c,writerStack) != NULL,"Channel writer stack empty",__LINE__);
+			
+			EventList expA;
+			
+			expA = tuple_list_of
+				(us,writer2,writer2) //We poison, freeing the writers on the stack (most recent first)
+				(us,writer0,writer0)
+				(us,writer1,writer1) //Then the writer in the reader's queue
+				(us,us,us) (us,NullProcessPtr,NullProcessPtr) //We yield
+				(NullProcessPtr,NullProcessPtr,NullProcessPtr) //They all finish
+				(NullProcessPtr,NullProcessPtr,NullProcessPtr)
+				(NullProcessPtr,NullProcessPtr,NullProcessPtr)
+			;
+			
+			EventList actA;
+			{
+				RecordEvents _(&actA);
+				
+				c.reader().poison();
+				CPPCSP_Yield();
+			}
+			
+			ASSERTEQ(expA,actA,"Channel events not as expected in part A",__LINE__);
+			ASSERTL(ACCESS(QueuedAny2One,c,writerStack) == &(ACCESS(QueuedAny2One,c,poisonedMarker)),"Channel not marked as poisoned",__LINE__);
+			ASSERTL(ACCESS(QueuedAny2One,c,readerQueueHead) == NULL,"Channel reader queue not empty",__LINE__);
+			
+			//Later writers should notice straight away:
+			bool poisoned = false;
+			try
+			{
+				c.writer() << 9;
+			}
+			catch (PoisonException&)
+			{
+				poisoned = true;
+			}
+			ASSERTEQ(true,poisoned,"Writer did not notice poison",__LINE__);
+		}
+		
+		END_TEST("Any2OneChannel Poison Test");
+	}
+	
+	/**
+	*	Tests alting on an Any2OneChannel when a writer arrives after the alt has begun waiting
+	*/
+	static TestResult testQueuedAny2OneAlt()
+	{
+		BEGIN_TEST()
+		
+		SetUp setup;
+		
+		Any2OneChannel<int> c;
+		
+		{
+			ScopedForking forking;
+			
+			ASSERTEQ(false,c.reader().pending(),"Channel pending when empty",__LINE__);
+			
+			WriterProcess<int>* _writer = new WriterProcess<int>(c.writer(),6,1);
+			ProcessPtr writer(getProcessPtr(_writer));
+			
+			forking.forkInThisThread(_writer);
+			
+			std::list<Guard*> guards;
+			guards.push_back(c.reader().inputGuard());
+			Alternative alt(guards);
+			
+			EventList expA;
+			
+			expA = tuple_list_of
+				(us,NullProcessPtr,NullProcessPtr) //We wait in the alt
+				(writer,us,us) //The writer queues up and frees us
+				(writer,NullProcessPtr,NullProcessPtr) //They block on the channel
+			;
+			
+			EventList actA;
+			unsigned selected;
+			{
+				RecordEvents _(&actA);
+				
+				selected = alt.priSelect();
+			}
+			
+			ASSERTEQ(expA,actA,"Channel events not as expected in part A",__LINE__);
+			ASSERTEQ(0u,selected,"Alt did not select the channel",__LINE__);
+			ASSERTEQ(true,c.reader().pending(),"Channel not pending",__LINE__);
+			ASSERTL(ACCESS(QueuedAny2One,c,writerStack) != &(ACCESS(QueuedAny2One,c,readerWaitingMarker)),"Reader still marked as waiting",__LINE__);
+			
+			int n;
+			c.reader() >> n;
+			ASSERTEQ(6,n,"Channel did not deliver the data",__LINE__);
+			ASSERTEQ(false,c.reader().pending(),"Channel pending when empty",__LINE__);
+		}
+		
+		END_TEST("Any2OneChannel Alt Test");
+	}
+	
+	/**
+	*	Measures an any-to-one channel with many writers (spread across several threads) writing to a single reader
+	*/
+	template <typename CHANNEL>
+	static TestResult _any2OnePerfTest(const char* name,int numThreads,int writersPerThread)
+	{
+		const int writesPerWriter = 20000;
+		double microsPerComm = 0;
+		
+		BEGIN_TEST()
+		
+		CHANNEL c;
+		
+		{
+			ScopedForking forking;
+			
+			for (int i = 0;i < numThreads;i++)
+			{
+				list<CSProcessPtr> writers;
+				for (int j = 0;j < writersPerThread;j++)
+				{
+					writers.push_back(new WriterProcess<int>(c.writer(),j,writesPerWriter));
+				}
+				forking.fork(InParallelOneThread(writers.begin(),writers.end()).process());
+			}
+			
+			const int total = numThreads * writersPerThread * writesPerWriter;
+			
+			Time start,finish;
+			CurrentTime(&start);
+			
+			int n;
+			for (int i = 0;i < total;i++)
+			{
+				c.reader() >> n;
+			}
+			
+			CurrentTime(&finish);
+			finish -= start;
+			
+			microsPerComm = (GetSeconds(&finish) / static_cast<double>(total)) * 1000000.0;
+		}
+		
+		END_TEST(string("Any2One Writers Test (") + name + "), " + lexical_cast<string>(numThreads) + " threads, each with " + lexical_cast<string>(writersPerThread) + " writers: " + lexical_cast<string>(microsPerComm) + " microseconds per communication");
+	}
+	
+	static TestResult any2OnePerfTest0()
+	{
+		return _any2OnePerfTest< Any2OneChannel<int> >("Queued",8,4);
+	}
+	
+	static TestResult any2OnePerfTest1()
+	{
+		return _any2OnePerfTest< Any2AnyChannel<int> >("Mutex (Any2Any)",8,4);
+	}
+	
+	static TestResult any2OnePerfTest2()
+	{
+		return _any2OnePerfTest< Any2OneChannel<int> >("Queued",1,32);
+	}
+	
+	static TestResult any2OnePerfTest3()
+	{
+		return _any2OnePerfTest< Any2AnyChannel<int> >("Mutex (Any2Any)",1,32);
+	}
+	
 	std::list<TestResult (*)()> tests()
 	{
-		#define CHANNELS (One2OneChannel<int>)(One2AnyChannel<int>)(Any2OneChannel<int>)(Any2AnyChannel<int>)
+		//Any2OneChannel does not use the Any2OneAdapter, so it has its own tests (testQueuedAny2One*) instead of these:
+		#define CHANNELS (One2OneChannel<int>)(One2AnyChannel<int>)(Any2AnyChannel<int>)
 						
 		us = currentProcess();
 		return list_of<TestResult (*) ()>
@@ -2445,16 +2878,18 @@ public:
 		#ifdef CPPCSP_PARCOMM
 			(testParcomm)
 		#endif
-			(testAny20<Any2OneChannel<int> >) (testAny20<Any2AnyChannel<int> >)
+			(testAny20<Any2AnyChannel<int> >)
 			(test2Any0<One2AnyChannel<int> >) (test2Any0<Any2AnyChannel<int> >)
 			
-			(testExtAny20<Any2OneChannel<int> >) (testExtAny20<Any2AnyChannel<int> >)
+			(testExtAny20<Any2AnyChannel<int> >)
 			(testExt2Any0<One2AnyChannel<int> >) (testExt2Any0<Any2AnyChannel<int> >)
 			
-			(testPoisonAny2<Any2OneChannel<int> >) (testPoisonAny2<Any2AnyChannel<int> >)
+			(testPoisonAny2<Any2AnyChannel<int> >)
 			
 			(testPoison2Any<One2AnyChannel<int> >) (testPoison2Any<Any2AnyChannel<int> >)
 			
+			(testQueuedAny2One0) (testQueuedAny2One1) (testQueuedAny2OneExt) (testQueuedAny2OnePoison) (testQueuedAny2OneAlt)
+			
 			(testLatePoison< One2OneChannel<int> , false >) 
 			(testLatePoison< Any2AnyChannel<int> , false >)
 			(testLatePoison< Any2OneChannel<int> , false >)
@@ -2476,6 +2911,7 @@ public:
 			(commsTimeTest0Double) (commsTimeTest1Double)
 			(commsTimeTest0Triangle) (commsTimeTest1Triangle) (commsTimeTest2Triangle)
 			(pingPongTest0) (pingPongTest1) (pingPongTest2) //(pingPongTest3)
+			(any2OnePerfTest0) (any2OnePerfTest1) (any2OnePerfTest2) (any2OnePerfTest3)
 		;
 	}	
 	
@@ -0,0 +1,613 @@
+/*
+*	The Kent C++CSP Library
+*	Copyright (C) 2002-2007 Neil Brown
+*
+*	This library is free software; you can redistribute it and/or
+*	modify it under the terms of the GNU Lesser General Public
+*	License as published by the Free Software Foundation; either
+*	version 2.1 of the License, or (at your option) any later version.
+*
+*	This library is distributed in the hope that it will be useful,
+*	but WITHOUT ANY WARRANTY; without even the implied warranty of
+*	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+*	Lesser General Public License for more details.
+*
+*	You should have received a copy of the GNU Lesser General Public
+*	License along with this library; if not, write to the Free Software
+*	Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#include "test.h"
+#include <boost/assign/list_of.hpp>
+
+#include "../src/cppcsp.h"
+#include "../src/common/basic.h"
+
+#ifdef CPPCSP_LINUX
+	#include "../src/common/file_io.h"
+	#include <stdio.h>
+#endif
+
+using namespace csp;
+using namespace csp::internal;
+using namespace csp::common;
+using namespace boost::assign;
+using namespace boost;
+using namespace std;
+
+class FileIOTest : public Test, public virtual internal::TestInfo, public SchedulerRecorder
+{
+public:
+#ifdef CPPCSP_LINUX
+
+	static string TempPath(const string& name)
+	{
+		return "/tmp/cppcsp_file_io_test_" + lexical_cast<string>(getpid()) + "_" + name;
+	}
+
+	///Some bytes that differ from chunk to chunk
+	static vector<unsigned char> Pattern(size_t size)
+	{
+		vector<unsigned char> ret(size);
+		for (size_t i = 0;i < size;i++)
+		{
+			ret[i] = static_cast<unsigned char>((i * 7) ^ (i >> 12));
+		}
+		return ret;
+	}
+
+	static void WriteWhole(const string& path,const vector<unsigned char>& data)
+	{
+		FILE* file = fopen(path.c_str(),"wb");
+		if (!data.empty())
+		{
+			fwrite(&data[0],1,data.size(),file);
+		}
+		fclose(file);
+	}
+
+	static vector<unsigned char> ReadWhole(const string& path)
+	{
+		vector<unsigned char> ret;
+		FILE* file = fopen(path.c_str(),"rb");
+		if (file != NULL)
+		{
+			unsigned char block[4096];
+			size_t n;
+			while ((n = fread(block,1,sizeof(block),file)) > 0)
+			{
+				ret.insert(ret.end(),block,block + n);
+			}
+			fclose(file);
+		}
+		return ret;
+	}
+
+	///Reads chunks until the channel is poisoned, appending them to the data and their sizes to the list
+	static void ReadChunks(Chanin< Mobile<Buffer> > in,vector<unsigned char>* data,list<usign32>* sizes)
+	{
+		try
+		{
+			while (true)
+			{
+				Mobile<Buffer> chunk;
+				in >> chunk;
+				data->insert(data->end(),chunk->data(),chunk->data() + chunk->size());
+				sizes->push_back(chunk->size());
+			}
+		}
+		catch (PoisonException&)
+		{
+		}
+	}
+
+	///Reads a file with blocking system calls, sending its chunks and then poisoning the channel
+	class BlockingFileReader : public CSProcess
+	{
+	private:
+		Chanout< Mobile<Buffer> > out;
+		const string path;
+		const usign32 chunkSize;
+	protected:
+		void run()
+		{
+			const int fd = open(path.c_str(),O_RDONLY);
+			try
+			{
+				while (true)
+				{
+					Mobile<Buffer> chunk(new Buffer(chunkSize));
+					const ssize_t n = read(fd,chunk->data(),chunkSize);
+					if (n <= 0)
+					{
+						break;
+					}
+					chunk->resize(static_cast<usign32>(n));
+					out << chunk;
+				}
+				out.poison();
+			}
+			catch (PoisonException&)
+			{
+			}
+			close(fd);
+		}
+	public:
+		inline BlockingFileReader(const Chanout< Mobile<Buffer> >& _out,const string& _path,usign32 _chunkSize)
+			:	CSProcess(65536),out(_out),path(_path),chunkSize(_chunkSize)
+		{
+		}
+	};
+
+	///Writes the buffers it reads with blocking system calls, until the channel is poisoned
+	class BlockingFileWriter : public CSProcess
+	{
+	private:
+		Chanin< Mobile<Buffer> > in;
+		const string path;
+	protected:
+		void run()
+		{
+			const int fd = open(path.c_str(),O_WRONLY | O_CREAT | O_TRUNC,0666);
+			try
+			{
+				while (true)
+				{
+					Mobile<Buffer> buffer;
+					in >> buffer;
+					if (write(fd,buffer->data(),buffer->size()) < 0)
+					{
+						in.poison();
+					}
+				}
+			}
+			catch (PoisonException&)
+			{
+			}
+			close(fd);
+		}
+	public:
+		inline BlockingFileWriter(const Chanin< Mobile<Buffer> >& _in,const string& _path)
+			:	CSProcess(65536),in(_in),path(_path)
+		{
+		}
+	};
+
+	static TestResult test0()
+	{
+		const usign32 chunkSize = 4096;
+		const string path = TempPath("read");
+
+		BEGIN_TEST()
+
+		//A file that ends part-way through a chunk, and one that ends with a full chunk:
+		const size_t sizes[] = {3 * chunkSize + 123,2 * chunkSize,100};
+		for (size_t s = 0;s < sizeof(sizes) / sizeof(sizes[0]);s++)
+		{
+			const vector<unsigned char> expected = Pattern(sizes[s]);
+			WriteWhole(path,expected);
+
+			One2OneChannel< Mobile<Buffer> > c;
+			vector<unsigned char> data;
+			list<usign32> chunkSizes;
+			{
+				ScopedForking forking;
+				forking.forkInThisThread(new FileReader(c.writer(),path,chunkSize,3));
+				ReadChunks(c.reader(),&data,&chunkSizes);
+			}
+
+			ASSERTL(expected == data,"File was not read correctly",__LINE__);
+			ASSERTEQ((sizes[s] + chunkSize - 1) / chunkSize,chunkSizes.size(),"File was not read in chunks",__LINE__);
+			ASSERTEQ(sizes[s] - (chunkSizes.size() - 1) * chunkSize,chunkSizes.back(),"Last chunk was the wrong size",__LINE__);
+		}
+
+		//An empty file, and one that does not exist, poison the channel straight away:
+		WriteWhole(path,vector<unsigned char>());
+		for (int i = 0;i < 2;i++)
+		{
+			One2OneChannel< Mobile<Buffer> > c;
+			vector<unsigned char> data;
+			list<usign32> chunkSizes;
+			{
+				ScopedForking forking;
+				forking.forkInThisThread(new FileReader(c.writer(),path));
+				ReadChunks(c.reader(),&data,&chunkSizes);
+			}
+			ASSERTL(chunkSizes.empty(),"Chunks were read from an empty or missing file",__LINE__);
+			unlink(path.c_str());
+		}
+
+		ASSERTEQ(0,IoRing::Current()->inFlight(),"Reads were left in flight",__LINE__);
+
+		unlink(path.c_str());
+		END_TEST("FileReader test" + string(IoRing::Current()->asynchronous() ? "" : " (without io_uring)"));
+	}
+
+	static TestResult test1()
+	{
+		const string path = TempPath("write");
+		const string copyPath = TempPath("copy");
+
+		BEGIN_TEST()
+
+		//Buffers of various sizes, including an empty one:
+		const usign32 sizes[] = {1000,0,65536,1,70000,4096};
+		vector<unsigned char> expected;
+		{
+			One2OneChannel< Mobile<Buffer> > c;
+			ScopedForking forking;
+			forking.forkInThisThread(new FileWriter(c.reader(),path,2));
+			for (size_t s = 0;s < sizeof(sizes) / sizeof(sizes[0]);s++)
+			{
+				const vector<unsigned char> data = Pattern(sizes[s] + s);
+				Mobile<Buffer> buffer(new Buffer(sizes[s]));
+				if (sizes[s] > 0)
+				{
+					memcpy(buffer->data(),&data[s],sizes[s]);
+				}
+				buffer->resize(sizes[s]);
+				expected.insert(expected.end(),data.begin() + s,data.end());
+				c.writer() << buffer;
+			}
+			c.writer().poison();
+		}
+		ASSERTL(expected == ReadWhole(path),"File was not written correctly",__LINE__);
+
+		//Copying a file, with the reader and writer in the same thread (so the buffers stay registered),
+		//then in different threads:
+		expected = Pattern(1000000);
+		WriteWhole(path,expected);
+		for (int i = 0;i < 2;i++)
+		{
+			unlink(copyPath.c_str());
+			{
+				One2OneChannel< Mobile<Buffer> > c;
+				ScopedForking forking;
+				if (i == 0)
+				{
+					forking.forkInThisThread(new FileReader(c.writer(),path,16384,8));
+				}
+				else
+				{
+					forking.fork(new FileReader(c.writer(),path,16384,8));
+				}
+				forking.forkInThisThread(new FileWriter(c.reader(),copyPath,8));
+			}
+			ASSERTL(expected == ReadWhole(copyPath),"File was not copied correctly",__LINE__);
+		}
+
+		//A file that cannot be opened poisons the channel:
+		{
+			One2OneChannel< Mobile<Buffer> > c;
+			ScopedForking forking;
+			forking.forkInThisThread(new FileWriter(c.reader(),"/nonexistent/directory/file"));
+			bool poisoned = false;
+			try
+			{
+				c.writer() << Mobile<Buffer>(new Buffer(10));
+			}
+			catch (PoisonException&)
+			{
+				poisoned = true;
+			}
+			ASSERTL(poisoned,"Writer did not poison its channel",__LINE__);
+		}
+
+		ASSERTEQ(0,IoRing::Current()->inFlight(),"Writes were left in flight",__LINE__);
+
+		unlink(path.c_str());
+		unlink(copyPath.c_str());
+		END_TEST("FileWriter test");
+	}
+
+	///True if the file is mapped into our memory
+	static bool IsMapped(const string& path)
+	{
+		const vector<unsigned char> maps = ReadWhole("/proc/self/maps");
+		return string(maps.begin(),maps.end()).find(path) != string::npos;
+	}
+
+	static TestResult test2()
+	{
+		const size_t chunkSize = 10000;
+		const string path = TempPath("mapped");
+
+		BEGIN_TEST()
+
+		const vector<unsigned char> expected = Pattern(25 * chunkSize + 17);
+		WriteWhole(path,expected);
+
+		//The views are kept after the source has finished, so the mapping must outlive it:
+		list<MappedView> views;
+		{
+			One2OneChannel<MappedView> c;
+			ScopedForking forking;
+			forking.forkInThisThread(new MappedFileSource(c.writer(),path,chunkSize,3 * chunkSize));
+			try
+			{
+				while (true)
+				{
+					MappedView view;
+					c.reader() >> view;
+					views.push_back(view);
+				}
+			}
+			catch (PoisonException&)
+			{
+			}
+		}
+		ASSERTEQ(26,views.size(),"File was not sent in chunks",__LINE__);
+		ASSERTL(IsMapped(path),"File was unmapped while views of it remained",__LINE__);
+
+		vector<unsigned char> data;
+		size_t offset = 0;
+		for (list<MappedView>::const_iterator it = views.begin();it != views.end();it++)
+		{
+			ASSERTEQ(offset,it->offset(),"View was at the wrong offset",__LINE__);
+			data.insert(data.end(),it->data(),it->data() + it->size());
+			offset += it->size();
+		}
+		ASSERTL(expected == data,"Views did not match the file",__LINE__);
+
+		//Views of views share the mapping too:
+		MappedView part = views.back().sub(10,100);
+		ASSERTEQ(7,part.size(),"Sub-view was not clipped to its view",__LINE__);
+		ASSERTEQ(25 * chunkSize + 10,part.offset(),"Sub-view was at the wrong offset",__LINE__);
+		views.clear();
+		ASSERTL(IsMapped(path),"File was unmapped while a view of it remained",__LINE__);
+		ASSERTL(0 == memcmp(&expected[part.offset()],part.data(),part.size()),"Sub-view did not match the file",__LINE__);
+		part = MappedView();
+		ASSERTL(false == IsMapped(path),"File was not unmapped after its last view was destroyed",__LINE__);
+
+		//An empty file, and one that does not exist, poison the channel straight away:
+		WriteWhole(path,vector<unsigned char>());
+		for (int i = 0;i < 2;i++)
+		{
+			One2OneChannel<MappedView> c;
+			ScopedForking forking;
+			forking.forkInThisThread(new MappedFileSource(c.writer(),path));
+			bool poisoned = false;
+			try
+			{
+				MappedView view;
+				c.reader() >> view;
+			}
+			catch (PoisonException&)
+			{
+				poisoned = true;
+			}
+			ASSERTL(poisoned,"Source did not poison its channel",__LINE__);
+			unlink(path.c_str());
+		}
+
+		END_TEST("MappedFileSource test");
+	}
+
+	///Sums every byte of the chunks it reads, until the channel is poisoned
+	template <typename CHUNK>
+	class Summer : public CSProcess
+	{
+	private:
+		Chanin<CHUNK> in;
+		usign32* sum;
+
+		static inline const unsigned char* Begin(const vector<unsigned char>& chunk) {return chunk.empty() ? NULL : &chunk[0];}
+		static inline size_t Size(const vector<unsigned char>& chunk) {return chunk.size();}
+		static inline const unsigned char* Begin(const Mobile<Buffer>& chunk) {return chunk->data();}
+		static inline size_t Size(const Mobile<Buffer>& chunk) {return chunk->size();}
+		static inline const unsigned char* Begin(const MappedView& chunk) {return chunk.data();}
+		static inline size_t Size(const MappedView& chunk) {return chunk.size();}
+	protected:
+		void run()
+		{
+			try
+			{
+				while (true)
+				{
+					CHUNK chunk;
+					in >> chunk;
+					const unsigned char* const data = Begin(chunk);
+					for (size_t i = 0;i < Size(chunk);i++)
+					{
+						*sum += data[i];
+					}
+				}
+			}
+			catch (PoisonException&)
+			{
+			}
+		}
+	public:
+		inline Summer(const Chanin<CHUNK>& _in,usign32* _sum)
+			:	CSProcess(65536),in(_in),sum(_sum)
+		{
+		}
+	};
+
+	///Reads a file into vectors with blocking system calls, sending them and then poisoning the channel
+	class VectorFileReader : public CSProcess
+	{
+	private:
+		Chanout< vector<unsigned char> > out;
+		const string path;
+		const size_t chunkSize;
+	protected:
+		void run()
+		{
+			const int fd = open(path.c_str(),O_RDONLY);
+			vector<unsigned char> chunk(chunkSize);
+			try
+			{
+				ssize_t n;
+				while ((n = read(fd,&chunk[0],chunkSize)) > 0)
+				{
+					chunk.resize(static_cast<size_t>(n));
+					out << chunk;
+					chunk.resize(chunkSize);
+				}
+				out.poison();
+			}
+			catch (PoisonException&)
+			{
+			}
+			close(fd);
+		}
+	public:
+		inline VectorFileReader(const Chanout< vector<unsigned char> >& _out,const string& _path,size_t _chunkSize)
+			:	CSProcess(65536),out(_out),path(_path),chunkSize(_chunkSize)
+		{
+		}
+	};
+
+	static TestResult filePerfTest1()
+	{
+		const usign32 fileSize = 64 * 1024 * 1024;
+		const usign32 chunkSize = 1024 * 1024;
+		const string path = TempPath("perfmapped");
+		string results;
+
+		BEGIN_TEST()
+
+		WriteWhole(path,Pattern(fileSize));
+
+		//Each way passes the chunks through two Id processes before they are summed:
+		usign32 sums[3] = {0,0,0};
+		for (int way = 0;way < 3;way++)
+		{
+			csp::Time start,finish;
+			CurrentTime(&start);
+			{
+				ScopedForking forking;
+				if (way == 0)
+				{
+					One2OneChannel< vector<unsigned char> > a,b,c;
+					forking.forkInThisThread(new VectorFileReader(a.writer(),path,chunkSize));
+					forking.forkInThisThread(new Id< vector<unsigned char> >(a.reader(),b.writer()));
+					forking.forkInThisThread(new Id< vector<unsigned char> >(b.reader(),c.writer()));
+					forking.forkInThisThread(new Summer< vector<unsigned char> >(c.reader(),&sums[way]));
+				}
+				else if (way == 1)
+				{
+					One2OneChannel< Mobile<Buffer> > a,b,c;
+					forking.forkInThisThread(new FileReader(a.writer(),path,chunkSize,4));
+					forking.forkInThisThread(new Id< Mobile<Buffer> >(a.reader(),b.writer()));
+					forking.forkInThisThread(new Id< Mobile<Buffer> >(b.reader(),c.writer()));
+					forking.forkInThisThread(new Summer< Mobile<Buffer> >(c.reader(),&sums[way]));
+				}
+				else
+				{
+					One2OneChannel<MappedView> a,b,c;
+					forking.forkInThisThread(new MappedFileSource(a.writer(),path,chunkSize));
+					forking.forkInThisThread(new Id<MappedView>(a.reader(),b.writer()));
+					forking.forkInThisThread(new Id<MappedView>(b.reader(),c.writer()));
+					forking.forkInThisThread(new Summer<MappedView>(c.reader(),&sums[way]));
+				}
+			}
+			CurrentTime(&finish);
+			finish -= start;
+
+			static const char* const names[] = {"vectors","FileReader","MappedFileSource"};
+			results += (way == 0 ? ": " : ", ") + string(names[way]) + ": "
+				+ lexical_cast<string>(static_cast<int>(static_cast<double>(fileSize) / (1024.0 * 1024.0) / GetSeconds(&finish))) + " MB/s";
+		}
+		ASSERTL(sums[0] == sums[1] && sums[1] == sums[2],"Files were not read the same",__LINE__);
+
+		unlink(path.c_str());
+		END_TEST("Scanning a 64MB file (cached) through two Id processes" + results);
+	}
+
+	static TestResult filePerfTest0()
+	{
+		const usign32 fileSize = 64 * 1024 * 1024;
+		const usign32 chunkSize = 65536;
+		const string path = TempPath("perf");
+		const string copyPath = TempPath("perfcopy");
+		string results;
+
+		BEGIN_TEST()
+
+		WriteWhole(path,Pattern(fileSize));
+
+		for (int way = 0;way < 4;way++)
+		{
+			csp::Time start,finish;
+			CurrentTime(&start);
+			{
+				One2OneChannel< Mobile<Buffer> > c;
+				ScopedForking forking;
+				switch (way)
+				{
+				case 0:
+					//Reading, today's way: a thread blocked in read calls:
+					forking.fork(new BlockingFileReader(c.writer(),path,chunkSize));
+					break;
+				case 1:
+					forking.forkInThisThread(new FileReader(c.writer(),path,chunkSize,8));
+					break;
+				case 2:
+					//Copying: a thread blocked in write calls:
+					forking.forkInThisThread(new FileReader(c.writer(),path,chunkSize,8));
+					forking.fork(new BlockingFileWriter(c.reader(),copyPath));
+					break;
+				case 3:
+					forking.forkInThisThread(new FileReader(c.writer(),path,chunkSize,8));
+					forking.forkInThisThread(new FileWriter(c.reader(),copyPath,8));
+					break;
+				}
+				if (way < 2)
+				{
+					vector<unsigned char> data;
+					data.reserve(fileSize);
+					list<usign32> chunkSizes;
+					ReadChunks(c.reader(),&data,&chunkSizes);
+					ASSERTEQ(fileSize,data.size(),"File was not read",__LINE__);
+				}
+			}
+			CurrentTime(&finish);
+			finish -= start;
+
+			static const char* const names[] = {"blocking read thread","FileReader","blocking write thread","FileWriter"};
+			results += (way == 0 ? ": " : ", ") + string(names[way]) + ": "
+				+ lexical_cast<string>(static_cast<int>(static_cast<double>(fileSize) / (1024.0 * 1024.0) / GetSeconds(&finish))) + " MB/s";
+		}
+
+		unlink(path.c_str());
+		unlink(copyPath.c_str());
+		END_TEST("Reading and copying a 64MB file (cached)" + results);
+	}
+
+	std::list<TestResult (*)()> tests()
+	{
+		return list_of<TestResult (*) ()>
+			(test0) (test1) (test2)
+		;
+	}
+
+	std::list<TestResult (*)()> perfTests()
+	{
+		return list_of<TestResult (*) ()>
+			(filePerfTest0) (filePerfTest1)
+		;
+	}
+
+#else
+
+	//The file processes are only available on Linux:
+
+	std::list<TestResult (*)()> tests()
+	{
+		return std::list<TestResult (*)()>();
+	}
+
+	std::list<TestResult (*)()> perfTests()
+	{
+		return std::list<TestResult (*)()>();
+	}
+
+#endif //CPPCSP_LINUX
+};
+
+Test* GetFileIOTest()
+{
+	return new FileIOTest;
+}
@@ -0,0 +1,372 @@
+/*
+*	The Kent C++CSP Library
+*	Copyright (C) 2002-2007 Neil Brown
+*
+*	This library is free software; you can redistribute it and/or
+*	modify it under the terms of the GNU Lesser General Public
+*	License as published by the Free Software Foundation; either
+*	version 2.1 of the License, or (at your option) any later version.
+*
+*	This library is distributed in the hope that it will be useful,
+*	but WITHOUT ANY WARRANTY; without even the implied warranty of
+*	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+*	Lesser General Public License for more details.
+*
+*	You should have received a copy of the GNU Lesser General Public
+*	License along with this library; if not, write to the Free Software
+*	Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#include "test.h"
+#include <boost/assign/list_of.hpp>
+
+#include "../src/cppcsp.h"
+
+#include "../src/common/basic.h"
+
+using namespace csp;
+using namespace csp::internal;
+using namespace csp::common;
+using namespace boost::assign;
+using namespace boost;
+
+#include <list>
+
+using namespace std;
+
+class InstrumentedChannelTest : public Test, public virtual internal::TestInfo
+{
+public:
+	static ProcessPtr us;
+
+	static bool findStatistics(const string& name,ChannelStatistics* stats)
+	{
+		list<ChannelStatistics> all = GetAllChannelStatistics();
+		for (list<ChannelStatistics>::iterator it = all.begin();it != all.end();it++)
+		{
+			if (it->name == name)
+			{
+				*stats = *it;
+				return true;
+			}
+		}
+		return false;
+	}
+
+	static TestResult testOne2One()
+	{
+		BEGIN_TEST()
+
+		InstrumentedOne2OneChannel<int> c("one2one");
+
+		ChannelStatistics stats = c.statistics();
+		ASSERTEQ(string("one2one"),stats.name,"Channel name not as expected",__LINE__);
+		ASSERTEQ(0u,stats.messages,"Messages not zero to begin with",__LINE__);
+		ASSERTEQ(0u,stats.mutexClaims,"Mutex claims not zero to begin with",__LINE__);
+
+		int n = 0;
+
+		//Reader arrives first:
+		{
+			ScopedForking forking;
+			forking.forkInThisThread(new WriterProcess<int>(c.writer(),6));
+
+			c.reader() >> n;
+			ASSERTEQ(6,n,"Channel did not deliver the right value",__LINE__);
+		}
+
+		stats = c.statistics();
+		ASSERTEQ(1u,stats.messages,"Messages not as expected",__LINE__);
+		ASSERTEQ(1u,stats.readerWaits,"Reader waits not as expected",__LINE__);
+		ASSERTEQ(0u,stats.writerWaits,"Writer waits not as expected",__LINE__);
+		ASSERTEQ(2u,stats.mutexClaims,"Mutex claims not as expected",__LINE__);
+		ASSERTEQ(0u,stats.mutexSpins,"Mutex spun within one thread",__LINE__);
+
+		//Writer arrives first:
+		{
+			ScopedForking forking;
+			forking.forkInThisThread(new WriterProcess<int>(c.writer(),7));
+
+			CPPCSP_Yield();
+
+			c.reader() >> n;
+			ASSERTEQ(7,n,"Channel did not deliver the right value",__LINE__);
+		}
+
+		stats = c.statistics();
+		ASSERTEQ(2u,stats.messages,"Messages not as expected",__LINE__);
+		ASSERTEQ(1u,stats.readerWaits,"Reader waits not as expected",__LINE__);
+		ASSERTEQ(1u,stats.writerWaits,"Writer waits not as expected",__LINE__);
+		ASSERTEQ(4u,stats.mutexClaims,"Mutex claims not as expected",__LINE__);
+		ASSERTEQ(0u,stats.bufferHighWater,"Unbuffered channel has a buffer high-water mark",__LINE__);
+
+		//Extended input, with the writer arriving first:
+		{
+			ScopedForking forking;
+			forking.forkInThisThread(new WriterProcess<int>(c.writer(),8));
+
+			CPPCSP_Yield();
+
+			{
+				ScopedExtInput<int> extInput(c.reader(),&n);
+				ASSERTEQ(2u,c.statistics().messages,"Message counted before the extended input finished",__LINE__);
+			}
+			ASSERTEQ(8,n,"Channel did not deliver the right value",__LINE__);
+		}
+
+		stats = c.statistics();
+		ASSERTEQ(3u,stats.messages,"Messages not as expected",__LINE__);
+		ASSERTEQ(2u,stats.writerWaits,"Writer waits not as expected",__LINE__);
+
+		c.resetStatistics();
+		stats = c.statistics();
+		ASSERTEQ(string("one2one"),stats.name,"Channel name lost by reset",__LINE__);
+		ASSERTEQ(0u,stats.messages,"Messages not reset",__LINE__);
+		ASSERTEQ(0u,stats.readerWaits,"Reader waits not reset",__LINE__);
+		ASSERTEQ(0u,stats.writerWaits,"Writer waits not reset",__LINE__);
+		ASSERTEQ(0u,stats.mutexClaims,"Mutex claims not reset",__LINE__);
+
+		END_TEST("InstrumentedOne2OneChannel Test");
+	}
+
+	static TestResult testBuffered()
+	{
+		BEGIN_TEST()
+
+		InstrumentedBufferedOne2OneChannel<int> c("buffered",FIFOBuffer<int>::Factory(4));
+
+		int n = 0;
+
+		c.writer() << 1;
+		c.writer() << 2;
+		c.writer() << 3;
+		c.reader() >> n;
+		c.reader() >> n;
+		c.writer() << 4;
+
+		ChannelStatistics stats = c.statistics();
+		ASSERTEQ(4u,stats.messages,"Messages not as expected",__LINE__);
+		ASSERTEQ(3u,stats.bufferHighWater,"Buffer high-water mark not as expected",__LINE__);
+		ASSERTEQ(0u,stats.readerWaits,"Reader waits not as expected",__LINE__);
+		ASSERTEQ(0u,stats.writerWaits,"Writer waits not as expected",__LINE__);
+
+		//Fill the buffer, then have a writer wait for space:
+		c.writer() << 5;
+		c.writer() << 6;
+
+		{
+			ScopedForking forking;
+			forking.forkInThisThread(new WriterProcess<int>(c.writer(),7));
+
+			CPPCSP_Yield();
+
+			ASSERTEQ(6u,c.statistics().messages,"Message counted before the writer was let in",__LINE__);
+
+			for (int i = 3;i <= 7;i++)
+			{
+				c.reader() >> n;
+				ASSERTEQ(i,n,"Channel did not deliver the right value",__LINE__);
+			}
+		}
+
+		stats = c.statistics();
+		ASSERTEQ(7u,stats.messages,"Messages not as expected",__LINE__);
+		ASSERTEQ(4u,stats.bufferHighWater,"Buffer high-water mark not as expected",__LINE__);
+		ASSERTEQ(1u,stats.writerWaits,"Writer waits not as expected",__LINE__);
+
+		//Reader waits on an empty buffer:
+		{
+			ScopedForking forking;
+			forking.forkInThisThread(new WriterProcess<int>(c.writer(),8));
+
+			c.reader() >> n;
+			ASSERTEQ(8,n,"Channel did not deliver the right value",__LINE__);
+		}
+
+		stats = c.statistics();
+		ASSERTEQ(8u,stats.messages,"Messages not as expected",__LINE__);
+		ASSERTEQ(1u,stats.readerWaits,"Reader waits not as expected",__LINE__);
+
+		//Poisoning from the reader's end clears the buffer:
+		c.writer() << 9;
+		c.writer() << 10;
+		c.resetStatistics();
+		ASSERTEQ(2u,c.statistics().bufferHighWater,"Reset did not keep the current buffer occupancy",__LINE__);
+
+		c.reader().poison();
+		c.resetStatistics();
+		ASSERTEQ(0u,c.statistics().bufferHighWater,"Poison did not clear the buffer occupancy",__LINE__);
+
+		END_TEST("InstrumentedBufferedOne2OneChannel Test");
+	}
+
+	static TestResult testShared()
+	{
+		BEGIN_TEST()
+
+		{
+			InstrumentedAny2AnyChannel<int> c("any2any");
+
+			{
+				ScopedForking forking;
+				forking.forkInThisThread(new WriterProcess<int>(c.writer(),1,10));
+				forking.forkInThisThread(new WriterProcess<int>(c.writer(),1,10));
+
+				int n;
+				for (int i = 0;i < 20;i++)
+				{
+					c.reader() >> n;
+				}
+			}
+
+			ChannelStatistics stats = c.statistics();
+			ASSERTEQ(20u,stats.messages,"Messages not as expected",__LINE__);
+			//Each message claims the writer mutex, the reader mutex and the channel mutex twice:
+			ASSERTEQ(80u,stats.mutexClaims,"Mutex claims not as expected",__LINE__);
+			//The second writer always queues behind the first:
+			ASSERTL(stats.mutexSpins > 0,"Writers did not queue on the shared end",__LINE__);
+		}
+
+		{
+			InstrumentedBufferedAny2OneChannel<int> c("bufferedAny2One",FIFOBuffer<int>::Factory(8));
+
+			{
+				ScopedForking forking;
+				forking.fork(new WriterProcess<int>(c.writer(),1,100));
+				forking.fork(new WriterProcess<int>(c.writer(),1,100));
+
+				int n;
+				for (int i = 0;i < 200;i++)
+				{
+					c.reader() >> n;
+				}
+			}
+
+			ChannelStatistics stats = c.statistics();
+			ASSERTEQ(200u,stats.messages,"Messages not as expected",__LINE__);
+			ASSERTL(stats.bufferHighWater >= 1 && stats.bufferHighWater <= 8,"Buffer high-water mark out of range",__LINE__);
+			ASSERTL(stats.mutexClaims >= 400,"Mutex claims not as expected",__LINE__);
+		}
+
+		END_TEST("Instrumented Shared Channel Test");
+	}
+
+	static TestResult testRegistry()
+	{
+		BEGIN_TEST()
+
+		ChannelStatistics stats;
+
+		ASSERTEQ(false,findStatistics("registryA",&stats),"Channel found before it was constructed",__LINE__);
+
+		{
+			InstrumentedOne2OneChannel<int> a("registryA");
+			InstrumentedBufferedOne2AnyChannel<int> b("registryB",FIFOBuffer<int>::Factory(2));
+
+			b.writer() << 3;
+
+			ASSERTEQ(true,findStatistics("registryA",&stats),"Channel not found in registry",__LINE__);
+			ASSERTEQ(0u,stats.messages,"Messages not as expected",__LINE__);
+			ASSERTEQ(true,findStatistics("registryB",&stats),"Channel not found in registry",__LINE__);
+			ASSERTEQ(1u,stats.messages,"Messages not as expected",__LINE__);
+			ASSERTEQ(1u,stats.bufferHighWater,"Buffer high-water mark not as expected",__LINE__);
+
+			//The registry is in construction order:
+			list<ChannelStatistics> all = GetAllChannelStatistics();
+			ASSERTL(all.size() >= 2,"Registry too small",__LINE__);
+			ASSERTEQ(string("registryB"),all.back().name,"Registry not in construction order",__LINE__);
+			all.pop_back();
+			ASSERTEQ(string("registryA"),all.back().name,"Registry not in construction order",__LINE__);
+		}
+
+		ASSERTEQ(false,findStatistics("registryA",&stats),"Channel still in registry after destruction",__LINE__);
+		ASSERTEQ(false,findStatistics("registryB",&stats),"Channel still in registry after destruction",__LINE__);
+
+		END_TEST("Instrumented Channel Registry Test");
+	}
+
+	template <typename CHANNEL>
+	static double timeChannel(CHANNEL& c,const int iterations)
+	{
+		Time start,finish;
+
+		{
+			ScopedForking forking;
+			forking.forkInThisThread(new WriterProcess<int>(c.writer(),1,iterations));
+
+			CurrentTime(&start);
+
+			int n;
+			for (int i = 0;i < iterations;i++)
+			{
+				c.reader() >> n;
+			}
+
+			CurrentTime(&finish);
+		}
+
+		finish -= start;
+		return (GetSeconds(&finish) / static_cast<double>(iterations)) * 1000000.0;
+	}
+
+	static TestResult instrumentedPerfTest0()
+	{
+		const int iterations = 200000;
+		double plainMicros = 0,instrumentedMicros = 0;
+
+		BEGIN_TEST()
+
+		One2OneChannel<int> plain;
+		InstrumentedOne2OneChannel<int> instrumented("perf");
+
+		plainMicros = timeChannel(plain,iterations);
+		instrumentedMicros = timeChannel(instrumented,iterations);
+
+		END_TEST("Instrumented One2OneChannel Test, same thread: " + lexical_cast<string>(instrumentedMicros) + " microseconds per communication (uninstrumented: " + lexical_cast<string>(plainMicros) + ")");
+	}
+
+	static TestResult instrumentedPerfTest1()
+	{
+		const int iterations = 200000;
+		double plainMicros = 0,instrumentedMicros = 0;
+
+		BEGIN_TEST()
+
+		BufferedOne2OneChannel<int> plain(FIFOBuffer<int>::Factory(16));
+		InstrumentedBufferedOne2OneChannel<int> instrumented("perf",FIFOBuffer<int>::Factory(16));
+
+		plainMicros = timeChannel(plain,iterations);
+		instrumentedMicros = timeChannel(instrumented,iterations);
+
+		END_TEST("Instrumented BufferedOne2OneChannel Test, same thread, buffer size 16: " + lexical_cast<string>(instrumentedMicros) + " microseconds per communication (uninstrumented: " + lexical_cast<string>(plainMicros) + ")");
+	}
+
+	std::list<TestResult (*)()> tests()
+	{
+		us = currentProcess();
+
+		return list_of<TestResult (*) ()>
+			(testOne2One) (testBuffered) (testShared) (testRegistry)
+		;
+	}
+
+	std::list<TestResult (*)()> perfTests()
+	{
+		us = currentProcess();
+
+		return list_of<TestResult (*) ()>
+			(instrumentedPerfTest0) (instrumentedPerfTest1)
+		;
+	}
+
+	inline virtual ~InstrumentedChannelTest()
+	{
+	}
+};
+
+ProcessPtr InstrumentedChannelTest::us;
+
+Test* GetInstrumentedChannelTest()
+{
+	return new InstrumentedChannelTest;
+}
@@ -34,6 +34,7 @@ using namespace boost::assign;
 using namespace boost;
 
 #include <list>
+#include <numeric>
 
 using namespace std;
 
@@ -43,6 +44,251 @@ template <> unsigned int volatile csp::internal::_AtomicProcessQueue<class csp::
 namespace
 {
 
+//Claims the lock for reading or writing (times times), checking that it has the lock to itself (or only shares it with readers).
+//Writers change the two values, yielding in the middle; readers check that they are equal:
+class LockUser : public CSProcess
+{
+private:
+	ReadWriteLock* lock;
+	bool writer;
+	int times;
+	volatile usign32* readersInside;
+	volatile int* writersInside;
+	volatile int* a;
+	volatile int* b;
+	int* wrong;
+protected:
+	void run()
+	{
+		for (int i = 0;i < times;i++)
+		{
+			if (writer)
+			{
+				ScopedWriteLock _(*lock);
+				if ((*writersInside)++ != 0 || AtomicGet(readersInside) != 0)
+				{
+					*wrong += 1;
+				}
+				*a = i;
+				CPPCSP_Yield();
+				*b = i;
+				(*writersInside)--;
+			}
+			else
+			{
+				ScopedReadLock _(*lock);
+				AtomicIncrement(readersInside);
+				if (*writersInside != 0 || *a != *b)
+				{
+					*wrong += 1;
+				}
+				CPPCSP_Yield();
+				if (*a != *b)
+				{
+					*wrong += 1;
+				}
+				AtomicDecrement(readersInside);
+			}
+		}
+	}
+public:
+	inline LockUser(ReadWriteLock* _lock,bool _writer,int _times,volatile usign32* _readersInside,volatile int* _writersInside,volatile int* _a,volatile int* _b,int* _wrong)
+		:	CSProcess(65536),lock(_lock),writer(_writer),times(_times),readersInside(_readersInside),writersInside(_writersInside),a(_a),b(_b),wrong(_wrong)
+	{
+	}
+};
+
+//Claims the lock for reading, and records how many readers had it at once:
+class LockReader : public CSProcess
+{
+private:
+	ReadWriteLock* lock;
+	volatile usign32* inside;
+	volatile usign32* mostInside;
+protected:
+	void run()
+	{
+		ScopedReadLock _(*lock);
+		const usign32 now = AtomicIncrement(inside);
+		if (now > *mostInside)
+		{
+			*mostInside = now;
+		}
+		CPPCSP_Yield();
+		AtomicDecrement(inside);
+	}
+public:
+	inline LockReader(ReadWriteLock* _lock,volatile usign32* _inside,volatile usign32* _mostInside)
+		:	lock(_lock),inside(_inside),mostInside(_mostInside)
+	{
+	}
+};
+
+//Claims the lock for writing, and records how many readers had the lock at the time:
+class LockWriter : public CSProcess
+{
+private:
+	ReadWriteLock* lock;
+	volatile usign32* inside;
+	usign32* readersSeen;
+protected:
+	void run()
+	{
+		ScopedWriteLock _(*lock);
+		*readersSeen = AtomicGet(inside);
+	}
+public:
+	inline LockWriter(ReadWriteLock* _lock,volatile usign32* _inside,usign32* _readersSeen)
+		:	lock(_lock),inside(_inside),readersSeen(_readersSeen)
+	{
+	}
+};
+
+//Acquires a permit (times times), and counts the times that more than permits processes had one at once:
+class PermitUser : public CSProcess
+{
+private:
+	Semaphore* semaphore;
+	usign32 permits;
+	int times;
+	volatile usign32* inside;
+	int* wrong;
+protected:
+	void run()
+	{
+		for (int i = 0;i < times;i++)
+		{
+			semaphore->acquire();
+			if (AtomicIncrement(inside) > permits)
+			{
+				*wrong += 1;
+			}
+			CPPCSP_Yield();
+			AtomicDecrement(inside);
+			semaphore->release();
+		}
+	}
+public:
+	inline PermitUser(Semaphore* _semaphore,usign32 _permits,int _times,volatile usign32* _inside,int* _wrong)
+		:	CSProcess(65536),semaphore(_semaphore),permits(_permits),times(_times),inside(_inside),wrong(_wrong)
+	{
+	}
+};
+
+//A value that checks its own consistency, and counts how many copies of it exist:
+class TrackedValue
+{
+public:
+	int a,b;
+	int* alive;
+	
+	inline TrackedValue(int _a,int* _alive)
+		:	a(_a),b(2 * _a),alive(_alive)
+	{
+		(*alive)++;
+	}
+	
+	inline TrackedValue(const TrackedValue& other)
+		:	a(other.a),b(other.b),alive(other.alive)
+	{
+		(*alive)++;
+	}
+	
+	inline ~TrackedValue()
+	{
+		(*alive)--;
+		//So that reading a deleted value is (probably) noticed:
+		a = -1;
+		b = 0;
+	}
+	
+	inline bool consistent() const
+	{
+		return a >= 0 && b == 2 * a;
+	}
+};
+
+//Takes snapshots of the value (times times), and holds them across a yield:
+class SnapshotReader : public CSProcess
+{
+private:
+	SharedValue<TrackedValue>* value;
+	int times;
+	int* wrong;
+protected:
+	void run()
+	{
+		for (int i = 0;i < times;i++)
+		{
+			SharedValue<TrackedValue>::Snapshot snapshot(*value);
+			const int a = snapshot->a;
+			if (false == snapshot->consistent())
+			{
+				*wrong += 1;
+			}
+			CPPCSP_Yield();
+			if (false == snapshot->consistent() || snapshot->a != a)
+			{
+				*wrong += 1;
+			}
+		}
+	}
+public:
+	inline SnapshotReader(SharedValue<TrackedValue>* _value,int _times,int* _wrong)
+		:	CSProcess(65536),value(_value),times(_times),wrong(_wrong)
+	{
+	}
+};
+
+//Sets the value (times times), yielding in between:
+class SnapshotWriter : public CSProcess
+{
+private:
+	SharedValue<TrackedValue>* value;
+	int times;
+	int* alive;
+protected:
+	void run()
+	{
+		for (int i = 1;i <= times;i++)
+		{
+			value->set(TrackedValue(i,alive));
+			CPPCSP_Yield();
+		}
+	}
+public:
+	inline SnapshotWriter(SharedValue<TrackedValue>* _value,int _times,int* _alive)
+		:	CSProcess(65536),value(_value),times(_times),alive(_alive)
+	{
+	}
+};
+
+//Takes a snapshot and holds it while blocked on a channel, then blocks again without it:
+class SnapshotHolder : public CSProcess
+{
+private:
+	SharedValue<int>* value;
+	Chanout<int> out;
+	Chanin<int> in;
+protected:
+	void run()
+	{
+		int x;
+		{
+			SharedValue<int>::Snapshot snapshot(*value);
+			out << *snapshot;
+			in >> x;
+		}
+		out << 0;
+		in >> x;
+	}
+public:
+	inline SnapshotHolder(SharedValue<int>* _value,const Chanout<int>& _out,const Chanin<int>& _in)
+		:	value(_value),out(_out),in(_in)
+	{
+	}
+};
+
 class MutexTest : public Test, public virtual internal::TestInfo, public SchedulerRecorder
 {
 public:
@@ -70,6 +316,278 @@ public:
 		END_TEST("Barrier Test 0");
 	}	
 */	
+	//Readers and a writer in one thread:
+	static TestResult rwLockTest0()
+	{
+		BEGIN_TEST()
+		
+		ReadWriteLock lock;
+		volatile usign32 inside = 0;
+		volatile usign32 mostInside = 0;
+		usign32 readersSeenA = 99,readersSeenB = 99;
+		volatile usign32 insideWhileWriting;
+		
+		{
+			ScopedForking forking;
+			
+			lock.claimWrite();
+			
+			forking.forkInThisThread(new LockReader(&lock,&inside,&mostInside));
+			forking.forkInThisThread(new LockReader(&lock,&inside,&mostInside));
+			forking.forkInThisThread(new LockWriter(&lock,&inside,&readersSeenA));
+			forking.forkInThisThread(new LockReader(&lock,&inside,&mostInside));
+			CPPCSP_Yield();
+			
+			//They should all be waiting for us:
+			insideWhileWriting = inside;
+			
+			lock.releaseWrite();
+			
+			//The readers all get the lock (together) before the waiting writer:
+			forking.forkInThisThread(new LockWriter(&lock,&inside,&readersSeenB));
+		}
+		
+		//Now uncontended:
+		lock.claimRead();
+		lock.claimRead();
+		lock.releaseRead();
+		lock.releaseRead();
+		lock.claimWrite();
+		lock.releaseWrite();
+		
+		ASSERTEQ(0,insideWhileWriting,"Readers got the lock while it was held for writing",__LINE__);
+		ASSERTEQ(3,mostInside,"Readers did not share the lock",__LINE__);
+		ASSERTEQ(0,readersSeenA,"Writer got the lock while readers had it",__LINE__);
+		ASSERTEQ(0,readersSeenB,"Writer got the lock while readers had it",__LINE__);
+		
+		END_TEST("ReadWriteLock Test 0");
+	}
+	
+	static TestResult _rwLockTest(const char* name,int threads,int perThread,int writersPerThread,int times)
+	{
+		BEGIN_TEST()
+		
+		ReadWriteLock lock;
+		volatile usign32 readersInside = 0;
+		volatile int writersInside = 0;
+		volatile int a = 0,b = 0;
+		vector<int> wrong(threads * perThread,0);
+		
+		{
+			ScopedForking forking;
+			for (int i = 0;i < threads;i++)
+			{
+				list<CSProcessPtr> users;
+				for (int j = 0;j < perThread;j++)
+				{
+					users.push_back(new LockUser(&lock,j < writersPerThread,times,&readersInside,&writersInside,&a,&b,&wrong[i * perThread + j]));
+				}
+				forking.fork(InParallelOneThread(users.begin(),users.end()).process());
+			}
+		}
+		
+		ASSERTEQ(0,std::accumulate(wrong.begin(),wrong.end(),0),"Lock was not exclusive",__LINE__);
+		
+		END_TEST(name);
+	}
+	
+	//Readers and writers in several threads:
+	static TestResult rwLockTest1()
+	{
+		return _rwLockTest("ReadWriteLock Test 1",4,5,1,200);
+	}
+	
+	//Only readers, in several threads:
+	static TestResult rwLockTest2()
+	{
+		return _rwLockTest("ReadWriteLock Test 2",4,5,0,200);
+	}
+	
+	static TestResult semaphoreTest0()
+	{
+		BEGIN_TEST()
+		
+		Semaphore one(1);
+		bool firstTry,secondTry,thirdTry;
+		usign32 availableAfter;
+		
+		firstTry = one.tryAcquire();
+		secondTry = one.tryAcquire();
+		one.release();
+		thirdTry = one.tryAcquire();
+		one.release();
+		one.acquire();
+		one.release();
+		availableAfter = one.available();
+		
+		ASSERTEQ(true,firstTry,"Could not take a permit",__LINE__);
+		ASSERTEQ(false,secondTry,"Could take a permit that was not there",__LINE__);
+		ASSERTEQ(true,thirdTry,"Could not take a released permit",__LINE__);
+		ASSERTEQ(1,availableAfter,"Wrong number of permits",__LINE__);
+		
+		END_TEST("Semaphore Test 0");
+	}
+	
+	//Many processes sharing a few permits, in one thread and in several:
+	static TestResult semaphoreTest1()
+	{
+		BEGIN_TEST()
+		
+		Semaphore local(2),shared(3);
+		volatile usign32 localInside = 0,sharedInside = 0;
+		int localWrong = 0;
+		vector<int> sharedWrong(4 * 5,0);
+		usign32 localAfter,sharedAfter;
+		
+		{
+			ScopedForking forking;
+			for (int i = 0;i < 5;i++)
+			{
+				forking.forkInThisThread(new PermitUser(&local,2,100,&localInside,&localWrong));
+			}
+		}
+		
+		{
+			ScopedForking forking;
+			for (int i = 0;i < 4;i++)
+			{
+				list<CSProcessPtr> users;
+				for (int j = 0;j < 5;j++)
+				{
+					users.push_back(new PermitUser(&shared,3,100,&sharedInside,&sharedWrong[i * 5 + j]));
+				}
+				forking.fork(InParallelOneThread(users.begin(),users.end()).process());
+			}
+		}
+		
+		localAfter = local.available();
+		sharedAfter = shared.available();
+		
+		ASSERTEQ(0,localWrong,"Too many processes had a permit",__LINE__);
+		ASSERTEQ(0,std::accumulate(sharedWrong.begin(),sharedWrong.end(),0),"Too many processes had a permit",__LINE__);
+		ASSERTEQ(2,localAfter,"Permits were lost",__LINE__);
+		ASSERTEQ(3,sharedAfter,"Permits were lost",__LINE__);
+		
+		END_TEST("Semaphore Test 1");
+	}
+	
+	//Snapshots and reclamation in one thread:
+	static TestResult sharedValueTest0()
+	{
+		BEGIN_TEST()
+		
+		int alive = 0;
+		int seenA,seenB;
+		usign32 pendingWhileHeld,pendingAfter;
+		int aliveAfter,aliveAtEnd;
+		
+		{
+			SharedValue<TrackedValue> value(TrackedValue(1,&alive));
+			
+			{
+				SharedValue<TrackedValue>::Snapshot snapshot(value);
+				value.set(TrackedValue(2,&alive));
+				seenA = snapshot->a;
+				value.set(TrackedValue(3,&alive));
+				pendingWhileHeld = value.pending();
+			}
+			
+			{
+				SharedValue<TrackedValue>::Snapshot snapshot(value);
+				seenB = snapshot->a;
+			}
+			
+			//No-one holds a snapshot now, so both old versions can go:
+			value.set(TrackedValue(4,&alive));
+			pendingAfter = value.pending();
+			aliveAfter = alive;
+		}
+		
+		aliveAtEnd = alive;
+		
+		ASSERTEQ(1,seenA,"Snapshot changed when the value was set",__LINE__);
+		ASSERTEQ(2,pendingWhileHeld,"Old versions were deleted while a snapshot was held",__LINE__);
+		ASSERTEQ(3,seenB,"New snapshot did not see the latest version",__LINE__);
+		ASSERTEQ(0,pendingAfter,"Old versions were not deleted",__LINE__);
+		ASSERTEQ(1,aliveAfter,"Old versions were not deleted",__LINE__);
+		ASSERTEQ(0,aliveAtEnd,"Versions were leaked",__LINE__);
+		
+		END_TEST("SharedValue Test 0");
+	}
+	
+	//Readers in several threads, and a writer:
+	static TestResult sharedValueTest1()
+	{
+		BEGIN_TEST()
+		
+		int alive = 0;
+		vector<int> wrong(4 * 5,0);
+		
+		{
+			SharedValue<TrackedValue> value(TrackedValue(0,&alive));
+			
+			ScopedForking forking;
+			for (int i = 0;i < 4;i++)
+			{
+				list<CSProcessPtr> readers;
+				for (int j = 0;j < 5;j++)
+				{
+					readers.push_back(new SnapshotReader(&value,200,&wrong[i * 5 + j]));
+				}
+				forking.fork(InParallelOneThread(readers.begin(),readers.end()).process());
+			}
+			forking.fork(new SnapshotWriter(&value,200,&alive));
+		}
+		
+		ASSERTEQ(0,std::accumulate(wrong.begin(),wrong.end(),0),"Snapshots were inconsistent",__LINE__);
+		ASSERTEQ(0,alive,"Versions were leaked",__LINE__);
+		
+		END_TEST("SharedValue Test 1");
+	}
+	
+	//A snapshot held by a blocked process in another thread:
+	static TestResult sharedValueTest2()
+	{
+		BEGIN_TEST()
+		
+		SharedValue<int> value(7);
+		One2OneChannel<int> fromHolder,toHolder;
+		int seen,x;
+		usign32 pendingWhileHeld,pendingAfter = 1;
+		
+		{
+			ScopedForking forking;
+			forking.fork(new SnapshotHolder(&value,fromHolder.writer(),toHolder.reader()));
+			
+			fromHolder.reader() >> seen;
+			value.set(8);
+			value.set(9);
+			pendingWhileHeld = value.pending();
+			
+			toHolder.writer() << 0;
+			fromHolder.reader() >> x;
+			
+			//Once the holder's thread has rescheduled (or gone idle) without its snapshot, the old versions can go:
+			for (int i = 0;i < 1000 && pendingAfter != 0;i++)
+			{
+				value.set(10 + i);
+				pendingAfter = value.pending();
+				if (pendingAfter != 0)
+				{
+					SleepFor(MilliSeconds(1));
+				}
+			}
+			
+			toHolder.writer() << 0;
+		}
+		
+		ASSERTEQ(7,seen,"Holder did not see the first version",__LINE__);
+		ASSERTEQ(2,pendingWhileHeld,"Old versions were deleted while a snapshot was held",__LINE__);
+		ASSERTEQ(0,pendingAfter,"Old versions were not deleted after the snapshot was released",__LINE__);
+		
+		END_TEST("SharedValue Test 2");
+	}
+	
 	static Time timeNonAtomicSwap(Mobile<BarrierEnd>& end)
 	{
 		Time start,finish,nonAtomic;		
@@ -408,6 +926,126 @@ public:
 		}
 	};
 	
+	///Treats the reading side of a ReadWriteLock as a mutex, for the mutex tests
+	class ReadLockAsMutex
+	{
+		ReadWriteLock lock;
+	public:
+		class End
+		{
+			ReadWriteLock* lock;
+		public:
+			inline explicit End(ReadWriteLock* _lock) : lock(_lock) {}
+			inline void claim() {lock->claimRead();}
+			inline void release() {lock->releaseRead();}
+		};
+		
+		End end() {return End(&lock);}
+	};
+	
+	///Treats the writing side of a ReadWriteLock as a mutex, for the mutex tests
+	class WriteLockAsMutex
+	{
+		ReadWriteLock lock;
+	public:
+		class End
+		{
+			ReadWriteLock* lock;
+		public:
+			inline explicit End(ReadWriteLock* _lock) : lock(_lock) {}
+			inline void claim() {lock->claimWrite();}
+			inline void release() {lock->releaseWrite();}
+		};
+		
+		End end() {return End(&lock);}
+	};
+	
+	///Treats a Semaphore with one permit as a mutex, for the mutex tests
+	class SemaphoreAsMutex
+	{
+		Semaphore semaphore;
+	public:
+		inline SemaphoreAsMutex() : semaphore(1) {}
+		
+		class End
+		{
+			Semaphore* semaphore;
+		public:
+			inline explicit End(Semaphore* _semaphore) : semaphore(_semaphore) {}
+			inline void claim() {semaphore->acquire();}
+			inline void release() {semaphore->release();}
+		};
+		
+		End end() {return End(&semaphore);}
+	};
+	
+	///Reads and writes a value protected by a ReadWriteLock, for the read-mostly tests
+	class ReadWriteLockEnd
+	{
+		ReadWriteLock* lock;
+		int* value;
+	public:
+		inline ReadWriteLockEnd(ReadWriteLock* _lock,int* _value) : lock(_lock),value(_value) {}
+		inline int read() {ScopedReadLock _(*lock); return *value;}
+		inline void write(int x) {ScopedWriteLock _(*lock); *value = x;}
+	};
+	
+	///Reads and writes a value protected by a mutex, for the read-mostly tests
+	template <typename MUTEXEND>
+	class ExclusiveLockEnd
+	{
+		MUTEXEND mutexEnd;
+		int* value;
+	public:
+		inline ExclusiveLockEnd(MUTEXEND _mutexEnd,int* _value) : mutexEnd(_mutexEnd),value(_value) {}
+		inline int read() {mutexEnd.claim(); const int ret = *value; mutexEnd.release(); return ret;}
+		inline void write(int x) {mutexEnd.claim(); *value = x; mutexEnd.release();}
+	};
+	
+	///Reads and writes a SharedValue, for the read-mostly tests
+	class SharedValueEnd
+	{
+		SharedValue<int>* value;
+	public:
+		inline explicit SharedValueEnd(SharedValue<int>* _value) : value(_value) {}
+		inline int read() {SharedValue<int>::Snapshot snapshot(*value); return *snapshot;}
+		inline void write(int x) {value->set(x);}
+	};
+	
+	///Accesses the value 100000 times, writing one time in writeEvery and reading the rest
+	template <typename VALUEEND>
+	class ReadMostlyFunction
+	{
+		VALUEEND valueEnd;
+		int writeEvery;
+	public:
+		Time operator() (Mobile<BarrierEnd>& barrierEnd)
+		{
+			volatile int total = 0;
+			
+			barrierEnd->sync();
+			for (int i = 0;i < 100000;i++)
+			{
+				if (i % writeEvery == writeEvery - 1)
+				{
+					valueEnd.write(i);
+				}
+				else
+				{
+					total += valueEnd.read();
+				}
+			}
+			barrierEnd->sync();
+			
+			return Time();
+		}
+		
+		inline ReadMostlyFunction(VALUEEND _valueEnd,int _writeEvery)
+			:	valueEnd(_valueEnd),writeEvery(_writeEvery)
+		{
+		}
+	};
+	
 	template <typename MUTEX>
 	static TestResult _mutexPerfTestDep(const char* name,int threads, int claimersPerThread,bool yield)
 	{				
@@ -484,7 +1122,89 @@ public:
 			+ lexical_cast<string>(GetSeconds(&time) * 100.0) + " microseconds per claim/release");
 	}
 	
-#define BOTH_MUTEX_LIST (QueuedMutex) (SpinMutex) (PureSpinMutex) (PureSpinMutex_TTS) (OSNonBlockingMutex) (OSBlockingMutex)
+	template <typename VALUEEND>
+	static TestResult _readMostlyPerfTest(const char* name,int threads,int claimersPerThread,int writeEvery,VALUEEND valueEnd)
+	{
+		BlackHoleChannel<Time> c;
+		
+		Barrier barrier;
+		Time start,finish;
+		Time time;
+		
+		list<ThreadCSProcessPtr> processes;
+		
+		for (int i = 0;i < threads;i++)
+		{
+			list<CSProcessPtr> subProcesses;
+			for (int j = 0;j < claimersPerThread;j++)
+			{
+				subProcesses.push_back(new EvaluateFunctionBarrier<Time,ReadMostlyFunction<VALUEEND> >(ReadMostlyFunction<VALUEEND>(valueEnd,writeEvery),c.writer(),barrier.enrolledEnd()));
+			}
+			
+			processes.push_back(InParallelOneThread(subProcesses.begin(),subProcesses.end()).process());
+		}
+		
+		{
+			ScopedBarrierEnd end(barrier.end());
+			
+			ScopedForking forking;
+			
+			forking.fork(processes.begin(),processes.end());
+			
+			CurrentTime(&start);
+			end.sync();
+			end.sync();
+			CurrentTime(&finish);
+			
+			time = finish - start;
+		}
+		
+		return TestResultPass(string(name) + " Read-Mostly Test (" + lexical_cast<string>(threads) + " threads, each with " + lexical_cast<string>(claimersPerThread)
+			+ " claimers, one write in " + lexical_cast<string>(writeEvery) + "): "
+			+ lexical_cast<string>(GetSeconds(&time) * 1000000.0 / (100000.0 * threads * claimersPerThread)) + " microseconds per access");
+	}
+	
+	static TestResult readMostlyPerfTest0()
+	{
+		ReadWriteLock lock;
+		int value = 0;
+		return _readMostlyPerfTest("ReadWriteLock",4,10,100,ReadWriteLockEnd(&lock,&value));
+	}
+	
+	static TestResult readMostlyPerfTest1()
+	{
+		QueuedMutex mutex;
+		int value = 0;
+		return _readMostlyPerfTest("QueuedMutex",4,10,100,ExclusiveLockEnd<QueuedMutex::End>(mutex.end(),&value));
+	}
+	
+	static TestResult readMostlyPerfTest2()
+	{
+		ReadWriteLock lock;
+		int value = 0;
+		return _readMostlyPerfTest("ReadWriteLock",4,10,10000,ReadWriteLockEnd(&lock,&value));
+	}
+	
+	static TestResult readMostlyPerfTest3()
+	{
+		QueuedMutex mutex;
+		int value = 0;
+		return _readMostlyPerfTest("QueuedMutex",4,10,10000,ExclusiveLockEnd<QueuedMutex::End>(mutex.end(),&value));
+	}
+	
+	static TestResult readMostlyPerfTest4()
+	{
+		SharedValue<int> value(0);
+		return _readMostlyPerfTest("SharedValue",4,10,100,SharedValueEnd(&value));
+	}
+	
+	static TestResult readMostlyPerfTest5()
+	{
+		SharedValue<int> value(0);
+		return _readMostlyPerfTest("SharedValue",4,10,10000,SharedValueEnd(&value));
+	}
+	
+#define BOTH_MUTEX_LIST (QueuedMutex) (SpinMutex) (PureSpinMutex) (PureSpinMutex_TTS) (OSNonBlockingMutex) (OSBlockingMutex) (ReadLockAsMutex) (WriteLockAsMutex) (SemaphoreAsMutex)
 #ifdef CPPCSP_WINDOWS
 	#define MUTEX_LIST BOTH_MUTEX_LIST (OSCritSection) (OSNonBlockingCritSection)
 #else
@@ -572,7 +1292,11 @@ public:
 	std::list<TestResult (*) ()> tests()
 	{
 		us = currentProcess();
-		return list<TestResult (*) ()>(); //list_of<TestResult (*) ()>(); 
+		return list_of<TestResult (*) ()>
+			(rwLockTest0) (rwLockTest1) (rwLockTest2)
+			(semaphoreTest0) (semaphoreTest1)
+			(sharedValueTest0) (sharedValueTest1) (sharedValueTest2)
+		;
 	}
 
 	std::list<TestResult (*) ()> perfTests()
@@ -585,6 +1309,8 @@ public:
 			BOOST_PP_SEQ_FOR_EACH(MUTEX_TEST_NAME_BR,(1,1),MUTEX_LIST)
 			BOOST_PP_SEQ_FOR_EACH(MUTEX_IND_TEST_NAME_BR,dummyparam,MUTEX_LIST)
 			(queuePerfTest0) (queuePerfTest1) (queuePerfTest2)
+			(readMostlyPerfTest0) (readMostlyPerfTest1) (readMostlyPerfTest2) (readMostlyPerfTest3)
+			(readMostlyPerfTest4) (readMostlyPerfTest5)
 		; 
 	}
 	
@@ -0,0 +1,336 @@
+/*
+*	The Kent C++CSP Library
+*	Copyright (C) 2002-2007 Neil Brown
+*
+*	This library is free software; you can redistribute it and/or
+*	modify it under the terms of the GNU Lesser General Public
+*	License as published by the Free Software Foundation; either
+*	version 2.1 of the License, or (at your option) any later version.
+*
+*	This library is distributed in the hope that it will be useful,
+*	but WITHOUT ANY WARRANTY; without even the implied warranty of
+*	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+*	Lesser General Public License for more details.
+*
+*	You should have received a copy of the GNU Lesser General Public
+*	License along with this library; if not, write to the Free Software
+*	Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#include "test.h"
+#include <boost/assign/list_of.hpp>
+
+#include "../src/cppcsp.h"
+#include "../src/common/basic.h"
+
+using namespace csp;
+using namespace csp::internal;
+using namespace csp::common;
+using namespace boost::assign;
+using namespace boost;
+using namespace std;
+
+class NamedChannelTest : public Test, public virtual internal::TestInfo, public SchedulerRecorder
+{
+public:
+#ifdef CPPCSP_LINUX
+
+	///Writes a value, then signals that the write has completed
+	class SignallingWriter : public CSProcess
+	{
+	private:
+		Chanout<int> out;
+		Chanout<int> done;
+		const int value;
+	protected:
+		void run()
+		{
+			try
+			{
+				out << value;
+				done << value;
+			}
+			catch (PoisonException&)
+			{
+				done.poison();
+			}
+		}
+	public:
+		inline SignallingWriter(const Chanout<int>& _out,const Chanout<int>& _done,int _value)
+			:	out(_out),done(_done),value(_value)
+		{
+		}
+	};
+
+	///Returns true if the channel has something to read within the timeout
+	static bool readyWithin(AltChanin<int> in,const csp::Time& timeout)
+	{
+		std::list<Guard*> guards;
+		guards.push_back(in.inputGuard());
+		guards.push_back(new RelTimeoutGuard(timeout));
+		Alternative alt(guards);
+		return 0 == alt.priSelect();
+	}
+
+	static TestResult test0()
+	{
+		BEGIN_TEST()
+
+		Mobile<ChannelNameServer> server = OpenChannelNameServer(0,IPAddress_Localhost);
+		ASSERTL(server,"Could not open name server",__LINE__);
+
+		Mobile<ChannelNode> a = JoinChannelNameServer(server->address());
+		Mobile<ChannelNode> b = JoinChannelNameServer(server->address());
+		ASSERTL(a && b,"Could not join name server",__LINE__);
+
+		{
+			Mobile< NamedChannelReader<int> > reader = a->openReader<int>("numbers");
+			ASSERTL(reader,"Could not open named channel",__LINE__);
+			ASSERTL(!b->openReader<int>("numbers"),"Opened a named channel twice",__LINE__);
+			ASSERTL(!b->connectWriter<int>("letters"),"Connected to a channel that does not exist",__LINE__);
+
+			//From another node, and from the same one:
+			Mobile< NamedChannelWriter<int> > writerB = b->connectWriter<int>("numbers");
+			Mobile< NamedChannelWriter<int> > writerA = a->connectWriter<int>("numbers");
+			ASSERTL(writerA && writerB,"Could not connect to named channel",__LINE__);
+
+			ScopedForking forking;
+			forking.forkInThisThread(new WriterProcess<int>(writerB->writer(),7,10));
+			forking.forkInThisThread(new WriterProcess<int>(writerA->writer(),9,10));
+
+			int sum = 0,n;
+			for (int i = 0;i < 20;i++)
+			{
+				reader->reader() >> n;
+				sum += n;
+			}
+			ASSERTEQ(160,sum,"Values did not arrive from both writers",__LINE__);
+
+			//Destroying a writer does not poison the reader:
+			writerA.blank();
+			ASSERTL(false == readyWithin(reader->reader(),MilliSeconds(50)),"Reader had a value after a writer closed",__LINE__);
+		}
+
+		//The name is free once the reader has gone:
+		ASSERTL(!a->connectWriter<int>("numbers"),"Connected to a closed channel",__LINE__);
+		Mobile< NamedChannelReader<int> > reader = b->openReader<int>("numbers");
+		ASSERTL(reader,"Could not reopen named channel on another node",__LINE__);
+
+		//Strings are sent with their own serializer:
+		Mobile< NamedChannelReader<string> > words = b->openReader<string>("words",8);
+		Mobile< NamedChannelWriter<string> > wordsOut = a->connectWriter<string>("words");
+		ASSERTL(words && wordsOut,"Could not open string channel",__LINE__);
+		string word;
+		wordsOut->writer() << string("hello");
+		wordsOut->writer() << string();
+		words->reader() >> word;
+		ASSERTEQ(string("hello"),word,"String did not arrive",__LINE__);
+		words->reader() >> word;
+		ASSERTEQ(string(),word,"Empty string did not arrive",__LINE__);
+
+		END_TEST("Named channel name service test");
+	}
+
+	static TestResult test1()
+	{
+		BEGIN_TEST()
+
+		Mobile<ChannelNameServer> server = OpenChannelNameServer(0,IPAddress_Localhost);
+		Mobile<ChannelNode> a = JoinChannelNameServer(server->address());
+		Mobile<ChannelNode> b = JoinChannelNameServer(server->address());
+
+		//Unbuffered, so a write completes only once the remote reader has taken the value:
+		{
+			Mobile< NamedChannelReader<int> > reader = a->openReader<int>("rendezvous");
+			Mobile< NamedChannelWriter<int> > writer = b->connectWriter<int>("rendezvous");
+			ASSERTL(reader && writer,"Could not open named channel",__LINE__);
+
+			One2OneChannel<int> done;
+			ScopedForking forking;
+			for (int i = 0;i < 3;i++)
+			{
+				forking.forkInThisThread(new SignallingWriter(writer->writer(),done.writer(),i));
+				ASSERTL(false == readyWithin(done.reader(),MilliSeconds(50)),"Write completed before the value was read",__LINE__);
+
+				int n;
+				reader->reader() >> n;
+				ASSERTEQ(i,n,"Value did not arrive",__LINE__);
+				ASSERTL(readyWithin(done.reader(),Seconds(5)),"Write did not complete once the value was read",__LINE__);
+				done.reader() >> n;
+			}
+		}
+
+		//Buffered, so that many writes complete without the reader:
+		{
+			const usign32 bufferSize = 4;
+			Mobile< NamedChannelReader<int> > reader = a->openReader<int>("buffered",bufferSize);
+			Mobile< NamedChannelWriter<int> > writer = b->connectWriter<int>("buffered");
+			ASSERTL(reader && writer,"Could not open named channel",__LINE__);
+
+			for (usign32 i = 0;i < bufferSize;i++)
+			{
+				writer->writer() << static_cast<int>(i);
+			}
+
+			One2OneChannel<int> done;
+			ScopedForking forking;
+			forking.forkInThisThread(new SignallingWriter(writer->writer(),done.writer(),bufferSize));
+			ASSERTL(false == readyWithin(done.reader(),MilliSeconds(50)),"Write completed with the buffer full",__LINE__);
+
+			int n;
+			for (usign32 i = 0;i <= bufferSize;i++)
+			{
+				reader->reader() >> n;
+				ASSERTEQ(static_cast<int>(i),n,"Value did not arrive in order",__LINE__);
+			}
+			ASSERTL(readyWithin(done.reader(),Seconds(5)),"Write did not complete once the buffer had room",__LINE__);
+			done.reader() >> n;
+		}
+
+		END_TEST("Named channel rendezvous and buffering test");
+	}
+
+	static TestResult test2()
+	{
+		BEGIN_TEST()
+
+		Mobile<ChannelNameServer> server = OpenChannelNameServer(0,IPAddress_Localhost);
+		Mobile<ChannelNode> a = JoinChannelNameServer(server->address());
+		Mobile<ChannelNode> b = JoinChannelNameServer(server->address());
+
+		//Poisoning the writer poisons the reader, once the values written have been read:
+		{
+			Mobile< NamedChannelReader<int> > reader = a->openReader<int>("poison",16);
+			Mobile< NamedChannelWriter<int> > writer = b->connectWriter<int>("poison");
+			ASSERTL(reader && writer,"Could not open named channel",__LINE__);
+
+			writer->writer() << 1;
+			writer->writer() << 2;
+			writer->writer().poison();
+
+			int n;
+			reader->reader() >> n;
+			ASSERTEQ(1,n,"Value did not arrive before the poison",__LINE__);
+			reader->reader() >> n;
+			ASSERTEQ(2,n,"Value did not arrive before the poison",__LINE__);
+
+			bool poisoned = false;
+			try
+			{
+				reader->reader() >> n;
+			}
+			catch (PoisonException&)
+			{
+				poisoned = true;
+			}
+			ASSERTL(poisoned,"Reader was not poisoned",__LINE__);
+		}
+
+		//Closing the reader poisons the writer:
+		{
+			Mobile< NamedChannelReader<int> > reader = a->openReader<int>("closing");
+			Mobile< NamedChannelWriter<int> > writer = b->connectWriter<int>("closing");
+			ASSERTL(reader && writer,"Could not open named channel",__LINE__);
+
+			reader.blank();
+
+			bool poisoned = false;
+			try
+			{
+				writer->writer() << 1;
+			}
+			catch (PoisonException&)
+			{
+				poisoned = true;
+			}
+			ASSERTL(poisoned,"Writer was not poisoned",__LINE__);
+		}
+
+		//Leaving the name service removes the node's names:
+		{
+			Mobile< NamedChannelReader<int> > reader = a->openReader<int>("leaving");
+			ASSERTL(reader,"Could not open named channel",__LINE__);
+			reader.blank();
+			a.blank();
+			ASSERTL(!b->connectWriter<int>("leaving"),"Connected to a channel of a node that has left",__LINE__);
+		}
+
+		END_TEST("Named channel poison test");
+	}
+
+	static TestResult namedPerfTest0()
+	{
+		const int count = 20000;
+		const usign32 bufferSizes[] = {0,1,16,256};
+		string results;
+
+		BEGIN_TEST()
+
+		Mobile<ChannelNameServer> server = OpenChannelNameServer(0,IPAddress_Localhost);
+		Mobile<ChannelNode> a = JoinChannelNameServer(server->address());
+		Mobile<ChannelNode> b = JoinChannelNameServer(server->address());
+
+		for (size_t s = 0;s < sizeof(bufferSizes) / sizeof(bufferSizes[0]);s++)
+		{
+			const string name = "perf" + lexical_cast<string>(bufferSizes[s]);
+			Mobile< NamedChannelReader<int> > reader = a->openReader<int>(name,bufferSizes[s]);
+			Mobile< NamedChannelWriter<int> > writer = b->connectWriter<int>(name);
+			ASSERTL(reader && writer,"Could not open named channel",__LINE__);
+
+			csp::Time start,finish;
+			CurrentTime(&start);
+			{
+				ScopedForking forking;
+				forking.forkInThisThread(new WriterProcess<int>(writer->writer(),1,count));
+				int n;
+				for (int i = 0;i < count;i++)
+				{
+					reader->reader() >> n;
+				}
+			}
+			CurrentTime(&finish);
+			finish -= start;
+
+			const double microsPerValue = (GetSeconds(&finish) / static_cast<double>(count)) * 1000000.0;
+			results += (s == 0 ? ": " : ", ") + string("buffer ") + lexical_cast<string>(bufferSizes[s]) + ": "
+				+ lexical_cast<string>(microsPerValue) + " microseconds per value";
+		}
+
+		END_TEST("Named channel over TCP loopback" + results);
+	}
+
+	std::list<TestResult (*)()> tests()
+	{
+		return list_of<TestResult (*) ()>
+			(test0) (test1) (test2)
+		;
+	}
+
+	std::list<TestResult (*)()> perfTests()
+	{
+		return list_of<TestResult (*) ()>
+			(namedPerfTest0)
+		;
+	}
+
+#else
+
+	//The named channels are only available on Linux:
+
+	std::list<TestResult (*)()> tests()
+	{
+		return std::list<TestResult (*)()>();
+	}
+
+	std::list<TestResult (*)()> perfTests()
+	{
+		return std::list<TestResult (*)()>();
+	}
+
+#endif //CPPCSP_LINUX
+};
+
+Test* GetNamedChannelTest()
+{
+	return new NamedChannelTest;
+}
@@ -0,0 +1,425 @@
+/*
+*	The Kent C++CSP Library
+*	Copyright (C) 2002-2007 Neil Brown
+*
+*	This library is free software; you can redistribute it and/or
+*	modify it under the terms of the GNU Lesser General Public
+*	License as published by the Free Software Foundation; either
+*	version 2.1 of the License, or (at your option) any later version.
+*
+*	This library is distributed in the hope that it will be useful,
+*	but WITHOUT ANY WARRANTY; without even the implied warranty of
+*	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+*	Lesser General Public License for more details.
+*
+*	You should have received a copy of the GNU Lesser General Public
+*	License along with this library; if not, write to the Free Software
+*	Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+/*
+*	NetBench: a loopback benchmark of the TCP socket channels.
+*
+*	A CSP server, built from ConnectionHandler, runs in its own thread with an echo service and a sink service.
+*	CSP clients in the main thread measure the rate at which connections are accepted, the round-trip latency of
+*	ping-pong messages (as percentiles), and the streaming throughput for various message sizes and numbers of
+*	connections.  Everything runs over 127.0.0.1, and the results are written to stdout as JSON.
+*
+*	Usage: NetBench [--quick]    (--quick runs each benchmark for a tenth as long)
+*/
+
+#include "../src/cppcsp.h"
+#include "../src/common/basic.h"
+
+#include <iostream>
+#include <sstream>
+#include <iomanip>
+#include <algorithm>
+#include <stdexcept>
+#include <string.h>
+
+using namespace csp;
+using namespace csp::common;
+using namespace std;
+
+#ifdef CPPCSP_LINUX
+
+#include <time.h>
+#include <sys/resource.h>
+
+namespace
+{
+	typedef vector<unsigned char> Bytes;
+
+	///A monotonic clock in microseconds, finer than csp::Time
+	inline double NowMicros()
+	{
+		timespec ts;
+		clock_gettime(CLOCK_MONOTONIC,&ts);
+		return static_cast<double>(ts.tv_sec) * 1000000.0 + static_cast<double>(ts.tv_nsec) / 1000.0;
+	}
+
+	inline Mobile<Bytes> Message(size_t size)
+	{
+		return Mobile<Bytes>(new Bytes(size,0x5A));
+	}
+
+	///Reads from the channel until size bytes have arrived (TCP does not keep the writes apart)
+	void ReadBytes(Chanin<Bytes> in,size_t size)
+	{
+		Bytes data;
+		for (size_t received = 0;received < size;received += data.size())
+		{
+			in >> data;
+		}
+	}
+
+	Mobile<Bytes> Echo(const Bytes& data)
+	{
+		return Mobile<Bytes>(new Bytes(data));
+	}
+
+	typedef ConnectionHandler< TCPSocketChannel,FunctionProcess< Bytes,Mobile<Bytes> >,Mobile<Bytes> (*)(const Bytes&) > EchoServer;
+
+	/**
+	*	Serves the sink: each batch starts with its length in bytes (8 bytes, most significant first, counting the
+	*	header), and once the whole batch has arrived one byte is sent back.
+	*/
+	class Sink : public CSProcess
+	{
+	private:
+		Chanin<Bytes> in;
+		Chanout< Mobile<Bytes> > out;
+	protected:
+		void run()
+		{
+			try
+			{
+				Bytes data;
+				size_t have = 0,expected = 0;
+				Bytes header;
+				while (true)
+				{
+					in >> data;
+					for (size_t i = 0;i < data.size() && header.size() < 8;i++)
+					{
+						header.push_back(data[i]);
+						if (header.size() == 8)
+						{
+							expected = 0;
+							for (int j = 0;j < 8;j++)
+							{
+								expected = (expected << 8) | header[j];
+							}
+						}
+					}
+					have += data.size();
+					if (header.size() == 8 && have >= expected)
+					{
+						out << Message(1);
+						//Batches do not overlap, since the client waits for the reply:
+						header.clear();
+						have = 0;
+					}
+				}
+			}
+			catch (PoisonException&)
+			{
+				in.poison();
+				out.poison();
+			}
+		}
+	public:
+		inline Sink(const Chanin<Bytes>& _in,const Chanout< Mobile<Bytes> >& _out,int)
+			:	CSProcess(65536),in(_in),out(_out)
+		{
+		}
+	};
+
+	typedef ConnectionHandler<TCPSocketChannel,Sink,int> SinkServer;
+
+	///Makes round trips on one connection, recording how long each took
+	class PingPong : public CSProcess
+	{
+	private:
+		Mobile<TCPSocketChannel> chan;
+		const size_t size;
+		const int rounds;
+		vector<double>* const samples;
+	protected:
+		void run()
+		{
+			for (int i = 0;i < rounds;i++)
+			{
+				const double start = NowMicros();
+				chan->writer() << Message(size);
+				ReadBytes(chan->reader(),size);
+				samples->push_back(NowMicros() - start);
+			}
+		}
+	public:
+		inline PingPong(const Mobile<TCPSocketChannel>& _chan,size_t _size,int _rounds,vector<double>* _samples)
+			:	CSProcess(65536),chan(_chan),size(_size),rounds(_rounds),samples(_samples)
+		{
+		}
+	};
+
+	///Streams a batch of messages (made beforehand, so that only the sending is timed) to the sink, then waits for its reply
+	class Streamer : public CSProcess
+	{
+	private:
+		Mobile<TCPSocketChannel> chan;
+		list< Mobile<Bytes> > messages;
+	protected:
+		void run()
+		{
+			for (list< Mobile<Bytes> >::iterator it = messages.begin();it != messages.end();it++)
+			{
+				chan->writer() << *it;
+			}
+			ReadBytes(chan->reader(),1);
+		}
+	public:
+		inline Streamer(const Mobile<TCPSocketChannel>& _chan,size_t size,size_t count)
+			:	CSProcess(65536),chan(_chan)
+		{
+			Mobile<Bytes> header = Message(8);
+			const unsigned long long total = 8 + static_cast<unsigned long long>(size) * count;
+			for (int j = 0;j < 8;j++)
+			{
+				(*header)[j] = static_cast<unsigned char>(total >> (8 * (7 - j)));
+			}
+			messages.push_back(header);
+			for (size_t i = 0;i < count;i++)
+			{
+				messages.push_back(Message(size));
+			}
+		}
+	};
+
+	///The value below which the given fraction of the (sorted) samples lie
+	double Percentile(const vector<double>& sorted,double fraction)
+	{
+		const size_t index = static_cast<size_t>(fraction * static_cast<double>(sorted.size() - 1) + 0.5);
+		return sorted[(std::min)(index,sorted.size() - 1)];
+	}
+
+	class Benchmarks
+	{
+	private:
+		const TCPUDPAddress echoAddress;
+		const TCPUDPAddress sinkAddress;
+		const int scale;
+		ostringstream json;
+
+		Mobile<TCPSocketChannel> connect(const TCPUDPAddress& address,usign32 bufSize)
+		{
+			Mobile<TCPSocketChannel> ret = ConnectTCPSocket(address,bufSize);
+			if (!ret)
+			{
+				throw runtime_error("Could not connect to the loopback server");
+			}
+			return ret;
+		}
+	public:
+		inline Benchmarks(const TCPUDPAddress& _echoAddress,const TCPUDPAddress& _sinkAddress,bool quick)
+			:	echoAddress(_echoAddress),sinkAddress(_sinkAddress),scale(quick ? 1 : 10)
+		{
+			json << setprecision(6);
+		}
+
+		void accept()
+		{
+			//Each connection takes a descriptor at both ends:
+			rlimit limit;
+			getrlimit(RLIMIT_NOFILE,&limit);
+			limit.rlim_cur = limit.rlim_max;
+			setrlimit(RLIMIT_NOFILE,&limit);
+			getrlimit(RLIMIT_NOFILE,&limit);
+			const size_t connections = static_cast<size_t>((std::min<rlim_t>)(500 * scale,(limit.rlim_cur - 64) / 2));
+
+			//Each connection makes one round trip before the next is made, so that it has been accepted and served:
+			list< Mobile<TCPSocketChannel> > clients;
+			vector<double> samples;
+			const double start = NowMicros();
+			for (size_t i = 0;i < connections;i++)
+			{
+				const double connectStart = NowMicros();
+				clients.push_back(connect(echoAddress,4096));
+				clients.back()->writer() << Message(1);
+				ReadBytes(clients.back()->reader(),1);
+				samples.push_back(NowMicros() - connectStart);
+			}
+			const double seconds = (NowMicros() - start) / 1000000.0;
+			clients.clear();
+
+			sort(samples.begin(),samples.end());
+			json << "\"accept\":{\"connections\":" << connections << ",\"seconds\":" << seconds
+				<< ",\"connections_per_second\":" << static_cast<double>(connections) / seconds
+				<< ",\"p50_us\":" << Percentile(samples,0.5) << ",\"p99_us\":" << Percentile(samples,0.99) << "}";
+		}
+
+		void latency()
+		{
+			const size_t sizes[] = {64,4096};
+			const size_t connectionCounts[] = {1,16};
+
+			json << "\"latency\":[";
+			bool first = true;
+			for (size_t c = 0;c < sizeof(connectionCounts) / sizeof(connectionCounts[0]);c++)
+			{
+				for (size_t s = 0;s < sizeof(sizes) / sizeof(sizes[0]);s++)
+				{
+					const int rounds = static_cast<int>(2000 * scale / connectionCounts[c]);
+					vector< vector<double> > samples(connectionCounts[c]);
+					{
+						ScopedForking forking;
+						for (size_t i = 0;i < connectionCounts[c];i++)
+						{
+							samples[i].reserve(rounds);
+							forking.forkInThisThread(new PingPong(connect(echoAddress,65536),sizes[s],rounds,&samples[i]));
+						}
+					}
+
+					vector<double> all;
+					for (size_t i = 0;i < samples.size();i++)
+					{
+						all.insert(all.end(),samples[i].begin(),samples[i].end());
+					}
+					sort(all.begin(),all.end());
+					double total = 0;
+					for (size_t i = 0;i < all.size();i++)
+					{
+						total += all[i];
+					}
+
+					json << (first ? "" : ",") << "{\"connections\":" << connectionCounts[c] << ",\"message_bytes\":" << sizes[s]
+						<< ",\"round_trips\":" << all.size() << ",\"mean_us\":" << total / static_cast<double>(all.size())
+						<< ",\"p50_us\":" << Percentile(all,0.5) << ",\"p90_us\":" << Percentile(all,0.9)
+						<< ",\"p99_us\":" << Percentile(all,0.99) << ",\"p999_us\":" << Percentile(all,0.999)
+						<< ",\"max_us\":" << all.back() << "}";
+					first = false;
+				}
+			}
+			json << "]";
+		}
+
+		void throughput()
+		{
+			const size_t sizes[] = {64,1024,65536,1048576};
+			const size_t connectionCounts[] = {1,8,64};
+			const size_t totalBytes = static_cast<size_t>(scale) * 8 * 1024 * 1024;
+			//Small messages are limited by count rather than bytes, to bound the time spent making them:
+			const size_t maxMessages = static_cast<size_t>(scale) * 20000;
+
+			json << "\"throughput\":[";
+			bool first = true;
+			for (size_t c = 0;c < sizeof(connectionCounts) / sizeof(connectionCounts[0]);c++)
+			{
+				for (size_t s = 0;s < sizeof(sizes) / sizeof(sizes[0]);s++)
+				{
+					const size_t perConnection = (std::max)(static_cast<size_t>(1),(std::min)(totalBytes / sizes[s],maxMessages) / connectionCounts[c]);
+
+					list<CSProcessPtr> streamers;
+					for (size_t i = 0;i < connectionCounts[c];i++)
+					{
+						streamers.push_back(new Streamer(connect(sinkAddress,65536),sizes[s],perConnection));
+					}
+
+					const double start = NowMicros();
+					{
+						ScopedForking forking;
+						forking.forkInThisThread(streamers.begin(),streamers.end());
+					}
+					const double seconds = (NowMicros() - start) / 1000000.0;
+
+					const double messages = static_cast<double>(perConnection * connectionCounts[c]);
+					json << (first ? "" : ",") << "{\"connections\":" << connectionCounts[c] << ",\"message_bytes\":" << sizes[s]
+						<< ",\"messages\":" << perConnection * connectionCounts[c] << ",\"seconds\":" << seconds
+						<< ",\"megabytes_per_second\":" << messages * static_cast<double>(sizes[s]) / (1024.0 * 1024.0) / seconds
+						<< ",\"messages_per_second\":" << messages / seconds << "}";
+					first = false;
+				}
+			}
+			json << "]";
+		}
+
+		inline string results() const
+		{
+			return json.str();
+		}
+
+		inline void separate()
+		{
+			json << ",";
+		}
+	};
+}
+
+int main(int argc,char** argv)
+{
+	bool quick = false;
+	for (int i = 1;i < argc;i++)
+	{
+		if (0 == strcmp(argv[i],"--quick"))
+		{
+			quick = true;
+		}
+		else
+		{
+			cerr << "Usage: " << argv[0] << " [--quick]" << endl;
+			return 2;
+		}
+	}
+
+	Start_CPPCSP();
+	int ret = 0;
+	{
+		Mobile<TCPSocketAccepterChannel> echoAccepter = OpenTCPSocketAccepter(0,IPAddress_Localhost,65536);
+		Mobile<TCPSocketAccepterChannel> sinkAccepter = OpenTCPSocketAccepter(0,IPAddress_Localhost,65536);
+		if (!echoAccepter || !sinkAccepter)
+		{
+			cerr << "Could not open the loopback server" << endl;
+			End_CPPCSP();
+			return 1;
+		}
+
+		ScopedForking forking;
+		//The server runs all its connections in one thread of its own:
+		forking.fork(new EchoServer(echoAccepter->reader(),&Echo,false));
+		forking.fork(new SinkServer(sinkAccepter->reader(),0,false));
+
+		try
+		{
+			Benchmarks benchmarks(echoAccepter->localAddress(),sinkAccepter->localAddress(),quick);
+			benchmarks.accept();
+			benchmarks.separate();
+			benchmarks.latency();
+			benchmarks.separate();
+			benchmarks.throughput();
+
+			cout << "{\"benchmark\":\"tcp_loopback\",\"version\":\"" << CPPCSP2_VERSION << "\",\"address\":\"127.0.0.1\",\"quick\":"
+				<< (quick ? "true" : "false") << "," << benchmarks.results() << "}" << endl;
+		}
+		catch (std::exception& e)
+		{
+			cerr << e.what() << endl;
+			ret = 1;
+		}
+
+		echoAccepter->reader().poison();
+		sinkAccepter->reader().poison();
+	}
+	End_CPPCSP();
+	return ret;
+}
+
+#else
+
+int main(int,char**)
+{
+	cerr << "NetBench needs the network channels, which are only available on Linux" << endl;
+	return 1;
+}
+
+#endif //CPPCSP_LINUX
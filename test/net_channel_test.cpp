@@ -23,6 +23,14 @@
 #include "../src/cppcsp.h"
 #include "../src/common/basic.h"
 
+#ifdef CPPCSP_LINUX
+	#include <sys/resource.h>
+	#include <unistd.h>
+	#include <fcntl.h>
+	#include <dirent.h>
+	#include <string.h>
+#endif
+
 using namespace csp;
 using namespace csp::internal;
 using namespace csp::common;
@@ -30,16 +38,16 @@ using namespace boost::assign;
 using namespace boost;
 using namespace std;
 
-vector< unsigned char> reverseVector(const vector<unsigned char>& v)
-{
-	vector<unsigned char> r(v.size());
-	reverse_copy(v.begin(),v.end(),r.begin());
-	return r;
-}
-
 class NetChannelTest : public Test, public virtual internal::TestInfo, public SchedulerRecorder
 {
 public:
+#ifdef CPPCSP_LINUX
+
+	static Mobile< vector<unsigned char> > echoVector(const vector<unsigned char>& v)
+	{
+		return Mobile< vector<unsigned char> >(new vector<unsigned char>(v));
+	}
+
 	static std::vector<unsigned char> getPattern(size_t size)
 	{
 		std::vector<unsigned char> v(size);
@@ -49,6 +57,11 @@ public:
 		}
 		return v;
 	}
+
+	static Mobile< std::vector<unsigned char> > mobilePattern(size_t size)
+	{
+		return Mobile< std::vector<unsigned char> >(new std::vector<unsigned char>(getPattern(size)));
+	}
 	
 	template <typename T>
 	static bool vectorsEqual(const vector<T>& a,const vector<T>& b)
@@ -64,7 +77,91 @@ public:
 		
 		return true;
 	}
-	/*
+
+	///Reads from the channel until size bytes have arrived (TCP does not keep the writes apart)
+	static vector<unsigned char> readBytes(AltChanin< vector<unsigned char> > in,size_t size)
+	{
+		vector<unsigned char> all,data;
+		while (all.size() < size)
+		{
+			in >> data;
+			all.insert(all.end(),data.begin(),data.end());
+		}
+		return all;
+	}
+
+	///Opens an accepter on the first free port from 56000
+	static Mobile<TCPSocketAccepterChannel> openAccepter(usign16* port,usign32 bufSize)
+	{
+		Mobile<TCPSocketAccepterChannel> chan;
+		for (*port = 56000;!chan && *port < 57000;(*port)++)
+		{
+			chan = OpenTCPSocketAccepter(*port,IPAddress_Any,bufSize);
+		}
+		(*port)--;
+		return chan;
+	}
+
+	typedef ConnectionHandler<
+		TCPSocketChannel ,
+		FunctionProcess< vector<unsigned char> , Mobile< vector<unsigned char> > , Mobile< vector<unsigned char> > (*)(const vector<unsigned char>&) >,
+		Mobile< vector<unsigned char> > (*)(const vector<unsigned char>&)
+		> EchoHandler;
+
+	typedef PooledConnectionHandler<
+		TCPSocketChannel ,
+		FunctionProcess< vector<unsigned char> , Mobile< vector<unsigned char> > , Mobile< vector<unsigned char> > (*)(const vector<unsigned char>&) >,
+		Mobile< vector<unsigned char> > (*)(const vector<unsigned char>&)
+		> PooledEchoHandler;
+
+	///The number of descriptors the process has open
+	static int openDescriptors()
+	{
+		int count = 0;
+		DIR* dir = opendir("/proc/self/fd");
+		if (dir != NULL)
+		{
+			while (readdir(dir) != NULL)
+			{
+				count++;
+			}
+			closedir(dir);
+		}
+		return count;
+	}
+
+	///True if the reader has something to read within the time
+	static bool readable(AltChanin< vector<unsigned char> > in,const Time& timeout)
+	{
+		std::list<Guard*> guards;
+		guards.push_back(in.inputGuard());
+		guards.push_back(new RelTimeoutGuard(timeout));
+		Alternative alt(guards);
+		return 0 == alt.priSelect();
+	}
+
+	///Writes a number of copies of a pattern, each in its own buffer
+	class PatternWriter : public CSProcess
+	{
+	private:
+		Chanout< Mobile< vector<unsigned char> > > out;
+		const size_t size;
+		const int times;
+	protected:
+		void run()
+		{
+			for (int i = 0;i < times;i++)
+			{
+				out << mobilePattern(size);
+			}
+		}
+	public:
+		inline PatternWriter(const Chanout< Mobile< vector<unsigned char> > >& _out,size_t _size,int _times)
+			:	out(_out),size(_size),times(_times)
+		{
+		}
+	};
+
 	static TestResult test0()
 	{
 		BEGIN_TEST()
@@ -72,57 +169,1065 @@ public:
 		vector<unsigned char> dataOut = getPattern(100);
 		vector<unsigned char> dataIn;
 		
-	
-		usign16 port = 56000;
-		
-		Mobile<TCPSocketAccepterChannel> chan;
+		usign16 port;
 		
-		chan = OpenTCPSocketAccepter(port,IPAddress_Any,8);
+		Mobile<TCPSocketAccepterChannel> chan = openAccepter(&port,8);
 		
-		while (!chan)
-		{
-			port++;
-			chan = OpenTCPSocketAccepter(port,IPAddress_Any,8);
-		}
+		ASSERTL(chan,"Could not open TCP accepter channel",__LINE__);
 		
 		{
 			ScopedForking forking;
 			
-			forking.fork(new ConnectionHandler< 				
-				TCPSocketChannel ,
-				FunctionProcess< vector<unsigned char> >,
-				vector<unsigned char> (*)(const vector<unsigned char>&)
-				> (chan->reader(),&reverseVector)
-			);
+			forking.fork(new EchoHandler(chan->reader(),&echoVector));
 			
 			Mobile<TCPSocketChannel> clientChan = ConnectTCPSocket(TCPUDPAddress(IPAddress_Localhost,port),5);
 			
 			ASSERTL(clientChan,"Could not connect to TCP accepter channel",__LINE__);
 			
-			clientChan->writer() << dataOut;
-			clientChan->reader() >> dataIn;
+			//Both more than the buffers hold:
+			clientChan->writer() << Mobile< vector<unsigned char> >(new vector<unsigned char>(dataOut));
+			dataIn = readBytes(clientChan->reader(),dataOut.size());
 			
-			ASSERTL(vectorsEqual(dataOut,reverseVector(dataIn)),"Data did not arrive back as transmitted",__LINE__);
+			ASSERTL(vectorsEqual(dataOut,dataIn),"Data did not arrive back as transmitted",__LINE__);
+			
+			//Stop the handler; its echo process finishes when clientChan closes the connection:
+			chan->reader().poison();
 		}
 		
 		END_TEST("TCP network channel test");
 	}
-	*/
+
+	static TestResult test1()
+	{
+		BEGIN_TEST()
+
+		const size_t chunkSize = 4096;
+		const int chunks = 256;
+
+		usign16 port;
+		Mobile<TCPSocketAccepterChannel> chan = openAccepter(&port,chunkSize);
+
+		ASSERTL(chan,"Could not open TCP accepter channel",__LINE__);
+
+		{
+			ScopedForking forking;
+
+			forking.fork(new EchoHandler(chan->reader(),&echoVector));
+
+			Mobile<TCPSocketChannel> clientChan = ConnectTCPSocket(TCPUDPAddress(IPAddress_Localhost,port),chunkSize);
+
+			ASSERTL(clientChan,"Could not connect to TCP accepter channel",__LINE__);
+
+			vector<unsigned char> dataIn;
+			{
+				ScopedForking writing;
+
+				//Far more than the sockets hold, so both ends have to wait for the network:
+				writing.forkInThisThread(new PatternWriter(clientChan->writer(),chunkSize,chunks));
+
+				dataIn = readBytes(clientChan->reader(),chunkSize * chunks);
+			}
+
+			ASSERTL(vectorsEqual(getPattern(chunkSize * chunks),dataIn),"Data did not arrive back as transmitted",__LINE__);
+
+			chan->reader().poison();
+		}
+
+		END_TEST("TCP network channel bulk test");
+	}
+
+	static TestResult test2()
+	{
+		BEGIN_TEST()
+
+		usign16 port;
+		Mobile<TCPSocketAccepterChannel> chan = openAccepter(&port,64);
+
+		ASSERTL(chan,"Could not open TCP accepter channel",__LINE__);
+
+		Mobile<TCPSocketChannel> clientChan = ConnectTCPSocket(TCPUDPAddress(IPAddress_Localhost,port),64);
+
+		ASSERTL(clientChan,"Could not connect to TCP accepter channel",__LINE__);
+
+		Mobile<TCPSocketChannel> serverChan;
+		chan->reader() >> serverChan;
+
+		//Nothing has been sent yet:
+		{
+			std::list<Guard*> guards;
+			guards.push_back(serverChan->reader().inputGuard());
+			guards.push_back(new RelTimeoutGuard(MilliSeconds(50)));
+			Alternative alt(guards);
+
+			ASSERTEQ(1u,alt.priSelect(),"Alt did not time out",__LINE__);
+		}
+
+		clientChan->writer() << mobilePattern(5);
+
+		{
+			std::list<Guard*> guards;
+			guards.push_back(serverChan->reader().inputGuard());
+			guards.push_back(new RelTimeoutGuard(Seconds(5)));
+			Alternative alt(guards);
+
+			ASSERTEQ(0u,alt.priSelect(),"Alt did not select the socket",__LINE__);
+		}
+
+		ASSERTL(vectorsEqual(getPattern(5),readBytes(serverChan->reader(),5)),"Data did not arrive as transmitted",__LINE__);
+
+		//Closing the connection poisons the other end's reader:
+		clientChan.blank();
+
+		bool poisoned = false;
+		try
+		{
+			vector<unsigned char> data;
+			serverChan->reader() >> data;
+		}
+		catch (PoisonException&)
+		{
+			poisoned = true;
+		}
+		ASSERTL(poisoned,"Reader was not poisoned when the connection closed",__LINE__);
+
+		//There is no longer anything listening on the port:
+		chan.blank();
+		ASSERTL(!ConnectTCPSocket(TCPUDPAddress(IPAddress_Localhost,port),64),"Connected to a closed accepter",__LINE__);
+
+		END_TEST("TCP network channel close test");
+	}
+
+	static TestResult test3()
+	{
+		BEGIN_TEST()
+
+		//Large enough to be sent with zero-copy, where the kernel supports it:
+		const size_t size = 1024 * 1024;
+
+		usign16 port;
+		Mobile<TCPSocketAccepterChannel> chan = openAccepter(&port,65536);
+
+		ASSERTL(chan,"Could not open TCP accepter channel",__LINE__);
+
+		{
+			ScopedForking forking;
+
+			forking.fork(new EchoHandler(chan->reader(),&echoVector));
+
+			Mobile<TCPSocketChannel> clientChan = ConnectTCPSocket(TCPUDPAddress(IPAddress_Localhost,port),65536);
+
+			ASSERTL(clientChan,"Could not connect to TCP accepter channel",__LINE__);
+
+			//The writes are taken by ownership, so the buffers are blanked:
+			Mobile< vector<unsigned char> > first(mobilePattern(size)),second(mobilePattern(size)),empty(new vector<unsigned char>);
+			clientChan->writer() << first;
+			clientChan->writer() << empty;
+			clientChan->writer() << second;
+
+			ASSERTL(!first && !second && !empty,"Written buffers were not taken",__LINE__);
+
+			vector<unsigned char> expected = getPattern(size);
+			expected.insert(expected.end(),expected.begin(),expected.end());
+			ASSERTL(vectorsEqual(expected,readBytes(clientChan->reader(),2 * size)),"Data did not arrive back as transmitted",__LINE__);
+
+			chan->reader().poison();
+		}
+
+		END_TEST("TCP network channel large write test");
+	}
+
+	struct Sample
+	{
+		usign32 id;
+		double value;
+	};
+
+	///Echoes the values on a NetChannel until it closes
+	template <typename DATA_TYPE>
+	class NetEcho : public CSProcess
+	{
+	private:
+		Mobile<TCPSocketChannel> socket;
+	protected:
+		void run()
+		{
+			NetChannel<DATA_TYPE> chan(socket);
+			DATA_TYPE value;
+			try
+			{
+				while (true)
+				{
+					chan.reader() >> value;
+					chan.writer() << value;
+				}
+			}
+			catch (PoisonException&)
+			{
+			}
+		}
+	public:
+		inline explicit NetEcho(const Mobile<TCPSocketChannel>& _socket)
+			:	socket(_socket)
+		{
+		}
+	};
+
+	static TestResult test4()
+	{
+		BEGIN_TEST()
+
+		const usign32 count = 1000;
+
+		usign16 port;
+		//Small buffers, so that the frames are split between reads:
+		Mobile<TCPSocketAccepterChannel> chan = openAccepter(&port,7);
+
+		ASSERTL(chan,"Could not open TCP accepter channel",__LINE__);
+
+		{
+			ScopedForking forking;
+
+			NetChannel<Sample> samples(ConnectTCPSocket(TCPUDPAddress(IPAddress_Localhost,port),7));
+			{
+				Mobile<TCPSocketChannel> server;
+				chan->reader() >> server;
+				forking.fork(new NetEcho<Sample>(server));
+			}
+
+			for (usign32 i = 0;i < count;i++)
+			{
+				Sample sample = {i,i * 0.5};
+				samples.writer() << sample;
+
+				//Keep no more than the buffers hold in flight:
+				if (i >= 32)
+				{
+					samples.reader() >> sample;
+					ASSERTEQ(i - 32,sample.id,"Samples did not arrive in order",__LINE__);
+					//Bit for bit, as it was sent:
+					const double sent = (i - 32) * 0.5;
+					ASSERTL(0 == memcmp(&sent,&sample.value,sizeof(double)),"Sample did not arrive as transmitted",__LINE__);
+				}
+			}
+			for (usign32 i = count - 32;i < count;i++)
+			{
+				Sample sample;
+				samples.reader() >> sample;
+				ASSERTEQ(i,sample.id,"Samples did not arrive in order",__LINE__);
+			}
+
+			NetChannel<std::string> strings(ConnectTCPSocket(TCPUDPAddress(IPAddress_Localhost,port),4096));
+			{
+				Mobile<TCPSocketChannel> server;
+				chan->reader() >> server;
+				forking.fork(new NetEcho<std::string>(server));
+			}
+
+			const std::string big(100000,'x');
+			strings.writer() << std::string("hello");
+			strings.writer() << std::string();
+			strings.writer() << big;
+
+			std::string s;
+			strings.reader() >> s;
+			ASSERTEQ(std::string("hello"),s,"String did not arrive as transmitted",__LINE__);
+			strings.reader() >> s;
+			ASSERTEQ(std::string(),s,"Empty string did not arrive as transmitted",__LINE__);
+			strings.reader() >> s;
+			ASSERTL(big == s,"Large string did not arrive as transmitted",__LINE__);
+
+			chan->reader().poison();
+			//Destroying the NetChannels finishes the echoes
+		}
+
+		END_TEST("Typed network channel test");
+	}
+
+	static TestResult test5()
+	{
+		BEGIN_TEST()
+
+		usign16 port;
+		Mobile<TCPSocketAccepterChannel> chan = openAccepter(&port,64);
+
+		ASSERTL(chan,"Could not open TCP accepter channel",__LINE__);
+
+		Mobile<TCPSocketChannel> raw = ConnectTCPSocket(TCPUDPAddress(IPAddress_Localhost,port),64);
+		ASSERTL(raw,"Could not connect to TCP accepter channel",__LINE__);
+
+		Mobile<TCPSocketChannel> server;
+		chan->reader() >> server;
+		NetChannel<usign32> typed(server);
+
+		//Nothing has arrived yet:
+		{
+			std::list<Guard*> guards;
+			guards.push_back(typed.reader().inputGuard());
+			guards.push_back(new RelTimeoutGuard(MilliSeconds(50)));
+			Alternative alt(guards);
+
+			ASSERTEQ(1u,alt.priSelect(),"Alt did not time out",__LINE__);
+		}
+
+		//Part of a frame does not make the reader ready:
+		const unsigned char frame[] = {0,0,0,4,1,2,3,4};
+		raw->writer() << Mobile< vector<unsigned char> >(new vector<unsigned char>(frame,frame + 6));
+		{
+			std::list<Guard*> guards;
+			guards.push_back(typed.reader().inputGuard());
+			guards.push_back(new RelTimeoutGuard(MilliSeconds(50)));
+			Alternative alt(guards);
+
+			ASSERTEQ(1u,alt.priSelect(),"Alt selected a partial frame",__LINE__);
+		}
+
+		raw->writer() << Mobile< vector<unsigned char> >(new vector<unsigned char>(frame + 6,frame + 8));
+		{
+			std::list<Guard*> guards;
+			guards.push_back(typed.reader().inputGuard());
+			guards.push_back(new RelTimeoutGuard(Seconds(5)));
+			Alternative alt(guards);
+
+			ASSERTEQ(0u,alt.priSelect(),"Alt did not select the completed frame",__LINE__);
+		}
+
+		usign32 value,expected;
+		typed.reader() >> value;
+		memcpy(&expected,frame + 4,sizeof(expected));
+		ASSERTEQ(expected,value,"Value did not arrive as transmitted",__LINE__);
+
+		//A frame of the wrong size for the type poisons the reader:
+		const unsigned char bad[] = {0,0,0,2,1,2};
+		raw->writer() << Mobile< vector<unsigned char> >(new vector<unsigned char>(bad,bad + sizeof(bad)));
+
+		bool poisoned = false;
+		try
+		{
+			typed.reader() >> value;
+		}
+		catch (PoisonException&)
+		{
+			poisoned = true;
+		}
+		ASSERTL(poisoned,"Reader was not poisoned by a bad frame",__LINE__);
+
+		//A socket that has already been read from can still be made into a NetChannel, which decodes what follows:
+		raw = ConnectTCPSocket(TCPUDPAddress(IPAddress_Localhost,port),64);
+		ASSERTL(raw,"Could not connect to TCP accepter channel",__LINE__);
+		chan->reader() >> server;
+
+		raw->writer() << mobilePattern(3);
+		ASSERTL(vectorsEqual(getPattern(3),readBytes(server->reader(),3)),"Data did not arrive as transmitted",__LINE__);
+
+		raw->writer() << Mobile< vector<unsigned char> >(new vector<unsigned char>(frame,frame + sizeof(frame)));
+		NetChannel<usign32> retyped(server);
+		value = 0;
+		retyped.reader() >> value;
+		ASSERTEQ(expected,value,"Value did not arrive as transmitted",__LINE__);
+
+		END_TEST("Typed network channel alt and framing test");
+	}
+
+	///Opens a UDP channel on localhost, on the first free port from the given one
+	static Mobile<UDPSocketChannel> openUDP(usign16* port,usign16 from,usign32 maxDatagramSize = 2048)
+	{
+		Mobile<UDPSocketChannel> chan;
+		for (*port = from;!chan && *port < from + 1000;(*port)++)
+		{
+			chan = OpenUDPChannel(*port,IPAddress_Localhost,1024,maxDatagramSize);
+		}
+		(*port)--;
+		return chan;
+	}
+
+	static TestResult test6()
+	{
+		BEGIN_TEST()
+
+		usign16 portA,portB;
+		Mobile<UDPSocketChannel> a = openUDP(&portA,56000);
+		Mobile<UDPSocketChannel> b = openUDP(&portB,portA + 1,100);
+
+		ASSERTL(a && b,"Could not open UDP channels",__LINE__);
+
+		//Nothing has been sent yet:
+		{
+			std::list<Guard*> guards;
+			guards.push_back(b->reader().inputGuard());
+			guards.push_back(new RelTimeoutGuard(MilliSeconds(50)));
+			Alternative alt(guards);
+
+			ASSERTEQ(1u,alt.priSelect(),"Alt did not time out",__LINE__);
+		}
+
+		//Too long for b, so it is dropped:
+		a->writer() << UDPDatagram(TCPUDPAddress(IPAddress_Localhost,portB),getPattern(101));
+
+		//Few enough that the socket buffers hold them all:
+		const usign32 count = 100;
+		for (usign32 i = 0;i < count;i++)
+		{
+			a->writer() << UDPDatagram(TCPUDPAddress(IPAddress_Localhost,portB),getPattern(i % 100 + 1));
+		}
+
+		{
+			std::list<Guard*> guards;
+			guards.push_back(b->reader().inputGuard());
+			guards.push_back(new RelTimeoutGuard(Seconds(5)));
+			Alternative alt(guards);
+
+			ASSERTEQ(0u,alt.priSelect(),"Alt did not select the socket",__LINE__);
+		}
+
+		UDPDatagram datagram;
+		for (usign32 i = 0;i < count;i++)
+		{
+			b->reader() >> datagram;
+			ASSERTL(vectorsEqual(getPattern(i % 100 + 1),datagram.data),"Datagram did not arrive as transmitted",__LINE__);
+			ASSERTL(TCPUDPAddress(IPAddress_Localhost,portA) == datagram.address,"Datagram did not have the sender's address",__LINE__);
+		}
+
+		//Reply to the sender:
+		datagram.data = getPattern(3);
+		b->writer() << datagram;
+		a->reader() >> datagram;
+		ASSERTL(vectorsEqual(getPattern(3),datagram.data),"Reply did not arrive as transmitted",__LINE__);
+		ASSERTL(TCPUDPAddress(IPAddress_Localhost,portB) == datagram.address,"Reply did not have the sender's address",__LINE__);
+
+		END_TEST("UDP channel test");
+	}
+
+	///Reads messages from a Unix stream socket until the given number of bytes has arrived
+	static vector<unsigned char> readUnixBytes(AltChanin<UnixMessage> in,size_t size)
+	{
+		vector<unsigned char> ret;
+		UnixMessage message;
+		while (ret.size() < size)
+		{
+			in >> message;
+			ret.insert(ret.end(),message.data.begin(),message.data.end());
+		}
+		return ret;
+	}
+
+	static TestResult test7()
+	{
+		BEGIN_TEST()
+
+		const string path = "/tmp/cppcsp-unix-test-" + lexical_cast<string>(getpid());
+		{
+			Mobile<UnixSocketAccepterChannel> accepter = OpenUnixSocketAccepter(path,UnixStream,4096);
+			ASSERTL(accepter,"Could not open Unix accepter channel",__LINE__);
+			ASSERTL(!OpenUnixSocketAccepter(path,UnixStream,4096),"Opened a second accepter on the same path",__LINE__);
+
+			Mobile<UnixSocketChannel> client = ConnectUnixSocket(path,UnixStream,4096);
+			ASSERTL(client,"Could not connect to Unix accepter channel",__LINE__);
+			Mobile<UnixSocketChannel> server;
+			accepter->reader() >> server;
+
+			//Data arrives as a stream, in pieces no bigger than bufSize:
+			UnixMessage message;
+			message.data = getPattern(100000);
+			client->writer() << message;
+			ASSERTL(vectorsEqual(getPattern(100000),readUnixBytes(server->reader(),100000)),"Data did not arrive as transmitted",__LINE__);
+
+			//Pass the write end of a pipe from the server to the client:
+			int pipeFds[2];
+			ASSERTEQ(0,pipe(pipeFds),"Could not create pipe",__LINE__);
+			message.data = getPattern(1);
+			message.fds.push_back(Mobile<FileDescriptor>(new FileDescriptor(pipeFds[1])));
+			server->writer() << message;
+			ASSERTL(!message.fds.front(),"Writing the message did not move its descriptor",__LINE__);
+
+			client->reader() >> message;
+			ASSERTL(vectorsEqual(getPattern(1),message.data),"Data with descriptor did not arrive as transmitted",__LINE__);
+			ASSERTEQ((size_t)1,message.fds.size(),"Descriptor did not arrive",__LINE__);
+			ASSERTL(message.fds.front(),"Descriptor did not arrive",__LINE__);
+
+			//Writing to the received descriptor reaches the pipe:
+			char byte = 'x';
+			ASSERTEQ(1,(int)write(message.fds.front()->get(),&byte,1),"Could not write to passed descriptor",__LINE__);
+			byte = 0;
+			ASSERTEQ(1,(int)read(pipeFds[0],&byte,1),"Could not read from pipe",__LINE__);
+			ASSERTEQ('x',byte,"Pipe did not carry the byte written to the passed descriptor",__LINE__);
+
+			//The sender closed its copy once it was sent, so closing the received one leaves no writers:
+			message.fds.clear();
+			ASSERTEQ(0,(int)read(pipeFds[0],&byte,1),"Pipe still had a writer",__LINE__);
+			close(pipeFds[0]);
+
+			//Closing the client closes the server's reader:
+			client.blank();
+			bool poisoned = false;
+			try
+			{
+				server->reader() >> message;
+			}
+			catch (PoisonException&)
+			{
+				poisoned = true;
+			}
+			ASSERTL(poisoned,"Server's reader was not poisoned when the client closed",__LINE__);
+		}
+
+		ASSERTL(0 != access(path.c_str(),F_OK),"Accepter did not remove its path",__LINE__);
+
+		END_TEST("Unix stream channel test");
+	}
+
+	static TestResult test8()
+	{
+		BEGIN_TEST()
+
+		//In the abstract namespace:
+		const string path = string(1,'\0') + "cppcsp-seqpacket-test-" + lexical_cast<string>(getpid());
+		Mobile<UnixSocketAccepterChannel> accepter = OpenUnixSocketAccepter(path,UnixSeqPacket,100);
+		ASSERTL(accepter,"Could not open Unix accepter channel",__LINE__);
+
+		Mobile<UnixSocketChannel> client = ConnectUnixSocket(path,UnixSeqPacket,1000);
+		ASSERTL(client,"Could not connect to Unix accepter channel",__LINE__);
+		ASSERTL(!ConnectUnixSocket(path,UnixStream,1000),"Connected a stream socket to a seqpacket accepter",__LINE__);
+		Mobile<UnixSocketChannel> server;
+		accepter->reader() >> server;
+
+		//Nothing has been sent yet:
+		{
+			std::list<Guard*> guards;
+			guards.push_back(server->reader().inputGuard());
+			guards.push_back(new RelTimeoutGuard(MilliSeconds(50)));
+			Alternative alt(guards);
+
+			ASSERTEQ(1u,alt.priSelect(),"Alt did not time out",__LINE__);
+		}
+
+		UnixMessage message;
+
+		//Too long for the server, so it is dropped:
+		message.data = getPattern(101);
+		client->writer() << message;
+
+		const usign32 count = 100;
+		for (usign32 i = 0;i < count;i++)
+		{
+			message.data = getPattern(i + 1);
+			client->writer() << message;
+		}
+
+		//Each message arrives whole:
+		for (usign32 i = 0;i < count;i++)
+		{
+			server->reader() >> message;
+			ASSERTL(vectorsEqual(getPattern(i + 1),message.data),"Message did not arrive as transmitted",__LINE__);
+		}
+
+		//A packet may carry only descriptors, which are received close-on-exec:
+		message.data.clear();
+		message.fds.push_back(Mobile<FileDescriptor>(new FileDescriptor(open("/dev/null",O_RDONLY))));
+		message.fds.push_back(Mobile<FileDescriptor>(new FileDescriptor(open("/dev/null",O_RDONLY))));
+		client->writer() << message;
+		server->reader() >> message;
+		ASSERTL(message.data.empty(),"Message with only descriptors had data",__LINE__);
+		ASSERTEQ((size_t)2,message.fds.size(),"Descriptors did not arrive",__LINE__);
+		for (std::list< Mobile<FileDescriptor> >::iterator it = message.fds.begin();it != message.fds.end();it++)
+		{
+			ASSERTL(0 != (fcntl((*it)->get(),F_GETFD) & FD_CLOEXEC),"Received descriptor was not close-on-exec",__LINE__);
+		}
+
+		message.fds.clear();
+		message.data = getPattern(1000);
+		server->writer() << message;
+		client->reader() >> message;
+		ASSERTL(vectorsEqual(getPattern(1000),message.data),"Reply did not arrive whole",__LINE__);
+
+		END_TEST("Unix seqpacket channel test");
+	}
+
+	static TestResult test9()
+	{
+		BEGIN_TEST()
+
+		usign16 port;
+		Mobile<TCPSocketAccepterChannel> chan = openAccepter(&port,64);
+
+		ASSERTL(chan,"Could not open TCP accepter channel",__LINE__);
+
+		{
+			ScopedForking forking;
+
+			forking.fork(new EchoHandler(chan->reader(),&echoVector,false));
+
+			const int before = openDescriptors();
+			for (int i = 0;i < 20;i++)
+			{
+				Mobile<TCPSocketChannel> clientChan = ConnectTCPSocket(TCPUDPAddress(IPAddress_Localhost,port),64);
+				ASSERTL(clientChan,"Could not connect to TCP accepter channel",__LINE__);
+
+				clientChan->writer() << mobilePattern(10);
+				ASSERTL(vectorsEqual(getPattern(10),readBytes(clientChan->reader(),10)),"Data did not arrive back as transmitted",__LINE__);
+			}
+
+			//The handler closes each connection once its process has seen the client close it:
+			for (int i = 0;i < 500 && openDescriptors() > before;i++)
+			{
+				SleepFor(MilliSeconds(10));
+			}
+			ASSERTL(openDescriptors() <= before,"Handler did not close finished connections",__LINE__);
+
+			chan->reader().poison();
+		}
+
+		END_TEST("TCP connection handler release test");
+	}
+
+	static TestResult test10()
+	{
+		BEGIN_TEST()
+
+		usign16 port;
+		Mobile<TCPSocketAccepterChannel> chan = openAccepter(&port,64);
+
+		ASSERTL(chan,"Could not open TCP accepter channel",__LINE__);
+
+		{
+			ScopedForking forking;
+
+			//Two workers, one in each of two threads:
+			forking.fork(new PooledEchoHandler(chan->reader(),&echoVector,2,2));
+
+			Mobile<TCPSocketChannel> clients[3];
+			for (int i = 0;i < 3;i++)
+			{
+				clients[i] = ConnectTCPSocket(TCPUDPAddress(IPAddress_Localhost,port),64);
+				ASSERTL(clients[i],"Could not connect to TCP accepter channel",__LINE__);
+
+				clients[i]->writer() << mobilePattern(10 + i);
+				if (i < 2)
+				{
+					ASSERTL(vectorsEqual(getPattern(10 + i),readBytes(clients[i]->reader(),10 + i)),"Data did not arrive back as transmitted",__LINE__);
+				}
+			}
+
+			//Both workers are busy, so the third connection waits:
+			ASSERTL(!readable(clients[2]->reader(),MilliSeconds(100)),"Third connection was served while both workers were busy",__LINE__);
+
+			//Until the first is closed, freeing its worker:
+			clients[0].blank();
+			ASSERTL(readable(clients[2]->reader(),Seconds(5)),"Third connection was not served once a worker was free",__LINE__);
+			ASSERTL(vectorsEqual(getPattern(12),readBytes(clients[2]->reader(),12)),"Data did not arrive back as transmitted",__LINE__);
+
+			//The workers stop once their connections close:
+			chan->reader().poison();
+			clients[1].blank();
+			clients[2].blank();
+		}
+
+		END_TEST("TCP pooled connection handler test");
+	}
+
+	///Echoes the data on one connection until it closes
+	class Echo : public CSProcess
+	{
+	private:
+		Mobile<TCPSocketChannel> chan;
+	protected:
+		void run()
+		{
+			vector<unsigned char> data;
+			try
+			{
+				while (true)
+				{
+					chan->reader() >> data;
+					Mobile< vector<unsigned char> > reply(new vector<unsigned char>);
+					reply->swap(data);
+					chan->writer() << reply;
+				}
+			}
+			catch (PoisonException&)
+			{
+			}
+		}
+	public:
+		inline explicit Echo(const Mobile<TCPSocketChannel>& _chan)
+			:	CSProcess(65536),chan(_chan)
+		{
+		}
+	};
+
+	///Forks an Echo for every connection, until its channel is poisoned
+	class EchoServer : public CSProcess
+	{
+	private:
+		Chanin< Mobile<TCPSocketChannel> > in;
+	protected:
+		void run()
+		{
+			ScopedForking forking;
+			try
+			{
+				while (true)
+				{
+					Mobile<TCPSocketChannel> chan;
+					in >> chan;
+					forking.forkInThisThread(new Echo(chan));
+				}
+			}
+			catch (PoisonException&)
+			{
+			}
+		}
+	public:
+		inline explicit EchoServer(const Chanin< Mobile<TCPSocketChannel> >& _in)
+			:	in(_in)
+		{
+		}
+	};
+
+	static TestResult netPerfTest0()
+	{
+		const size_t messageSize = 64;
+		const int rounds = 10;
+
+		//Each connection takes a descriptor at both ends:
+		rlimit limit;
+		getrlimit(RLIMIT_NOFILE,&limit);
+		limit.rlim_cur = limit.rlim_max;
+		setrlimit(RLIMIT_NOFILE,&limit);
+		getrlimit(RLIMIT_NOFILE,&limit);
+		const unsigned connections = static_cast<unsigned>(std::min<rlim_t>(10000,(limit.rlim_cur - 64) / 2));
+
+		double microsPerConnect = 0,microsPerMessage = 0;
+
+		BEGIN_TEST()
+
+		usign16 port;
+		Mobile<TCPSocketAccepterChannel> chan = openAccepter(&port,4096);
+
+		ASSERTL(chan,"Could not open TCP accepter channel",__LINE__);
+
+		{
+			ScopedForking forking;
+
+			forking.fork(new EchoServer(chan->reader()));
+
+			std::list< Mobile<TCPSocketChannel> > clients;
+			const vector<unsigned char> message = getPattern(messageSize);
+			Time start,finish;
+
+			//Each connection is used once before the next is made, so this is the rate at which they are accepted and served:
+			CurrentTime(&start);
+			for (unsigned i = 0;i < connections;i++)
+			{
+				clients.push_back(ConnectTCPSocket(TCPUDPAddress(IPAddress_Localhost,port),4096));
+				ASSERTL(clients.back(),"Could not connect to TCP accepter channel",__LINE__);
+				clients.back()->writer() << mobilePattern(1);
+				readBytes(clients.back()->reader(),1);
+			}
+			CurrentTime(&finish);
+			finish -= start;
+			microsPerConnect = (GetSeconds(&finish) / static_cast<double>(connections)) * 1000000.0;
+
+			//All the connections have a message in flight at once:
+			CurrentTime(&start);
+			for (int r = 0;r < rounds;r++)
+			{
+				for (std::list< Mobile<TCPSocketChannel> >::iterator it = clients.begin();it != clients.end();it++)
+				{
+					(*it)->writer() << Mobile< vector<unsigned char> >(new vector<unsigned char>(message));
+				}
+				for (std::list< Mobile<TCPSocketChannel> >::iterator it = clients.begin();it != clients.end();it++)
+				{
+					readBytes((*it)->reader(),messageSize);
+				}
+			}
+			CurrentTime(&finish);
+			finish -= start;
+			microsPerMessage = (GetSeconds(&finish) / static_cast<double>(connections * rounds)) * 1000000.0;
+
+			//Closing the connections finishes the echoes:
+			clients.clear();
+			chan->reader().poison();
+		}
+
+		END_TEST("TCP loopback echo, " + lexical_cast<string>(connections) + " connections: " + lexical_cast<string>(microsPerConnect)
+			+ " microseconds per connection, " + lexical_cast<string>(microsPerMessage) + " microseconds per " + lexical_cast<string>(messageSize) + "-byte message");
+	}
+	
+	///Reads the given number of bytes from a connection, then replies with one byte
+	class Sink : public CSProcess
+	{
+	private:
+		Mobile<TCPSocketChannel> chan;
+		const size_t total;
+	protected:
+		void run()
+		{
+			vector<unsigned char> data;
+			for (size_t received = 0;received < total;received += data.size())
+			{
+				chan->reader() >> data;
+			}
+			chan->writer() << mobilePattern(1);
+		}
+	public:
+		inline Sink(const Mobile<TCPSocketChannel>& _chan,size_t _total)
+			:	chan(_chan),total(_total)
+		{
+		}
+	};
+
+	static TestResult netPerfTest1()
+	{
+		const size_t totalBytes = 32 * 1024 * 1024;
+		const size_t sizes[] = {64,1024,65536,1024 * 1024};
+		string results;
+
+		BEGIN_TEST()
+
+		usign16 port;
+		Mobile<TCPSocketAccepterChannel> chan = openAccepter(&port,65536);
+
+		ASSERTL(chan,"Could not open TCP accepter channel",__LINE__);
+
+		for (unsigned s = 0;s < sizeof(sizes) / sizeof(sizes[0]);s++)
+		{
+			const size_t count = totalBytes / sizes[s];
+
+			//The buffers are made beforehand, so that only the sending is timed:
+			std::list< Mobile< vector<unsigned char> > > messages;
+			for (size_t i = 0;i < count;i++)
+			{
+				messages.push_back(mobilePattern(sizes[s]));
+			}
+
+			Mobile<TCPSocketChannel> clientChan = ConnectTCPSocket(TCPUDPAddress(IPAddress_Localhost,port),65536);
+			ASSERTL(clientChan,"Could not connect to TCP accepter channel",__LINE__);
+			Mobile<TCPSocketChannel> serverChan;
+			chan->reader() >> serverChan;
+
+			Time start,finish;
+			{
+				ScopedForking forking;
+				forking.forkInThisThread(new Sink(serverChan,count * sizes[s]));
+
+				CurrentTime(&start);
+				for (std::list< Mobile< vector<unsigned char> > >::iterator it = messages.begin();it != messages.end();it++)
+				{
+					clientChan->writer() << *it;
+				}
+				readBytes(clientChan->reader(),1);
+				CurrentTime(&finish);
+			}
+			finish -= start;
+
+			const double megabytesPerSecond = (static_cast<double>(count * sizes[s]) / (1024.0 * 1024.0)) / GetSeconds(&finish);
+			results += ", " + lexical_cast<string>(sizes[s]) + " bytes: " + lexical_cast<string>(megabytesPerSecond) + " MB/s";
+		}
+
+		END_TEST("TCP loopback throughput" + results);
+	}
+
+	static TestResult netPerfTest2()
+	{
+		const int count = 1000000;
+		double microsPerValue = 0;
+
+		BEGIN_TEST()
+
+		usign16 port;
+		Mobile<TCPSocketAccepterChannel> chan = openAccepter(&port,65536);
+
+		ASSERTL(chan,"Could not open TCP accepter channel",__LINE__);
+
+		NetChannel<Sample> client(ConnectTCPSocket(TCPUDPAddress(IPAddress_Localhost,port),65536),1024);
+		Mobile<TCPSocketChannel> socket;
+		chan->reader() >> socket;
+		NetChannel<Sample> server(socket,1024);
+
+		Time start,finish;
+		CurrentTime(&start);
+		{
+			ScopedForking forking;
+			Sample sample = {1,1.0};
+			forking.forkInThisThread(new WriterProcess<Sample>(client.writer(),sample,count));
+
+			for (int i = 0;i < count;i++)
+			{
+				server.reader() >> sample;
+			}
+		}
+		CurrentTime(&finish);
+		finish -= start;
+		microsPerValue = (GetSeconds(&finish) / static_cast<double>(count)) * 1000000.0;
+
+		END_TEST("Typed network channel over TCP loopback: " + lexical_cast<string>(microsPerValue) + " microseconds per "
+			+ lexical_cast<string>(sizeof(Sample)) + "-byte value");
+	}
+
+	static TestResult netPerfTest3()
+	{
+		const int bursts = 2000;
+		//Few enough that the socket buffer holds them all, so that none should be lost:
+		const int burstSize = 128;
+		const size_t size = 64;
+		int received = 0;
+		double datagramsPerSecond = 0;
+
+		BEGIN_TEST()
+
+		usign16 portA,portB;
+		Mobile<UDPSocketChannel> a = openUDP(&portA,56000);
+		Mobile<UDPSocketChannel> b = openUDP(&portB,portA + 1);
+
+		ASSERTL(a && b,"Could not open UDP channels",__LINE__);
+
+		const UDPDatagram datagram(TCPUDPAddress(IPAddress_Localhost,portB),getPattern(size));
+		UDPDatagram in;
+		std::list<Guard*> guards;
+		guards.push_back(b->reader().inputGuard());
+		guards.push_back(new RelTimeoutGuard(MilliSeconds(200)));
+		Alternative alt(guards);
+
+		Time start,finish;
+		CurrentTime(&start);
+		for (int i = 0;i < bursts;i++)
+		{
+			for (int j = 0;j < burstSize;j++)
+			{
+				a->writer() << datagram;
+			}
+
+			//Any that were lost time out:
+			for (int j = 0;j < burstSize && 0 == alt.priSelect();j++)
+			{
+				b->reader() >> in;
+				received++;
+			}
+		}
+		CurrentTime(&finish);
+		finish -= start;
+		datagramsPerSecond = static_cast<double>(received) / GetSeconds(&finish);
+
+		END_TEST("UDP loopback, " + lexical_cast<string>(size) + "-byte datagrams in bursts of " + lexical_cast<string>(burstSize) + ": "
+			+ lexical_cast<string>(datagramsPerSecond) + " per second (" + lexical_cast<string>(bursts * burstSize - received) + " lost)");
+	}
+
+	///Echoes the messages on one Unix socket until it closes
+	class UnixEcho : public CSProcess
+	{
+	private:
+		Mobile<UnixSocketChannel> chan;
+	protected:
+		void run()
+		{
+			UnixMessage message;
+			try
+			{
+				while (true)
+				{
+					chan->reader() >> message;
+					chan->writer() << message;
+				}
+			}
+			catch (PoisonException&)
+			{
+			}
+		}
+	public:
+		inline explicit UnixEcho(const Mobile<UnixSocketChannel>& _chan)
+			:	CSProcess(65536),chan(_chan)
+		{
+		}
+	};
+
+	static TestResult netPerfTest4()
+	{
+		const int rounds = 20000;
+		const size_t messageSize = 64;
+		double unixMicros = 0,tcpMicros = 0;
+
+		BEGIN_TEST()
+
+		const string path = string(1,'\0') + "cppcsp-unix-perf-" + lexical_cast<string>(getpid());
+		Mobile<UnixSocketAccepterChannel> unixAccepter = OpenUnixSocketAccepter(path,UnixStream,4096);
+		usign16 port;
+		Mobile<TCPSocketAccepterChannel> tcpAccepter = openAccepter(&port,4096);
+
+		ASSERTL(unixAccepter && tcpAccepter,"Could not open accepter channels",__LINE__);
+
+		Time start,finish;
+
+		{
+			ScopedForking forking;
+			Mobile<UnixSocketChannel> client = ConnectUnixSocket(path,UnixStream,4096);
+			Mobile<UnixSocketChannel> server;
+			unixAccepter->reader() >> server;
+			forking.fork(new UnixEcho(server));
+
+			UnixMessage message;
+			CurrentTime(&start);
+			for (int i = 0;i < rounds;i++)
+			{
+				message.data = getPattern(messageSize);
+				client->writer() << message;
+				readUnixBytes(client->reader(),messageSize);
+			}
+			CurrentTime(&finish);
+			finish -= start;
+			unixMicros = (GetSeconds(&finish) / static_cast<double>(rounds)) * 1000000.0;
+		}
+
+		{
+			ScopedForking forking;
+			Mobile<TCPSocketChannel> client = ConnectTCPSocket(TCPUDPAddress(IPAddress_Localhost,port),4096);
+			Mobile<TCPSocketChannel> server;
+			tcpAccepter->reader() >> server;
+			forking.fork(new Echo(server));
+
+			CurrentTime(&start);
+			for (int i = 0;i < rounds;i++)
+			{
+				client->writer() << mobilePattern(messageSize);
+				readBytes(client->reader(),messageSize);
+			}
+			CurrentTime(&finish);
+			finish -= start;
+			tcpMicros = (GetSeconds(&finish) / static_cast<double>(rounds)) * 1000000.0;
+		}
+
+		END_TEST("Round trip of a " + lexical_cast<string>(messageSize) + "-byte message: " + lexical_cast<string>(unixMicros)
+			+ " microseconds over a Unix stream socket, " + lexical_cast<string>(tcpMicros) + " microseconds over TCP loopback");
+	}
 	
 	std::list<TestResult (*)()> tests()
 	{		
-		return std::list<TestResult (*)()>();
-		/*
 		return list_of<TestResult (*) ()>
-			(test0)
+			(test0) (test1) (test2) (test3) (test4) (test5) (test6) (test7) (test8) (test9) (test10)
 		;
-		*/
 	}
 	
 	std::list<TestResult (*)()> perfTests()
 	{		
+		return list_of<TestResult (*) ()>
+			(netPerfTest0) (netPerfTest1) (netPerfTest2) (netPerfTest3) (netPerfTest4)
+		;
+	}
+
+#else
+
+	//The socket channels are only available on Linux:
+
+	std::list<TestResult (*)()> tests()
+	{
+		return std::list<TestResult (*)()>();
+	}
+
+	std::list<TestResult (*)()> perfTests()
+	{
 		return std::list<TestResult (*)()>();
-	}	
+	}
+
+#endif //CPPCSP_LINUX
 };
 
 Test* GetNetChannelTest()
@@ -0,0 +1,488 @@
+/*
+*	The Kent C++CSP Library
+*	Copyright (C) 2002-2007 Neil Brown
+*
+*	This library is free software; you can redistribute it and/or
+*	modify it under the terms of the GNU Lesser General Public
+*	License as published by the Free Software Foundation; either
+*	version 2.1 of the License, or (at your option) any later version.
+*
+*	This library is distributed in the hope that it will be useful,
+*	but WITHOUT ANY WARRANTY; without even the implied warranty of
+*	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+*	Lesser General Public License for more details.
+*
+*	You should have received a copy of the GNU Lesser General Public
+*	License along with this library; if not, write to the Free Software
+*	Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#include "test.h"
+#include <boost/assign/list_of.hpp>
+
+#include "../src/cppcsp.h"
+
+#include "../src/common/basic.h"
+
+#ifdef CPPCSP_LINUX
+	#include <sys/types.h>
+	#include <sys/wait.h>
+	#include <unistd.h>
+	#include <string.h>
+#endif
+
+using namespace csp;
+using namespace csp::internal;
+using namespace csp::common;
+using namespace boost::assign;
+using namespace boost;
+
+#include <list>
+
+using namespace std;
+
+class ShmChannelTest : public Test, public virtual internal::TestInfo
+{
+public:
+#ifdef CPPCSP_LINUX
+
+	class ScopedShmName
+	{
+	public:
+		const string name;
+
+		inline explicit ScopedShmName(const char* what)
+			:	name(string("/cppcsp2-test-") + what + "-" + lexical_cast<string>(getpid()))
+		{
+			SharedMemoryChannel<int>::Unlink(name);
+		}
+
+		inline ~ScopedShmName()
+		{
+			SharedMemoryChannel<int>::Unlink(name);
+		}
+	};
+
+	static TestResult testBuffered()
+	{
+		BEGIN_TEST()
+
+		ScopedShmName shm("buffered");
+
+		//Two separate mappings of the same channel, as if they were in two OS processes:
+		SharedMemoryChannel<int> a(shm.name,3);
+		SharedMemoryChannel<int> b(shm.name,3);
+
+		ASSERTL(a.ring.header != b.ring.header,"Channel mapped at the same address twice",__LINE__);
+		ASSERTEQ(3u,b.ring.header->capacity,"Channel capacity not as expected",__LINE__);
+
+		ASSERTEQ(false,b.reader().pending(),"Channel pending when empty",__LINE__);
+
+		//We can fill the buffer without blocking:
+		a.writer() << 1;
+		a.writer() << 2;
+		a.writer() << 3;
+
+		ASSERTEQ(3u,b.ring.header->head,"Channel head not as expected",__LINE__);
+		ASSERTEQ(0u,b.ring.header->headSlot,"Channel head slot not as expected",__LINE__);
+		ASSERTEQ(true,b.reader().pending(),"Channel not pending",__LINE__);
+
+		int n = 0;
+		b.reader() >> n;
+		ASSERTEQ(1,n,"Channel did not deliver the right value",__LINE__);
+
+		//Go round the ring:
+		a.writer() << 4;
+
+		b.reader() >> n;
+		ASSERTEQ(2,n,"Channel did not deliver the right value",__LINE__);
+		b.reader() >> n;
+		ASSERTEQ(3,n,"Channel did not deliver the right value",__LINE__);
+		b.reader() >> n;
+		ASSERTEQ(4,n,"Channel did not deliver the right value",__LINE__);
+
+		ASSERTEQ(4u,a.ring.header->tail,"Channel tail not as expected",__LINE__);
+		ASSERTEQ(1u,a.ring.header->tailSlot,"Channel tail slot not as expected",__LINE__);
+		ASSERTEQ(false,b.reader().pending(),"Channel pending when empty",__LINE__);
+
+		//Neither side had to wait, so no watcher threads were started:
+		ASSERTEQ(false,a.ring.writerWatcher.started,"Writer's watcher started",__LINE__);
+		ASSERTEQ(false,b.ring.readerWatcher.started,"Reader's watcher started",__LINE__);
+
+		END_TEST("SharedMemoryChannel Buffered Test");
+	}
+
+	static TestResult testUnbuffered()
+	{
+		BEGIN_TEST()
+
+		ScopedShmName shm("unbuffered");
+
+		SharedMemoryChannel<int> a(shm.name);
+		SharedMemoryChannel<int> b(shm.name);
+
+		{
+			ScopedForking forking;
+
+			forking.fork(new WriterProcess<int>(a.writer(),7,100));
+
+			int n;
+			for (int i = 0;i < 100;i++)
+			{
+				n = 0;
+				b.reader() >> n;
+				ASSERTEQ(7,n,"Channel did not deliver the right value",__LINE__);
+			}
+		}
+
+		ASSERTEQ(100u,b.ring.header->tail,"Channel tail not as expected",__LINE__);
+		ASSERTEQ(100u,b.ring.header->head,"Channel head not as expected",__LINE__);
+		ASSERTL(a.ring.writerWatcher.waitingProcess == NullProcessPtr,"Writer's watcher still has a waiting process",__LINE__);
+		ASSERTL(b.ring.readerWatcher.waitingProcess == NullProcessPtr,"Reader's watcher still has a waiting process",__LINE__);
+
+		END_TEST("SharedMemoryChannel Unbuffered Test");
+	}
+
+	static TestResult testExt()
+	{
+		BEGIN_TEST()
+
+		ScopedShmName shm("ext");
+
+		SharedMemoryChannel<int> a(shm.name);
+		SharedMemoryChannel<int> b(shm.name);
+
+		{
+			ScopedForking forking;
+
+			forking.fork(new WriterProcess<int>(a.writer(),9));
+
+			int n = 0;
+			{
+				ScopedExtInput<int> extInput(b.reader(),&n);
+
+				ASSERTEQ(9,n,"Channel did not deliver the right value",__LINE__);
+				//The writer cannot finish until we do:
+				ASSERTEQ(0u,b.ring.header->tail,"Item taken during extended input",__LINE__);
+			}
+
+			ASSERTEQ(1u,b.ring.header->tail,"Item not taken after extended input",__LINE__);
+		}
+
+		END_TEST("SharedMemoryChannel Extended Input Test");
+	}
+
+	static TestResult testPoison()
+	{
+		BEGIN_TEST()
+
+		{
+			ScopedShmName shm("poison0");
+
+			SharedMemoryChannel<int> a(shm.name,4);
+			SharedMemoryChannel<int> b(shm.name,4);
+
+			a.writer() << 1;
+			a.writer() << 2;
+			a.writer().poison();
+
+			bool threw = false;
+			try
+			{
+				a.writer() << 3;
+			}
+			catch (PoisonException&)
+			{
+				threw = true;
+			}
+			ASSERTEQ(true,threw,"Writer did not see poison",__LINE__);
+
+			//The reader sees the buffered items before the poison:
+			int n = 0;
+			b.reader() >> n;
+			ASSERTEQ(1,n,"Channel did not deliver the right value",__LINE__);
+			b.reader() >> n;
+			ASSERTEQ(2,n,"Channel did not deliver the right value",__LINE__);
+
+			threw = false;
+			try
+			{
+				b.reader() >> n;
+			}
+			catch (PoisonException&)
+			{
+				threw = true;
+			}
+			ASSERTEQ(true,threw,"Reader did not see poison",__LINE__);
+		}
+
+		{
+			ScopedShmName shm("poison1");
+
+			SharedMemoryChannel<int> a(shm.name);
+			SharedMemoryChannel<int> b(shm.name);
+
+			One2OneChannel<bool> resultChan;
+
+			class PoisonCatcher : public CSProcess
+			{
+			private:
+				Chanout<int> out;
+				Chanout<bool> result;
+			protected:
+				void run()
+				{
+					bool threw = false;
+					try
+					{
+						out << 5;
+					}
+					catch (PoisonException&)
+					{
+						threw = true;
+					}
+					result << threw;
+				}
+			public:
+				PoisonCatcher(const Chanout<int>& _out,const Chanout<bool>& _result)
+					:	out(_out),result(_result)
+				{
+				}
+			};
+
+			ScopedForking forking;
+
+			//The writer waits in another thread until the reader poisons the channel:
+			forking.fork(new PoisonCatcher(a.writer(),resultChan.writer()));
+
+			while (false == b.reader().pending())
+			{
+				CPPCSP_Yield();
+			}
+			b.reader().poison();
+
+			bool threw = false;
+			resultChan.reader() >> threw;
+			ASSERTEQ(true,threw,"Writer did not see poison",__LINE__);
+		}
+
+		END_TEST("SharedMemoryChannel Poison Test");
+	}
+
+	static TestResult testAlt()
+	{
+		BEGIN_TEST()
+
+		ScopedShmName shm("alt");
+
+		SharedMemoryChannel<int> a(shm.name);
+		SharedMemoryChannel<int> b(shm.name);
+		One2OneChannel<int> other;
+
+		{
+			ScopedForking forking;
+
+			std::list<Guard*> guards;
+			guards.push_back(other.reader().inputGuard());
+			guards.push_back(b.reader().inputGuard());
+			Alternative alt(guards);
+
+			forking.fork(new WriterProcess<int>(a.writer(),11));
+
+			ASSERTEQ(1u,alt.priSelect(),"Alt did not select the shared memory channel",__LINE__);
+			ASSERTL(b.ring.readerWatcher.waitingProcess == NullProcessPtr,"Reader's watcher still has a waiting process",__LINE__);
+
+			int n = 0;
+			b.reader() >> n;
+			ASSERTEQ(11,n,"Channel did not deliver the right value",__LINE__);
+
+			ASSERTEQ(false,b.reader().pending(),"Channel pending when empty",__LINE__);
+		}
+
+		END_TEST("SharedMemoryChannel Alt Test");
+	}
+
+	static TestResult testMismatch()
+	{
+		BEGIN_TEST()
+
+		ScopedShmName shm("mismatch");
+
+		SharedMemoryChannel<int> a(shm.name,4);
+
+		bool threw = false;
+		try
+		{
+			SharedMemoryChannel<int> b(shm.name,8);
+		}
+		catch (CPPCSPError&)
+		{
+			threw = true;
+		}
+		ASSERTEQ(true,threw,"Opening with a different buffer size did not fail",__LINE__);
+
+		threw = false;
+		try
+		{
+			SharedMemoryChannel<double> b(shm.name,4);
+		}
+		catch (CPPCSPError&)
+		{
+			threw = true;
+		}
+		ASSERTEQ(true,threw,"Opening with a different element size did not fail",__LINE__);
+
+		END_TEST("SharedMemoryChannel Mismatch Test");
+	}
+
+	struct Sample
+	{
+		int id;
+		double value;
+	};
+
+	static TestResult testOSProcess()
+	{
+		BEGIN_TEST()
+
+		ScopedShmName shm("process");
+
+		SharedMemoryChannel<Sample> c(shm.name,16);
+
+		pid_t child = fork();
+		ASSERTL(child != -1,"Could not fork",__LINE__);
+
+		if (child == 0)
+		{
+			//The child only ever writes into free buffer space, so it never needs the C++CSP2 run-time:
+			int status = 0;
+			try
+			{
+				SharedMemoryChannel<Sample> out(shm.name,16);
+				for (int i = 0;i < 10;i++)
+				{
+					Sample s;
+					s.id = i;
+					s.value = i * 0.5;
+					out.writer() << s;
+				}
+				out.writer().poison();
+			}
+			catch (...)
+			{
+				status = 1;
+			}
+			_exit(status);
+		}
+
+		Sample s;
+		for (int i = 0;i < 10;i++)
+		{
+			c.reader() >> s;
+			ASSERTEQ(i,s.id,"Channel did not deliver the right value",__LINE__);
+			const double sent = i * 0.5;
+			ASSERTL(0 == memcmp(&sent,&s.value,sizeof(double)),"Channel did not deliver the right value",__LINE__);
+		}
+
+		bool threw = false;
+		try
+		{
+			c.reader() >> s;
+		}
+		catch (PoisonException&)
+		{
+			threw = true;
+		}
+		ASSERTEQ(true,threw,"Reader did not see poison from the other OS process",__LINE__);
+
+		int status = -1;
+		waitpid(child,&status,0);
+		ASSERTL(WIFEXITED(status) && WEXITSTATUS(status) == 0,"Child OS process failed",__LINE__);
+
+		END_TEST("SharedMemoryChannel OS Process Test");
+	}
+
+	static TestResult _shmPerfTest(usign32 bufferSize)
+	{
+		const int iterations = 200000;
+		double microsPerComm = 0;
+
+		BEGIN_TEST()
+
+		ScopedShmName shm("perf");
+
+		SharedMemoryChannel<int> a(shm.name,bufferSize);
+		SharedMemoryChannel<int> b(shm.name,bufferSize);
+
+		{
+			ScopedForking forking;
+
+			forking.fork(new WriterProcess<int>(a.writer(),1,iterations));
+
+			Time start,finish;
+			CurrentTime(&start);
+
+			int n;
+			for (int i = 0;i < iterations;i++)
+			{
+				b.reader() >> n;
+			}
+
+			CurrentTime(&finish);
+			finish -= start;
+
+			microsPerComm = (GetSeconds(&finish) / static_cast<double>(iterations)) * 1000000.0;
+		}
+
+		END_TEST("SharedMemoryChannel Test, writer in another thread, buffer size " + lexical_cast<string>(bufferSize) + ": " + lexical_cast<string>(microsPerComm) + " microseconds per communication");
+	}
+
+	static TestResult shmPerfTest0()
+	{
+		return _shmPerfTest(0);
+	}
+
+	static TestResult shmPerfTest1()
+	{
+		return _shmPerfTest(64);
+	}
+
+	std::list<TestResult (*)()> tests()
+	{
+		return list_of<TestResult (*) ()>
+			(testBuffered) (testUnbuffered) (testExt) (testPoison) (testAlt) (testMismatch) (testOSProcess)
+		;
+	}
+
+	std::list<TestResult (*)()> perfTests()
+	{
+		return list_of<TestResult (*) ()>
+			(shmPerfTest0) (shmPerfTest1)
+		;
+	}
+
+#else
+
+	//SharedMemoryChannel is only available on Linux:
+
+	std::list<TestResult (*)()> tests()
+	{
+		return std::list<TestResult (*)()>();
+	}
+
+	std::list<TestResult (*)()> perfTests()
+	{
+		return std::list<TestResult (*)()>();
+	}
+
+#endif //CPPCSP_LINUX
+
+	inline virtual ~ShmChannelTest()
+	{
+	}
+};
+
+Test* GetShmChannelTest()
+{
+	return new ShmChannelTest;
+}
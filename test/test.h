@@ -364,9 +364,14 @@ Test* GetTimeTest();
 Test* GetBufferedChannelTest();
 Test* GetAltChannelTest();
 Test* GetNetChannelTest();
+Test* GetNamedChannelTest();
+Test* GetFileIOTest();
+Test* GetBroadcastChannelTest();
+Test* GetShmChannelTest();
+Test* GetInstrumentedChannelTest();
 
 inline std::list<Test*> GetAllTests()
 {
-	return boost::assign::list_of (GetBarrierTest()) (GetRunTest()) (GetChannelTest()) (GetMutexTest()) (GetAltTest()) (GetTimeTest()) (GetBufferedChannelTest()) (GetAltChannelTest()) (GetNetChannelTest());
+	return boost::assign::list_of (GetBarrierTest()) (GetRunTest()) (GetChannelTest()) (GetMutexTest()) (GetAltTest()) (GetTimeTest()) (GetBufferedChannelTest()) (GetAltChannelTest()) (GetNetChannelTest()) (GetNamedChannelTest()) (GetFileIOTest()) (GetBroadcastChannelTest()) (GetShmChannelTest()) (GetInstrumentedChannelTest());
 }
 